@@ -1,6 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/eventfd.h>
 #include <sys/prctl.h>
 #include <unistd.h>
 #include <stddef.h>
@@ -8,93 +12,37 @@
 #include "app_ipcam_ll.h"
 
 
-#define LL_DATA_CACHE_DEPTH_MAX     30
+#define LL_DATA_RING_MASK       (APP_DATA_RING_DEPTH - 1)
+#define LL_DATA_POLL_TIMEOUT    100     /* ms, only bounds the shutdown latency */
+#define LL_DATA_DROP_LOG_GAP    1000000 /* us between two drop reports */
 
-#define LL_INIT(N) ((N)->next = (N)->prev = (N))
-
-#define LL_HEAD(H) struct llhead H = { &H, &H }
-
-#define LL_ENTRY(P,T,N) ((T *)((char *)(P) - offsetof(T, N)))
-
-#define LL_ADD(H, N) do {       \
-    ((H)->next)->prev = (N);    \
-    (N)->next = ((H)->next);    \
-    (N)->prev = (H);            \
-    (H)->next = (N);            \
-} while (0)
-
-#define LL_TAIL(H, N) do {      \
-    ((H)->prev)->next = (N);    \
-    (N)->prev = ((H)->prev);    \
-    (N)->next = (H);            \
-    (H)->prev = (N);            \
-} while (0)
-
-#define LL_DEL(N) do {                  \
-    ((N)->next)->prev = ((N)->prev);    \
-    ((N)->prev)->next = ((N)->next);    \
-    LL_INIT(N);                         \
-} while (0)
-
-#define LL_EMPTY(N) ((N)->next == (N))
-
-#define LL_FOREACH(H,N) for (N = (H)->next; N != (H); N = (N)->next)
-
-#define LL_FOREACH_SAFE(H,N,T)  for (N = (H)->next, T = (N)->next; N != (H); N = (T), T = (N)->next)
-
-#define LL_DATA_NODE_DEL(pNode) do {                \
-    if (pNode != NULL) {                            \
-        ((pNode)->next)->prev = ((pNode)->prev);    \
-        ((pNode)->prev)->next = ((pNode)->next);    \
-    }                                               \
-} while(0)
-
-#define container_of(ptr, type, member) ({          \
-    const typeof(((type *)0)->member) *mptr = ptr;  \
-    (type *)((char *)mptr-offsetof(type, member));  \
-})
-
-#define LINK_LIST_DATA_POP_FRONT(PopPoint, Head, member) ({             \
-    if(Head->next == Head) {                                            \
-        PopPoint = NULL;                                                \
-    } else {                                                            \
-        PopPoint = container_of(Head->next, typeof(*PopPoint), member); \
-        LL_DATA_NODE_DEL(Head->next);                                   \
-    }                                                                   \
-})
-
-#define LINK_LIST_DATA_PUSH_TAIL(H, N) do { \
-    ((H)->prev)->next = (N);                \
-    (N)->prev = ((H)->prev);                \
-    (N)->next = (H);                        \
-    (H)->prev = (N);                        \
-} while (0)
-
-int app_ipcam_LList_Data_Pop(void **pData, void *pArgs)
+static uint64_t app_ipcam_LList_Now_Us(void)
 {
-    APP_DATA_CTX_S *pstDataCtx = (APP_DATA_CTX_S *)pArgs;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 
-    APP_LINK_LIST_S *pHeadLink = &pstDataCtx->stHead.link;
-    if (LL_EMPTY(pHeadLink)) {
-        return -1;
+static void app_ipcam_LList_Data_Wakeup(APP_DATA_CTX_S *pstDataCtx)
+{
+    uint64_t u64One = 1;
+    if (write(pstDataCtx->s32EventFd, &u64One, sizeof(u64One)) != sizeof(u64One)) {
+        /* counter saturated, the consumer is awake anyway */
     }
+}
 
-    APP_DATA_LL_S *pNodePop = NULL;
-
-    pthread_mutex_lock(&pstDataCtx->mutex);
-    LINK_LIST_DATA_POP_FRONT(pNodePop, pHeadLink, link);
-    if(pNodePop) {
-        pstDataCtx->LListDepth--;
-    }
-    pthread_mutex_unlock(&pstDataCtx->mutex);
+static int app_ipcam_LList_Data_Pop(APP_DATA_ITEM_S *pItem, APP_DATA_CTX_S *pstDataCtx)
+{
+    uint32_t u32Head = pstDataCtx->u32Head;
+    uint32_t u32Tail = __atomic_load_n(&pstDataCtx->u32Tail, __ATOMIC_ACQUIRE);
 
-    if(pNodePop) {
-        *pData = pNodePop->pData;
-        free(pNodePop);
-    } else {
+    if (u32Head == u32Tail) {
         return -1;
     }
 
+    *pItem = pstDataCtx->astRing[u32Head & LL_DATA_RING_MASK];
+    __atomic_store_n(&pstDataCtx->u32Head, u32Head + 1, __ATOMIC_RELEASE);
+
     return 0;
 }
 
@@ -107,85 +55,89 @@ int app_ipcam_LList_Data_Push(void *pData, void *pArgs)
 
     APP_DATA_CTX_S *pstDataCtx = (APP_DATA_CTX_S *)pArgs;
     APP_DATA_PARAM_S *pstDataParam = &pstDataCtx->stDataParam;
-    APP_DATA_LL_S *pHead = &pstDataCtx->stHead;
+    APP_DATA_STAT_S *pstStat = &pstDataCtx->stStat;
 
     if (!pstDataCtx->bRunStatus) {
         printf("Link List Cache Not Running Now!!\n");
         return -1;
     }
 
-    APP_DATA_LL_S *pNewNode = NULL;
-    pNewNode = (APP_DATA_LL_S *)malloc(sizeof(APP_DATA_LL_S));
-    if(pNewNode == NULL) {
-        printf("pNewNode malloc failed!\n");
+    uint32_t u32Tail = pstDataCtx->u32Tail;
+    uint32_t u32Head = __atomic_load_n(&pstDataCtx->u32Head, __ATOMIC_ACQUIRE);
+    uint32_t u32Depth = u32Tail - u32Head;
+
+    pstStat->u64Pushed++;
+
+    if (u32Depth >= APP_DATA_RING_DEPTH) {
+        /* only the consumer may pop, so the producer drops the incoming item */
+        static __thread uint64_t u64LastLogUs = 0;
+        static __thread uint64_t u64LastDropped = 0;
+        uint64_t u64NowUs = app_ipcam_LList_Now_Us();
+        pstStat->u64Dropped++;
+        if (u64NowUs - u64LastLogUs > LL_DATA_DROP_LOG_GAP) {
+            printf("data ring is full, dropped %llu item(s) (depth:%u)\n",
+                (unsigned long long)(pstStat->u64Dropped - u64LastDropped), u32Depth);
+            u64LastLogUs = u64NowUs;
+            u64LastDropped = pstStat->u64Dropped;
+        }
         return -1;
     }
 
-    pNewNode->pData = NULL;
-
-    if (pstDataParam->fpDataSave(&pNewNode->pData, pData) != 0) {
-        free(pNewNode);
+    APP_DATA_ITEM_S *pItem = &pstDataCtx->astRing[u32Tail & LL_DATA_RING_MASK];
+    pItem->pData = NULL;
+    if (pstDataParam->fpDataSave(&pItem->pData, pData) != 0) {
         printf("data save failded!\n");
         return -1;
     }
+    pItem->u64PushUs = app_ipcam_LList_Now_Us();
 
-    if (pstDataCtx->LListDepth > LL_DATA_CACHE_DEPTH_MAX) {
-        void *pDataDrop = NULL;
-        printf("LL cache is full and drop data. (LList depth:%d > Max:%d) \n", pstDataCtx->LListDepth, LL_DATA_CACHE_DEPTH_MAX);
-        if (app_ipcam_LList_Data_Pop(&pDataDrop, pArgs) != 0) {
-            free(pNewNode);
-            printf("LL data drop failded!\n");
-            return -1;
-        }
-        if(pDataDrop) {
-            if(pstDataParam->fpDataFree) {
-                pstDataParam->fpDataFree(&pDataDrop);
-            }
-            pDataDrop = NULL;
-        }
-    }
+    __atomic_store_n(&pstDataCtx->u32Tail, u32Tail + 1, __ATOMIC_RELEASE);
 
-    pthread_mutex_lock(&pstDataCtx->mutex);
-    APP_LINK_LIST_S *pHeadLink = &pHead->link;
-    APP_LINK_LIST_S *pNodeLink = &pNewNode->link;
-    if (pHeadLink == NULL || pNodeLink == NULL) {
-        printf(" pHeadLink or pNodeLink is NULL\n");
-        pthread_mutex_unlock(&pstDataCtx->mutex);
-        return -1;
+    u32Depth++;
+    if (u32Depth > pstStat->u32PeakDepth) {
+        pstStat->u32PeakDepth = u32Depth;
     }
 
-    LINK_LIST_DATA_PUSH_TAIL(pHeadLink, pNodeLink);
-
-    pstDataCtx->LListDepth++;
-    pthread_mutex_unlock(&pstDataCtx->mutex);
+    app_ipcam_LList_Data_Wakeup(pstDataCtx);
 
     return 0;
-
 }
 
 static void *Thread_LList_Data_Consume(void *pArgs)
 {
     APP_DATA_CTX_S *pstDataCtx = (APP_DATA_CTX_S *)pArgs;
     APP_DATA_PARAM_S *pstDataParam = &pstDataCtx->stDataParam;
-    
-    void *pData = NULL;
+    APP_DATA_STAT_S *pstStat = &pstDataCtx->stStat;
+    APP_DATA_ITEM_S stItem;
+    struct pollfd stPollFd = { .fd = pstDataCtx->s32EventFd, .events = POLLIN };
+    uint64_t u64Count = 0;
+
     char TaskName[32] = {0};
 
     sprintf(TaskName, "DataConsume");
     prctl(PR_SET_NAME, TaskName, 0, 0, 0);
     while(pstDataCtx->bRunStatus) {
-        if(app_ipcam_LList_Data_Pop(&pData, pArgs) == 0) {
-            if(pData != NULL) {
+        if (poll(&stPollFd, 1, LL_DATA_POLL_TIMEOUT) <= 0) {
+            continue;
+        }
+        if (read(pstDataCtx->s32EventFd, &u64Count, sizeof(u64Count)) != sizeof(u64Count)) {
+            continue;
+        }
+        while (app_ipcam_LList_Data_Pop(&stItem, pstDataCtx) == 0) {
+            uint32_t u32LatencyUs = (uint32_t)(app_ipcam_LList_Now_Us() - stItem.u64PushUs);
+            pstStat->u32LatencyAvgUs = pstStat->u32LatencyAvgUs - (pstStat->u32LatencyAvgUs >> 3) + (u32LatencyUs >> 3);
+            if (u32LatencyUs > pstStat->u32LatencyMaxUs) {
+                pstStat->u32LatencyMaxUs = u32LatencyUs;
+            }
+            if(stItem.pData != NULL) {
                 if(pstDataParam->fpDataHandle) {
-                    pstDataParam->fpDataHandle(pData, pArgs);
+                    pstDataParam->fpDataHandle(stItem.pData, pArgs);
                 }
                 if(pstDataParam->fpDataFree) {
-                    pstDataParam->fpDataFree(&pData);
+                    pstDataParam->fpDataFree(&stItem.pData);
                 }
-                pData = NULL;
             }
-        } else {
-            usleep(5*1000);
+            pstStat->u64Handled++;
         }
     }
 
@@ -201,18 +153,19 @@ int app_ipcam_LList_Data_Init(void **pCtx, void *pParam)
 
     int s32Ret = 0;
     APP_DATA_PARAM_S *pDataParam = (APP_DATA_PARAM_S *)pParam;
-    APP_DATA_CTX_S *pDataCtx = (APP_DATA_CTX_S *)malloc(sizeof(APP_DATA_CTX_S));
+    APP_DATA_CTX_S *pDataCtx = (APP_DATA_CTX_S *)calloc(1, sizeof(APP_DATA_CTX_S));
     if (pDataCtx == NULL) {
         printf("pDataCtx is NULL\n");
         return -1;
     }
 
     pDataCtx->stDataParam = *pDataParam;
-    pDataCtx->LListDepth = 0;
-    pthread_mutex_init(&pDataCtx->mutex, NULL);
-
-    /* init link list head */
-    LL_INIT(&pDataCtx->stHead.link);
+    pDataCtx->s32EventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (pDataCtx->s32EventFd < 0) {
+        printf("eventfd create failed\n");
+        s32Ret = -1;
+        goto EXIT;
+    }
 
     pDataCtx->bRunStatus = true;
     s32Ret = pthread_create(&pDataCtx->pthread_id,
@@ -220,7 +173,7 @@ int app_ipcam_LList_Data_Init(void **pCtx, void *pParam)
                             Thread_LList_Data_Consume,
                             (void *)pDataCtx);
     if (s32Ret != 0) {
-        pthread_mutex_destroy(&pDataCtx->mutex);
+        close(pDataCtx->s32EventFd);
         goto EXIT;
     }
 
@@ -229,10 +182,7 @@ int app_ipcam_LList_Data_Init(void **pCtx, void *pParam)
     return s32Ret;
 
 EXIT:
-    if(pDataCtx != NULL) {
-        free(pDataCtx);
-    }
-    pDataCtx->bRunStatus = false;
+    free(pDataCtx);
 
     return s32Ret;
 }
@@ -246,25 +196,35 @@ int app_ipcam_LList_Data_DeInit(void * *pCtx)
 
     APP_DATA_CTX_S *pstDataCtx = *pCtx;
     APP_DATA_PARAM_S *pstDataParam = &pstDataCtx->stDataParam;
+    APP_DATA_ITEM_S stItem;
 
-    void *pDataDrop = NULL;
     pstDataCtx->bRunStatus = false;
+    app_ipcam_LList_Data_Wakeup(pstDataCtx);
 
     pthread_join(pstDataCtx->pthread_id, NULL);
 
-    while(app_ipcam_LList_Data_Pop(&pDataDrop, *pCtx) == 0) {
-        if(pDataDrop) {
-            if(pstDataParam->fpDataFree) {
-                pstDataParam->fpDataFree(&pDataDrop);
-            }
-            pDataDrop = NULL;
+    while(app_ipcam_LList_Data_Pop(&stItem, pstDataCtx) == 0) {
+        if(stItem.pData && pstDataParam->fpDataFree) {
+            pstDataParam->fpDataFree(&stItem.pData);
         }
     }
-    pstDataCtx->LListDepth = 0;
-    pthread_mutex_destroy(&pstDataCtx->mutex);
+    close(pstDataCtx->s32EventFd);
 
     free(*pCtx);
     *pCtx = NULL;
 
     return 0;
 }
+
+int app_ipcam_LList_Data_Stat_Get(void *pCtx, APP_DATA_STAT_S *pstStat)
+{
+    if ((pCtx == NULL) || (pstStat == NULL)) {
+        return -1;
+    }
+
+    APP_DATA_CTX_S *pstDataCtx = (APP_DATA_CTX_S *)pCtx;
+    *pstStat = pstDataCtx->stStat;
+    pstStat->u32Depth = __atomic_load_n(&pstDataCtx->u32Tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&pstDataCtx->u32Head, __ATOMIC_ACQUIRE);
+
+    return 0;
+}
@@ -2,6 +2,8 @@
 #define __APP_IPCAM_LL_H__
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -10,20 +12,16 @@ extern "C"
 
 #define APP_LL_CONTEXT_MAX      8
 #define APP_DATA_COMSUMES_MAX   8
+#define APP_DATA_RING_DEPTH     32  /* power of two */
 
 typedef int (*pfpDataSave)(void **dst, void *src);
 typedef int (*pfpDataFree)(void **src);
 typedef void (*pfpDataHandle)(void *data, void *param);
 
-typedef struct llhead {
-    struct llhead *prev;
-    struct llhead *next;
-} APP_LINK_LIST_S;
-
-typedef struct APP_DATA_LL_T {
-    APP_LINK_LIST_S link;
+typedef struct APP_DATA_ITEM_T {
     void *pData;
-} APP_DATA_LL_S;
+    uint64_t u64PushUs;
+} APP_DATA_ITEM_S;
 
 typedef struct APP_DATA_PARAM_T {
     void *pParam;
@@ -32,27 +30,35 @@ typedef struct APP_DATA_PARAM_T {
     pfpDataHandle fpDataHandle;
 } APP_DATA_PARAM_S;
 
+typedef struct APP_DATA_STAT_T {
+    uint32_t u32Depth;          /* items waiting, filled in by app_ipcam_LList_Data_Stat_Get */
+    uint32_t u32PeakDepth;      /* high-water mark */
+    uint64_t u64Pushed;
+    uint64_t u64Handled;
+    uint64_t u64Dropped;        /* ring full, newest item discarded */
+    uint32_t u32LatencyAvgUs;   /* push to handle, moving average */
+    uint32_t u32LatencyMaxUs;
+} APP_DATA_STAT_S;
+
+/* single producer (push) / single consumer (worker thread) ring, woken through an eventfd */
 typedef struct APP_DATA_CTX_T {
-    APP_DATA_LL_S stHead;
-    int LListDepth;
+    APP_DATA_ITEM_S astRing[APP_DATA_RING_DEPTH];
+    uint32_t u32Head;
+    uint32_t u32Tail;
+    int s32EventFd;
     bool bRunStatus;
     pthread_t pthread_id;
-    pthread_mutex_t mutex;
+    APP_DATA_STAT_S stStat;
     APP_DATA_PARAM_S stDataParam;
 } APP_DATA_CTX_S;
 
 int app_ipcam_LList_Data_Init(void * *pCtx, void *pParam);
 int app_ipcam_LList_Data_DeInit(void * *pCtx);
 int app_ipcam_LList_Data_Push(void *pData, void *pArgs);
+int app_ipcam_LList_Data_Stat_Get(void *pCtx, APP_DATA_STAT_S *pstStat);
 
 #ifdef __cplusplus
 }
 #endif
 
 #endif
-
-
-
-
-
-
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "app_ipcam_ref.h"
+
+/*
+ * Fixed pool of refcounted handles for buffers owned by a producer that must
+ * get them back in the order it handed them out (e.g. VENC stream buffers).
+ * Handles are allocated round-robin; when the last reference of a handle is
+ * dropped it is marked done, and every done handle at the head is returned
+ * through fpRelease. A buffer is never returned while it is still referenced:
+ * Alloc waits for the head handle once u32Depth handles are in flight, and
+ * DeInit waits for the last one.
+ */
+
+static void app_ipcam_Ref_Drain(APP_REF_POOL_S *pstPool)
+{
+    while (pstPool->u32Head != pstPool->u32Tail) {
+        APP_REF_HANDLE_S *pHandle = &pstPool->astHandle[pstPool->u32Head % pstPool->u32Depth];
+        if (!pHandle->bDone) {
+            break;
+        }
+        if (pstPool->fpRelease) {
+            pstPool->fpRelease(pHandle->pPayload, pstPool->pArgs);
+        }
+        pHandle->bDone = false;
+        pstPool->u32Head++;
+    }
+}
+
+int app_ipcam_Ref_Pool_Init(void **pCtx, int s32Depth, size_t payloadSize, pfpRefRelease fpRelease, void *pArgs)
+{
+    if ((pCtx == NULL) || (s32Depth <= 0) || (s32Depth > APP_REF_INFLIGHT_MAX)) {
+        printf("ref pool invalid param, depth:%d (max:%d)\n", s32Depth, APP_REF_INFLIGHT_MAX);
+        return -1;
+    }
+
+    APP_REF_POOL_S *pstPool = (APP_REF_POOL_S *)calloc(1, sizeof(APP_REF_POOL_S));
+    if (pstPool == NULL) {
+        printf("pstPool malloc failed!\n");
+        return -1;
+    }
+
+    if (payloadSize > 0) {
+        pstPool->pPayloadBuf = calloc(s32Depth, payloadSize);
+        if (pstPool->pPayloadBuf == NULL) {
+            printf("pPayloadBuf malloc failed!\n");
+            free(pstPool);
+            return -1;
+        }
+    }
+
+    pstPool->u32Depth = s32Depth;
+    pstPool->fpRelease = fpRelease;
+    pstPool->pArgs = pArgs;
+    for (int i = 0; i < s32Depth; i++) {
+        pstPool->astHandle[i].pPool = pstPool;
+        pstPool->astHandle[i].pPayload = pstPool->pPayloadBuf ? (char *)pstPool->pPayloadBuf + i * payloadSize : NULL;
+    }
+
+    pthread_mutex_init(&pstPool->mutex, NULL);
+    pthread_cond_init(&pstPool->cond, NULL);
+
+    *pCtx = pstPool;
+
+    return 0;
+}
+
+static void app_ipcam_Ref_Deadline(struct timespec *pTs, int s32TimeoutMs)
+{
+    clock_gettime(CLOCK_REALTIME, pTs);
+    pTs->tv_sec += s32TimeoutMs / 1000;
+    pTs->tv_nsec += (s32TimeoutMs % 1000) * 1000000L;
+    if (pTs->tv_nsec >= 1000000000L) {
+        pTs->tv_sec++;
+        pTs->tv_nsec -= 1000000000L;
+    }
+}
+
+/* waits for every handle in flight, reporting them each s32TimeoutMs until they are back */
+int app_ipcam_Ref_Pool_DeInit(void **pCtx, int s32TimeoutMs)
+{
+    if ((pCtx == NULL) || (*pCtx == NULL)) {
+        printf("pCtx or *pCtx is NULL\n");
+        return -1;
+    }
+
+    APP_REF_POOL_S *pstPool = (APP_REF_POOL_S *)*pCtx;
+    struct timespec ts;
+
+    pthread_mutex_lock(&pstPool->mutex);
+    pstPool->bClosing = true;
+    pthread_cond_broadcast(&pstPool->cond);
+    app_ipcam_Ref_Deadline(&ts, s32TimeoutMs);
+    while (pstPool->u32Head != pstPool->u32Tail) {
+        if (pthread_cond_timedwait(&pstPool->cond, &pstPool->mutex, &ts) == ETIMEDOUT) {
+            printf("ref pool deinit waiting on %u handle(s) in flight\n", pstPool->u32Tail - pstPool->u32Head);
+            app_ipcam_Ref_Deadline(&ts, s32TimeoutMs);
+        }
+    }
+    pthread_mutex_unlock(&pstPool->mutex);
+
+    pthread_mutex_destroy(&pstPool->mutex);
+    pthread_cond_destroy(&pstPool->cond);
+    if (pstPool->pPayloadBuf) {
+        free(pstPool->pPayloadBuf);
+    }
+    free(pstPool);
+    *pCtx = NULL;
+
+    return 0;
+}
+
+/* waits up to s32TimeoutMs for the head handle when u32Depth are in flight, NULL on timeout or while closing */
+APP_REF_HANDLE_S *app_ipcam_Ref_Alloc(void *pCtx, int s32TimeoutMs)
+{
+    APP_REF_POOL_S *pstPool = (APP_REF_POOL_S *)pCtx;
+    APP_REF_HANDLE_S *pHandle = NULL;
+    struct timespec ts;
+
+    if (pstPool == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pstPool->mutex);
+    if (!pstPool->bClosing && (pstPool->u32Tail - pstPool->u32Head >= pstPool->u32Depth) && (s32TimeoutMs > 0)) {
+        app_ipcam_Ref_Deadline(&ts, s32TimeoutMs);
+        while (!pstPool->bClosing && (pstPool->u32Tail - pstPool->u32Head >= pstPool->u32Depth)) {
+            if (pthread_cond_timedwait(&pstPool->cond, &pstPool->mutex, &ts) == ETIMEDOUT) {
+                break;
+            }
+        }
+    }
+    if (!pstPool->bClosing && (pstPool->u32Tail - pstPool->u32Head < pstPool->u32Depth)) {
+        pHandle = &pstPool->astHandle[pstPool->u32Tail % pstPool->u32Depth];
+        pHandle->refCnt = 1;
+        pHandle->bDone = false;
+        pstPool->u32Tail++;
+        pstPool->u64Alloc++;
+        if (pstPool->u32Tail - pstPool->u32Head > pstPool->u32Peak) {
+            pstPool->u32Peak = pstPool->u32Tail - pstPool->u32Head;
+        }
+    } else {
+        pstPool->u64Exhausted++;
+    }
+    pthread_mutex_unlock(&pstPool->mutex);
+
+    return pHandle;
+}
+
+void app_ipcam_Ref_Get(APP_REF_HANDLE_S *pHandle)
+{
+    if (pHandle == NULL) {
+        return;
+    }
+    __atomic_add_fetch(&pHandle->refCnt, 1, __ATOMIC_RELAXED);
+}
+
+void app_ipcam_Ref_Put(APP_REF_HANDLE_S *pHandle)
+{
+    if (pHandle == NULL) {
+        return;
+    }
+    if (__atomic_sub_fetch(&pHandle->refCnt, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+
+    APP_REF_POOL_S *pstPool = (APP_REF_POOL_S *)pHandle->pPool;
+
+    pthread_mutex_lock(&pstPool->mutex);
+    pHandle->bDone = true;
+    app_ipcam_Ref_Drain(pstPool);
+    pthread_cond_broadcast(&pstPool->cond);
+    pthread_mutex_unlock(&pstPool->mutex);
+}
+
+int app_ipcam_Ref_InFlight(void *pCtx)
+{
+    APP_REF_POOL_S *pstPool = (APP_REF_POOL_S *)pCtx;
+    int s32InFlight = 0;
+
+    if (pstPool == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&pstPool->mutex);
+    s32InFlight = pstPool->u32Tail - pstPool->u32Head;
+    pthread_mutex_unlock(&pstPool->mutex);
+
+    return s32InFlight;
+}
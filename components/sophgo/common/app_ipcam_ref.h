@@ -0,0 +1,52 @@
+#ifndef __APP_IPCAM_REF_H__
+#define __APP_IPCAM_REF_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define APP_REF_INFLIGHT_MAX    16
+
+/* called once per handle when the last reference is dropped, in allocation order */
+typedef void (*pfpRefRelease)(void *pPayload, void *pArgs);
+
+typedef struct APP_REF_HANDLE_T {
+    void *pPool;
+    int refCnt;
+    bool bDone;
+    void *pPayload;
+} APP_REF_HANDLE_S;
+
+typedef struct APP_REF_POOL_T {
+    APP_REF_HANDLE_S astHandle[APP_REF_INFLIGHT_MAX];
+    unsigned int u32Head;
+    unsigned int u32Tail;
+    unsigned int u32Depth;
+    unsigned int u32Peak;
+    unsigned long long u64Alloc;
+    unsigned long long u64Exhausted;
+    bool bClosing;
+    void *pPayloadBuf;
+    pfpRefRelease fpRelease;
+    void *pArgs;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} APP_REF_POOL_S;
+
+int app_ipcam_Ref_Pool_Init(void **pCtx, int s32Depth, size_t payloadSize, pfpRefRelease fpRelease, void *pArgs);
+int app_ipcam_Ref_Pool_DeInit(void **pCtx, int s32TimeoutMs);
+APP_REF_HANDLE_S *app_ipcam_Ref_Alloc(void *pCtx, int s32TimeoutMs);
+void app_ipcam_Ref_Get(APP_REF_HANDLE_S *pHandle);
+void app_ipcam_Ref_Put(APP_REF_HANDLE_S *pHandle);
+int app_ipcam_Ref_InFlight(void *pCtx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -4,6 +4,7 @@
 #include <cvi_venc.h>
 
 #include "app_ipcam_ll.h"
+#include "app_ipcam_ref.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -175,6 +176,7 @@ typedef struct APP_RC_PARAM_T {
 typedef struct APP_VENC_CHN_CFG_T {
     CVI_BOOL bEnable;   /* set by param_config.ini , DO NOT update by coding */
     CVI_BOOL bStart;
+    CVI_BOOL bPause;    /* started but not receiving frames, see app_ipcam_Venc_Pause() */
     VENC_CHN VencChn;
     PAYLOAD_TYPE_E enType;
     // CVI_U32 StreamTo;
@@ -210,6 +212,9 @@ typedef struct APP_VENC_CHN_CFG_T {
     CVI_CHAR SavePath[32];
     // volatile CVI_S32 savePic;
     CVI_BOOL no_need_venc;
+    CVI_U32 u32InFlight; /* zero-copy: max streams held by consumers, 0 copies every stream */
+    CVI_S32 s32Timeout;      /* GetStream timeout in ms, 0 until first derived from the frame rate */
+    CVI_U32 u32TimeoutStamp; /* when s32Timeout was last derived */
 } APP_VENC_CHN_CFG_S;
 
 typedef struct APP_VENC_ROI_CFG_T {
@@ -239,6 +244,13 @@ char *app_ipcam_Postfix_Get(PAYLOAD_TYPE_E enPayload);
 int app_ipcam_Venc_Init(APP_VENC_CHN_E VencIdx);
 int app_ipcam_Venc_Start(APP_VENC_CHN_E VencIdx);
 int app_ipcam_Venc_Stop(APP_VENC_CHN_E VencIdx);
+int app_ipcam_Venc_Data_Stat_Get(VENC_CHN VencChn, APP_DATA_STAT_S *pstStat);
+int app_ipcam_Venc_ZeroCopy_Set(VENC_CHN VencChn, CVI_U32 u32InFlight);
+int app_ipcam_Venc_Harvest_Set(CVI_BOOL bSingle);
+int app_ipcam_Venc_IDR_Request(VENC_CHN VencChn);
+int app_ipcam_Venc_Pause(VENC_CHN VencChn, CVI_BOOL bPause);
+void *app_ipcam_Venc_Stream_Hold(void);
+void app_ipcam_Venc_Stream_Drop(void *pHandle);
 
 #ifdef __cplusplus
 }
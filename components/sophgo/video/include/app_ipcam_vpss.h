@@ -32,9 +32,23 @@ typedef struct APP_PARAM_VPSS_CFG_S {
     APP_VPSS_GRP_CFG_T astVpssGrpCfg[CVI_MAX_VPSS_GRP];
 } APP_PARAM_VPSS_CFG_T;
 
+/* one crop of an RGB888 frame in ION memory, scaled into a packed RGB888 buffer */
+typedef struct APP_VPSS_CROP_T {
+    CVI_U64 u64SrcPhyAddr;
+    CVI_U32 u32SrcWidth;
+    CVI_U32 u32SrcHeight;
+    CVI_U32 u32SrcStride;
+    RECT_S stRect;
+    CVI_U32 u32DstWidth;
+    CVI_U32 u32DstHeight;
+    CVI_VOID *pDst;
+} APP_VPSS_CROP_S;
+
 APP_PARAM_VPSS_CFG_T *app_ipcam_Vpss_Param_Get(void);
 int app_ipcam_Vpss_Init(void);
 int app_ipcam_Vpss_DeInit(void);
+int app_ipcam_Vpss_Crop(const APP_VPSS_CROP_S *pstCrop);
+int app_ipcam_Vpss_Crop_DeInit(void);
 
 #ifdef __cplusplus
 }
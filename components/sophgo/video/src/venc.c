@@ -1,6 +1,8 @@
 
 #include <sys/prctl.h>
+#include <sys/epoll.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <errno.h>
 
 #include <cvi_type.h>
@@ -15,6 +17,10 @@
  **************************************************************************/
 #define H26X_MAX_NUM_PACKS      8
 #define JPEG_MAX_NUM_PACKS      1
+#define VENC_REF_DEINIT_TIMEOUT 500
+#define VENC_TIMEOUT_REFRESH    1000    /* ms between two exposure queries */
+#define VENC_TIMEOUT_DEFAULT    66      /* ms, 30 fps until the ISP reports a rate */
+#define VENC_HARVEST_TIMEOUT    80      /* ms */
 
 /**************************************************************************
  *                           C O N S T A N T S                            *
@@ -23,6 +29,12 @@
 /**************************************************************************
  *                          D A T A    T Y P E S                          *
  **************************************************************************/
+/* zero-copy stream: the encoder buffer stays owned until the last consumer drops it */
+typedef struct APP_VENC_STREAM_REF_T {
+    VENC_CHN VencChn;
+    VENC_STREAM_S stStream;
+    VENC_PACK_S astPack[H26X_MAX_NUM_PACKS];
+} APP_VENC_STREAM_REF_S;
 
 /**************************************************************************
  *                         G L O B A L    D A T A                         *
@@ -35,6 +47,19 @@ static void *g_pDataCtx[VENC_CHN_MAX] = { NULL };
 static void *g_pUserData[VENC_CHN_MAX][APP_DATA_COMSUMES_MAX] = { NULL };
 static pfpDataConsumes g_Consumes[VENC_CHN_MAX][APP_DATA_COMSUMES_MAX] = { NULL };
 
+static void *g_pRefCtx[VENC_CHN_MAX] = { NULL };
+
+static CVI_BOOL g_bHarvestSingle = CVI_FALSE;
+static struct {
+    volatile CVI_BOOL bRun;
+    pthread_t pthread_id;
+    CVI_S32 s32EpollFd;
+    CVI_S32 s32Count;
+    CVI_BOOL abMember[VENC_CHN_MAX];
+    pthread_mutex_t mutex;
+} g_stHarvest = { .s32EpollFd = -1, .mutex = PTHREAD_MUTEX_INITIALIZER };
+static __thread APP_REF_HANDLE_S *t_pStreamRef = NULL; /* stream being dispatched by this thread */
+
 /**************************************************************************
  *                 E X T E R N A L    R E F E R E N C E S                 *
  **************************************************************************/
@@ -63,6 +88,97 @@ int app_ipcam_Venc_Consumes_Set(int chn, int index, pfpDataConsumes consume, voi
     return 0;
 }
 
+int app_ipcam_Venc_Data_Stat_Get(VENC_CHN VencChn, APP_DATA_STAT_S *pstStat)
+{
+    if (VencChn < 0 || VencChn >= VENC_CHN_MAX || g_pDataCtx[VencChn] == NULL) {
+        return -1;
+    }
+
+    return app_ipcam_LList_Data_Stat_Get(g_pDataCtx[VencChn], pstStat);
+}
+
+int app_ipcam_Venc_ZeroCopy_Set(VENC_CHN VencChn, CVI_U32 u32InFlight)
+{
+    if (VencChn < 0 || VencChn >= VENC_CHN_MAX) {
+        return -1;
+    }
+    if (u32InFlight > APP_REF_INFLIGHT_MAX) {
+        u32InFlight = APP_REF_INFLIGHT_MAX;
+    }
+
+    g_pstVencCtx->astVencChnCfg[VencChn].u32InFlight = u32InFlight;
+
+    return 0;
+}
+
+/* ask a running H.264/H.265 channel for an IDR on its next frame, for viewers joining mid-GOP */
+int app_ipcam_Venc_IDR_Request(VENC_CHN VencChn)
+{
+    if (VencChn < 0 || VencChn >= VENC_CHN_MAX || !g_pstVencCtx->astVencChnCfg[VencChn].bStart) {
+        return -1;
+    }
+
+    CVI_S32 s32Ret = CVI_VENC_RequestIDR(VencChn, CVI_TRUE);
+    if (s32Ret != CVI_SUCCESS) {
+        APP_PROF_LOG_PRINT(LEVEL_WARN, "CVI_VENC_RequestIDR vechn[%d] failed with %#x\n", VencChn, s32Ret);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* stop or resume feeding a started channel without tearing it down, so an encoder nobody
+ * watches costs no bandwidth and comes back at once with an IDR */
+int app_ipcam_Venc_Pause(VENC_CHN VencChn, CVI_BOOL bPause)
+{
+    CVI_S32 s32Ret = CVI_SUCCESS;
+
+    if (VencChn < 0 || VencChn >= VENC_CHN_MAX || !g_pstVencCtx->astVencChnCfg[VencChn].bStart) {
+        return -1;
+    }
+
+    APP_VENC_CHN_CFG_S *pstVencChnCfg = &g_pstVencCtx->astVencChnCfg[VencChn];
+    if (pstVencChnCfg->bPause == bPause) {
+        return 0;
+    }
+
+    if (bPause) {
+        s32Ret = CVI_VENC_StopRecvFrame(VencChn);
+    } else {
+        VENC_RECV_PIC_PARAM_S stRecvParam = {0};
+        stRecvParam.s32RecvPicNum = -1;
+        s32Ret = CVI_VENC_StartRecvFrame(VencChn, &stRecvParam);
+        if (s32Ret == CVI_SUCCESS && pstVencChnCfg->enType != PT_JPEG) {
+            CVI_VENC_RequestIDR(VencChn, CVI_TRUE);
+        }
+    }
+    if (s32Ret != CVI_SUCCESS) {
+        APP_PROF_LOG_PRINT(LEVEL_ERROR, "vechn[%d] %s failed with %#x\n", VencChn, bPause ? "pause" : "resume", s32Ret);
+        return -1;
+    }
+
+    pstVencChnCfg->bPause = bPause;
+    APP_PROF_LOG_PRINT(LEVEL_INFO, "vechn[%d] %s\n", VencChn, bPause ? "paused" : "resumed");
+
+    return 0;
+}
+
+/* take a reference on the stream currently passed to a consumer, NULL if it is a copy */
+void *app_ipcam_Venc_Stream_Hold(void)
+{
+    if (t_pStreamRef == NULL) {
+        return NULL;
+    }
+    app_ipcam_Ref_Get(t_pStreamRef);
+
+    return t_pStreamRef;
+}
+
+void app_ipcam_Venc_Stream_Drop(void *pHandle)
+{
+    app_ipcam_Ref_Put((APP_REF_HANDLE_S *)pHandle);
+}
+
 char* app_ipcam_Postfix_Get(PAYLOAD_TYPE_E enPayload)
 {
     if (enPayload == PT_H264)
@@ -873,6 +989,114 @@ static CVI_S32 _Data_Free(void **src)
     return CVI_SUCCESS;
 }
 
+static void _Stream_Release(void *pPayload, void *pArgs)
+{
+    APP_VENC_STREAM_REF_S *pstRef = (APP_VENC_STREAM_REF_S *)pPayload;
+
+    if (pstRef->stStream.u32PackCount == 0) {
+        return;
+    }
+
+    CVI_S32 s32Ret = CVI_VENC_ReleaseStream(pstRef->VencChn, &pstRef->stStream);
+    if (s32Ret != CVI_SUCCESS) {
+        APP_PROF_LOG_PRINT(LEVEL_ERROR, "CVI_VENC_ReleaseStream, s32Ret = %d\n", s32Ret);
+    }
+    pstRef->stStream.u32PackCount = 0;
+}
+
+/* GetStream timeout derived from the sensor frame rate, refreshed at most once per second,
+ * kept per channel since each channel is harvested by its own thread */
+static CVI_S32 app_ipcam_Venc_Timeout_Get(APP_VENC_CHN_CFG_S *pastVencChnCfg)
+{
+    CVI_U32 u32Now = GetCurTimeInMsec();
+
+    if ((pastVencChnCfg->s32Timeout == 0) || (u32Now - pastVencChnCfg->u32TimeoutStamp >= VENC_TIMEOUT_REFRESH)) {
+        ISP_EXP_INFO_S stExpInfo;
+        memset(&stExpInfo, 0, sizeof(stExpInfo));
+        CVI_ISP_QueryExposureInfo(0, &stExpInfo);
+        if (stExpInfo.u32Fps >= 100) {
+            pastVencChnCfg->s32Timeout = (1000 * 2) / (stExpInfo.u32Fps / 100); // u32Fps = fps * 100
+        } else if (pastVencChnCfg->s32Timeout == 0) {
+            pastVencChnCfg->s32Timeout = VENC_TIMEOUT_DEFAULT;
+        }
+        pastVencChnCfg->u32TimeoutStamp = u32Now;
+    }
+
+    return pastVencChnCfg->s32Timeout;
+}
+
+/* fetch one stream from a ready channel and pass it on, pastPack holds H26X_MAX_NUM_PACKS entries */
+static CVI_S32 app_ipcam_Venc_Stream_Proc(APP_VENC_CHN_CFG_S *pastVencChnCfg, VENC_PACK_S *pastPack, VIDEO_FRAME_INFO_S *pstVpssFrame)
+{
+    CVI_S32 s32Ret = CVI_SUCCESS;
+    VENC_CHN VencChn = pastVencChnCfg->VencChn;
+
+    // get stream
+    VENC_STREAM_S stStream = { 0 }, *pstStream = &stStream;
+    CVI_S32 timeout = app_ipcam_Venc_Timeout_Get(pastVencChnCfg);
+    APP_REF_HANDLE_S *pRef = app_ipcam_Ref_Alloc(g_pRefCtx[VencChn], timeout);
+    if (g_pRefCtx[VencChn] != NULL && pRef == NULL) {
+        /* zero-copy streams go back in GetStream order, so while the oldest one is still held
+         * the next stays in the encoder, which drops frames once its buffer is full */
+        APP_PROF_LOG_PRINT(LEVEL_WARN, "VencChn(%d) all %u streams held, skipped\n", VencChn, pastVencChnCfg->u32InFlight);
+        if (pstVpssFrame != NULL) {
+            CVI_VPSS_ReleaseChnFrame(pastVencChnCfg->VpssGrp, pastVencChnCfg->VpssChn, pstVpssFrame);
+        }
+        return CVI_FAILURE;
+    }
+    if (pRef != NULL) {
+        APP_VENC_STREAM_REF_S *pstRef = (APP_VENC_STREAM_REF_S *)pRef->pPayload;
+        memset(&pstRef->stStream, 0, sizeof(VENC_STREAM_S));
+        pstRef->VencChn = VencChn;
+        pstRef->stStream.pstPack = pstRef->astPack;
+        pstStream = &pstRef->stStream;
+    } else {
+        stStream.pstPack = pastPack;
+    }
+
+    s32Ret = CVI_VENC_GetStream(VencChn, pstStream, timeout);
+    if (pstVpssFrame != NULL) {
+        CVI_VPSS_ReleaseChnFrame(pastVencChnCfg->VpssGrp, pastVencChnCfg->VpssChn, pstVpssFrame);
+    }
+    if (s32Ret != CVI_SUCCESS || (0 == pstStream->u32PackCount)) {
+        APP_PROF_LOG_PRINT(LEVEL_WARN, "CVI_VENC_GetStream, VencChn(%d) cnt(%d), s32Ret = 0x%X timeout:%d\n",
+            VencChn, pstStream->u32PackCount, s32Ret, timeout);
+        pstStream->u32PackCount = 0;
+        app_ipcam_Ref_Put(pRef);
+        return s32Ret;
+    }
+
+    if ((1 == pstStream->u32PackCount) && (pstStream->pstPack[0].u32Len > P_MAX_SIZE)) {
+        APP_PROF_LOG_PRINT(LEVEL_WARN, "CVI_VENC_GetStream, VencChn(%d) p oversize:%d\n",
+            VencChn, pstStream->pstPack[0].u32Len);
+    } else if (g_pRefCtx[VencChn] != NULL) {
+        /* zero-copy mode: hand the encoder buffer to the consumers directly, they take
+         * a reference through app_ipcam_Venc_Stream_Hold() */
+        t_pStreamRef = pRef;
+        _Data_Handle(pstStream, g_pDataCtx[VencChn]);
+        t_pStreamRef = NULL;
+    } else {
+        /* save streaming to LinkList and proc it in another thread */
+        s32Ret = app_ipcam_LList_Data_Push(pstStream, g_pDataCtx[VencChn]);
+        if (s32Ret != CVI_SUCCESS) {
+            APP_PROF_LOG_PRINT(LEVEL_ERROR, "Venc %d streaming push linklist failed!\n", VencChn);
+        }
+    }
+
+    if (pRef != NULL) {
+        /* drop the harvester's reference, the stream is released once consumers are done */
+        app_ipcam_Ref_Put(pRef);
+        return CVI_SUCCESS;
+    }
+
+    s32Ret = CVI_VENC_ReleaseStream(VencChn, pstStream);
+    if (s32Ret != CVI_SUCCESS) {
+        APP_PROF_LOG_PRINT(LEVEL_ERROR, "CVI_VENC_ReleaseStream, s32Ret = %d\n", s32Ret);
+    }
+
+    return s32Ret;
+}
+
 static void* Thread_Streaming_Proc(void* pArgs)
 {
     CVI_S32 s32Ret = CVI_SUCCESS;
@@ -881,13 +1105,13 @@ static void* Thread_Streaming_Proc(void* pArgs)
     CVI_S32 vpssGrp = pastVencChnCfg->VpssGrp;
     CVI_S32 vpssChn = pastVencChnCfg->VpssChn;
     CVI_S32 iTime = GetCurTimeInMsec();
+    VENC_PACK_S astPack[H26X_MAX_NUM_PACKS];
 
     CVI_CHAR TaskName[64] = { '\0' };
     sprintf(TaskName, "Thread_Venc%d_Proc", VencChn);
     prctl(PR_SET_NAME, TaskName, 0, 0, 0);
     APP_PROF_LOG_PRINT(LEVEL_INFO, "Venc channel_%d start running\n", VencChn);
 
-    pastVencChnCfg->bStart = CVI_TRUE;
     while (pastVencChnCfg->bStart) {
         VIDEO_FRAME_INFO_S stVpssFrame = { 0 };
 
@@ -944,51 +1168,122 @@ static void* Thread_Streaming_Proc(void* pArgs)
             continue;
         }
 
-        // get stream
-        VENC_STREAM_S stStream = { 0 };
-        stStream.pstPack = (VENC_PACK_S*)malloc(sizeof(VENC_PACK_S) * H26X_MAX_NUM_PACKS);
-        if (stStream.pstPack == NULL) {
-            APP_PROF_LOG_PRINT(LEVEL_ERROR, "streaming malloc memory failed!\n");
+        app_ipcam_Venc_Stream_Proc(pastVencChnCfg, astPack,
+            (pastVencChnCfg->enBindMode == VENC_BIND_DISABLE) ? &stVpssFrame : NULL);
+    }
+
+    return (CVI_VOID*)CVI_SUCCESS;
+}
+
+/* single harvester: one epoll set over every VPSS-bound channel */
+static void* Thread_Streaming_Harvest(void* pArgs)
+{
+    struct epoll_event astEvents[VENC_CHN_MAX];
+    static VENC_PACK_S astPack[VENC_CHN_MAX][H26X_MAX_NUM_PACKS];
+
+    prctl(PR_SET_NAME, "Thread_Venc_Harvest", 0, 0, 0);
+    APP_PROF_LOG_PRINT(LEVEL_INFO, "Venc harvester start running\n");
+
+    while (g_stHarvest.bRun) {
+        CVI_S32 s32Cnt = epoll_wait(g_stHarvest.s32EpollFd, astEvents, VENC_CHN_MAX, VENC_HARVEST_TIMEOUT);
+        if (s32Cnt < 0) {
+            if (errno == EINTR)
+                continue;
+            APP_PROF_LOG_PRINT(LEVEL_ERROR, "venc harvester epoll_wait failed!\n");
             break;
         }
 
-        ISP_EXP_INFO_S stExpInfo;
-        memset(&stExpInfo, 0, sizeof(stExpInfo));
-        CVI_ISP_QueryExposureInfo(0, &stExpInfo);
-        CVI_S32 timeout = (1000 * 2) / (stExpInfo.u32Fps / 100); // u32Fps = fps * 100
-        s32Ret = CVI_VENC_GetStream(VencChn, &stStream, timeout);
-        if (pastVencChnCfg->enBindMode == VENC_BIND_DISABLE) {
-            CVI_VPSS_ReleaseChnFrame(vpssGrp, vpssChn, &stVpssFrame);
-        }
-        if (s32Ret != CVI_SUCCESS || (0 == stStream.u32PackCount)) {
-            APP_PROF_LOG_PRINT(LEVEL_WARN, "CVI_VENC_GetStream, VencChn(%d) cnt(%d), s32Ret = 0x%X timeout:%d %d\n",
-                VencChn, stStream.u32PackCount, s32Ret, timeout, stExpInfo.u32Fps);
-            goto CONTINUE;
+        pthread_mutex_lock(&g_stHarvest.mutex);
+        for (CVI_S32 i = 0; i < s32Cnt; i++) {
+            VENC_CHN VencChn = (VENC_CHN)astEvents[i].data.u32;
+            APP_VENC_CHN_CFG_S *pstVencChnCfg = &g_pstVencCtx->astVencChnCfg[VencChn];
+            /* the channel may have been removed while waiting */
+            if (!pstVencChnCfg->bStart || !g_stHarvest.abMember[VencChn]) {
+                continue;
+            }
+            app_ipcam_Venc_Stream_Proc(pstVencChnCfg, astPack[VencChn], NULL);
         }
+        pthread_mutex_unlock(&g_stHarvest.mutex);
+    }
 
-        if ((1 == stStream.u32PackCount) && (stStream.pstPack[0].u32Len > P_MAX_SIZE)) {
-            APP_PROF_LOG_PRINT(LEVEL_WARN, "CVI_VENC_GetStream, VencChn(%d) p oversize:%d\n",
-                VencChn, stStream.pstPack[0].u32Len);
-        } else {
-            /* save streaming to LinkList and proc it in another thread */
-            s32Ret = app_ipcam_LList_Data_Push(&stStream, g_pDataCtx[VencChn]);
-            if (s32Ret != CVI_SUCCESS) {
-                APP_PROF_LOG_PRINT(LEVEL_ERROR, "Venc %d streaming push linklist failed!\n", VencChn);
-            }
+    return (CVI_VOID*)CVI_SUCCESS;
+}
+
+static CVI_S32 app_ipcam_Venc_Harvest_Add(APP_VENC_CHN_CFG_S *pstVencChnCfg)
+{
+    VENC_CHN VencChn = pstVencChnCfg->VencChn;
+    CVI_S32 vencFd = CVI_VENC_GetFd(VencChn);
+    if (vencFd <= 0) {
+        APP_PROF_LOG_PRINT(LEVEL_ERROR, "CVI_VENC_GetFd failed with%#x!\n", vencFd);
+        return CVI_FAILURE;
+    }
+
+    if (g_stHarvest.s32EpollFd < 0) {
+        g_stHarvest.s32EpollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (g_stHarvest.s32EpollFd < 0) {
+            APP_PROF_LOG_PRINT(LEVEL_ERROR, "venc harvester epoll_create1 failed!\n");
+            return CVI_FAILURE;
         }
+    }
 
-        s32Ret = CVI_VENC_ReleaseStream(VencChn, &stStream);
-        if (s32Ret != CVI_SUCCESS) {
-            APP_PROF_LOG_PRINT(LEVEL_ERROR, "CVI_VENC_ReleaseStream, s32Ret = %d\n", s32Ret);
-            goto CONTINUE;
+    struct epoll_event stEvent = { 0 };
+    stEvent.events = EPOLLIN;
+    stEvent.data.u32 = VencChn;
+
+    pthread_mutex_lock(&g_stHarvest.mutex);
+    if (epoll_ctl(g_stHarvest.s32EpollFd, EPOLL_CTL_ADD, vencFd, &stEvent) != 0) {
+        pthread_mutex_unlock(&g_stHarvest.mutex);
+        APP_PROF_LOG_PRINT(LEVEL_ERROR, "VencChn(%d) epoll_ctl add failed!\n", VencChn);
+        return CVI_FAILURE;
+    }
+    g_stHarvest.abMember[VencChn] = CVI_TRUE;
+    g_stHarvest.s32Count++;
+    pthread_mutex_unlock(&g_stHarvest.mutex);
+
+    if (!g_stHarvest.bRun) {
+        pthread_attr_t pthread_attr;
+        struct sched_param param;
+        pthread_attr_init(&pthread_attr);
+        param.sched_priority = 80;
+        pthread_attr_setschedpolicy(&pthread_attr, SCHED_RR);
+        pthread_attr_setschedparam(&pthread_attr, &param);
+        pthread_attr_setinheritsched(&pthread_attr, PTHREAD_EXPLICIT_SCHED);
+
+        g_stHarvest.bRun = CVI_TRUE;
+        if (pthread_create(&g_stHarvest.pthread_id, &pthread_attr, Thread_Streaming_Harvest, NULL) != 0) {
+            APP_PROF_LOG_PRINT(LEVEL_ERROR, "venc harvester pthread_create failed!\n");
+            g_stHarvest.bRun = CVI_FALSE;
+            return CVI_FAILURE;
         }
+    }
+
+    return CVI_SUCCESS;
+}
 
-    CONTINUE:
-        free(stStream.pstPack);
-        stStream.pstPack = NULL;
+static CVI_VOID app_ipcam_Venc_Harvest_Del(APP_VENC_CHN_CFG_S *pstVencChnCfg)
+{
+    VENC_CHN VencChn = pstVencChnCfg->VencChn;
+    CVI_BOOL bLast = CVI_FALSE;
+
+    pthread_mutex_lock(&g_stHarvest.mutex);
+    epoll_ctl(g_stHarvest.s32EpollFd, EPOLL_CTL_DEL, CVI_VENC_GetFd(VencChn), NULL);
+    g_stHarvest.abMember[VencChn] = CVI_FALSE;
+    bLast = (--g_stHarvest.s32Count == 0);
+    pthread_mutex_unlock(&g_stHarvest.mutex);
+
+    if (bLast && g_stHarvest.bRun) {
+        g_stHarvest.bRun = CVI_FALSE;
+        pthread_join(g_stHarvest.pthread_id, CVI_NULL);
+        close(g_stHarvest.s32EpollFd);
+        g_stHarvest.s32EpollFd = -1;
+        APP_PROF_LOG_PRINT(LEVEL_WARN, "Venc harvester done \n");
     }
+}
 
-    return (CVI_VOID*)CVI_SUCCESS;
+int app_ipcam_Venc_Harvest_Set(CVI_BOOL bSingle)
+{
+    g_bHarvestSingle = bSingle;
+    return CVI_SUCCESS;
 }
 
 static void app_ipcam_VencRemap(void)
@@ -1151,6 +1446,15 @@ int app_ipcam_Venc_Init(APP_VENC_CHN_E VencIdx)
                 goto VENC_EXIT1;
             }
         }
+
+        if (pstVencChnCfg->u32InFlight > 0) {
+            s32Ret = app_ipcam_Ref_Pool_Init(&g_pRefCtx[VencChn], pstVencChnCfg->u32InFlight,
+                sizeof(APP_VENC_STREAM_REF_S), _Stream_Release, NULL);
+            if (s32Ret != CVI_SUCCESS) {
+                APP_PROF_LOG_PRINT(LEVEL_ERROR, "Venc_%d stream ref pool init failed with %#x\n", VencChn, s32Ret);
+                goto VENC_EXIT1;
+            }
+        }
     }
 
     APP_PROF_LOG_PRINT(LEVEL_INFO, "Ven init ------------------> done \n");
@@ -1200,6 +1504,19 @@ int app_ipcam_Venc_Start(APP_VENC_CHN_E VencIdx)
             }
         }
 
+        pstVencChnCfg->bStart = CVI_TRUE;
+        pstVencChnCfg->bPause = CVI_FALSE;
+
+        /* VPSS-bound channels can share one harvester, the others feed the encoder themselves */
+        if (g_bHarvestSingle && (pstVencChnCfg->enBindMode != VENC_BIND_DISABLE)) {
+            if (app_ipcam_Venc_Harvest_Add(pstVencChnCfg) != CVI_SUCCESS) {
+                APP_PROF_LOG_PRINT(LEVEL_ERROR, "[Chn %d]venc harvester add failed\n", VencChn);
+                pstVencChnCfg->bStart = CVI_FALSE;
+                return CVI_FAILURE;
+            }
+            continue;
+        }
+
         pthread_attr_t pthread_attr;
         pthread_attr_init(&pthread_attr);
 
@@ -1242,12 +1559,22 @@ int app_ipcam_Venc_Stop(APP_VENC_CHN_E VencIdx)
             continue;
         pstVencChnCfg->bStart = CVI_FALSE;
 
+        if (g_stHarvest.abMember[VencChn]) {
+            app_ipcam_Venc_Harvest_Del(pstVencChnCfg);
+        }
+
         if (g_Venc_pthread[VencChn] != 0) {
             pthread_join(g_Venc_pthread[VencChn], CVI_NULL);
             APP_PROF_LOG_PRINT(LEVEL_WARN, "Venc_%d Streaming Proc done \n", VencChn);
             g_Venc_pthread[VencChn] = 0;
         }
 
+        if (g_pRefCtx[VencChn] != NULL) {
+            /* streams still held by consumers must go back before the channel is destroyed,
+             * the camera drops the ones it has queued before stopping the video */
+            app_ipcam_Ref_Pool_DeInit(&g_pRefCtx[VencChn], VENC_REF_DEINIT_TIMEOUT);
+        }
+
         if (pstVencChnCfg->enBindMode != VENC_BIND_DISABLE) {
             s32Ret = CVI_SYS_UnBind(&pstVencChnCfg->astChn[0], &pstVencChnCfg->astChn[1]);
             if (s32Ret != CVI_SUCCESS) {
@@ -1256,11 +1583,14 @@ int app_ipcam_Venc_Stop(APP_VENC_CHN_E VencIdx)
             }
         }
 
-        s32Ret = CVI_VENC_StopRecvFrame(VencChn);
-        if (s32Ret != CVI_SUCCESS) {
-            APP_PROF_LOG_PRINT(LEVEL_ERROR,"CVI_VENC_StopRecvFrame vechn[%d] failed with %#x\n", VencChn, s32Ret);
-            return s32Ret;
+        if (!pstVencChnCfg->bPause) {
+            s32Ret = CVI_VENC_StopRecvFrame(VencChn);
+            if (s32Ret != CVI_SUCCESS) {
+                APP_PROF_LOG_PRINT(LEVEL_ERROR,"CVI_VENC_StopRecvFrame vechn[%d] failed with %#x\n", VencChn, s32Ret);
+                return s32Ret;
+            }
         }
+        pstVencChnCfg->bPause = CVI_FALSE;
 
         s32Ret = CVI_VENC_ResetChn(VencChn);
         if (s32Ret != CVI_SUCCESS) {
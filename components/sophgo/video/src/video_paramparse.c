@@ -385,7 +385,8 @@ static void fix_vi_grp_attr(const APP_PARAM_SNS_CFG_T* pstSnsCfg, VPSS_GRP_ATTR_
     }
 }
 
-#define APP_IPCAM_CHN_NUM 3
+#define APP_IPCAM_CHN_NUM      5  // video channels, each with its VB pool and encoder
+#define APP_IPCAM_GRP0_CHN_NUM 4  // of which on group 0, the last one is on group 1
 
 extern ISP_SNS_MIRRORFLIP_TYPE_E g_aeOv5647_MirrorFip[VI_MAX_PIPE_NUM];
 extern ISP_SNS_MIRRORFLIP_TYPE_E g_aeGc2053_MirrorFip[VI_MAX_PIPE_NUM];
@@ -432,7 +433,7 @@ int app_ipcam_Param_Load(void) {
 
     // vpss
     APP_PARAM_VPSS_CFG_T* vpss = app_ipcam_Vpss_Param_Get();
-    vpss->u32GrpCnt            = 1;
+    vpss->u32GrpCnt            = 2;
     vpss->astVpssGrpCfg[0]     = vpss_grp;
     APP_VPSS_GRP_CFG_T* pgrp   = &vpss->astVpssGrpCfg[0];
     pgrp->VpssGrp              = 0;
@@ -446,13 +447,32 @@ int app_ipcam_Param_Load(void) {
     pgrp->astChn[1].enModId       = CVI_ID_VPSS;  // src
     pgrp->astChn[1].s32DevId      = 0;
     pgrp->astChn[1].s32ChnId      = 0;
-    for (uint32_t i = 0; i < APP_IPCAM_CHN_NUM; i++) {
+    for (uint32_t i = 0; i < APP_IPCAM_GRP0_CHN_NUM; i++) {
         pgrp->abChnEnable[i]    = 0;  // default disabled
         pgrp->aAttachEn[i]      = 0;
         pgrp->aAttachPool[i]    = i;
         pgrp->astVpssChnAttr[i] = chn_attr;
     }
 
+    // group 1 scales the H.264 channel of group 0 for the sub stream, enabled by setupVideo()
+    vpss->astVpssGrpCfg[1]        = vpss_grp;
+    pgrp                          = &vpss->astVpssGrpCfg[1];
+    pgrp->VpssGrp                 = 1;
+    pgrp->bEnable                 = 0;
+    pgrp->stVpssGrpAttr           = grp_attr;
+    pgrp->stVpssGrpAttr.u8VpssDev = 0;
+    pgrp->bBindMode               = 1;
+    pgrp->astChn[0].enModId       = CVI_ID_VPSS;  // src
+    pgrp->astChn[0].s32DevId      = 0;
+    pgrp->astChn[0].s32ChnId      = 2;
+    pgrp->astChn[1].enModId       = CVI_ID_VPSS;  // dst
+    pgrp->astChn[1].s32DevId      = 1;
+    pgrp->astChn[1].s32ChnId      = 0;
+    pgrp->abChnEnable[0]          = 0;
+    pgrp->aAttachEn[0]            = 0;
+    pgrp->aAttachPool[0]          = APP_IPCAM_GRP0_CHN_NUM;
+    pgrp->astVpssChnAttr[0]       = chn_attr;
+
     // venc
     APP_PARAM_VENC_CTX_S* venc = app_ipcam_Venc_Param_Get();
     venc->s32VencChnCnt        = APP_IPCAM_CHN_NUM;
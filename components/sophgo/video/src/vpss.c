@@ -3,6 +3,8 @@
 /**************************************************************************
  *                              M A C R O S                               *
  **************************************************************************/
+#define VPSS_CROP_GRP       (CVI_MAX_VPSS_GRP - 1)  /* spare group fed from memory */
+#define VPSS_CROP_TIMEOUT   100
 
 /**************************************************************************
  *                           C O N S T A N T S                            *
@@ -18,6 +20,15 @@
 static APP_PARAM_VPSS_CFG_T g_stVpssCfg;
 static APP_PARAM_VPSS_CFG_T *g_pstVpssCfg = &g_stVpssCfg;
 
+static struct {
+    CVI_BOOL bCreate;
+    CVI_U32 u32MaxW;
+    CVI_U32 u32MaxH;
+    CVI_U32 u32DstW;
+    CVI_U32 u32DstH;
+    pthread_mutex_t mutex;
+} g_stCrop = {.bCreate = CVI_FALSE, .mutex = PTHREAD_MUTEX_INITIALIZER};
+
 /**************************************************************************
  *                 E X T E R N A L    R E F E R E N C E S                 *
  **************************************************************************/
@@ -216,10 +227,143 @@ static int app_ipcam_Vpss_Bind(VPSS_GRP VpssGrp)
     return CVI_SUCCESS;
 }
 
+static void app_ipcam_Vpss_Crop_Destroy(void)
+{
+    if (!g_stCrop.bCreate) {
+        return;
+    }
+    CVI_VPSS_DisableChn(VPSS_CROP_GRP, 0);
+    CVI_VPSS_StopGrp(VPSS_CROP_GRP);
+    CVI_VPSS_DestroyGrp(VPSS_CROP_GRP);
+    g_stCrop.bCreate = CVI_FALSE;
+}
+
+static int app_ipcam_Vpss_Crop_Create(CVI_U32 u32MaxW, CVI_U32 u32MaxH, CVI_U32 u32DstW, CVI_U32 u32DstH)
+{
+    CVI_S32 s32Ret = CVI_SUCCESS;
+
+    if (g_stCrop.bCreate && g_stCrop.u32MaxW >= u32MaxW && g_stCrop.u32MaxH >= u32MaxH
+        && g_stCrop.u32DstW == u32DstW && g_stCrop.u32DstH == u32DstH) {
+        return CVI_SUCCESS;
+    }
+    app_ipcam_Vpss_Crop_Destroy();
+
+    VPSS_GRP_ATTR_S stGrpAttr = {0};
+    stGrpAttr.stFrameRate.s32SrcFrameRate = -1;
+    stGrpAttr.stFrameRate.s32DstFrameRate = -1;
+    stGrpAttr.enPixelFormat = PIXEL_FORMAT_RGB_888;
+    stGrpAttr.u32MaxW = u32MaxW;
+    stGrpAttr.u32MaxH = u32MaxH;
+    stGrpAttr.u8VpssDev = 0;
+
+    VPSS_CHN_ATTR_S stChnAttr = {0};
+    stChnAttr.u32Width = u32DstW;
+    stChnAttr.u32Height = u32DstH;
+    stChnAttr.enVideoFormat = VIDEO_FORMAT_LINEAR;
+    stChnAttr.enPixelFormat = PIXEL_FORMAT_RGB_888;
+    stChnAttr.stFrameRate.s32SrcFrameRate = -1;
+    stChnAttr.stFrameRate.s32DstFrameRate = -1;
+    stChnAttr.u32Depth = 1;
+    stChnAttr.stAspectRatio.enMode = ASPECT_RATIO_NONE;
+    stChnAttr.stNormalize.bEnable = CVI_FALSE;
+
+    if ((s32Ret = CVI_VPSS_CreateGrp(VPSS_CROP_GRP, &stGrpAttr)) != CVI_SUCCESS) {
+        APP_PROF_LOG_PRINT(LEVEL_ERROR, "CVI_VPSS_CreateGrp(grp:%d) failed with %#x!\n", VPSS_CROP_GRP, s32Ret);
+        return s32Ret;
+    }
+    if ((s32Ret = CVI_VPSS_SetChnAttr(VPSS_CROP_GRP, 0, &stChnAttr)) != CVI_SUCCESS
+        || (s32Ret = CVI_VPSS_EnableChn(VPSS_CROP_GRP, 0)) != CVI_SUCCESS
+        || (s32Ret = CVI_VPSS_StartGrp(VPSS_CROP_GRP)) != CVI_SUCCESS) {
+        APP_PROF_LOG_PRINT(LEVEL_ERROR, "vpss crop group setup failed with %#x!\n", s32Ret);
+        CVI_VPSS_DestroyGrp(VPSS_CROP_GRP);
+        return s32Ret;
+    }
+
+    g_stCrop.bCreate = CVI_TRUE;
+    g_stCrop.u32MaxW = u32MaxW;
+    g_stCrop.u32MaxH = u32MaxH;
+    g_stCrop.u32DstW = u32DstW;
+    g_stCrop.u32DstH = u32DstH;
+
+    return CVI_SUCCESS;
+}
+
+int app_ipcam_Vpss_Crop(const APP_VPSS_CROP_S *pstCrop)
+{
+    CVI_S32 s32Ret = CVI_SUCCESS;
+    VIDEO_FRAME_INFO_S stSrc = {0};
+    VIDEO_FRAME_INFO_S stDst = {0};
+    VPSS_CROP_INFO_S stCropInfo = {0};
+    CVI_U8 *pSrc = NULL;
+
+    if (pstCrop == NULL || pstCrop->pDst == NULL) {
+        return CVI_FAILURE;
+    }
+
+    pthread_mutex_lock(&g_stCrop.mutex);
+
+    s32Ret = app_ipcam_Vpss_Crop_Create(pstCrop->u32SrcWidth, pstCrop->u32SrcHeight, pstCrop->u32DstWidth, pstCrop->u32DstHeight);
+    if (s32Ret != CVI_SUCCESS) {
+        goto CROP_EXIT;
+    }
+
+    stCropInfo.bEnable = CVI_TRUE;
+    stCropInfo.enCropCoordinate = VPSS_CROP_ABS_COOR;
+    stCropInfo.stCropRect = pstCrop->stRect;
+    if ((s32Ret = CVI_VPSS_SetGrpCrop(VPSS_CROP_GRP, &stCropInfo)) != CVI_SUCCESS) {
+        APP_PROF_LOG_PRINT(LEVEL_ERROR, "CVI_VPSS_SetGrpCrop failed with %#x!\n", s32Ret);
+        goto CROP_EXIT;
+    }
+
+    stSrc.stVFrame.enPixelFormat = PIXEL_FORMAT_RGB_888;
+    stSrc.stVFrame.enCompressMode = COMPRESS_MODE_NONE;
+    stSrc.stVFrame.enVideoFormat = VIDEO_FORMAT_LINEAR;
+    stSrc.stVFrame.u32Width = pstCrop->u32SrcWidth;
+    stSrc.stVFrame.u32Height = pstCrop->u32SrcHeight;
+    stSrc.stVFrame.u32Stride[0] = pstCrop->u32SrcStride;
+    stSrc.stVFrame.u32Length[0] = pstCrop->u32SrcStride * pstCrop->u32SrcHeight;
+    stSrc.stVFrame.u64PhyAddr[0] = pstCrop->u64SrcPhyAddr;
+
+    if ((s32Ret = CVI_VPSS_SendFrame(VPSS_CROP_GRP, &stSrc, VPSS_CROP_TIMEOUT)) != CVI_SUCCESS) {
+        APP_PROF_LOG_PRINT(LEVEL_ERROR, "CVI_VPSS_SendFrame failed with %#x!\n", s32Ret);
+        goto CROP_EXIT;
+    }
+    if ((s32Ret = CVI_VPSS_GetChnFrame(VPSS_CROP_GRP, 0, &stDst, VPSS_CROP_TIMEOUT)) != CVI_SUCCESS) {
+        APP_PROF_LOG_PRINT(LEVEL_ERROR, "CVI_VPSS_GetChnFrame failed with %#x!\n", s32Ret);
+        goto CROP_EXIT;
+    }
+
+    /* the channel output is stride aligned, hand back packed rows */
+    pSrc = (CVI_U8 *)CVI_SYS_Mmap(stDst.stVFrame.u64PhyAddr[0], stDst.stVFrame.u32Length[0]);
+    if (pSrc == NULL) {
+        s32Ret = CVI_FAILURE;
+    } else {
+        for (CVI_U32 y = 0; y < pstCrop->u32DstHeight; y++) {
+            memcpy((CVI_U8 *)pstCrop->pDst + y * pstCrop->u32DstWidth * 3, pSrc + y * stDst.stVFrame.u32Stride[0], pstCrop->u32DstWidth * 3);
+        }
+        CVI_SYS_Munmap(pSrc, stDst.stVFrame.u32Length[0]);
+    }
+    CVI_VPSS_ReleaseChnFrame(VPSS_CROP_GRP, 0, &stDst);
+
+CROP_EXIT:
+    pthread_mutex_unlock(&g_stCrop.mutex);
+    return s32Ret;
+}
+
+int app_ipcam_Vpss_Crop_DeInit(void)
+{
+    pthread_mutex_lock(&g_stCrop.mutex);
+    app_ipcam_Vpss_Crop_Destroy();
+    pthread_mutex_unlock(&g_stCrop.mutex);
+    return CVI_SUCCESS;
+}
+
 int app_ipcam_Vpss_DeInit(void)
 {
     CVI_S32 s32Ret = CVI_SUCCESS;
 
+    app_ipcam_Vpss_Crop_DeInit();
+
     for (CVI_U32 VpssGrp = 0; VpssGrp < g_pstVpssCfg->u32GrpCnt; VpssGrp++) {
         s32Ret = app_ipcam_Vpss_Unbind(VpssGrp);
         if (s32Ret != CVI_SUCCESS) {
@@ -1,5 +1,7 @@
 #include "video.h"
 
+#define VIDEO_SUB_SRC_CH VIDEO_CH2  // the sub stream group takes its frames from this channel
+
 static bool is_started   = false;
 static bool video_mirror = false;
 static bool video_flip   = false;
@@ -25,26 +27,47 @@ static int setVbPool(video_ch_index_t ch, const video_ch_param_t* param) {
     return 0;
 }
 
-static int setGrpChn(int grp, video_ch_index_t ch, const video_ch_param_t* param) {
+// channels 0-3 are the physical channels of group 0, the sub stream is channel 0 of group 1
+static void getGrpChn(video_ch_index_t ch, int* grp, int* chn) {
+    *grp = (ch == VIDEO_CH4) ? 1 : 0;
+    *chn = (ch == VIDEO_CH4) ? 0 : ch;
+}
+
+static int setGrpChn(video_ch_index_t ch, const video_ch_param_t* param) {
     APP_PARAM_VPSS_CFG_T* vpss = app_ipcam_Vpss_Param_Get();
+    int grp, chn;
 
-    if (grp >= vpss->u32GrpCnt) {
-        APP_PROF_LOG_PRINT(LEVEL_ERROR, "grp(%d) > u32GrpCnt(%d)\n", grp, vpss->u32GrpCnt);
-        return -1;
-    }
     if (ch >= VIDEO_CH_MAX) {
         APP_PROF_LOG_PRINT(LEVEL_ERROR, "ch(%d) > VIDEO_CH_MAX(%d)\n", ch, VIDEO_CH_MAX);
         return -1;
     }
+    getGrpChn(ch, &grp, &chn);
+    if (grp >= vpss->u32GrpCnt) {
+        APP_PROF_LOG_PRINT(LEVEL_ERROR, "grp(%d) > u32GrpCnt(%d)\n", grp, vpss->u32GrpCnt);
+        return -1;
+    }
     if (param == NULL) {
         APP_PROF_LOG_PRINT(LEVEL_ERROR, "param is null\n");
         return -1;
     }
 
-    APP_VPSS_GRP_CFG_T* pgrp  = &vpss->astVpssGrpCfg[grp];
-    pgrp->abChnEnable[ch]     = 1;
-    pgrp->aAttachEn[ch]       = 1;
-    VPSS_CHN_ATTR_S* vpss_chn = &pgrp->astVpssChnAttr[ch];
+    APP_VPSS_GRP_CFG_T* pgrp = &vpss->astVpssGrpCfg[grp];
+    if (grp != 0) {
+        /* fed by a group 0 channel, so the input is that channel's NV21 output */
+        APP_VPSS_GRP_CFG_T* psrc = &vpss->astVpssGrpCfg[0];
+        if (!psrc->abChnEnable[VIDEO_SUB_SRC_CH]) {
+            APP_PROF_LOG_PRINT(LEVEL_ERROR, "ch(%d) needs ch(%d) set up first\n", ch, VIDEO_SUB_SRC_CH);
+            return -1;
+        }
+        pgrp->bEnable                     = 1;
+        pgrp->stVpssGrpAttr.u32MaxW       = psrc->astVpssChnAttr[VIDEO_SUB_SRC_CH].u32Width;
+        pgrp->stVpssGrpAttr.u32MaxH       = psrc->astVpssChnAttr[VIDEO_SUB_SRC_CH].u32Height;
+        pgrp->stVpssGrpAttr.enPixelFormat = psrc->astVpssChnAttr[VIDEO_SUB_SRC_CH].enPixelFormat;
+    }
+    pgrp->abChnEnable[chn]    = 1;
+    pgrp->aAttachEn[chn]      = 1;
+    pgrp->aAttachPool[chn]    = ch;
+    VPSS_CHN_ATTR_S* vpss_chn = &pgrp->astVpssChnAttr[chn];
     vpss_chn->u32Width        = param->width;
     vpss_chn->u32Height       = param->height;
     vpss_chn->enPixelFormat   = (param->format == VIDEO_FORMAT_RGB888) ? PIXEL_FORMAT_RGB_888 : PIXEL_FORMAT_NV21;
@@ -78,6 +101,20 @@ static int setVencChn(video_ch_index_t ch, const video_ch_param_t* param) {
     pvchn->u32Height          = param->height;
     pvchn->u32DstFrameRate    = param->fps;
 
+    int grp, chn;
+    getGrpChn(ch, &grp, &chn);
+    pvchn->VpssGrp            = grp;
+    pvchn->VpssChn            = chn;
+    pvchn->astChn[0].s32DevId = grp;
+    pvchn->astChn[0].s32ChnId = chn;
+    if (ch == VIDEO_CH4 && enType != PT_JPEG) {
+        /* the template rate is meant for 1080p, scale it with the area */
+        uint64_t area        = (uint64_t)param->width * param->height;
+        pvchn->u32BitRate    = (uint32_t)(pvchn->u32BitRate * area / (1920 * 1080));
+        pvchn->u32BitRate    = pvchn->u32BitRate < 256 ? 256 : pvchn->u32BitRate;
+        pvchn->u32MaxBitRate = pvchn->u32BitRate;
+    }
+
     if ((VIDEO_FORMAT_RGB888 == param->format) || (VIDEO_FORMAT_NV21 == param->format)) {
         pvchn->no_need_venc = 1;
     }
@@ -131,7 +168,9 @@ int setupVideo(video_ch_index_t ch, const video_ch_param_t* param) {
     }
 
     setVbPool(ch, param);
-    setGrpChn(0, ch, param);
+    if (setGrpChn(ch, param) != 0) {
+        return -1;
+    }
     setVencChn(ch, param);
 
     return 0;
@@ -142,6 +181,74 @@ int registerVideoFrameHandler(video_ch_index_t ch, int index, pfpDataConsumes ha
     return 0;
 }
 
+int setVideoZeroCopy(video_ch_index_t ch, uint32_t inflight) {
+    if (ch >= VIDEO_CH_MAX) {
+        APP_PROF_LOG_PRINT(LEVEL_ERROR, "video ch(%d) index is out of range\n", ch);
+        return -1;
+    }
+    // must follow setupVideo(), which resets the channel configuration
+    return app_ipcam_Venc_ZeroCopy_Set(ch, inflight);
+}
+
+int setVideoHarvestSingle(bool single) {
+    // takes effect on the next startVideo()
+    return app_ipcam_Venc_Harvest_Set(single ? CVI_TRUE : CVI_FALSE);
+}
+
+int requestVideoIDR(video_ch_index_t ch) {
+    if (ch >= VIDEO_CH_MAX) {
+        return -1;
+    }
+    return app_ipcam_Venc_IDR_Request(ch);
+}
+
+int setVideoPaused(video_ch_index_t ch, bool paused) {
+    if (ch >= VIDEO_CH_MAX) {
+        return -1;
+    }
+    return app_ipcam_Venc_Pause(ch, paused ? CVI_TRUE : CVI_FALSE);
+}
+
+void* holdVideoStream(void) {
+    return app_ipcam_Venc_Stream_Hold();
+}
+
+void dropVideoStream(void* handle) {
+    app_ipcam_Venc_Stream_Drop(handle);
+}
+
+int getVideoStreamStat(video_ch_index_t ch, APP_DATA_STAT_S* stat) {
+    if (ch >= VIDEO_CH_MAX || stat == NULL) {
+        return -1;
+    }
+    return app_ipcam_Venc_Data_Stat_Get(ch, stat);
+}
+
+int cropVideoFrame(const video_crop_t* crop) {
+    if (crop == NULL || crop->dst == NULL || crop->width == 0 || crop->height == 0) {
+        return -1;
+    }
+    if (crop->x < 0 || crop->y < 0 || crop->x + crop->width > crop->src_width || crop->y + crop->height > crop->src_height) {
+        APP_PROF_LOG_PRINT(LEVEL_ERROR, "crop (%d,%d %ux%u) is out of the frame\n", crop->x, crop->y, crop->width, crop->height);
+        return -1;
+    }
+
+    APP_VPSS_CROP_S stCrop = {0};
+    stCrop.u64SrcPhyAddr    = crop->src_phy;
+    stCrop.u32SrcWidth      = crop->src_width;
+    stCrop.u32SrcHeight     = crop->src_height;
+    stCrop.u32SrcStride     = crop->src_stride;
+    stCrop.stRect.s32X      = crop->x;
+    stCrop.stRect.s32Y      = crop->y;
+    stCrop.stRect.u32Width  = crop->width;
+    stCrop.stRect.u32Height = crop->height;
+    stCrop.u32DstWidth      = crop->dst_width;
+    stCrop.u32DstHeight     = crop->dst_height;
+    stCrop.pDst             = crop->dst;
+
+    return app_ipcam_Vpss_Crop(&stCrop) == CVI_SUCCESS ? 0 : -1;
+}
+
 int setVideoMirror(bool mirror) {
     video_mirror = mirror;
 }
@@ -21,6 +21,8 @@ typedef enum {
     VIDEO_CH0 = 0,
     VIDEO_CH1,
     VIDEO_CH2,
+    VIDEO_CH3,
+    VIDEO_CH4,  // sub stream: a second VPSS group scales VIDEO_CH2 down, so that channel has to be set up too
 
     VIDEO_CH_MAX
 } video_ch_index_t;
@@ -32,6 +34,20 @@ typedef struct {
     uint8_t fps;
 } video_ch_param_t;
 
+typedef struct {
+    uint64_t src_phy;  // RGB888 frame in ION memory, e.g. a raw channel frame
+    uint32_t src_width;
+    uint32_t src_height;
+    uint32_t src_stride;
+    int32_t x;
+    int32_t y;
+    uint32_t width;
+    uint32_t height;
+    uint32_t dst_width;
+    uint32_t dst_height;
+    uint8_t* dst;  // packed RGB888, dst_width * dst_height * 3 bytes
+} video_crop_t;
+
 // typedef struct {
 //     uint32_t width;
 //     uint32_t height;
@@ -50,6 +66,14 @@ int getVideoMirror();
 int getVideoFlip();
 int setupVideo(video_ch_index_t ch, const video_ch_param_t* param);
 int registerVideoFrameHandler(video_ch_index_t ch, int index, pfpDataConsumes handler, void* pUserData);
+int setVideoZeroCopy(video_ch_index_t ch, uint32_t inflight);
+int setVideoHarvestSingle(bool single);
+int requestVideoIDR(video_ch_index_t ch);
+int setVideoPaused(video_ch_index_t ch, bool paused);
+void* holdVideoStream(void);
+void dropVideoStream(void* handle);
+int getVideoStreamStat(video_ch_index_t ch, APP_DATA_STAT_S* stat);
+int cropVideoFrame(const video_crop_t* crop);
 
 #ifdef __cplusplus
 }
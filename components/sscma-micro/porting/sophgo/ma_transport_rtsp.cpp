@@ -9,6 +9,8 @@ static const char* TAG = "ma::transport::rtsp";
 std::unordered_map<int, CVI_RTSP_CTX*> TransportRTSP::s_contexts;
 std::unordered_map<int, UserAuthenticationDatabase*> TransportRTSP::s_auths;
 std::unordered_map<int, std::vector<CVI_RTSP_SESSION*>> TransportRTSP::s_sessions;
+std::unordered_map<int, uint32_t> TransportRTSP::s_connections;
+Mutex TransportRTSP::s_connections_mutex;
 
 TransportRTSP::TransportRTSP() : Transport(MA_TRANSPORT_RTSP), m_format(MA_PIXEL_FORMAT_H264), m_port(0), m_session(nullptr), m_ctx(nullptr) {}
 
@@ -16,8 +18,11 @@ TransportRTSP::~TransportRTSP() {
     deInit();
 }
 
-static void onConnectStub(const char* ip, void* arg) {
+// arg is the port, the listener outlives the transport that registered it
+void onConnectStub(const char* ip, void* arg) {
     MA_LOGD(TAG, "rtsp connected: %s", ip);
+    Guard guard(TransportRTSP::s_connections_mutex);
+    TransportRTSP::s_connections[static_cast<int>(reinterpret_cast<intptr_t>(arg))]++;
 }
 
 static void onDisconnectStub(const char* ip, void* arg) {
@@ -58,7 +63,7 @@ ma_err_t TransportRTSP::init(const void* config) noexcept {
         }
         CVI_RTSP_STATE_LISTENER listener = {0};
         listener.onConnect               = onConnectStub;
-        listener.argConn                 = this;
+        listener.argConn                 = reinterpret_cast<void*>(static_cast<intptr_t>(m_port));
         listener.onDisconnect            = onDisconnectStub;
         listener.argDisconn              = this;
 
@@ -224,6 +229,31 @@ size_t TransportRTSP::sendAudio(const char* data, size_t length) noexcept {
 }
 
 
+uint32_t TransportRTSP::connections() const noexcept {
+    Guard guard(s_connections_mutex);
+    auto it = s_connections.find(m_port);
+    return it != s_connections.end() ? it->second : 0;
+}
+
+
+uint32_t TransportRTSP::viewers() const noexcept {
+    if (!m_initialized || m_ctx == nullptr) {
+        return 0;
+    }
+    // The sessions table only changes through CreateSession/DestroySession on our side; the
+    // reference count, bumped by the server thread on SETUP and dropped on TEARDOWN, is read racily.
+    RTSPServer* server = static_cast<RTSPServer*>(m_ctx->server);
+    GenericMediaServer::ServerMediaSessionIterator it(*server);
+    ServerMediaSession* sms = nullptr;
+    while ((sms = it.next()) != nullptr) {
+        if (m_name == sms->streamName()) {
+            return sms->referenceCount();
+        }
+    }
+    return 0;
+}
+
+
 size_t TransportRTSP::receive(char* data, size_t length) noexcept {
     return 0;
 }
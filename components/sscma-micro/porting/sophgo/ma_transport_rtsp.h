@@ -50,6 +50,11 @@ public:
     size_t sendVideo(const char* data, size_t length) noexcept;
     size_t sendAudio(const char* data, size_t length) noexcept;
 
+    // clients that connected to this port so far, the server is shared by all its sessions
+    uint32_t connections() const noexcept;
+    // clients playing this session right now
+    uint32_t viewers() const noexcept;
+
 private:
     ma_pixel_format_t m_format;
     int m_port;
@@ -63,6 +68,10 @@ private:
     static std::unordered_map<int, CVI_RTSP_CTX*> s_contexts;
     static std::unordered_map<int, UserAuthenticationDatabase*> s_auths;
     static std::unordered_map<int, std::vector<CVI_RTSP_SESSION*>> s_sessions;
+    static std::unordered_map<int, uint32_t> s_connections;
+    static Mutex s_connections_mutex;
+
+    friend void onConnectStub(const char* ip, void* arg);
 };
 
 }  // namespace ma
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "ma_transport_websocket.h"
 
 namespace ma {
@@ -6,8 +8,12 @@ using namespace hv;
 
 static const char* TAG = "ma::transport::websocket";
 
+#define WS_WRITE_HIGH_WATER (256 * 1024)  // bytes libhv may hold for a socket before the queue keeps the rest
+#define WS_POLL_MS          10            // a blocked socket is retried this often
+
 
-TransportWebSocket::TransportWebSocket() : Transport{MA_TRANSPORT_WS}, m_port(8080), m_receiveBuffer(nullptr) {}
+TransportWebSocket::TransportWebSocket()
+    : Transport{MA_TRANSPORT_WS}, m_port(8080), m_receiveBuffer(nullptr), m_pending(0), m_running(false), m_thread(nullptr) {}
 TransportWebSocket::~TransportWebSocket() {
     deInit();
 }
@@ -17,10 +23,19 @@ ma_err_t TransportWebSocket::init(const void* config) noexcept {
 
     const Config* config_ = reinterpret_cast<const Config*>(config);
 
+    m_config      = *config_;
     m_server.port = config_->port;
 
     m_service.onopen = [this](const WebSocketChannelPtr& channel, const HttpRequestPtr& req) {
-        m_channels.emplace_front(channel);
+        Guard guard(m_mutex);
+        Client client  = {};
+        client.channel = channel;
+        client.framed  = req->GetParam("format") == "framed";
+        // a stream joined midway is useless until its next key frame, or a prime() replaying the GOP
+        client.joining      = m_config.keyframes && !client.framed;
+        client.waiting_key  = m_config.keyframes;
+        client.window_start = Tick::current();
+        m_clients.push_back(std::move(client));
     };
 
     m_service.onmessage = [this](const WebSocketChannelPtr& channel, const std::string& msg) {
@@ -28,13 +43,20 @@ ma_err_t TransportWebSocket::init(const void* config) noexcept {
     };
 
     m_service.onclose = [this](const WebSocketChannelPtr& channel) {
-        m_channels.remove_if([](const WebSocketChannelPtr& c) { return !c->isConnected(); });
+        Guard guard(m_mutex);
+        m_clients.remove_if([&](const Client& c) { return c.channel == channel || !c.channel->isConnected(); });
     };
 
     m_server.registerWebSocketService(&m_service);
 
     m_receiveBuffer = new SPSCRingBuffer<char>(64 * 1024);
 
+    m_running = true;
+    m_thread  = new Thread(("ws#" + std::to_string(config_->port)).c_str(), &TransportWebSocket::threadEntryStub, this);
+    if (m_thread != nullptr) {
+        m_thread->start(this);
+    }
+
     if (m_server.start() == MA_OK) {
         return MA_OK;
     }
@@ -43,8 +65,21 @@ ma_err_t TransportWebSocket::init(const void* config) noexcept {
 }
 void TransportWebSocket::deInit() noexcept {
 
+    if (m_thread != nullptr) {
+        m_running = false;
+        m_pending.signal();
+        m_thread->join();
+        delete m_thread;
+        m_thread = nullptr;
+    }
+
     m_server.stop();
 
+    {
+        Guard guard(m_mutex);
+        m_clients.clear();
+    }
+
     if (m_receiveBuffer) {
         delete m_receiveBuffer;
         m_receiveBuffer = nullptr;
@@ -62,15 +97,217 @@ size_t TransportWebSocket::flush() noexcept {
     return 0;
 }
 
+void TransportWebSocket::enqueue(Client& client, const std::shared_ptr<const std::string>& data, bool key, ma_tick_t now) {
+    size_t size = data->size();
+    if (m_config.keyframes) {
+        if (client.waiting_key && !key) {
+            client.dropped++;
+            return;
+        }
+        if (client.queued + size > m_config.queue) {
+            // the frames waiting decode against the one being dropped, start over from a key frame
+            client.dropped += client.queue.size();
+            client.queue.clear();
+            client.queued = 0;
+            client.behind = client.behind ? client.behind : now;
+            if (!key) {
+                client.waiting_key = true;
+                client.dropped++;
+                return;
+            }
+        }
+        client.waiting_key = false;
+        client.joining     = client.joining && !key;
+    } else {
+        while (!client.queue.empty() && client.queued + size > m_config.queue) {
+            client.queued -= client.queue.front().data->size();
+            client.queue.pop_front();
+            client.dropped++;
+            client.behind = client.behind ? client.behind : now;
+        }
+        if (size > m_config.queue) {
+            client.dropped++;
+            client.behind = client.behind ? client.behind : now;
+            return;
+        }
+    }
+    client.queue.push_back({data, key});
+    client.queued += size;
+}
+
+size_t TransportWebSocket::enqueue(const std::shared_ptr<const std::string>& data, bool framed, bool key) {
+    ma_tick_t now = Tick::current();
+    size_t count  = 0;
+    {
+        Guard guard(m_mutex);
+        for (auto& client : m_clients) {
+            if (client.framed == framed) {
+                enqueue(client, data, key, now);
+                count++;
+            }
+        }
+    }
+    if (count > 0) {
+        m_pending.signal();
+    }
+    return count > 0 ? data->size() : 0;
+}
+
 size_t TransportWebSocket::send(const char* data, size_t length) noexcept {
+    return send(data, length, true);
+}
+
+size_t TransportWebSocket::send(const char* data, size_t length, bool key) noexcept {
+    if (clients(false) == 0) {
+        return 0;
+    }
+    return enqueue(std::make_shared<const std::string>(data, length), false, key);
+}
+
+size_t TransportWebSocket::clients(bool framed) const noexcept {
     Guard guard(m_mutex);
-    if (m_channels.empty()) {
+    return std::count_if(m_clients.begin(), m_clients.end(), [&](const Client& c) { return c.framed == framed; });
+}
+
+size_t TransportWebSocket::send(const char* const* parts, const size_t* lengths, size_t count) noexcept {
+    if (clients(true) == 0) {
         return 0;
     }
-    for (auto& channel : m_channels) {
-        int n_send = channel->send(data, length);
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += lengths[i];
+    }
+    auto message = std::make_shared<std::string>();
+    message->reserve(total);
+    for (size_t i = 0; i < count; i++) {
+        message->append(parts[i], lengths[i]);
+    }
+    return enqueue(message, true, true);
+}
+
+size_t TransportWebSocket::joining() const noexcept {
+    Guard guard(m_mutex);
+    return std::count_if(m_clients.begin(), m_clients.end(), [](const Client& c) { return c.joining; });
+}
+
+size_t TransportWebSocket::prime(const char* const* data, const size_t* lengths, size_t count, bool resume) noexcept {
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += lengths[i];
+    }
+    // a run that does not fit the queue would be cut, the client waits for a key frame instead
+    bool fits = count > 0 && total <= m_config.queue;
+    std::vector<std::shared_ptr<const std::string>> messages;
+    size_t primed = 0;
+    {
+        Guard guard(m_mutex);
+        for (auto& client : m_clients) {
+            if (!client.joining) {
+                continue;
+            }
+            client.joining = false;
+            if (!fits) {
+                continue;
+            }
+            if (messages.empty()) {
+                for (size_t i = 0; i < count; i++) {
+                    messages.push_back(std::make_shared<const std::string>(data[i], lengths[i]));
+                }
+            }
+            for (auto& message : messages) {
+                client.queue.push_back({message, false});
+            }
+            client.queued += total;
+            client.primed++;
+            client.waiting_key = !resume;
+            primed++;
+        }
+    }
+    if (primed > 0) {
+        m_pending.signal();
     }
-    return length;
+    return primed;
+}
+
+std::vector<TransportWebSocket::ClientStats> TransportWebSocket::stats() const noexcept {
+    Guard guard(m_mutex);
+    ma_tick_t now = Tick::current();
+    std::vector<ClientStats> stats;
+    for (const auto& client : m_clients) {
+        ClientStats item = {};
+        item.address     = client.channel->peeraddr();
+        item.framed      = client.framed;
+        item.queued      = client.queued;
+        item.lag         = client.behind ? Tick::toMicroseconds(now - client.behind) / 1000 : 0;
+        item.sent        = client.sent;
+        item.bytes       = client.bytes;
+        item.dropped     = client.dropped;
+        item.primed      = client.primed;
+        item.rate        = client.rate;
+        stats.push_back(item);
+    }
+    return stats;
+}
+
+void TransportWebSocket::threadEntry() {
+    std::vector<std::pair<WebSocketChannelPtr, std::shared_ptr<const std::string>>> batch;
+    std::vector<WebSocketChannelPtr> lagging;
+
+    while (m_running) {
+        m_pending.wait(Tick::fromMilliseconds(WS_POLL_MS));
+        ma_tick_t now = Tick::current();
+        {
+            Guard guard(m_mutex);
+            for (auto& client : m_clients) {
+                if (!client.channel->isConnected()) {
+                    continue;
+                }
+                // libhv buffers whatever the socket does not take, keep that small so drops happen here
+                size_t buffered = client.channel->writeBufsize();
+                while (!client.queue.empty() && buffered < WS_WRITE_HIGH_WATER) {
+                    size_t size = client.queue.front().data->size();
+                    batch.emplace_back(client.channel, std::move(client.queue.front().data));
+                    client.queue.pop_front();
+                    client.queued -= size;
+                    client.sent++;
+                    client.bytes += size;
+                    client.window_bytes += size;
+                    buffered += size;
+                }
+                // in sync once everything queued went out, a client skipping to a key frame after drops is not
+                if (client.queue.empty() && buffered < WS_WRITE_HIGH_WATER && !(client.waiting_key && client.behind)) {
+                    client.behind = 0;
+                } else if (client.behind == 0) {
+                    client.behind = now;
+                }
+                if (m_config.lag > 0 && client.behind && now - client.behind > Tick::fromMilliseconds(m_config.lag)) {
+                    MA_LOGW(TAG, "client %s more than %d ms behind, disconnecting", client.channel->peeraddr().c_str(), m_config.lag);
+                    client.dropped += client.queue.size();
+                    client.queue.clear();
+                    client.queued = 0;
+                    lagging.push_back(client.channel);
+                }
+                if (now - client.window_start >= Tick::fromSeconds(1)) {
+                    client.rate         = client.window_bytes * 1000000 / Tick::toMicroseconds(now - client.window_start);
+                    client.window_bytes = 0;
+                    client.window_start = now;
+                }
+            }
+        }
+        // the sockets are written without the lock, producers never wait on a client
+        for (auto& item : batch) {
+            item.first->send(item.second->data(), item.second->size(), WS_OPCODE_BINARY, true);
+        }
+        batch.clear();
+        for (auto& channel : lagging) {
+            channel->close(true);
+        }
+        lagging.clear();
+    }
+}
+
+void TransportWebSocket::threadEntryStub(void* obj) {
+    reinterpret_cast<TransportWebSocket*>(obj)->threadEntry();
 }
 
 size_t TransportWebSocket::receive(char* data, size_t length) noexcept {
@@ -89,4 +326,4 @@ size_t TransportWebSocket::receiveIf(char* data, size_t length, char delimiter)
     return m_receiveBuffer->popIf(data, length, delimiter);
 }
 
-}  // namespace ma
\ No newline at end of file
+}  // namespace ma
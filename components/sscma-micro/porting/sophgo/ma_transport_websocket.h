@@ -1,7 +1,11 @@
 #ifndef _MA_TRANSPORT_WEBSOCKET_H
 #define _MA_TRANSPORT_WEBSOCKET_H
 
-#include <forward_list>
+#include <atomic>
+#include <deque>
+#include <list>
+#include <memory>
+#include <vector>
 
 #include "core/ma_common.h"
 #include "core/utils/ma_ringbuffer.hpp"
@@ -20,8 +24,22 @@ public:
     struct Config {
         int port;
         std::string session;
+        size_t queue   = 2 * 1024 * 1024;  // bytes waiting per client before messages are dropped
+        int lag        = 5000;             // ms a client may fall behind before it is disconnected, 0 never
+        bool keyframes = false;            // H.264: after a drop, skip to the next key frame
     };
 
+    struct ClientStats {
+        std::string address;
+        bool framed;
+        size_t queued;     // bytes waiting
+        uint32_t lag;      // ms since the client was last in sync
+        uint64_t sent;     // messages
+        uint64_t bytes;    // bytes sent
+        uint64_t dropped;  // messages
+        uint64_t primed;   // GOP replays on connect
+        uint32_t rate;     // bytes per second over the last second
+    };
 
     TransportWebSocket();
     ~TransportWebSocket();
@@ -35,16 +53,63 @@ public:
     size_t receiveIf(char* data, size_t length, char delimiter) noexcept override;
     size_t flush() noexcept override;
 
+    // queues a message for every plain client, key marks one a client can resume from after drops
+    size_t send(const char* data, size_t length, bool key) noexcept;
+
+    // clients that connected with ?format=framed get binary frames only, the others plain send()
+    size_t clients(bool framed) const noexcept;
+    // one binary message to the framed clients, the parts are joined once into a buffer they share
+    size_t send(const char* const* parts, const size_t* lengths, size_t count) noexcept;
+
+    // key frame streams: clients that connected since the last prime()
+    size_t joining() const noexcept;
+    // queues a decodable run of messages, a cached GOP, for the joining clients ahead of the live
+    // ones; with resume false they skip to the next key frame afterwards
+    size_t prime(const char* const* data, const size_t* lengths, size_t count, bool resume) noexcept;
+
+    std::vector<ClientStats> stats() const noexcept;
+
 private:
+    struct Message {
+        std::shared_ptr<const std::string> data;
+        bool key;
+    };
+
+    // every client has its own queue, a slow one only ever delays itself
+    struct Client {
+        WebSocketChannelPtr channel;
+        bool framed;
+        bool joining;
+        bool waiting_key;
+        std::deque<Message> queue;
+        size_t queued;
+        ma_tick_t behind;  // when it fell out of sync, 0 while in sync
+        uint64_t sent;
+        uint64_t bytes;
+        uint64_t dropped;
+        uint64_t primed;
+        uint64_t window_bytes;
+        ma_tick_t window_start;
+        uint32_t rate;
+    };
+
+    size_t enqueue(const std::shared_ptr<const std::string>& data, bool framed, bool key);
+    void enqueue(Client& client, const std::shared_ptr<const std::string>& data, bool key, ma_tick_t now);
+    void threadEntry();
+    static void threadEntryStub(void* obj);
+
     int m_port;
+    Config m_config;
     Mutex m_mutex;
     hv::WebSocketService m_service;
     hv::WebSocketServer m_server;
-    std::forward_list<WebSocketChannelPtr> m_channels;
+    std::list<Client> m_clients;
     SPSCRingBuffer<char>* m_receiveBuffer;
+    Semaphore m_pending;
+    std::atomic<bool> m_running;
     Thread* m_thread;
 };
 
 }  // namespace ma
 
-#endif
\ No newline at end of file
+#endif
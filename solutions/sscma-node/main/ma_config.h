@@ -9,6 +9,8 @@
 
 #define MA_USE_TRANSPORT_RTSP 1
 
+#define MA_NODE_SERVER_WORKERS 3
+
 #include "logger.hpp"
 
 #endif  // MA_CONFIG_H
\ No newline at end of file
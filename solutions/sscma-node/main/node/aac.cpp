@@ -0,0 +1,158 @@
+#include <cmath>
+
+#include "aac.h"
+
+namespace ma::node {
+
+static constexpr char TAG[] = "ma::node::aac";
+
+static const int32_t AAC_SAMPLE_RATES[] = {96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350};
+
+AacEncoder::AacEncoder()
+    : ctx_(nullptr), frame_(nullptr), packet_(nullptr), sample_rate_(0), channels_(0), bitrate_(0), pts_(0), packets_(0), in_bytes_(0), out_bytes_(0), errors_(0) {}
+
+AacEncoder::~AacEncoder() {
+    close();
+}
+
+bool AacEncoder::open(int32_t sample_rate, int32_t channels, int32_t bitrate) {
+    Guard guard(mutex_);
+    if (ctx_ != nullptr) {
+        return true;
+    }
+
+    const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_AAC);
+    if (codec == nullptr) {
+        MA_LOGE(TAG, "could not find AAC encoder");
+        return false;
+    }
+    ctx_ = avcodec_alloc_context3(codec);
+    if (ctx_ == nullptr) {
+        MA_LOGE(TAG, "could not allocate AAC codec context");
+        return false;
+    }
+    ctx_->bit_rate       = bitrate;
+    ctx_->sample_rate    = sample_rate;
+    ctx_->channels       = channels;
+    ctx_->channel_layout = av_get_default_channel_layout(channels);
+    ctx_->sample_fmt     = AV_SAMPLE_FMT_FLTP;
+    ctx_->profile        = FF_PROFILE_AAC_LOW;
+    ctx_->time_base      = {1, sample_rate};
+
+    int ret = avcodec_open2(ctx_, codec, nullptr);
+    if (ret < 0) {
+        MA_LOGE(TAG, "could not open AAC codec: %d", ret);
+        avcodec_free_context(&ctx_);
+        return false;
+    }
+
+    frame_  = av_frame_alloc();
+    packet_ = av_packet_alloc();
+    if (frame_ != nullptr) {
+        frame_->nb_samples     = ctx_->frame_size;
+        frame_->format         = AV_SAMPLE_FMT_FLTP;
+        frame_->channel_layout = ctx_->channel_layout;
+        frame_->sample_rate    = sample_rate;
+    }
+    if (frame_ == nullptr || packet_ == nullptr || av_frame_get_buffer(frame_, 0) < 0) {
+        MA_LOGE(TAG, "could not allocate AAC frame");
+        av_frame_free(&frame_);
+        av_packet_free(&packet_);
+        avcodec_free_context(&ctx_);
+        return false;
+    }
+
+    sample_rate_ = sample_rate;
+    channels_    = channels;
+    bitrate_     = bitrate;
+    pts_         = 0;
+    pending_.clear();
+    pending_.reserve(ctx_->frame_size * channels * 2);
+    MA_LOGI(TAG, "AAC-LC %d Hz %d ch %d kbps", sample_rate, channels, bitrate / 1000);
+    return true;
+}
+
+void AacEncoder::close() {
+    Guard guard(mutex_);
+    av_frame_free(&frame_);
+    av_packet_free(&packet_);
+    if (ctx_ != nullptr) {
+        avcodec_free_context(&ctx_);
+    }
+    pending_.clear();
+}
+
+bool AacEncoder::opened() {
+    Guard guard(mutex_);
+    return ctx_ != nullptr;
+}
+
+void AacEncoder::encode(const uint8_t* pcm, size_t size, const Emit& emit) {
+    Guard guard(mutex_);
+    if (ctx_ == nullptr) {
+        return;
+    }
+    const int16_t* samples = reinterpret_cast<const int16_t*>(pcm);
+    pending_.insert(pending_.end(), samples, samples + size / sizeof(int16_t));
+    in_bytes_ += size;
+
+    size_t needed = static_cast<size_t>(ctx_->frame_size) * channels_;
+    size_t used   = 0;
+    while (pending_.size() - used >= needed) {
+        if (av_frame_make_writable(frame_) < 0) {
+            errors_++;
+            break;
+        }
+        // interleaved S16 to planar float
+        const int16_t* src = pending_.data() + used;
+        for (int32_t ch = 0; ch < channels_; ch++) {
+            float* dst = reinterpret_cast<float*>(frame_->data[ch]);
+            for (int32_t i = 0; i < ctx_->frame_size; i++) {
+                dst[i] = src[i * channels_ + ch] / 32768.0f;
+            }
+        }
+        used += needed;
+        frame_->pts = pts_;
+        pts_ += ctx_->frame_size;
+
+        if (avcodec_send_frame(ctx_, frame_) < 0) {
+            errors_++;
+            continue;
+        }
+        while (avcodec_receive_packet(ctx_, packet_) == 0) {
+            packets_++;
+            out_bytes_ += packet_->size;
+            emit(packet_->data, packet_->size);
+            av_packet_unref(packet_);
+        }
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + used);
+}
+
+std::vector<uint8_t> AacEncoder::config(int32_t sample_rate, int32_t channels) {
+    // 5 bits object type (2, AAC-LC), 4 bits sampling frequency index, 4 bits channel configuration, 3 bits zero
+    uint8_t index = 15;
+    for (uint8_t i = 0; i < sizeof(AAC_SAMPLE_RATES) / sizeof(AAC_SAMPLE_RATES[0]); i++) {
+        if (AAC_SAMPLE_RATES[i] == sample_rate) {
+            index = i;
+            break;
+        }
+    }
+    return {static_cast<uint8_t>((2 << 3) | (index >> 1)), static_cast<uint8_t>(((index & 1) << 7) | ((channels & 0x0f) << 3))};
+}
+
+json AacEncoder::stats() {
+    Guard guard(mutex_);
+    // what a consumer of the packets gets, against the PCM it would otherwise carry
+    double seconds = channels_ > 0 ? in_bytes_ / (2.0 * channels_ * sample_rate_) : 0;
+    return json::object({{"enabled", ctx_ != nullptr},
+                         {"bitrate", bitrate_ / 1000},
+                         {"packets", packets_},
+                         {"in_bytes", in_bytes_},
+                         {"out_bytes", out_bytes_},
+                         {"errors", errors_},
+                         {"kbps", seconds > 0 ? std::round(out_bytes_ * 8 / seconds / 100) / 10 : 0},
+                         {"ratio", in_bytes_ > 0 ? std::round(out_bytes_ * 1000.0 / in_bytes_) / 1000 : 0}});
+}
+
+}  // namespace ma::node
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "core/ma_core.h"
+#include "porting/ma_porting.h"
+
+namespace ma::node {
+
+// AAC-LC encoder for the camera's PCM, run once however many consumers take the result. Packets
+// are raw access units of AAC_FRAME_SAMPLES samples without ADTS headers: RTP (RFC 3640) and MP4
+// both carry them as they are, with the AudioSpecificConfig from config() out of band.
+#define AAC_FRAME_SAMPLES 1024
+
+class AacEncoder {
+public:
+    using Emit = std::function<void(const uint8_t* data, size_t size)>;
+
+    AacEncoder();
+    ~AacEncoder();
+
+    AacEncoder(const AacEncoder&)            = delete;
+    AacEncoder& operator=(const AacEncoder&) = delete;
+
+    // bitrate in bits per second, S16LE input
+    bool open(int32_t sample_rate, int32_t channels, int32_t bitrate);
+    void close();
+    bool opened();
+
+    // buffers pcm and calls emit for every packet it completes
+    void encode(const uint8_t* pcm, size_t size, const Emit& emit);
+
+    // AudioSpecificConfig of an AAC-LC stream, the esds/SDP "config" of the packets
+    static std::vector<uint8_t> config(int32_t sample_rate, int32_t channels);
+
+    json stats();
+
+private:
+    Mutex mutex_;
+    AVCodecContext* ctx_;
+    AVFrame* frame_;
+    AVPacket* packet_;
+    std::vector<int16_t> pending_;
+    int32_t sample_rate_;
+    int32_t channels_;
+    int32_t bitrate_;
+    int64_t pts_;
+    uint64_t packets_;
+    uint64_t in_bytes_;
+    uint64_t out_bytes_;
+    uint64_t errors_;
+};
+
+}  // namespace ma::node
@@ -0,0 +1,267 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/error.h>
+}
+
+#include "async_writer.h"
+
+namespace ma::node {
+
+static constexpr char TAG[] = "ma::node::writer";
+
+AsyncWriter::AsyncWriter()
+    : free_(new MessageBox(WRITER_BUFFER_COUNT)),
+      full_(new MessageBox(WRITER_BUFFER_COUNT)),
+      current_(nullptr),
+      thread_(nullptr),
+      running_(false),
+      fd_(-1),
+      failed_(false),
+      reserved_(0),
+      files_(0),
+      writes_(0),
+      bytes_(0),
+      stalls_(0),
+      prealloc_failed_(0),
+      total_us_(0),
+      max_us_(0),
+      histogram_{0},
+      queued_(0),
+      peak_(0) {}
+
+AsyncWriter::~AsyncWriter() {
+    close();
+    stop();
+    for (auto& buffer : buffers_) {
+        free(buffer.data);
+    }
+    delete free_;
+    delete full_;
+}
+
+void AsyncWriter::start(const std::string& name) {
+    if (thread_ != nullptr) {
+        return;
+    }
+    // allocated once the writer is used, kept until it is destroyed
+    if (buffers_.empty()) {
+        buffers_.resize(WRITER_BUFFER_COUNT, {nullptr, 0});
+        for (auto& buffer : buffers_) {
+            void* data = nullptr;
+            if (posix_memalign(&data, 4096, WRITER_BUFFER_SIZE) != 0) {
+                MA_THROW(Exception(MA_ENOMEM, "Not enough memory"));
+            }
+            buffer.data = static_cast<uint8_t*>(data);
+            free_->post(&buffer, Tick::fromMilliseconds(0));
+        }
+    }
+    running_ = true;
+    thread_  = new Thread(name.c_str(), threadEntryStub);
+    if (thread_ == nullptr) {
+        MA_THROW(Exception(MA_ENOMEM, "Not enough memory"));
+    }
+    thread_->start(this);
+}
+
+void AsyncWriter::stop() {
+    if (thread_ == nullptr) {
+        return;
+    }
+    running_ = false;
+    thread_->join();
+    delete thread_;
+    thread_ = nullptr;
+}
+
+void AsyncWriter::threadEntryStub(void* obj) {
+    reinterpret_cast<AsyncWriter*>(obj)->threadEntry();
+}
+
+void AsyncWriter::threadEntry() {
+    buffer_t* buffer = nullptr;
+    // queued buffers are written out before the thread ends
+    while (running_ || queued_.load() > 0) {
+        if (!full_->fetch(reinterpret_cast<void**>(&buffer), Tick::fromMilliseconds(100))) {
+            continue;
+        }
+        ma_tick_t start = Tick::current();
+        size_t done     = 0;
+        while (!failed_ && done < buffer->size) {
+            ssize_t n = ::write(fd_, buffer->data + done, buffer->size - done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                MA_LOGW(TAG, "write failed: %s", strerror(errno));
+                failed_ = true;
+                break;
+            }
+            done += n;
+        }
+        int64_t us = Tick::toMicroseconds(Tick::current() - start);
+        {
+            Guard guard(stats_mutex_);
+            int64_t ms = us / 1000;
+            int bucket = ms == 0 ? 0 : std::min(WRITER_BUCKETS - 1, 64 - __builtin_clzll(ms));
+            histogram_[bucket]++;
+            writes_++;
+            bytes_ += done;
+            total_us_ += us;
+            max_us_ = std::max(max_us_, us);
+        }
+        buffer->size = 0;
+        queued_--;
+        free_->post(buffer, Tick::fromMilliseconds(0));
+    }
+}
+
+AsyncWriter::buffer_t* AsyncWriter::acquire() {
+    buffer_t* buffer = nullptr;
+    if (free_->fetch(reinterpret_cast<void**>(&buffer), Tick::fromMilliseconds(0))) {
+        return buffer;
+    }
+    {
+        Guard guard(stats_mutex_);
+        stalls_++;
+    }
+    while (running_) {
+        if (free_->fetch(reinterpret_cast<void**>(&buffer), Tick::fromSeconds(1))) {
+            return buffer;
+        }
+    }
+    return nullptr;
+}
+
+bool AsyncWriter::open(const std::string& path, size_t prealloc) {
+    close();
+    if (!running_) {
+        MA_LOGE(TAG, "writer not started");
+        return false;
+    }
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        MA_LOGE(TAG, "could not open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    failed_   = false;
+    reserved_ = 0;
+    // the file keeps its size, so a reader or a crash never sees the reserved blocks as data
+    if (prealloc > 0) {
+        if (fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, prealloc) == 0) {
+            reserved_ = prealloc;
+        } else {
+            Guard guard(stats_mutex_);
+            prealloc_failed_++;
+            MA_LOGD(TAG, "fallocate %zu: %s", prealloc, strerror(errno));
+        }
+    }
+    Guard guard(stats_mutex_);
+    files_++;
+    return true;
+}
+
+void AsyncWriter::close() {
+    if (fd_ < 0) {
+        return;
+    }
+    flush();
+    if (current_ != nullptr) {
+        free_->post(current_, Tick::fromMilliseconds(0));
+        current_ = nullptr;
+    }
+    // every buffer back in the free box means the thread wrote them all
+    std::vector<buffer_t*> drained;
+    buffer_t* buffer = nullptr;
+    while (drained.size() < buffers_.size() && running_) {
+        if (free_->fetch(reinterpret_cast<void**>(&buffer), Tick::fromSeconds(1))) {
+            drained.push_back(buffer);
+        }
+    }
+    for (auto item : drained) {
+        free_->post(item, Tick::fromMilliseconds(0));
+    }
+    fdatasync(fd_);
+    if (reserved_ > 0) {
+        off_t size = lseek(fd_, 0, SEEK_CUR);
+        if (size >= 0 && ftruncate(fd_, size) != 0) {
+            MA_LOGD(TAG, "ftruncate: %s", strerror(errno));
+        }
+    }
+    ::close(fd_);
+    fd_       = -1;
+    reserved_ = 0;
+}
+
+void AsyncWriter::write(const uint8_t* data, size_t size) {
+    while (size > 0 && fd_ >= 0) {
+        if (current_ == nullptr && (current_ = acquire()) == nullptr) {
+            return;
+        }
+        size_t n = std::min(size, WRITER_BUFFER_SIZE - current_->size);
+        memcpy(current_->data + current_->size, data, n);
+        current_->size += n;
+        data += n;
+        size -= n;
+        if (current_->size == WRITER_BUFFER_SIZE) {
+            flush();
+        }
+    }
+}
+
+void AsyncWriter::flush() {
+    if (current_ == nullptr) {
+        return;
+    }
+    if (current_->size == 0) {
+        return;  // kept for the next write
+    }
+    uint32_t queued = ++queued_;
+    {
+        Guard guard(stats_mutex_);
+        peak_ = std::max(peak_, queued);
+    }
+    // never blocks, the box holds every buffer there is
+    full_->post(current_, Tick::fromMilliseconds(0));
+    current_ = nullptr;
+}
+
+bool AsyncWriter::failed() const {
+    return failed_;
+}
+
+int AsyncWriter::writePacket(void* opaque, uint8_t* data, int size) {
+    AsyncWriter* writer = static_cast<AsyncWriter*>(opaque);
+    if (writer->failed()) {
+        return AVERROR(EIO);
+    }
+    writer->write(data, size);
+    return size;
+}
+
+json AsyncWriter::stats() {
+    Guard guard(stats_mutex_);
+    json buckets = json::array();
+    for (int i = 0; i < WRITER_BUCKETS; i++) {
+        buckets.push_back(histogram_[i]);
+    }
+    return json::object({{"files", files_},
+                         {"writes", writes_},
+                         {"bytes", bytes_},
+                         {"queued", queued_.load()},
+                         {"peak", peak_},
+                         {"stalls", stalls_},
+                         {"failed", failed_.load()},
+                         {"prealloc_failed", prealloc_failed_},
+                         {"latency_avg_us", writes_ > 0 ? total_us_ / static_cast<int64_t>(writes_) : 0},
+                         {"latency_max_us", max_us_},
+                         {"histogram", buckets}});
+}
+
+}  // namespace ma::node
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "core/ma_core.h"
+#include "porting/ma_porting.h"
+
+namespace ma::node {
+
+#define WRITER_BUFFER_SIZE  (256 * 1024)  // bytes handed to write() at once, a multiple of the page
+#define WRITER_BUFFER_COUNT 8             // buffers in flight, the most a stalled card can hold back
+#define WRITER_BUCKETS      12            // latency buckets, 1 ms doubling up to 1 s, then the rest
+
+// Writes a file from its own thread so the caller never waits on storage until every buffer is
+// queued. Bytes are gathered into page-aligned buffers, a full buffer or flush() passes one to the
+// thread; buffers come back once written, so memory stays at WRITER_BUFFER_COUNT buffers.
+class AsyncWriter {
+public:
+    AsyncWriter();
+    ~AsyncWriter();
+
+    AsyncWriter(const AsyncWriter&)            = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    void start(const std::string& name);
+    void stop();
+
+    // prealloc reserves that many bytes without growing the file, 0 skips it
+    bool open(const std::string& path, size_t prealloc);
+    // waits for the queued buffers, syncs and trims what was reserved beyond the data
+    void close();
+
+    void write(const uint8_t* data, size_t size);
+    // hands the gathered bytes to the thread, e.g. at the end of a fragment
+    void flush();
+    // a write() failed since open(), the file ends before it
+    bool failed() const;
+
+    // AVIOContext write_packet callback, opaque is the writer
+    static int writePacket(void* opaque, uint8_t* data, int size);
+
+    json stats();
+
+private:
+    struct buffer_t {
+        uint8_t* data;
+        size_t size;
+    };
+
+    void threadEntry();
+    static void threadEntryStub(void* obj);
+    buffer_t* acquire();
+
+    std::vector<buffer_t> buffers_;
+    MessageBox* free_;
+    MessageBox* full_;
+    buffer_t* current_;
+    Thread* thread_;
+    std::atomic<bool> running_;
+    int fd_;
+    std::atomic<bool> failed_;
+    size_t reserved_;
+
+    Mutex stats_mutex_;
+    uint64_t files_;
+    uint64_t writes_;
+    uint64_t bytes_;
+    uint64_t stalls_;  // buffers the caller had to wait for
+    uint64_t prealloc_failed_;
+    int64_t total_us_;
+    int64_t max_us_;
+    uint64_t histogram_[WRITER_BUCKETS];
+    std::atomic<uint32_t> queued_;
+    uint32_t peak_;
+};
+
+}  // namespace ma::node
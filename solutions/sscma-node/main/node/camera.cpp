@@ -7,28 +7,28 @@ namespace ma::node {
 
 static constexpr char TAG[] = "ma::node::camera";
 
-const char* VIDEO_FORMATS[] = {"raw", "jpeg", "h264"};
+const char* VIDEO_FORMATS[] = {"raw", "jpeg", "h264", "raw", "h264"};
 
 
 #define CAMERA_INIT()                                                                                                                        \
     {                                                                                                                                        \
-        Thread::enterCritical();                                                                                                             \
+        std::unique_lock<std::shared_mutex> lock(pipeline());                                                                                \
         Thread::sleep(Tick::fromMilliseconds(100));                                                                                          \
         MA_LOGI(TAG, "start video");                                                                                                         \
         startVideo();                                                                                                                        \
         Thread::sleep(Tick::fromSeconds(1));                                                                                                 \
-        Thread::exitCritical();                                                                                                              \
+        lock.unlock();                                                                                                                       \
         server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "enabled"}, {"code", MA_OK}, {"data", enabled_.load()}})); \
     }
 
 #define CAMERA_DEINIT()                                                                                                                      \
     {                                                                                                                                        \
-        Thread::enterCritical();                                                                                                             \
+        std::unique_lock<std::shared_mutex> lock(pipeline());                                                                                \
         MA_LOGI(TAG, "stop video");                                                                                                          \
         Thread::sleep(Tick::fromMilliseconds(100));                                                                                          \
         deinitVideo();                                                                                                                       \
         Thread::sleep(Tick::fromSeconds(1));                                                                                                 \
-        Thread::exitCritical();                                                                                                              \
+        lock.unlock();                                                                                                                       \
         server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "enabled"}, {"code", MA_OK}, {"data", enabled_.load()}})); \
     }
 
@@ -37,20 +37,29 @@ CameraNode::CameraNode(std::string id)
       channels_(CHN_MAX),
       count_(0),
       light_(0),
+      zerocopy_(0),
+      harvest_single_(false),
       preview_(false),
       websocket_(true),
       audio_(80),
+      aac_bitrate_(32000),
       mirror_(false),
       flip_(false),
       option_(0),
       fps_(30),
+      encoding_(MSG_ENCODING_JSON),
+      replay_live_(false),
+      ws_config_(),
       frame_(60),
+      video_(60),
       thread_(nullptr),
+      thread_video_(nullptr),
       thread_audio_(nullptr),
       transport_(nullptr) {
     for (int i = 0; i < CHN_MAX; i++) {
         channels_[i].configured = false;
         channels_[i].enabled    = false;
+        channels_[i].paused     = false;
         channels_[i].format     = MA_PIXEL_FORMAT_H264;
         channels_[i].fps        = 30;
     }
@@ -82,7 +91,7 @@ int CameraNode::vencCallback(void* pData, void* pArgs) {
     APP_VENC_CHN_CFG_S* pstVencChnCfg = (APP_VENC_CHN_CFG_S*)pstDataParam->pParam;
     VENC_CHN VencChn                  = pstVencChnCfg->VencChn;
 
-    if (!started_ || !enabled_ || channels_[VencChn].msgboxes.empty()) {
+    if (!started_ || !enabled_ || channels_[VencChn].subscribers.empty()) {
         return CVI_SUCCESS;
     }
     if (pstVencChnCfg->VencChn >= CHN_MAX) {
@@ -96,7 +105,7 @@ int CameraNode::vencCallback(void* pData, void* pArgs) {
     for (int i = 0; i < pstStream->u32PackCount; i++) {
         videoFrame* frame = nullptr;
         ppack             = &pstStream->pstPack[i];
-        if (VencChn == CHN_H264 && isKeyFrame(ppack->DataType.enH264EType)) {
+        if (isH264(VencChn) && isKeyFrame(ppack->DataType.enH264EType)) {
             int cnt    = 0;
             int offset = 0;
             int size   = 0;
@@ -115,28 +124,44 @@ int CameraNode::vencCallback(void* pData, void* pArgs) {
                 i += 1;
                 cnt = 1;
             }
-            frame                      = new videoFrame();
-            frame->chn                 = VencChn;
-            frame->timestamp           = Tick::current();
-            frame->img.width           = channels_[VencChn].width;
-            frame->img.height          = channels_[VencChn].height;
-            frame->img.format          = channels_[VencChn].format;
-            frame->img.size            = size;
-            frame->img.key             = true;
-            frame->img.physical        = false;
-            frame->img.data            = new uint8_t[size];
-            frame->fps                 = channels_[VencChn].fps;
-            channels_[VencChn].dropped = false;
+            // merge the parameter sets and the IDR slice into one access unit
+            bool contiguous = true;
+            size            = 0;
             for (int j = i; j < i + cnt; j++) {
-                memcpy(frame->img.data + offset, pstStream->pstPack[j].pu8Addr + pstStream->pstPack[j].u32Offset, pstStream->pstPack[j].u32Len - pstStream->pstPack[j].u32Offset);
+                size += pstStream->pstPack[j].u32Len - pstStream->pstPack[j].u32Offset;
+                if (j > i && pstStream->pstPack[j - 1].pu8Addr + pstStream->pstPack[j - 1].u32Len != pstStream->pstPack[j].pu8Addr + pstStream->pstPack[j].u32Offset) {
+                    contiguous = false;
+                }
+            }
+            frame               = new videoFrame();
+            frame->chn          = VencChn;
+            frame->timestamp    = Tick::current();
+            frame->img.width    = channels_[VencChn].width;
+            frame->img.height   = channels_[VencChn].height;
+            frame->img.format   = channels_[VencChn].format;
+            frame->img.size     = size;
+            frame->img.key      = true;
+            frame->img.physical = false;
+            frame->fps          = channels_[VencChn].fps;
+            frame->handle       = contiguous ? holdVideoStream() : nullptr;
+            if (frame->handle != nullptr) {
+                frame->img.data = pstStream->pstPack[i].pu8Addr + pstStream->pstPack[i].u32Offset;
+            } else {
+                frame->img.data = static_cast<uint8_t*>(FramePool::instance().allocate(size));
+                if (frame->img.data == nullptr) {
+                    frame->release();
+                    break;
+                }
+            }
+            for (int j = i; j < i + cnt; j++) {
+                if (frame->handle == nullptr) {
+                    memcpy(frame->img.data + offset, pstStream->pstPack[j].pu8Addr + pstStream->pstPack[j].u32Offset, pstStream->pstPack[j].u32Len - pstStream->pstPack[j].u32Offset);
+                }
                 frame->blocks.push_back({frame->img.data + offset, pstStream->pstPack[j].u32Len - pstStream->pstPack[j].u32Offset});
                 offset += pstStream->pstPack[j].u32Len - pstStream->pstPack[j].u32Offset;
             }
             i += (cnt - 1);
         } else {
-            if (VencChn == CHN_H264 && channels_[VencChn].dropped) {
-                continue;
-            }
             frame               = new videoFrame();
             frame->chn          = VencChn;
             frame->timestamp    = Tick::current();
@@ -146,19 +171,22 @@ int CameraNode::vencCallback(void* pData, void* pArgs) {
             frame->img.size     = ppack->u32Len - ppack->u32Offset;
             frame->img.key      = false;
             frame->img.physical = false;
-            frame->img.data     = new uint8_t[ppack->u32Len - ppack->u32Offset];
             frame->fps          = channels_[VencChn].fps;
-            frame->blocks.push_back({frame->img.data, ppack->u32Len - ppack->u32Offset});
-            memcpy(frame->img.data, ppack->pu8Addr + ppack->u32Offset, ppack->u32Len - ppack->u32Offset);
-        }
-        if (frame != nullptr) {
-            frame->ref(channels_[VencChn].msgboxes.size());
-            for (auto& msgbox : channels_[VencChn].msgboxes) {
-                if (!msgbox->post(frame, Tick::fromMilliseconds(static_cast<int>(1000.0 / channels_[VencChn].fps)))) {
+            frame->handle       = holdVideoStream();
+            if (frame->handle != nullptr) {
+                frame->img.data = ppack->pu8Addr + ppack->u32Offset;
+            } else {
+                frame->img.data = static_cast<uint8_t*>(FramePool::instance().allocate(ppack->u32Len - ppack->u32Offset));
+                if (frame->img.data == nullptr) {
                     frame->release();
-                    channels_[VencChn].dropped = true;
+                    continue;
                 }
+                memcpy(frame->img.data, ppack->pu8Addr + ppack->u32Offset, ppack->u32Len - ppack->u32Offset);
             }
+            frame->blocks.push_back({frame->img.data, ppack->u32Len - ppack->u32Offset});
+        }
+        if (frame != nullptr) {
+            dispatch(VencChn, frame);
         }
     }
 
@@ -171,7 +199,7 @@ int CameraNode::vpssCallback(void* pData, void* pArgs) {
     VIDEO_FRAME_INFO_S* VpssFrame     = (VIDEO_FRAME_INFO_S*)pData;
     VIDEO_FRAME_S* f                  = &VpssFrame->stVFrame;
 
-    if (!started_ || !enabled_ || channels_[pstVencChnCfg->VencChn].msgboxes.empty()) {
+    if (!started_ || !enabled_ || channels_[pstVencChnCfg->VencChn].subscribers.empty()) {
         return CVI_SUCCESS;
     }
     if (pstVencChnCfg->VencChn >= CHN_MAX) {
@@ -190,13 +218,94 @@ int CameraNode::vpssCallback(void* pData, void* pArgs) {
     frame->img.data     = reinterpret_cast<uint8_t*>(f->u64PhyAddr[0]);
     frame->timestamp    = Tick::current();
     frame->fps          = channels_[pstVencChnCfg->VencChn].fps;
-    frame->ref(channels_[pstVencChnCfg->VencChn].msgboxes.size());
-    for (auto& msgbox : channels_[pstVencChnCfg->VencChn].msgboxes) {
-        if (msgbox->isFull() || !msgbox->post(frame, Tick::fromMilliseconds(5))) {
+    dispatch(pstVencChnCfg->VencChn, frame);
+    return CVI_SUCCESS;
+}
+
+std::shared_mutex& CameraNode::pipeline() {
+    static std::shared_mutex lock;
+    return lock;
+}
+
+void CameraNode::dispatch(int chn, Frame* frame) {
+    bool cached = chn == CHN_H264 && gops_[chn].enabled();
+    {
+        Guard guard(subscribers_mutex_);
+        // checked under the lock, so onStop() sees every frame posted before it drops them
+        if (!started_ || (channels_[chn].subscribers.empty() && !cached)) {
             frame->release();
+            return;
+        }
+        // each subscriber owns one reference; post() never blocks and releases it on drop
+        frame->ref(channels_[chn].subscribers.size() + (cached ? 1 : 0));
+        for (auto& sub : channels_[chn].subscribers) {
+            sub.queue->post(frame, sub.policy);
         }
     }
-    return CVI_SUCCESS;
+    // the cache copies zero-copy frames, which must not hold up attach() or the other channels
+    if (cached) {
+        gops_[chn].push(static_cast<videoFrame*>(frame));
+    }
+}
+
+bool CameraNode::isH264(int chn) const {
+    return !isAudioChannel(chn) && channels_[chn].format == MA_PIXEL_FORMAT_H264;
+}
+
+// caller holds mutex_ and subscribers_mutex_
+void CameraNode::demand(int chn) {
+    if (!started_ || chn == CHN_RAW || chn == CHN_EXT || isAudioChannel(chn) || !channels_[chn].enabled) {
+        return;
+    }
+    bool paused = !channels_[chn].subscribers.empty();
+    for (auto& sub : channels_[chn].subscribers) {
+        paused = paused && sub.idle;
+    }
+    if (paused != channels_[chn].paused && setVideoPaused(static_cast<video_ch_index_t>(chn), paused) == 0) {
+        channels_[chn].paused = paused;
+        MA_LOGI(TAG, "channel %d encoder %s", chn, paused ? "paused" : "resumed");
+    }
+}
+
+// encoders come up running after startVideo()
+void CameraNode::demandAll() {
+    Guard subscribers_guard(subscribers_mutex_);
+    for (int i = 0; i < CHN_MAX; i++) {
+        channels_[i].paused = false;
+        demand(i);
+    }
+}
+
+GopCache& CameraNode::gop(int chn) {
+    return gops_[chn];
+}
+
+void CameraNode::prime(videoFrame* live) {
+    std::vector<videoFrame*> frames;
+    // frames queued behind this one are already in the cache, they reach the viewer live
+    if (!live->img.key) {
+        gops_[live->chn].snapshot(frames, live->timestamp);
+        if (replay_live_) {
+            // fast-forward: the cached IDR shows a picture at once, the requested one catches up with live
+            for (size_t i = 1; i < frames.size(); i++) {
+                frames[i]->release();
+            }
+            frames.resize(std::min<size_t>(frames.size(), 1));
+            requestVideoIDR(static_cast<video_ch_index_t>(live->chn));
+        }
+    }
+
+    std::vector<const char*> data;
+    std::vector<size_t> lengths;
+    for (auto frame : frames) {
+        data.push_back(reinterpret_cast<const char*>(frame->img.data));
+        lengths.push_back(frame->img.size);
+    }
+    size_t primed = transport_->prime(data.data(), lengths.data(), frames.size(), !replay_live_);
+    MA_LOGD(TAG, "primed %zu websocket clients with %zu frames", primed, frames.size());
+    for (auto frame : frames) {
+        frame->release();
+    }
 }
 
 
@@ -206,24 +315,38 @@ void CameraNode::threadEntry() {
 
     while (started_) {
         if (frame_.fetch(reinterpret_cast<void**>(&frame), Tick::fromSeconds(1))) {
-            Thread::enterCritical();
-            if (transport_ && frame->img.format == MA_PIXEL_FORMAT_H264) {
-                transport_->send(reinterpret_cast<const char*>(frame->img.data), frame->img.size);
-            } else {
-                if (Tick::current() - last > Tick::fromMilliseconds(100)) {
-                    count_++;
-                    json reply     = json::object({{"type", MA_MSG_TYPE_EVT}, {"name", "sample"}, {"code", MA_OK}, {"data", {{"count", count_}}}});
+            if (Tick::current() - last > Tick::fromMilliseconds(100)) {
+                count_++;
+                json reply = json::object({{"type", MA_MSG_TYPE_EVT}, {"name", "sample"}, {"code", MA_OK}, {"data", {{"count", count_}}}});
+                if (encoding_ != MSG_ENCODING_JSON) {
+                    // the binary encodings carry the JPEG as a byte string, no base64
+                    reply["v"]             = MSG_SCHEMA_VERSION;
+                    reply["data"]["image"] = json::binary(std::vector<uint8_t>(frame->img.data, frame->img.data + frame->img.size));
+                } else {
                     char* base64   = new char[4 * ((frame->img.size + 2) / 3 + 2)];
                     int base64_len = 4 * ((frame->img.size + 2) / 3 + 2);
                     ma::utils::base64_encode(frame->img.data, frame->img.size, base64, &base64_len);
                     reply["data"]["image"] = std::string(base64, base64_len);
                     delete[] base64;
-                    server_->response(id_, reply);
-                    last = Tick::current();
                 }
+                server_->response(id_, reply, encoding_);
+                last = Tick::current();
+            }
+            frame->release();
+        }
+    }
+}
+
+void CameraNode::threadVideoEntry() {
+    videoFrame* frame = nullptr;
+
+    while (started_) {
+        if (video_.fetch(reinterpret_cast<void**>(&frame), Tick::fromSeconds(1))) {
+            if (transport_->joining() > 0) {
+                prime(frame);
             }
+            transport_->send(reinterpret_cast<const char*>(frame->img.data), frame->img.size, frame->img.key);
             frame->release();
-            Thread::exitCritical();
         }
     }
 }
@@ -325,6 +448,8 @@ void CameraNode::threadAudioEntry() {
 
     buffer = new uint16_t[chunk_size * bits_per_sample / 8 * 2 + 1];
 
+    aac_.open(SAMPLE_RATE, CHANNELS, aac_bitrate_);
+
     while (started_) {
         pcm_return = snd_pcm_readi(handle, buffer, chunk_size * 2);
         if (pcm_return == -EPIPE) {
@@ -338,23 +463,42 @@ void CameraNode::threadAudioEntry() {
             MA_LOGE(TAG, "error from read: %s", snd_strerror(pcm_return));
             break;
         }
-        if (!enabled_ || channels_[CHN_AUDIO].msgboxes.empty()) {
+        if (!enabled_) {
+            continue;
+        }
+        if (!channels_[CHN_AAC].subscribers.empty()) {
+            ma_tick_t timestamp = Tick::current();
+            aac_.encode(reinterpret_cast<const uint8_t*>(buffer), pcm_return * bits_per_sample / 8 * CHANNELS, [&](const uint8_t* data, size_t size) {
+                audioFrame* packet = new audioFrame();
+                packet->chn        = CHN_AAC;
+                packet->data       = static_cast<uint8_t*>(FramePool::instance().allocate(size));
+                packet->size       = size;
+                packet->timestamp  = timestamp;
+                if (packet->data == nullptr) {
+                    packet->release();
+                    return;
+                }
+                memcpy(packet->data, data, size);
+                dispatch(CHN_AAC, packet);
+            });
+        }
+        if (channels_[CHN_AUDIO].subscribers.empty()) {
             continue;
         }
         audioFrame* frame = new audioFrame();
         frame->chn        = CHN_AUDIO;
-        frame->data       = new uint8_t[chunk_size * bits_per_sample / 8 * 2];
+        frame->data       = static_cast<uint8_t*>(FramePool::instance().allocate(chunk_size * bits_per_sample / 8 * 2));
         frame->size       = chunk_size * bits_per_sample / 8 * 2;
         frame->timestamp  = Tick::current();
-        memcpy(frame->data, buffer, chunk_size * bits_per_sample / 8 * 2);
-        frame->ref(channels_[CHN_AUDIO].msgboxes.size());
-        for (auto& msgbox : channels_[CHN_AUDIO].msgboxes) {
-            if (msgbox->isFull() || !msgbox->post(frame, Tick::fromMilliseconds(20))) {
-                frame->release();
-            }
+        if (frame->data == nullptr) {
+            frame->release();
+            continue;
         }
+        memcpy(frame->data, buffer, chunk_size * bits_per_sample / 8 * 2);
+        dispatch(CHN_AUDIO, frame);
     }
 
+    aac_.close();
     snd_pcm_close(handle);
     delete[] buffer;
 }
@@ -373,6 +517,10 @@ void CameraNode::threadEntryStub(void* obj) {
 }
 
 
+void CameraNode::threadVideoEntryStub(void* obj) {
+    reinterpret_cast<CameraNode*>(obj)->threadVideoEntry();
+}
+
 void CameraNode::threadAudioEntryStub(void* obj) {
     reinterpret_cast<CameraNode*>(obj)->threadAudioEntry();
 }
@@ -406,8 +554,8 @@ ma_err_t CameraNode::onCreate(const json& config) {
         preview_ = config["preview"].get<bool>();
     }
 
-    if (config.contains("websocket") && config["websocket"].is_boolean()) {
-        websocket_ = config["websocket"].get<bool>();
+    if (config.contains("websocket")) {
+        websocketConfig(config["websocket"], websocket_, ws_config_);
     }
 
     if (config.contains("audio") && config["audio"].is_boolean()) {
@@ -424,6 +572,11 @@ ma_err_t CameraNode::onCreate(const json& config) {
         }
     }
 
+    // bitrate of the shared AAC encode in kbps
+    if (config.contains("aac") && config["aac"].is_number()) {
+        aac_bitrate_ = std::clamp(config["aac"].get<int32_t>(), 16, 128) * 1000;
+    }
+
     if (config.contains("fps") && config["fps"].is_number()) {
         fps_ = config["fps"].get<int>();
         if (fps_ < 1) {
@@ -434,10 +587,57 @@ ma_err_t CameraNode::onCreate(const json& config) {
         }
     }
 
+    // hold encoder buffers instead of copying them, bounded by the number of streams in flight
+    if (config.contains("zerocopy") && config["zerocopy"].is_boolean()) {
+        zerocopy_ = config["zerocopy"].get<bool>() ? 4 : 0;
+    }
+
+    if (config.contains("zerocopy") && config["zerocopy"].is_number()) {
+        zerocopy_ = config["zerocopy"].get<int>();
+        if (zerocopy_ < 0) {
+            zerocopy_ = 0;
+        }
+        if (zerocopy_ > APP_REF_INFLIGHT_MAX) {
+            zerocopy_ = APP_REF_INFLIGHT_MAX;
+        }
+    }
+
+    // one epoll thread collects every encoder instead of a thread per channel
+    if (config.contains("harvest") && config["harvest"].is_string()) {
+        harvest_single_ = config["harvest"].get<std::string>() == "single";
+    }
+
     if (config.contains("light") && config["light"].is_number()) {
         light_ = config["light"].get<int>();
     }
 
+    // the GOP cache is on with the websocket unless "gop" is false; bytes in KiB
+    size_t gop_frames = 90;
+    size_t gop_bytes  = 4096;
+    replay_live_      = false;
+    if (config.contains("gop") && config["gop"].is_boolean() && !config["gop"].get<bool>()) {
+        gop_frames = 0;
+    }
+    if (config.contains("gop") && config["gop"].is_object()) {
+        const json& gop = config["gop"];
+        if (gop.contains("frames") && gop["frames"].is_number_integer()) {
+            gop_frames = std::clamp(gop["frames"].get<int>(), 0, 600);
+        }
+        if (gop.contains("bytes") && gop["bytes"].is_number_integer()) {
+            gop_bytes = std::clamp(gop["bytes"].get<int>(), 256, 32 * 1024);
+        }
+        replay_live_ = gop.value("replay", std::string("full")) == "live";
+    }
+    // only websocket viewers of the main stream are replayed a GOP, nothing else pays for the copies
+    for (int i = 0; i < CHN_MAX; i++) {
+        gops_[i].configure(i == CHN_H264 && websocket_ ? gop_frames : 0, gop_bytes * 1024);
+    }
+
+    encoding_ = MSG_ENCODING_JSON;
+    if (config.contains("encoding") && config["encoding"].is_string() && !encodingFromName(config["encoding"].get<std::string>(), encoding_)) {
+        MA_THROW(Exception(MA_EINVAL, "Unknown encoding " + config["encoding"].get<std::string>()));
+    }
+
     if (config.contains("mirror") && config["mirror"].is_boolean()) {
         mirror_ = config["mirror"].get<bool>();
     }
@@ -494,13 +694,15 @@ ma_err_t CameraNode::onCreate(const json& config) {
     }
 
     if (websocket_) {
-        TransportWebSocket::Config ws_config = {.port = 8080};
+        TransportWebSocket::Config ws_config = ws_config_;
+        ws_config.keyframes                  = true;  // a client that falls behind skips to the next IDR
         MA_STORAGE_GET_POD(server_->getStorage(), MA_STORAGE_KEY_WS_PORT, ws_config.port, 8080);
         transport_ = new TransportWebSocket();
         if (transport_ != nullptr) {
             this->config(CHN_H264);
-            this->attach(CHN_H264, &frame_);
+            this->attach(CHN_H264, &video_, FRAME_POLICY_KEYFRAME);
             transport_->init(&ws_config);
+            thread_video_ = new Thread((type_ + "#" + id_ + "#video").c_str(), &CameraNode::threadVideoEntryStub, this);
         }
         MA_LOGI(TAG, "camera websocket server started on port %d", ws_config.port);
     } else {
@@ -517,6 +719,8 @@ ma_err_t CameraNode::onCreate(const json& config) {
     if (audio_) {
         channels_[CHN_AUDIO].enabled    = true;
         channels_[CHN_AUDIO].configured = true;
+        channels_[CHN_AAC].enabled      = true;
+        channels_[CHN_AAC].configured   = true;
         thread_audio_                   = new Thread((type_ + "#" + id_ + "#audio").c_str(), &CameraNode::threadAudioEntryStub, this);
         if (thread_audio_ == nullptr) {
             delete thread_;
@@ -556,12 +760,49 @@ ma_err_t CameraNode::onControl(const std::string& control, const json& data) {
             system("echo 1 > /sys/devices/platform/leds/leds/white/brightness");
         }
         server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", control}, {"code", MA_OK}, {"data", {"light", light_}}}));
+    } else if (control == "stats") {
+        json channels = json::array();
+        for (int i = 0; i < CHN_MAX; i++) {
+            json subscribers = json::array();
+            {
+                Guard subscribers_guard(subscribers_mutex_);
+                for (auto& sub : channels_[i].subscribers) {
+                    json item      = sub.queue->stats();
+                    item["policy"] = framePolicyName(sub.policy);
+                    subscribers.push_back(item);
+                }
+            }
+            json item = {{"chn", i}, {"enabled", channels_[i].enabled}, {"subscribers", subscribers}};
+            if (i == CHN_H264) {
+                item["gop"] = gops_[i].stats();
+            }
+            if (!isAudioChannel(i) && channels_[i].enabled) {
+                item["paused"] = channels_[i].paused;
+            }
+            APP_DATA_STAT_S stat;
+            if (!isAudioChannel(i) && started_ && getVideoStreamStat(static_cast<video_ch_index_t>(i), &stat) == 0) {
+                item["venc"] = {{"depth", stat.u32Depth},
+                                {"peak", stat.u32PeakDepth},
+                                {"pushed", stat.u64Pushed},
+                                {"handled", stat.u64Handled},
+                                {"dropped", stat.u64Dropped},
+                                {"latency_avg_us", stat.u32LatencyAvgUs},
+                                {"latency_max_us", stat.u32LatencyMaxUs}};
+            }
+            channels.push_back(item);
+        }
+        server_->response(id_,
+                          json::object({{"type", MA_MSG_TYPE_RESP},
+                                        {"name", control},
+                                        {"code", MA_OK},
+                                        {"data", {{"pool", FramePool::instance().stats()}, {"channels", channels}, {"aac", aac_.stats()}, {"websocket", websocketStats(transport_)}}}}));
     } else if (control == "enabled" && data.is_boolean()) {
         bool enabled = data.get<bool>();
         if (enabled_ != enabled) {
             enabled_.store(enabled);
             if (enabled_) {
                 CAMERA_INIT();
+                demandAll();
             } else {
                 CAMERA_DEINIT();
             }
@@ -586,6 +827,11 @@ ma_err_t CameraNode::onDestroy() {
         thread_ = nullptr;
     }
 
+    if (thread_video_ != nullptr) {
+        delete thread_video_;
+        thread_video_ = nullptr;
+    }
+
     if (transport_ != nullptr) {
         transport_->deInit();
         delete transport_;
@@ -628,7 +874,7 @@ ma_err_t CameraNode::onStart() {
     }
 
     for (int i = 0; i < CHN_MAX; i++) {
-        if (i == CHN_AUDIO) {
+        if (isAudioChannel(i)) {
             continue;
         }
         video_ch_param_t param;
@@ -657,25 +903,33 @@ ma_err_t CameraNode::onStart() {
         MA_LOGI(TAG, "start channel %d format %d width %d height %d fps %d", i, param.format, param.width, param.height, param.fps);
         if (channels_[i].enabled) {
             setupVideo(static_cast<video_ch_index_t>(i), &param);
-            if (i == CHN_RAW) {
+            if (i == CHN_RAW || i == CHN_EXT) {
                 registerVideoFrameHandler(static_cast<video_ch_index_t>(i), 0, vpssCallbackStub, this);
             } else {
+                setVideoZeroCopy(static_cast<video_ch_index_t>(i), zerocopy_);
                 registerVideoFrameHandler(static_cast<video_ch_index_t>(i), 0, vencCallbackStub, this);
             }
         }
     }
 
+    setVideoHarvestSingle(harvest_single_);
+
     started_ = true;
 
     if (thread_ != nullptr) {
         thread_->start(this);
     }
 
+    if (thread_video_ != nullptr) {
+        thread_video_->start(this);
+    }
+
     if (audio_ && thread_audio_ != nullptr) {
         thread_audio_->start(this);
     }
 
     CAMERA_INIT();
+    demandAll();
     return MA_OK;
 }
 
@@ -692,9 +946,26 @@ ma_err_t CameraNode::onStop() {
     if (thread_ != nullptr) {
         thread_->join();
     }
+    if (thread_video_ != nullptr) {
+        thread_video_->join();
+    }
     if (audio_ && thread_audio_ != nullptr) {
         thread_audio_->join();
     }
+    // queued zero-copy frames hold encoder streams, which the video waits for before it stops
+    {
+        Guard subscribers_guard(subscribers_mutex_);
+        for (auto& channel : channels_) {
+            for (auto& sub : channel.subscribers) {
+                sub.queue->clear();
+            }
+        }
+    }
+    frame_.clear();
+    video_.clear();
+    for (auto& gop : gops_) {
+        gop.clear();
+    }
     CAMERA_DEINIT();
     return MA_OK;
 }
@@ -720,29 +991,93 @@ ma_err_t CameraNode::config(int chn, int32_t width, int32_t height, int32_t fps,
     return MA_OK;
 }
 
-ma_err_t CameraNode::attach(int chn, MessageBox* msgbox) {
+ma_err_t CameraNode::attach(int chn, FrameQueue* queue, frame_policy_t policy) {
     Guard guard(mutex_);
+    if (chn < 0 || chn >= CHN_MAX) {
+        return MA_EINVAL;
+    }
     if (channels_[chn].enabled) {
-        MA_LOGI(TAG, "attach %p to %d", msgbox, chn);
-        channels_[chn].msgboxes.push_back(msgbox);
+        MA_LOGI(TAG, "attach %p to %d (%s)", queue, chn, framePolicyName(policy));
+        Guard subscribers_guard(subscribers_mutex_);
+        channels_[chn].subscribers.push_back({queue, policy, false});
+        demand(chn);
     }
     return MA_OK;
 }
 
 
-ma_err_t CameraNode::detach(int chn, MessageBox* msgbox) {
+ma_err_t CameraNode::detach(int chn, FrameQueue* queue) {
     Guard guard(mutex_);
-    auto it = std::find(channels_[chn].msgboxes.begin(), channels_[chn].msgboxes.end(), msgbox);
-    if (it != channels_[chn].msgboxes.end()) {
-        enabled_ = false;
-        MA_LOGI(TAG, "detach %p from %d", msgbox, chn);
-        Thread::sleep(Tick::fromMilliseconds(50));  // skip last frame
-        channels_[chn].msgboxes.erase(it);
-        enabled_ = true;
+    if (chn < 0 || chn >= CHN_MAX) {
+        return MA_EINVAL;
+    }
+    // once erased under the lock no callback can post to the queue any more
+    Guard subscribers_guard(subscribers_mutex_);
+    auto it = std::find_if(channels_[chn].subscribers.begin(), channels_[chn].subscribers.end(), [queue](const subscriber& sub) { return sub.queue == queue; });
+    if (it != channels_[chn].subscribers.end()) {
+        MA_LOGI(TAG, "detach %p from %d", queue, chn);
+        channels_[chn].subscribers.erase(it);
+        demand(chn);
     }
     return MA_OK;
 }
 
+ma_err_t CameraNode::idle(int chn, FrameQueue* queue, bool idle) {
+    Guard guard(mutex_);
+    if (chn < 0 || chn >= CHN_MAX) {
+        return MA_EINVAL;
+    }
+    Guard subscribers_guard(subscribers_mutex_);
+    for (auto& sub : channels_[chn].subscribers) {
+        if (sub.queue == queue) {
+            sub.idle = idle;
+        }
+    }
+    demand(chn);
+    return MA_OK;
+}
+
+int CameraNode::acquire(int32_t width, int32_t height, int32_t fps, ma_pixel_format_t format, FrameQueue* queue, frame_policy_t policy) {
+    Guard guard(mutex_);
+    static const int raws[] = {CHN_RAW, CHN_EXT};
+    int chn                 = -1;
+    {
+        Guard subscribers_guard(subscribers_mutex_);
+        // share a channel already scaled to this geometry
+        for (int i : raws) {
+            channel& ch = channels_[i];
+            if (!ch.subscribers.empty() && ch.width == width && ch.height == height && ch.format == format) {
+                chn = i;
+                break;
+            }
+        }
+        // otherwise claim one nobody is reading from
+        if (chn < 0) {
+            for (int i : raws) {
+                if (channels_[i].subscribers.empty()) {
+                    chn = i;
+                    break;
+                }
+            }
+        }
+    }
+    if (chn < 0) {
+        MA_LOGW(TAG, "no raw channel left for %dx%d", width, height);
+        return -1;
+    }
+    if (channels_[chn].subscribers.empty()) {
+        if (started_ && !(channels_[chn].enabled && channels_[chn].width == width && channels_[chn].height == height && channels_[chn].format == format)) {
+            // VPSS channels are only set up in onStart()
+            MA_LOGW(TAG, "channel %d reconfigured while started, takes effect on restart", chn);
+        }
+        config(chn, width, height, fps, format);
+    } else if (fps > channels_[chn].fps) {
+        channels_[chn].fps = fps;
+    }
+    attach(chn, queue, policy);
+    return chn;
+}
+
 REGISTER_NODE_SINGLETON("camera", CameraNode);
 
 
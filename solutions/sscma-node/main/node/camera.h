@@ -1,10 +1,18 @@
 #pragma once
 
+#include <shared_mutex>
+
 #include "node.h"
 #include "server.h"
 
 #include "video.h"
 
+#include "aac.h"
+#include "frame_pool.h"
+#include "frame_queue.h"
+#include "gop_cache.h"
+#include "websocket.h"
+
 namespace ma::node {
 
 #define AUDIO_DEVICE "hw:0"
@@ -12,7 +20,20 @@ namespace ma::node {
 #define CHANNELS     1
 #define FORMAT       SND_PCM_FORMAT_S16_LE
 
-enum { CHN_RAW = 0, CHN_JPEG = 1, CHN_H264 = 2, CHN_AUDIO = 3, CHN_MAX };
+// CHN_EXT is a second VPSS-scaled raw channel for a consumer whose geometry differs from CHN_RAW,
+// CHN_SUB a second H.264 stream scaled down from CHN_H264; CHN_AUDIO is PCM as captured, CHN_AAC
+// the same audio encoded once for every subscriber
+enum { CHN_RAW = 0, CHN_JPEG = 1, CHN_H264 = 2, CHN_EXT = 3, CHN_SUB = 4, CHN_AUDIO = 5, CHN_AAC = 6, CHN_MAX };
+
+static inline bool isAudioChannel(int chn) {
+    return chn == CHN_AUDIO || chn == CHN_AAC;
+}
+
+typedef struct {
+    FrameQueue* queue;
+    frame_policy_t policy;
+    bool idle;  // attached but with no use for frames right now
+} subscriber;
 
 typedef struct {
     int chn;
@@ -22,8 +43,8 @@ typedef struct {
     ma_pixel_format_t format;
     bool configured;
     bool enabled;
-    bool dropped;
-    std::vector<MessageBox*> msgboxes;
+    bool paused;  // encoder stopped while every subscriber is idle
+    std::vector<subscriber> subscribers;
 } channel;
 
 class Frame {
@@ -34,6 +55,16 @@ public:
         ref_cnt.fetch_add(n, std::memory_order_relaxed);
     }
     virtual inline void release() = 0;
+    static void* operator new(size_t size) {
+        void* ptr = FramePool::instance().allocate(size);
+        if (ptr == nullptr) {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+    static void operator delete(void* ptr) {
+        FramePool::instance().release(ptr);
+    }
     int chn;
     std::atomic<int> ref_cnt;
     ma_tick_t timestamp;
@@ -41,13 +72,15 @@ public:
 
 class videoFrame : public Frame {
 public:
-    videoFrame() : Frame() {
+    videoFrame() : Frame(), handle(nullptr) {
         memset(&img, 0, sizeof(img));
     }
     inline void release() override {
         if (ref_cnt.load(std::memory_order_relaxed) == 0 || ref_cnt.fetch_sub(1, std::memory_order_acq_rel) == 1) {
-            if (!img.physical) {
-                delete[] img.data;
+            if (handle != nullptr) {
+                dropVideoStream(handle);
+            } else if (!img.physical) {
+                FramePool::instance().release(img.data);
             }
             delete this;
         }
@@ -55,6 +88,7 @@ public:
     std::vector<std::pair<void*, size_t>> blocks;
     ma_img_t img;
     int fps;
+    void* handle;  // encoder stream held in zero-copy mode, img.data points into it
 };
 
 class audioFrame : public Frame {
@@ -65,7 +99,7 @@ public:
     }
     inline void release() override {
         if (ref_cnt.load(std::memory_order_relaxed) == 0 || ref_cnt.fetch_sub(1, std::memory_order_acq_rel) == 1) {
-            delete[] data;
+            FramePool::instance().release(data);
             delete this;
         }
     }
@@ -88,33 +122,62 @@ public:
     ma_err_t onDestroy() override;
 
     ma_err_t config(int chn, int32_t width = -1, int32_t height = -1, int32_t fps = -1, ma_pixel_format_t format = MA_PIXEL_FORMAT_UNKNOWN, bool enabled = true);
-    ma_err_t attach(int chn, MessageBox* msgbox);
-    ma_err_t detach(int chn, MessageBox* msgbox);
+    ma_err_t attach(int chn, FrameQueue* queue, frame_policy_t policy = FRAME_POLICY_DROP_OLDEST);
+    ma_err_t detach(int chn, FrameQueue* queue);
+    // An idle subscriber stays attached but does not need frames, e.g. a stream without viewers.
+    // The encoder of a channel whose subscribers are all idle is paused until one is not.
+    ma_err_t idle(int chn, FrameQueue* queue, bool idle);
+    // attaches to the raw channel matching the geometry, claiming a free one if none does; returns the channel or -1
+    int acquire(int32_t width, int32_t height, int32_t fps, ma_pixel_format_t format, FrameQueue* queue, frame_policy_t policy = FRAME_POLICY_DROP_OLDEST);
+
+    // shared while a frame pointing into VPSS memory is read, exclusive while the video pipeline starts or stops
+    static std::shared_mutex& pipeline();
+
+    // frames since the last IDR of an H.264 channel, for consumers that start midway
+    GopCache& gop(int chn);
 
 protected:
     void threadEntry();
+    void threadVideoEntry();
     void threadAudioEntry();
     static void threadEntryStub(void* obj);
+    static void threadVideoEntryStub(void* obj);
     static void threadAudioEntryStub(void* obj);
     int vencCallback(void* pData, void* pArgs);
     int vpssCallback(void* pData, void* pArgs);
     static int vencCallbackStub(void* pData, void* pArgs, void* pUserData);
     static int vpssCallbackStub(void* pData, void* pArgs, void* pUserData);
+    void dispatch(int chn, Frame* frame);
+    void prime(videoFrame* live);
+    bool isH264(int chn) const;
+    void demand(int chn);
+    void demandAll();
 
 private:
     std::vector<channel> channels_;
+    Mutex subscribers_mutex_;  // guards channels_[].subscribers against the capture callbacks
     uint32_t count_;
     bool preview_;
     bool websocket_;
     int audio_;
+    int32_t aac_bitrate_;  // bits per second
+    AacEncoder aac_;       // runs while CHN_AAC has subscribers
     int option_;
     int fps_;
     int light_;
+    int zerocopy_;
+    bool harvest_single_;
     bool mirror_;
     bool flip_;
+    msg_encoding_t encoding_;  // sample events only
+    GopCache gops_[CHN_MAX];
+    bool replay_live_;  // joining viewers get the cached IDR and a fresh one instead of the whole GOP
     Thread* thread_;
+    Thread* thread_video_;
     Thread* thread_audio_;
-    MessageBox frame_;
+    FrameQueue frame_;  // JPEG preview
+    FrameQueue video_;  // H.264 for the websocket, apart so a preview frame never evicts a delta frame
+    TransportWebSocket::Config ws_config_;  // queue and lag limits, the port comes from storage
     TransportWebSocket* transport_;
 };
 
@@ -0,0 +1,606 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#include "cascade.h"
+#include "encoding.h"
+
+namespace ma::node {
+
+using namespace ma::engine;
+
+static constexpr char TAG[] = "ma::node::cascade";
+
+CascadeNode::CascadeNode(std::string id)
+    : Node("cascade", id),
+      uri_(""),
+      mode_("classify"),
+      width_(1280),
+      height_(720),
+      fps_(30),
+      expand_(0.1f),
+      square_(false),
+      max_(8),
+      hardware_(true),
+      hardware_ok_(true),
+      priority_(0),
+      weight_(1),
+      engine_(nullptr),
+      input_width_(0),
+      input_height_(0),
+      batch_(1),
+      planar_(false),
+      thread_(nullptr),
+      camera_(nullptr),
+      detector_(nullptr),
+      encoding_(MSG_ENCODING_JSON),
+      raw_chn_(-1),
+      raw_frame_(CASCADE_HISTORY),
+      detections_(nullptr),
+      frames_(0),
+      crops_(0),
+      unmatched_(0),
+      cpu_crops_(0) {
+    memset(sources_, 0, sizeof(sources_));
+}
+
+CascadeNode::~CascadeNode() {
+    onDestroy();
+}
+
+void CascadeNode::discard(source_t* source) {
+    if (source->data != nullptr) {
+        if (source->phy != 0) {
+            CVI_SYS_IonFree(source->phy, source->data);
+        } else {
+            FramePool::instance().release(source->data);
+        }
+    }
+    memset(source, 0, sizeof(*source));
+}
+
+bool CascadeNode::hold(videoFrame* frame) {
+    source_t* source = nullptr;
+    if (history_.size() < CASCADE_HISTORY) {
+        for (auto& item : sources_) {
+            if (std::find(history_.begin(), history_.end(), &item) == history_.end()) {
+                source = &item;
+                break;
+            }
+        }
+    } else {
+        source = history_.front();
+        history_.pop_front();
+    }
+
+    // ION memory keeps the VPSS crop, the frame pool is the fallback when none is left
+    if (source->capacity < frame->img.size) {
+        discard(source);
+        void* data      = nullptr;
+        CVI_CHAR name[] = "cascade";
+        if (hardware_ && hardware_ok_ && !planar_ && CVI_SYS_IonAlloc_Cached(&source->phy, &data, name, frame->img.size) == CVI_SUCCESS) {
+            source->data = static_cast<uint8_t*>(data);
+        } else {
+            source->phy  = 0;
+            source->data = static_cast<uint8_t*>(FramePool::instance().allocate(frame->img.size));
+        }
+        if (source->data == nullptr) {
+            discard(source);
+            return false;
+        }
+        source->capacity = frame->img.size;
+    }
+
+    {
+        // the frame points into VPSS memory, keep the pipeline up while it is read
+        std::shared_lock<std::shared_mutex> pipeline(CameraNode::pipeline());
+        const uint8_t* data = frame->img.data;
+        if (frame->img.physical) {
+            data = static_cast<const uint8_t*>(CVI_SYS_Mmap(reinterpret_cast<CVI_U64>(frame->img.data), frame->img.size));
+            if (data == nullptr) {
+                return false;
+            }
+        }
+        memcpy(source->data, data, frame->img.size);
+        if (frame->img.physical) {
+            CVI_SYS_Munmap(const_cast<uint8_t*>(data), frame->img.size);
+        }
+    }
+    if (source->phy != 0) {
+        CVI_SYS_IonFlushCache(source->phy, source->data, frame->img.size);
+    }
+    source->timestamp = frame->timestamp;
+    source->width     = frame->img.width;
+    source->height    = frame->img.height;
+    source->size      = frame->img.size;
+    history_.push_back(source);
+    return true;
+}
+
+CascadeNode::source_t* CascadeNode::match(ma_tick_t timestamp) {
+    // both raw channels come out of the same VPSS pass, so the capture times line up
+    source_t* best      = nullptr;
+    ma_tick_t best_diff = 0;
+    for (auto item : history_) {
+        ma_tick_t diff = item->timestamp > timestamp ? item->timestamp - timestamp : timestamp - item->timestamp;
+        if (best == nullptr || diff < best_diff) {
+            best      = item;
+            best_diff = diff;
+        }
+    }
+    if (best == nullptr || best_diff > Tick::fromMilliseconds(1000 / std::max(fps_, 1))) {
+        return nullptr;
+    }
+    return best;
+}
+
+bool CascadeNode::crop(source_t* source, const roi_t& roi, uint8_t* dst) {
+    int32_t stride = source->size / source->height;
+
+    if (hardware_ && hardware_ok_ && !planar_ && source->phy != 0) {
+        video_crop_t param = {
+            .src_phy    = source->phy,
+            .src_width  = static_cast<uint32_t>(source->width),
+            .src_height = static_cast<uint32_t>(source->height),
+            .src_stride = static_cast<uint32_t>(stride),
+            .x          = roi.x,
+            .y          = roi.y,
+            .width      = static_cast<uint32_t>(roi.width),
+            .height     = static_cast<uint32_t>(roi.height),
+            .dst_width  = static_cast<uint32_t>(input_width_),
+            .dst_height = static_cast<uint32_t>(input_height_),
+            .dst        = dst,
+        };
+        if (cropVideoFrame(&param) == 0) {
+            return true;
+        }
+        // a memory-fed VPSS group may not be available next to the live pipeline
+        MA_LOGW(TAG, "vpss crop failed, cropping on the cpu from now on");
+        hardware_ok_ = false;
+    }
+
+    roiResize(source->data, stride, roi, dst, input_width_, input_height_, planar_);
+    cpu_crops_++;
+    return true;
+}
+
+json CascadeNode::evaluate(int32_t slot) {
+    for (int32_t i = 0; i < engine_->getOutputSize(); i++) {
+        ma_tensor_t output = engine_->getOutput(i);
+        if (output.type != MA_TENSOR_TYPE_F32) {
+            continue;
+        }
+        size_t total = 1;
+        for (int32_t d = 0; d < output.shape.size; d++) {
+            total *= output.shape.dims[d];
+        }
+        size_t count      = total / batch_;
+        const float* data = output.data.f32 + slot * count;
+        if (count == 0) {
+            break;
+        }
+
+        if (mode_ == "embed") {
+            float norm = 0;
+            for (size_t k = 0; k < count; k++) {
+                norm += data[k] * data[k];
+            }
+            norm           = sqrtf(norm + 1e-10f);
+            json embedding = json::array();
+            for (size_t k = 0; k < count; k++) {
+                embedding.push_back(std::round(data[k] / norm * 10000) / 10000);
+            }
+            return json::object({{"embedding", embedding}});
+        }
+
+        // scores may come as logits, normalise unless they already look like probabilities
+        size_t target = 0;
+        bool probs    = true;
+        for (size_t k = 0; k < count; k++) {
+            if (data[k] > data[target]) {
+                target = k;
+            }
+            probs = probs && data[k] >= 0 && data[k] <= 1;
+        }
+        float score = data[target];
+        if (!probs) {
+            float sum = 0;
+            for (size_t k = 0; k < count; k++) {
+                sum += expf(data[k] - data[target]);
+            }
+            score = 1 / sum;
+        }
+        json result = json::object({{"target", target}, {"score", static_cast<int8_t>(score * 100)}});
+        if (labels_.size() > target) {
+            result["label"] = labels_[target];
+        } else {
+            result["label"] = std::string("N/A-" + std::to_string(target));
+        }
+        return result;
+    }
+    return nullptr;
+}
+
+void CascadeNode::drain() {
+    detection_t* detection = nullptr;
+    while (detections_ != nullptr && detections_->fetch(reinterpret_cast<void**>(&detection), Tick::fromMilliseconds(0))) {
+        delete detection;
+    }
+    history_.clear();
+    for (auto& source : sources_) {
+        discard(&source);
+    }
+    raw_frame_.clear();
+}
+
+void CascadeNode::threadEntry() {
+    detection_t* item = nullptr;
+    videoFrame* raw   = nullptr;
+
+    server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "enabled"}, {"code", MA_OK}, {"data", enabled_.load()}}));
+
+    while (started_) {
+        // copied as they come, a detection arrives after its source frame
+        if (raw_frame_.fetch(reinterpret_cast<void**>(&raw), Tick::fromMilliseconds(100))) {
+            if (enabled_) {
+                hold(raw);
+            }
+            raw->release();
+        }
+        if (!detections_->fetch(reinterpret_cast<void**>(&item), Tick::fromMilliseconds(0))) {
+            continue;
+        }
+        std::unique_ptr<detection_t> detection(item);
+
+        if (!enabled_) {
+            continue;
+        }
+
+        source_t* frame = match(detection->timestamp);
+        if (frame == nullptr) {
+            unmatched_++;
+            continue;
+        }
+        frames_++;
+
+        std::vector<std::pair<size_t, roi_t>> jobs;
+        {
+            Guard config_guard(config_mutex_);
+            for (size_t i = 0; i < detection->boxes.size() && jobs.size() < static_cast<size_t>(max_); i++) {
+                const ma_bbox_t& box = detection->boxes[i];
+                if (!targets_.empty() && std::find(targets_.begin(), targets_.end(), box.target) == targets_.end()) {
+                    continue;
+                }
+                roi_t roi = roiFromBox(box.x, box.y, box.w, box.h, frame->width, frame->height, expand_, square_);
+                if (roi.width < 2 || roi.height < 2) {
+                    continue;
+                }
+                jobs.push_back({i, roi});
+            }
+        }
+
+        json results        = json::array();
+        int64_t crop_us     = 0;
+        int64_t run_us      = 0;
+        int64_t evaluate_us = 0;
+        for (size_t i = 0; i < detection->boxes.size(); i++) {
+            results.push_back(nullptr);
+        }
+
+        {
+            ma_tensor_t input = engine_->getInput(0);
+            size_t slot_size  = static_cast<size_t>(input_width_) * input_height_ * 3;
+
+            for (size_t j = 0; j < jobs.size();) {
+                ma_tick_t start = Tick::current();
+                std::vector<size_t> batch;
+                while (batch.size() < static_cast<size_t>(batch_) && j < jobs.size()) {
+                    if (crop(frame, jobs[j].second, input.data.u8 + batch.size() * slot_size)) {
+                        batch.push_back(jobs[j].first);
+                    }
+                    j++;
+                }
+                if (batch.empty()) {
+                    continue;
+                }
+
+                ma_tick_t cropped = Tick::current();
+                {
+                    TpuScheduler::Grant tpu(id_);
+                    engine_->run();
+                }
+                ma_tick_t ran = Tick::current();
+
+                for (size_t k = 0; k < batch.size(); k++) {
+                    results[batch[k]] = evaluate(static_cast<int32_t>(k));
+                }
+                crops_ += batch.size();
+                crop_us += Tick::toMicroseconds(cropped - start);
+                run_us += Tick::toMicroseconds(ran - cropped);
+                evaluate_us += Tick::toMicroseconds(Tick::current() - ran);
+            }
+        }
+
+        json& reply              = detection->reply;
+        reply["data"]["cascade"] = results;
+        reply["data"]["perf"].push_back({crop_us / 1000, run_us / 1000, evaluate_us / 1000});
+        if (encoding_ != MSG_ENCODING_JSON) {
+            compact(reply);
+        }
+        server_->response(id_, reply, encoding_);
+    }
+}
+
+void CascadeNode::threadEntryStub(void* obj) {
+    reinterpret_cast<CascadeNode*>(obj)->threadEntry();
+}
+
+void CascadeNode::applyConfig(const json& data) {
+    Guard guard(config_mutex_);
+    if (data.contains("expand") && data["expand"].is_number()) {
+        expand_ = std::clamp(data["expand"].get<float>(), 0.0f, 1.0f);
+    }
+    if (data.contains("square") && data["square"].is_boolean()) {
+        square_ = data["square"].get<bool>();
+    }
+    if (data.contains("max") && data["max"].is_number_integer()) {
+        max_ = std::clamp(data["max"].get<int32_t>(), 1, 32);
+    }
+    if (data.contains("targets") && data["targets"].is_array()) {
+        targets_ = data["targets"].get<std::vector<int>>();
+    }
+}
+
+ma_err_t CascadeNode::onCreate(const json& config) {
+    Guard guard(mutex_);
+
+    labels_.clear();
+
+    if (config.contains("uri") && config["uri"].is_string()) {
+        uri_ = config["uri"].get<std::string>();
+    }
+    if (uri_.empty() || access(uri_.c_str(), R_OK) != 0) {
+        MA_THROW(Exception(MA_ENOENT, "Model file not found " + uri_));
+    }
+
+    if (config.contains("mode") && config["mode"].is_string()) {
+        mode_ = config["mode"].get<std::string>();
+        if (mode_ != "classify" && mode_ != "embed") {
+            MA_THROW(Exception(MA_EINVAL, "Unknown mode " + mode_));
+        }
+    }
+
+    // classes from the model's json, as the model node does
+    size_t pos = uri_.find_last_of(".");
+    if (pos != std::string::npos) {
+        std::string path = uri_.substr(0, pos) + ".json";
+        if (access(path.c_str(), R_OK) == 0) {
+            std::ifstream ifs(path);
+            json info;
+            ifs >> info;
+            if (info.is_object() && info.contains("classes") && info["classes"].is_array()) {
+                labels_ = info["classes"].get<std::vector<std::string>>();
+            }
+        }
+    }
+    if (labels_.size() == 0 && config.contains("labels") && config["labels"].is_array()) {
+        labels_ = config["labels"].get<std::vector<std::string>>();
+    }
+
+    if (config.contains("resolution") && config["resolution"].is_string()) {
+        std::string resolution = config["resolution"].get<std::string>();
+        size_t pos             = resolution.find('x');
+        if (pos != std::string::npos) {
+            width_  = std::stoi(resolution.substr(0, pos));
+            height_ = std::stoi(resolution.substr(pos + 1));
+        }
+    }
+    if (config.contains("fps") && config["fps"].is_number_integer()) {
+        fps_ = config["fps"].get<int32_t>();
+    }
+    if (config.contains("scaler") && config["scaler"].is_string()) {
+        hardware_ = config["scaler"].get<std::string>() != "cpu";
+    }
+    if (config.contains("priority") && config["priority"].is_number_integer()) {
+        priority_ = config["priority"].get<int>();
+    }
+    if (config.contains("weight") && config["weight"].is_number_integer()) {
+        weight_ = config["weight"].get<int>();
+    }
+    applyConfig(config);
+
+    auto cleanup = [this]() {
+        if (engine_ != nullptr) {
+            delete engine_;
+            engine_ = nullptr;
+        }
+        if (thread_ != nullptr) {
+            delete thread_;
+            thread_ = nullptr;
+        }
+        if (detections_ != nullptr) {
+            delete detections_;
+            detections_ = nullptr;
+        }
+    };
+
+    MA_TRY {
+        engine_ = new EngineDefault();
+        if (engine_ == nullptr) {
+            MA_THROW(Exception(MA_ENOMEM, "Engine init failed"));
+        }
+        if (engine_->init() != MA_OK) {
+            MA_THROW(Exception(MA_EINVAL, "Engine init failed"));
+        }
+        if (engine_->load(uri_) != MA_OK) {
+            MA_THROW(Exception(MA_EINVAL, "Engine load failed"));
+        }
+
+        // RGB input, NHWC or NCHW, the leading dimension is the batch
+        ma_tensor_t input = engine_->getInput(0);
+        if (input.shape.size == 4 && input.shape.dims[3] == 3) {
+            input_height_ = input.shape.dims[1];
+            input_width_  = input.shape.dims[2];
+            planar_       = false;
+        } else if (input.shape.size == 4 && input.shape.dims[1] == 3) {
+            input_height_ = input.shape.dims[2];
+            input_width_  = input.shape.dims[3];
+            planar_       = true;
+        } else {
+            MA_THROW(Exception(MA_ENOTSUP, "Unsupported model input"));
+        }
+        batch_ = std::max(input.shape.dims[0], 1);
+
+        MA_LOGI(TAG, "cascade model: %s input %dx%d batch %d %s", uri_.c_str(), input_width_, input_height_, batch_, mode_.c_str());
+
+        detections_ = new MessageBox(2);
+        thread_     = new Thread((type_ + "#" + id_).c_str(), &CascadeNode::threadEntryStub, this);
+        if (detections_ == nullptr || thread_ == nullptr) {
+            MA_THROW(Exception(MA_ENOMEM, "Not enough memory"));
+        }
+    }
+    MA_CATCH(ma::Exception & e) {
+        cleanup();
+        MA_THROW(e);
+    }
+    MA_CATCH(std::exception & e) {
+        cleanup();
+        MA_THROW(Exception(MA_EINVAL, e.what()));
+    }
+
+    TpuScheduler::instance().join(id_, priority_, weight_);
+
+    created_ = true;
+
+    server_->response(id_,
+                      json::object({{"type", MA_MSG_TYPE_RESP},
+                                    {"name", "create"},
+                                    {"code", MA_OK},
+                                    {"data", {{"input", {input_width_, input_height_}}, {"batch", batch_}, {"mode", mode_}, {"classes", labels_}}}}));
+
+    return MA_OK;
+}
+
+ma_err_t CascadeNode::onControl(const std::string& control, const json& data) {
+    Guard guard(mutex_);
+    if (control == "config") {
+        applyConfig(data);
+        server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", control}, {"code", MA_OK}, {"data", data}}));
+    } else if (control == "enabled" && data.is_boolean()) {
+        enabled_.store(data.get<bool>());
+        server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", control}, {"code", MA_OK}, {"data", enabled_.load()}}));
+    } else if (control == "stats") {
+        json stats = {{"chn", raw_chn_},
+                      {"frames", frames_.load()},
+                      {"crops", crops_.load()},
+                      {"cpu", cpu_crops_.load()},
+                      {"unmatched", unmatched_.load()},
+                      {"scaler", hardware_ && hardware_ok_ ? "vpss" : "cpu"},
+                      {"tpu", TpuScheduler::instance().stats()}};
+        server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", control}, {"code", MA_OK}, {"data", stats}}));
+    } else {
+        server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", control}, {"code", MA_ENOTSUP}, {"data", "Not supported"}}));
+    }
+    return MA_OK;
+}
+
+ma_err_t CascadeNode::onStart() {
+    Guard guard(mutex_);
+    if (started_) {
+        return MA_OK;
+    }
+
+    for (auto& dep : dependencies_) {
+        if (camera_ == nullptr && dep.second->type() == "camera") {
+            camera_ = static_cast<CameraNode*>(dep.second);
+        } else if (detector_ == nullptr && dep.second->type() == "model") {
+            detector_ = static_cast<ModelNode*>(dep.second);
+        }
+    }
+
+    if (camera_ == nullptr || detector_ == nullptr) {
+        camera_   = nullptr;
+        detector_ = nullptr;
+        MA_THROW(Exception(MA_ENOTSUP, "Cascade needs a camera and a model node"));
+        return MA_ENOTSUP;
+    }
+
+    // crops come from a frame of their own, sharper than what the detector saw
+    raw_chn_ = camera_->acquire(width_, height_, fps_, MA_PIXEL_FORMAT_RGB888, &raw_frame_);
+    if (raw_chn_ < 0) {
+        camera_   = nullptr;
+        detector_ = nullptr;
+        MA_THROW(Exception(MA_EBUSY, "No raw channel left for " + std::to_string(width_) + "x" + std::to_string(height_)));
+        return MA_EBUSY;
+    }
+    detector_->attachDetections(detections_);
+    encoding_ = detector_->encoding();  // the replies are the detector's, published the way it publishes them
+
+    MA_LOGI(TAG, "start cascade: %s(%s) source %dx%d on channel %d", type_.c_str(), id_.c_str(), width_, height_, raw_chn_);
+    started_ = true;
+
+    thread_->start(this);
+
+    return MA_OK;
+}
+
+ma_err_t CascadeNode::onStop() {
+    Guard guard(mutex_);
+    if (!started_) {
+        return MA_OK;
+    }
+    started_ = false;
+
+    if (thread_ != nullptr) {
+        thread_->join();
+    }
+    if (detector_ != nullptr) {
+        detector_->detachDetections(detections_);
+        detector_ = nullptr;
+    }
+    if (camera_ != nullptr) {
+        camera_->detach(raw_chn_, &raw_frame_);
+        camera_  = nullptr;
+        raw_chn_ = -1;
+    }
+    drain();
+
+    return MA_OK;
+}
+
+ma_err_t CascadeNode::onDestroy() {
+    Guard guard(mutex_);
+
+    if (!created_) {
+        return MA_OK;
+    }
+
+    onStop();
+
+    TpuScheduler::instance().leave(id_);
+
+    if (thread_ != nullptr) {
+        delete thread_;
+        thread_ = nullptr;
+    }
+    if (detections_ != nullptr) {
+        delete detections_;
+        detections_ = nullptr;
+    }
+    if (engine_ != nullptr) {
+        delete engine_;
+        engine_ = nullptr;
+    }
+
+    created_ = false;
+
+    return MA_OK;
+}
+
+REGISTER_NODE("cascade", CascadeNode);
+
+}  // namespace ma::node
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <deque>
+
+#include "node.h"
+#include "server.h"
+
+#include "camera.h"
+#include "model.h"
+#include "roi.h"
+#include "tpu_scheduler.h"
+
+namespace ma::node {
+
+#define CASCADE_HISTORY 4  // source frames kept for matching, about the detector's latency
+
+// Second stage behind a detector model node: crops every detected box out of a high resolution
+// raw frame at the input size of its own model, classifies or embeds the crops, and publishes the
+// detector's invoke event with the results attached per box.
+class CascadeNode : public Node {
+
+public:
+    CascadeNode(std::string id);
+    ~CascadeNode();
+
+    ma_err_t onCreate(const json& config) override;
+    ma_err_t onStart() override;
+    ma_err_t onControl(const std::string& control, const json& data) override;
+    ma_err_t onStop() override;
+    ma_err_t onDestroy() override;
+
+protected:
+    // a source frame copied out of the VPSS channel, which takes its buffer back once the frame is dispatched
+    struct source_t {
+        ma_tick_t timestamp;
+        int32_t width;
+        int32_t height;
+        size_t size;
+        size_t capacity;
+        uint64_t phy;   // 0 when the copy lives in the frame pool, the VPSS cannot read it then
+        uint8_t* data;
+    };
+
+    void threadEntry();
+    static void threadEntryStub(void* obj);
+    void applyConfig(const json& data);
+    bool hold(videoFrame* frame);
+    void discard(source_t* source);
+    source_t* match(ma_tick_t timestamp);
+    bool crop(source_t* source, const roi_t& roi, uint8_t* dst);
+    json evaluate(int32_t slot);
+    void drain();
+
+protected:
+    std::string uri_;
+    std::string mode_;  // "classify" or "embed"
+    std::vector<std::string> labels_;
+    std::vector<int> targets_;  // detector classes to crop, empty for all
+    int32_t width_;             // source frame the crops are cut from
+    int32_t height_;
+    int32_t fps_;
+    float expand_;
+    bool square_;
+    int32_t max_;
+    bool hardware_;
+    std::atomic<bool> hardware_ok_;
+    int priority_;
+    int weight_;
+    Engine* engine_;
+    int32_t input_width_;
+    int32_t input_height_;
+    int32_t batch_;
+    bool planar_;
+    Thread* thread_;
+    CameraNode* camera_;
+    ModelNode* detector_;
+    msg_encoding_t encoding_;
+    int raw_chn_;
+    Mutex config_mutex_;
+    FrameQueue raw_frame_;
+    source_t sources_[CASCADE_HISTORY];
+    std::deque<source_t*> history_;  // recent source frames, matched to detections by capture time
+    MessageBox* detections_;
+    std::atomic<uint64_t> frames_;
+    std::atomic<uint64_t> crops_;
+    std::atomic<uint64_t> unmatched_;
+    std::atomic<uint64_t> cpu_crops_;
+};
+
+}  // namespace ma::node
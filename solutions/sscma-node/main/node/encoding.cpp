@@ -0,0 +1,86 @@
+#include "encoding.h"
+
+namespace ma::node {
+
+static const char* ENCODING_NAMES[] = {"json", "cbor", "msgpack"};
+
+const char* encodingName(msg_encoding_t encoding) {
+    return encoding <= MSG_ENCODING_MSGPACK ? ENCODING_NAMES[encoding] : "unknown";
+}
+
+bool encodingFromName(const std::string& name, msg_encoding_t& encoding) {
+    for (int i = MSG_ENCODING_JSON; i <= MSG_ENCODING_MSGPACK; i++) {
+        if (name == ENCODING_NAMES[i]) {
+            encoding = static_cast<msg_encoding_t>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void encode(const json& msg, msg_encoding_t encoding, std::string& out) {
+    out.clear();
+    switch (encoding) {
+        case MSG_ENCODING_CBOR:
+            json::to_cbor(msg, nlohmann::detail::output_adapter<char>(out));
+            break;
+        case MSG_ENCODING_MSGPACK:
+            json::to_msgpack(msg, nlohmann::detail::output_adapter<char>(out));
+            break;
+        default: {
+            nlohmann::detail::serializer<json> serializer(nlohmann::detail::output_adapter<char>(out), ' ');
+            serializer.dump(msg, false, false, 0);
+            break;
+        }
+    }
+}
+
+// appends the leaves of item to flat in order, consuming them
+static void flatten(json& item, json& flat) {
+    if (item.is_array()) {
+        for (auto& value : item) {
+            flatten(value, flat);
+        }
+    } else {
+        flat.push_back(std::move(item));
+    }
+}
+
+void compact(json& msg) {
+    msg["v"] = MSG_SCHEMA_VERSION;
+    if (!msg.contains("data") || !msg["data"].is_object()) {
+        return;
+    }
+    json& data = msg["data"];
+
+    data.erase("labels");
+    for (const char* key : {"boxes", "classes"}) {
+        // producers may already have built them flat
+        if (data.contains(key) && data[key].is_array() && data[key].size() > 0 && data[key][0].is_array()) {
+            json flat = json::array();
+            flatten(data[key], flat);
+            data[key] = std::move(flat);
+        }
+    }
+    for (const char* key : {"keypoints", "segments"}) {
+        if (!data.contains(key) || !data[key].is_array()) {
+            continue;
+        }
+        json masks = json::array();
+        for (auto& item : data[key]) {
+            // [box, points] or [box, contour, rle]
+            if (item.is_array() && item.size() == 3 && item[2].is_object()) {
+                masks.push_back(std::move(item[2]));
+                item.erase(2);
+            }
+            json flat = json::array();
+            flatten(item, flat);
+            item = std::move(flat);
+        }
+        if (masks.size() > 0) {
+            data["masks"] = std::move(masks);
+        }
+    }
+}
+
+}  // namespace ma::node
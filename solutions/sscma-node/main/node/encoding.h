@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "core/ma_core.h"
+#include "porting/ma_porting.h"
+
+namespace ma::node {
+
+typedef enum {
+    MSG_ENCODING_JSON = 0,
+    MSG_ENCODING_CBOR,
+    MSG_ENCODING_MSGPACK,
+} msg_encoding_t;
+
+// binary events carry "v": MSG_SCHEMA_VERSION and the compact layout below
+#define MSG_SCHEMA_VERSION 1
+
+// Framed WebSocket preview, one binary message per frame: this header, the JPEG, then the results
+// in the node's encoding. Little endian; readers skip `size` bytes so fields can be appended.
+#define PREVIEW_MAGIC       0x56505353  // "SSPV"
+#define PREVIEW_VERSION     1
+#define PREVIEW_FLAG_STALE  0x04        // results repeated by the motion gate
+#define PREVIEW_ENCODING(f) ((f) & 0x03)
+
+typedef struct {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t flags;     // encoding of the results in bits 0-1, PREVIEW_FLAG_*
+    uint16_t size;     // header bytes
+    uint32_t id;       // frame id, the count of the event it belongs to
+    uint32_t image;    // JPEG bytes, 0 without an image
+    uint32_t results;  // results bytes, 0 without results
+} __attribute__((packed)) preview_header_t;
+
+const char* encodingName(msg_encoding_t encoding);
+// false for an unknown name, encoding is left as it was
+bool encodingFromName(const std::string& name, msg_encoding_t& encoding);
+
+// serialises msg into out, which keeps its capacity between calls
+void encode(const json& msg, msg_encoding_t encoding, std::string& out);
+
+// Rewrites an event for the binary encodings: boxes (6 values each) and classes (2 each) become
+// flat arrays, keypoints and segments one flat array per instance (box, then the points), RLE
+// masks move to "masks" and the per-box labels are dropped, the classes come with create.
+void compact(json& msg);
+
+}  // namespace ma::node
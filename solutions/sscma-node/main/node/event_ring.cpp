@@ -0,0 +1,117 @@
+#include <algorithm>
+
+#include "camera.h"
+#include "event_ring.h"
+
+namespace ma::node {
+
+static inline bool isKey(Frame* frame) {
+    return !isAudioChannel(frame->chn) && static_cast<videoFrame*>(frame)->img.key;
+}
+
+static inline size_t sizeOf(Frame* frame) {
+    return isAudioChannel(frame->chn) ? static_cast<audioFrame*>(frame)->size : static_cast<videoFrame*>(frame)->img.size;
+}
+
+EventRing::EventRing() : span_(0), max_bytes_(0), bytes_(0), peak_(0), gops_(0), overflows_(0), copies_(0) {}
+
+EventRing::~EventRing() {
+    clear();
+}
+
+void EventRing::configure(ma_tick_t span, size_t bytes) {
+    Guard guard(mutex_);
+    span_      = span;
+    max_bytes_ = bytes;
+    while (!frames_.empty()) {
+        dropGop();
+    }
+}
+
+// caller holds the lock
+void EventRing::dropGop() {
+    do {
+        bytes_ -= sizeOf(frames_.front());
+        frames_.front()->release();
+        frames_.pop_front();
+    } while (!frames_.empty() && !isKey(frames_.front()));
+    keys_.pop_front();
+}
+
+void EventRing::push(Frame* frame) {
+    Guard guard(mutex_);
+    if (max_bytes_ == 0) {
+        frame->release();
+        return;
+    }
+    bool key = isKey(frame);
+    if (!key && frames_.empty()) {
+        frame->release();  // a clip cannot start here, wait for the next IDR
+        return;
+    }
+    if (!isAudioChannel(frame->chn)) {
+        bool zerocopy = static_cast<videoFrame*>(frame)->handle != nullptr;
+        frame         = holdFrame(static_cast<videoFrame*>(frame));
+        if (frame == nullptr) {
+            // a hole in the GOP, nothing after it decodes
+            while (!frames_.empty()) {
+                dropGop();
+            }
+            return;
+        }
+        copies_ += zerocopy ? 1 : 0;
+    }
+    if (key) {
+        keys_.push_back(frame->timestamp);
+        gops_++;
+    }
+    frames_.push_back(frame);
+    bytes_ += sizeOf(frame);
+
+    while (keys_.size() > 1 && frame->timestamp - keys_[1] >= span_) {
+        dropGop();
+    }
+    while (bytes_ > max_bytes_ && !frames_.empty()) {
+        overflows_++;
+        dropGop();
+    }
+    peak_ = std::max(peak_, bytes_);
+}
+
+size_t EventRing::drain(std::vector<Frame*>& frames) {
+    Guard guard(mutex_);
+    size_t count = frames_.size();
+    frames.insert(frames.end(), frames_.begin(), frames_.end());
+    frames_.clear();
+    keys_.clear();
+    bytes_ = 0;
+    return count;
+}
+
+bool EventRing::empty() {
+    Guard guard(mutex_);
+    return frames_.empty();
+}
+
+void EventRing::clear() {
+    Guard guard(mutex_);
+    while (!frames_.empty()) {
+        dropGop();
+    }
+}
+
+json EventRing::stats() {
+    Guard guard(mutex_);
+    int64_t span = frames_.empty() ? 0 : Tick::toMicroseconds(frames_.back()->timestamp - keys_.front()) / 1000;
+    return json::object({{"enabled", max_bytes_ > 0},
+                         {"frames", frames_.size()},
+                         {"bytes", bytes_},
+                         {"peak", peak_},
+                         {"limit", max_bytes_},
+                         {"span", span},
+                         {"gops", gops_},
+                         {"overflows", overflows_},
+                         {"copies", copies_}});
+}
+
+}  // namespace ma::node
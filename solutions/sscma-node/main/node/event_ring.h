@@ -0,0 +1,52 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "core/ma_core.h"
+#include "porting/ma_porting.h"
+
+namespace ma::node {
+
+class Frame;
+
+// The H.264 and AAC frames before an event, held by reference, for a clip to start with what led
+// up to it. The ring always begins at an IDR so a clip cut from it decodes from its first frame:
+// the oldest GOP goes once the next one alone covers the pre-roll, or whole while the ring is over
+// its byte limit, which may leave it empty until the next IDR.
+class EventRing {
+public:
+    EventRing();
+    ~EventRing();
+
+    EventRing(const EventRing&)            = delete;
+    EventRing& operator=(const EventRing&) = delete;
+
+    // bytes 0 turns the ring off
+    void configure(ma_tick_t span, size_t bytes);
+
+    // takes over one reference of frame
+    void push(Frame* frame);
+    // hands the frames over oldest first and empties the ring
+    size_t drain(std::vector<Frame*>& frames);
+    bool empty();
+    void clear();
+
+    json stats();
+
+private:
+    void dropGop();
+
+    Mutex mutex_;
+    std::deque<Frame*> frames_;
+    std::deque<ma_tick_t> keys_;  // capture times of the IDRs in the ring
+    ma_tick_t span_;
+    size_t max_bytes_;
+    size_t bytes_;
+    size_t peak_;
+    uint64_t gops_;
+    uint64_t overflows_;
+    uint64_t copies_;
+};
+
+}  // namespace ma::node
@@ -1,86 +1,242 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <deque>
 #include <functional>
 #include <memory>
-#include <queue>
 #include <string>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "core/ma_common.h"
 
 namespace ma::node {
 
+// return true to run the task again after the retry delay
 typedef std::function<bool(void)> task_t;
 
+// Worker pool running tasks in submission order per key: tasks sharing a key never overlap and
+// never overtake each other, tasks with different keys run in parallel. An exclusive task waits
+// for everything submitted before it and holds back everything submitted after it.
 class Executor {
 public:
-    Executor(std::size_t stack_size = 0, std::size_t priority = 0) : _task_queue_lock(), _task_queue_signal(0), _worker_name(MA_EXECUTOR_WORKER_NAME_PREFIX), _worker_handler() {
+    Executor(std::size_t workers = 1, std::size_t stack_size = 0, std::size_t priority = 0, ma_tick_t retry_delay = Tick::fromMilliseconds(20))
+        : _task_queue_lock(),
+          _task_queue_signal(0),
+          _retry_delay(retry_delay),
+          _seq(0),
+          _running(0),
+          _exclusive(false),
+          _stopping(false),
+          _submitted(0),
+          _executed(0),
+          _retried(0),
+          _latency_avg_us(0),
+          _latency_max_us(0) {
         static uint8_t worker_id        = 0u;
         static const char* hex_literals = "0123456789ABCDEF";
 
-        worker_id++;
+        if (workers == 0) {
+            workers = 1;
+        }
+
+        for (std::size_t i = 0; i < workers; i++) {
+            worker_id++;
 
-        // prepare worker name (FreeRTOS task required), reserve 2 bytes for uint8_t hex string
-        _worker_name.reserve(_worker_name.length() + (sizeof(uint8_t) << 1) + 1);
+            // prepare worker name (FreeRTOS task required), reserve 2 bytes for uint8_t hex string
+            std::string name(MA_EXECUTOR_WORKER_NAME_PREFIX);
+            name.reserve(name.length() + (sizeof(uint8_t) << 1) + 1);
 
-        // convert worker id to hex string
-        _worker_name += hex_literals[worker_id >> 4];
-        _worker_name += hex_literals[worker_id & 0x0f];
+            // convert worker id to hex string
+            name += hex_literals[worker_id >> 4];
+            name += hex_literals[worker_id & 0x0f];
+            _worker_names.push_back(name);
+        }
 
-        _worker_handler = new Thread(_worker_name.c_str(), &Executor::c_run, this, priority, stack_size);
-        MA_ASSERT(_worker_handler);
+        for (auto& name : _worker_names) {
+            Thread* worker = new Thread(name.c_str(), &Executor::c_run, this, priority, stack_size);
+            MA_ASSERT(worker);
 
-        if (!_worker_handler->start(this)) {
-            delete _worker_handler;
-            MA_ASSERT(false);
+            if (!worker->start(this)) {
+                delete worker;
+                MA_ASSERT(false);
+            }
+            _worker_handlers.push_back(worker);
         }
     }
 
     ~Executor() {
         cancel();
-        _worker_handler->stop();
-        delete _worker_handler;
+        _stopping.store(true);
+        for (std::size_t i = 0; i < _worker_handlers.size(); i++) {
+            _task_queue_signal.signal();
+        }
+        for (auto worker : _worker_handlers) {
+            worker->stop();
+            delete worker;
+        }
     }
 
     // the Callable must be a function object or a lambda, the prototype is task_t
     template <typename Callable>
     inline void submit(Callable&& callable) {
+        enqueue(std::string(), task_t(std::forward<Callable>(callable)), false);
+    }
+
+    template <typename Callable>
+    inline void submit(const std::string& key, Callable&& callable) {
+        enqueue(key, task_t(std::forward<Callable>(callable)), false);
+    }
+
+    template <typename Callable>
+    inline void submitExclusive(Callable&& callable) {
+        enqueue(std::string(), task_t(std::forward<Callable>(callable)), true);
+    }
+
+    // drops queued and delayed tasks, running tasks finish normally
+    inline void cancel() {
+        Guard guard(_task_queue_lock);
+        for (auto& task : _delayed_queue) {
+            _busy_keys.erase(task.key);
+        }
+        _delayed_queue.clear();
+        _task_queue.clear();
+    }
+
+    json stats() {
+        Guard guard(_task_queue_lock);
+        return json::object({{"workers", _worker_handlers.size()},
+                             {"pending", _task_queue.size()},
+                             {"delayed", _delayed_queue.size()},
+                             {"running", _running},
+                             {"submitted", _submitted},
+                             {"executed", _executed},
+                             {"retried", _retried},
+                             {"latency_avg_us", _latency_avg_us},
+                             {"latency_max_us", _latency_max_us}});
+    }
+
+protected:
+    struct Task {
+        task_t fn;
+        std::string key;
+        bool exclusive;
+        uint64_t seq;
+        ma_tick_t ready;  // queued since, or due time while delayed
+    };
+
+    void enqueue(const std::string& key, task_t&& fn, bool exclusive) {
         {
             Guard guard(_task_queue_lock);
-            _task_queue.push(std::forward<Callable>(callable));
+            _task_queue.push_back(Task{std::move(fn), key, exclusive, _seq++, Tick::current()});
+            _submitted++;
         }
         _task_queue_signal.signal();
     }
 
+    // move due retries back in front of everything submitted after them, caller holds the lock
+    ma_tick_t promote(ma_tick_t now) {
+        ma_tick_t wait = Tick::waitForever;
+        for (auto it = _delayed_queue.begin(); it != _delayed_queue.end();) {
+            if (it->ready <= now) {
+                _busy_keys.erase(it->key);
+                it->ready = now;
+                auto pos  = std::upper_bound(_task_queue.begin(), _task_queue.end(), it->seq, [](uint64_t seq, const Task& task) { return seq < task.seq; });
+                _task_queue.insert(pos, std::move(*it));
+                it = _delayed_queue.erase(it);
+            } else {
+                wait = std::min(wait, it->ready - now);
+                ++it;
+            }
+        }
+        return wait;
+    }
 
-    inline void cancel() {
-        Guard guard(_task_queue_lock);
-        while (!_task_queue.empty())
-            _task_queue.pop();
+    // caller holds the lock
+    bool pick(Task& task) {
+        if (_exclusive) {
+            return false;
+        }
+        for (auto& delayed : _delayed_queue) {
+            if (delayed.exclusive) {
+                return false;
+            }
+        }
+        for (auto it = _task_queue.begin(); it != _task_queue.end(); ++it) {
+            if (it->exclusive) {
+                // a barrier: nothing behind it may start before it has run
+                if (_running != 0 || !_delayed_queue.empty() || it != _task_queue.begin()) {
+                    return false;
+                }
+                _exclusive = true;
+            } else if (_busy_keys.count(it->key)) {
+                continue;
+            } else {
+                _busy_keys.insert(it->key);
+            }
+            task = std::move(*it);
+            _task_queue.erase(it);
+            _running++;
+            return true;
+        }
+        return false;
+    }
+
+    void account(ma_tick_t waited) {
+        uint64_t us     = Tick::toMicroseconds(waited);
+        _latency_avg_us = _latency_avg_us == 0 ? us : (_latency_avg_us * 7 + us) / 8;
+        _latency_max_us = std::max(_latency_max_us, us);
     }
 
-protected:
     void run() {
-        while (true) {
-            task_t task{};
+        while (!_stopping.load()) {
+            Task task{};
+            ma_tick_t wait = Tick::waitForever;
+            bool more      = false;
             {
-                Thread::sleep(Tick::fromMilliseconds(20)); // advoid race condition
-                _task_queue_signal.wait();
-                {
-                    Guard guard(_task_queue_lock);
-                    if (!_task_queue.empty()) [[likely]] {
-                        task = std::move(_task_queue.front());
-                        _task_queue.pop();
-                    }
+                Guard guard(_task_queue_lock);
+                ma_tick_t now = Tick::current();
+                wait          = promote(now);
+                if (pick(task)) {
+                    account(now - task.ready);
+                    more = !_task_queue.empty();
+                }
+            }
+
+            if (!task.fn) {
+                _task_queue_signal.wait(wait);
+                continue;
+            }
+
+            if (more) {
+                // let another worker look at the remaining keys
+                _task_queue_signal.signal();
+            }
+
+            bool again = task.fn();
+
+            {
+                Guard guard(_task_queue_lock);
+                _running--;
+                _executed++;
+                if (task.exclusive) {
+                    _exclusive = false;
                 }
-                if (task) [[unlikely]] {
-                    if (task()) {
-                        submit(std::move(task));  // push task back into queue
+                if (again) {
+                    // keep the key busy so later requests for it stay behind the retry
+                    _retried++;
+                    if (!task.exclusive) {
+                        _busy_keys.insert(task.key);
                     }
+                    task.ready = Tick::current() + _retry_delay;
+                    _delayed_queue.push_back(std::move(task));
+                } else if (!task.exclusive) {
+                    _busy_keys.erase(task.key);
                 }
             }
-            Thread::yield();
+            _task_queue_signal.signal();
         }
     }
 
@@ -91,10 +247,23 @@ protected:
 private:
     Mutex _task_queue_lock;
     Semaphore _task_queue_signal;
-    std::string _worker_name;
-    Thread* _worker_handler;
+    std::vector<std::string> _worker_names;
+    std::vector<Thread*> _worker_handlers;
+    ma_tick_t _retry_delay;
+
+    std::deque<Task> _task_queue;
+    std::vector<Task> _delayed_queue;
+    std::unordered_set<std::string> _busy_keys;
+    uint64_t _seq;
+    std::size_t _running;
+    bool _exclusive;
+    std::atomic<bool> _stopping;
 
-    std::queue<task_t> _task_queue;
+    uint64_t _submitted;
+    uint64_t _executed;
+    uint64_t _retried;
+    uint64_t _latency_avg_us;
+    uint64_t _latency_max_us;
 };
 
 }  // namespace ma::node
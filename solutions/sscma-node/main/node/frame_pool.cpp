@@ -0,0 +1,172 @@
+#include <cstdlib>
+
+#include "frame_pool.h"
+
+namespace ma::node {
+
+static constexpr char TAG[] = "ma::node::frame_pool";
+
+static constexpr uint32_t POOL_MAGIC    = 0x4d41504c;  // "MAPL"
+static constexpr uint32_t POOL_OVERSIZE = 0xffffffff;
+
+// size, number of cached blocks
+static const size_t POOL_CLASSES[][2] = {
+    {256, 256},         // frame objects, small NALs
+    {4 * 1024, 128},    // P slices
+    {16 * 1024, 64},    // P slices, audio periods
+    {64 * 1024, 32},    // I slices, small JPEGs
+    {256 * 1024, 12},   // IDR access units, JPEGs
+    {1024 * 1024, 4},   // 1080p JPEGs, large IDR access units
+};
+
+FramePool& FramePool::instance() {
+    // never destroyed, frames may still be released during static destruction
+    static FramePool* pool = new FramePool();
+    return *pool;
+}
+
+FramePool::FramePool() : oversize_(0), bytes_(0), peak_(0) {
+    for (auto& cfg : POOL_CLASSES) {
+        Class* cls    = new Class();
+        cls->size     = cfg[0];
+        cls->capacity = cfg[1];
+        cls->hits     = 0;
+        cls->misses   = 0;
+        cls->used     = 0;
+        cls->blocks.reserve(cls->capacity);
+        classes_.push_back(cls);
+    }
+}
+
+FramePool::~FramePool() {
+    trim();
+    for (auto cls : classes_) {
+        delete cls;
+    }
+    classes_.clear();
+}
+
+int FramePool::classify(size_t size) const {
+    for (size_t i = 0; i < classes_.size(); i++) {
+        if (size + sizeof(Header) <= classes_[i]->size) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void* FramePool::allocate(size_t size) {
+    int index      = classify(size);
+    Header* header = nullptr;
+
+    if (index < 0) {
+        header = static_cast<Header*>(malloc(size + sizeof(Header)));
+        if (header == nullptr) {
+            MA_LOGE(TAG, "allocate %zu bytes failed", size);
+            return nullptr;
+        }
+        header->cls = POOL_OVERSIZE;
+        oversize_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        Class* cls = classes_[index];
+        {
+            Guard guard(cls->mutex);
+            if (!cls->blocks.empty()) {
+                header = static_cast<Header*>(cls->blocks.back());
+                cls->blocks.pop_back();
+            }
+        }
+        if (header != nullptr) {
+            cls->hits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            header = static_cast<Header*>(malloc(cls->size));
+            if (header == nullptr) {
+                MA_LOGE(TAG, "allocate %zu bytes failed", cls->size);
+                return nullptr;
+            }
+            cls->misses.fetch_add(1, std::memory_order_relaxed);
+        }
+        header->cls = index;
+        cls->used.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    header->magic = POOL_MAGIC;
+    header->size  = size;
+
+    uint64_t bytes = bytes_.fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peak  = peak_.load(std::memory_order_relaxed);
+    while (bytes > peak && !peak_.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {
+    }
+
+    return header + 1;
+}
+
+void FramePool::release(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+
+    Header* header = static_cast<Header*>(ptr) - 1;
+    if (header->magic != POOL_MAGIC) {
+        MA_LOGE(TAG, "release %p not owned by pool", ptr);
+        return;
+    }
+    header->magic = 0;
+    bytes_.fetch_sub(header->size, std::memory_order_relaxed);
+
+    if (header->cls == POOL_OVERSIZE) {
+        free(header);
+        return;
+    }
+
+    Class* cls = classes_[header->cls];
+    cls->used.fetch_sub(1, std::memory_order_relaxed);
+    {
+        Guard guard(cls->mutex);
+        if (cls->blocks.size() < cls->capacity) {
+            cls->blocks.push_back(header);
+            return;
+        }
+    }
+    free(header);
+}
+
+void FramePool::trim() {
+    for (auto cls : classes_) {
+        Guard guard(cls->mutex);
+        for (auto block : cls->blocks) {
+            free(block);
+        }
+        cls->blocks.clear();
+    }
+}
+
+json FramePool::stats() {
+    json reply      = json::object();
+    json classes    = json::array();
+    uint64_t cached = 0;
+
+    for (auto cls : classes_) {
+        size_t idle = 0;
+        {
+            Guard guard(cls->mutex);
+            idle = cls->blocks.size();
+        }
+        cached += idle * cls->size;
+        classes.push_back({{"size", cls->size},
+                           {"hits", cls->hits.load(std::memory_order_relaxed)},
+                           {"misses", cls->misses.load(std::memory_order_relaxed)},
+                           {"used", cls->used.load(std::memory_order_relaxed)},
+                           {"free", idle}});
+    }
+
+    reply["classes"]  = classes;
+    reply["oversize"] = oversize_.load(std::memory_order_relaxed);
+    reply["bytes"]    = bytes_.load(std::memory_order_relaxed);
+    reply["peak"]     = peak_.load(std::memory_order_relaxed);
+    reply["cached"]   = cached;
+
+    return reply;
+}
+
+}  // namespace ma::node
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "core/ma_core.h"
+#include "porting/ma_porting.h"
+
+namespace ma::node {
+
+// Size-class slab allocator for frame objects and their payloads.
+// Blocks are recycled through per-class free lists instead of going back to the
+// heap, which keeps the long-running capture path from fragmenting it.
+class FramePool {
+public:
+    static FramePool& instance();
+
+    void* allocate(size_t size);
+    void release(void* ptr);
+
+    void trim();
+    json stats();
+
+private:
+    FramePool();
+    ~FramePool();
+    FramePool(const FramePool&)            = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t cls;
+        uint64_t size;
+    };
+
+    struct Class {
+        size_t size;
+        size_t capacity;
+        Mutex mutex;
+        std::vector<void*> blocks;
+        std::atomic<uint64_t> hits;
+        std::atomic<uint64_t> misses;
+        std::atomic<uint32_t> used;
+    };
+
+    int classify(size_t size) const;
+
+    std::vector<Class*> classes_;
+    std::atomic<uint64_t> oversize_;
+    std::atomic<uint64_t> bytes_;
+    std::atomic<uint64_t> peak_;
+};
+
+}  // namespace ma::node
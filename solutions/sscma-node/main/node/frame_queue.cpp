@@ -0,0 +1,192 @@
+#include "frame_queue.h"
+
+#include "camera.h"
+
+namespace ma::node {
+
+const char* framePolicyName(frame_policy_t policy) {
+    switch (policy) {
+        case FRAME_POLICY_DROP_OLDEST:
+            return "drop_oldest";
+        case FRAME_POLICY_DROP_NEWEST:
+            return "drop_newest";
+        case FRAME_POLICY_KEYFRAME:
+            return "keyframe";
+        default:
+            return "unknown";
+    }
+}
+
+FrameQueue::FrameQueue(size_t capacity) : head_(0), tail_(0), sem_(0), waiting_key_(0), posted_(0), fetched_(0), dropped_(0) {
+    // sequence numbers cannot tell a full single cell from an empty one, so one frame takes two cells
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    capacity_ = capacity <= 1 ? 1 : size;
+    mask_     = size - 1;
+    cells_ = std::make_unique<Cell[]>(size);
+    for (size_t i = 0; i < size; i++) {
+        cells_[i].seq.store(i, std::memory_order_relaxed);
+        cells_[i].frame = nullptr;
+    }
+}
+
+FrameQueue::~FrameQueue() {
+    clear();
+}
+
+bool FrameQueue::push(Frame* frame) {
+    Cell* cell = nullptr;
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    for (;;) {
+        cell         = &cells_[pos & mask_];
+        size_t seq   = cell->seq.load(std::memory_order_acquire);
+        intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (dif == 0) {
+            if (pos - head_.load(std::memory_order_acquire) >= capacity_) {
+                return false;
+            }
+            if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            return false;
+        } else {
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+    cell->frame = frame;
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool FrameQueue::pop(Frame** frame, bool signaled) {
+    Cell* cell = nullptr;
+    size_t pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+        cell         = &cells_[pos & mask_];
+        size_t seq   = cell->seq.load(std::memory_order_acquire);
+        intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+        if (dif == 0) {
+            if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            return false;
+        } else {
+            pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+    *frame = cell->frame;
+    cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+    // each push signals once, taking the signal with the frame keeps the count at the depth
+    // however the frame leaves, so evictions do not pile up wakeups for fetch()
+    if (!signaled) {
+        sem_.wait(0);
+    }
+    return true;
+}
+
+bool FrameQueue::post(Frame* frame, frame_policy_t policy) {
+    bool video   = !isAudioChannel(frame->chn);
+    bool key     = video && static_cast<videoFrame*>(frame)->img.key;
+    uint32_t bit = 1u << frame->chn;
+
+    posted_.fetch_add(1, std::memory_order_relaxed);
+
+    if (policy == FRAME_POLICY_KEYFRAME && video) {
+        if (key) {
+            waiting_key_.fetch_and(~bit, std::memory_order_relaxed);
+        } else if (waiting_key_.load(std::memory_order_relaxed) & bit) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            frame->release();
+            return false;
+        }
+    }
+
+    while (!push(frame)) {
+        Frame* victim = nullptr;
+        if (policy == FRAME_POLICY_DROP_OLDEST && pop(&victim)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            victim->release();
+            continue;
+        }
+        // the frames queued behind an evicted one would break its reference chain, so a key frame
+        // replaces everything queued, while a delta frame or audio never evicts
+        if (policy == FRAME_POLICY_KEYFRAME && key && flush(frame->chn) > 0) {
+            continue;
+        }
+        if (policy == FRAME_POLICY_KEYFRAME && video) {
+            waiting_key_.fetch_or(bit, std::memory_order_relaxed);
+        }
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        frame->release();
+        return false;
+    }
+
+    sem_.signal();
+    return true;
+}
+
+// caller posts a key frame of chn, the other video channels in the queue resume at their own
+size_t FrameQueue::flush(int chn) {
+    Frame* victim = nullptr;
+    size_t count  = 0;
+    while (pop(&victim)) {
+        if (!isAudioChannel(victim->chn) && victim->chn != chn) {
+            waiting_key_.fetch_or(1u << victim->chn, std::memory_order_relaxed);
+        }
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        victim->release();
+        count++;
+    }
+    return count;
+}
+
+bool FrameQueue::fetch(void** frame, ma_tick_t timeout) {
+    Frame* item     = nullptr;
+    ma_tick_t start = Tick::current();
+    bool signaled   = false;
+    for (;;) {
+        if (pop(&item, signaled)) {
+            fetched_.fetch_add(1, std::memory_order_relaxed);
+            *frame = item;
+            return true;
+        }
+        ma_tick_t elapsed = Tick::current() - start;
+        if (timeout != Tick::waitForever && elapsed >= timeout) {
+            return false;
+        }
+        // a signal posted after its frame was already taken only causes a spurious wakeup
+        signaled = sem_.wait(timeout == Tick::waitForever ? timeout : timeout - elapsed);
+    }
+}
+
+void FrameQueue::clear() {
+    Frame* frame = nullptr;
+    while (pop(&frame)) {
+        frame->release();
+    }
+    waiting_key_.store(0, std::memory_order_relaxed);
+}
+
+size_t FrameQueue::capacity() const {
+    return capacity_;
+}
+
+size_t FrameQueue::size() const {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+}
+
+json FrameQueue::stats() const {
+    return json::object({{"capacity", capacity()},
+                         {"depth", size()},
+                         {"posted", posted_.load(std::memory_order_relaxed)},
+                         {"fetched", fetched_.load(std::memory_order_relaxed)},
+                         {"dropped", dropped_.load(std::memory_order_relaxed)}});
+}
+
+}  // namespace ma::node
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "core/ma_core.h"
+#include "porting/ma_porting.h"
+
+namespace ma::node {
+
+class Frame;
+
+typedef enum {
+    FRAME_POLICY_DROP_OLDEST = 0,  // evict the oldest queued frame to make room
+    FRAME_POLICY_DROP_NEWEST,      // discard the incoming frame when full
+    FRAME_POLICY_KEYFRAME,         // H.264: after a drop, skip the channel's delta frames until its next key frame;
+                                   // a key frame finding the queue full replaces what is queued
+} frame_policy_t;
+
+const char* framePolicyName(frame_policy_t policy);
+
+// Bounded lock-free ring (Vyukov MPMC) carrying refcounted frames from the camera
+// callbacks to a subscriber. post() never blocks; fetch() mirrors MessageBox::fetch().
+class FrameQueue {
+public:
+    explicit FrameQueue(size_t capacity);
+    ~FrameQueue();
+
+    FrameQueue(const FrameQueue&)            = delete;
+    FrameQueue& operator=(const FrameQueue&) = delete;
+
+    // takes over one reference of frame, released when the frame is dropped
+    bool post(Frame* frame, frame_policy_t policy);
+    bool fetch(void** frame, ma_tick_t timeout = Tick::waitForever);
+    void clear();
+
+    size_t capacity() const;
+    size_t size() const;
+    json stats() const;
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        Frame* frame;
+    };
+
+    bool push(Frame* frame);
+    bool pop(Frame** frame, bool signaled = false);  // signaled: the caller already took the frame's signal
+    size_t flush(int chn);
+
+    size_t capacity_;
+    size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+    Semaphore sem_;
+    std::atomic<uint32_t> waiting_key_;  // a bit per channel skipping delta frames until its next key frame
+    std::atomic<uint64_t> posted_;
+    std::atomic<uint64_t> fetched_;
+    std::atomic<uint64_t> dropped_;
+};
+
+}  // namespace ma::node
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cstring>
+
+#include "camera.h"
+#include "gop_cache.h"
+
+namespace ma::node {
+
+GopCache::GopCache() : max_frames_(0), max_bytes_(0), bytes_(0), peak_(0), gops_(0), overflows_(0), replays_(0), copies_(0) {}
+
+GopCache::~GopCache() {
+    clear();
+}
+
+void GopCache::configure(size_t frames, size_t bytes) {
+    Guard guard(mutex_);
+    max_frames_ = frames;
+    max_bytes_  = bytes;
+    drop();
+}
+
+bool GopCache::enabled() {
+    Guard guard(mutex_);
+    return max_frames_ > 0;
+}
+
+// caller holds the lock
+void GopCache::drop() {
+    for (auto frame : frames_) {
+        frame->release();
+    }
+    frames_.clear();
+    bytes_ = 0;
+}
+
+videoFrame* holdFrame(videoFrame* frame) {
+    if (frame->handle == nullptr) {
+        return frame;
+    }
+    // a zero-copy frame pins an encoder stream, those have to go back within the in-flight bound
+    videoFrame* copy = new videoFrame();
+    copy->chn        = frame->chn;
+    copy->timestamp  = frame->timestamp;
+    copy->img        = frame->img;
+    copy->fps        = frame->fps;
+    copy->img.data   = static_cast<uint8_t*>(FramePool::instance().allocate(frame->img.size));
+    if (copy->img.data == nullptr) {
+        delete copy;
+        frame->release();
+        return nullptr;
+    }
+    memcpy(copy->img.data, frame->img.data, frame->img.size);
+    for (auto& block : frame->blocks) {
+        copy->blocks.push_back({copy->img.data + (static_cast<uint8_t*>(block.first) - frame->img.data), block.second});
+    }
+    copy->ref();  // counted from one like a dispatched frame, snapshots add to it
+    frame->release();
+    return copy;
+}
+
+// caller holds the lock
+videoFrame* GopCache::hold(videoFrame* frame) {
+    bool zerocopy = frame->handle != nullptr;
+    frame         = holdFrame(frame);
+    if (zerocopy && frame != nullptr) {
+        copies_++;
+    }
+    return frame;
+}
+
+void GopCache::push(videoFrame* frame) {
+    Guard guard(mutex_);
+    size_t size = frame->img.size;
+    if (frame->img.key) {
+        drop();
+        gops_++;
+    } else if (frames_.empty()) {
+        frame->release();  // nothing to build on until the next IDR
+        return;
+    }
+    if (frames_.size() >= max_frames_ || bytes_ + size > max_bytes_) {
+        overflows_++;
+        drop();
+        frame->release();
+        return;
+    }
+    frame = hold(frame);
+    if (frame == nullptr) {
+        drop();
+        return;
+    }
+    frames_.push_back(frame);
+    bytes_ += size;
+    peak_ = std::max(peak_, bytes_);
+}
+
+size_t GopCache::snapshot(std::vector<videoFrame*>& frames, ma_tick_t before) {
+    Guard guard(mutex_);
+    size_t count = 0;
+    for (auto frame : frames_) {
+        if (frame->timestamp >= before) {
+            break;
+        }
+        frame->ref();
+        frames.push_back(frame);
+        count++;
+    }
+    if (count > 0) {
+        replays_++;
+    }
+    return count;
+}
+
+void GopCache::clear() {
+    Guard guard(mutex_);
+    drop();
+}
+
+json GopCache::stats() {
+    Guard guard(mutex_);
+    return json::object({{"enabled", max_frames_ > 0},
+                         {"frames", frames_.size()},
+                         {"bytes", bytes_},
+                         {"peak", peak_},
+                         {"limit", {max_frames_, max_bytes_}},
+                         {"gops", gops_},
+                         {"overflows", overflows_},
+                         {"replays", replays_},
+                         {"copies", copies_}});
+}
+
+}  // namespace ma::node
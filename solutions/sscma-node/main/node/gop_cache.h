@@ -0,0 +1,56 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "core/ma_core.h"
+#include "porting/ma_porting.h"
+
+namespace ma::node {
+
+class videoFrame;
+
+// frame itself, or for a zero-copy frame a pool copy counted from one with the original released,
+// so that frames held for long never pin encoder streams; null if the copy cannot be allocated
+videoFrame* holdFrame(videoFrame* frame);
+
+// The H.264 frames since the last IDR, held by reference, so a viewer that joins midway can
+// decode at once instead of waiting for the next IDR. Bounded by frames and bytes; a GOP that
+// outgrows either is dropped whole until the next IDR, since part of one cannot be decoded.
+class GopCache {
+public:
+    GopCache();
+    ~GopCache();
+
+    GopCache(const GopCache&)            = delete;
+    GopCache& operator=(const GopCache&) = delete;
+
+    // frames 0 turns the cache off
+    void configure(size_t frames, size_t bytes);
+    bool enabled();
+
+    // takes over one reference of frame
+    void push(videoFrame* frame);
+    // a new reference to each cached frame captured before `before`, oldest first
+    size_t snapshot(std::vector<videoFrame*>& frames, ma_tick_t before);
+    void clear();
+
+    json stats();
+
+private:
+    videoFrame* hold(videoFrame* frame);
+    void drop();
+
+    Mutex mutex_;
+    std::deque<videoFrame*> frames_;
+    size_t max_frames_;
+    size_t max_bytes_;
+    size_t bytes_;
+    size_t peak_;
+    uint64_t gops_;
+    uint64_t overflows_;
+    uint64_t replays_;
+    uint64_t copies_;
+};
+
+}  // namespace ma::node
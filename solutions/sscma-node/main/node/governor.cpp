@@ -0,0 +1,190 @@
+#include <time.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "governor.h"
+
+namespace ma::node {
+
+static constexpr char TAG[] = "ma::node::governor";
+
+static constexpr int GOVERNOR_WINDOW_MS = 1000;
+static constexpr float GOVERNOR_DECREASE = 0.8f;  // over budget
+static constexpr float GOVERNOR_HEADROOM = 0.8f;  // below this share of the budget the rate may grow
+static constexpr float GOVERNOR_SMOOTH   = 0.2f;
+
+RateGovernor::RateGovernor()
+    : latency_ms_(0),
+      cpu_(0),
+      min_(1),
+      max_(30),
+      rate_(30),
+      due_(0),
+      window_(0),
+      frames_(0),
+      cpu_us_(0),
+      latency_avg_ms_(0),
+      cpu_per_frame_us_(0),
+      fps_(0),
+      load_(0),
+      reason_("source"),
+      dropped_(0),
+      changed_(false) {}
+
+void RateGovernor::configure(const json& config) {
+    Guard guard(mutex_);
+    if (!config.is_object()) {
+        latency_ms_ = 0;
+        cpu_        = 0;
+        return;
+    }
+    if (config.contains("latency") && config["latency"].is_number()) {
+        latency_ms_ = std::max(config["latency"].get<float>(), 0.0f);
+    }
+    if (config.contains("cpu") && config["cpu"].is_number()) {
+        cpu_ = std::clamp(config["cpu"].get<float>(), 0.0f, 100.0f) / 100.0f;
+    }
+    if (config.contains("min") && config["min"].is_number()) {
+        min_ = std::max(config["min"].get<float>(), 0.1f);
+    }
+    // start from the top, the first windows bring it down if needed
+    rate_   = max_;
+    window_ = 0;
+    MA_LOGI(TAG, "latency %.0fms cpu %.0f%% min %.1ffps", latency_ms_, cpu_ * 100, min_);
+}
+
+void RateGovernor::setLimit(float fps) {
+    Guard guard(mutex_);
+    max_  = std::max(fps, min_);
+    rate_ = std::min(rate_, max_);
+}
+
+bool RateGovernor::enabled() {
+    Guard guard(mutex_);
+    return latency_ms_ > 0 || cpu_ > 0;
+}
+
+bool RateGovernor::admit(ma_tick_t now) {
+    Guard guard(mutex_);
+    if (latency_ms_ <= 0 && cpu_ <= 0) {
+        return true;
+    }
+    if (now < due_) {
+        dropped_++;
+        return false;
+    }
+    ma_tick_t period = Tick::fromMilliseconds(static_cast<uint32_t>(1000 / rate_));
+    due_             = due_ + period > now ? due_ + period : now + period;
+    return true;
+}
+
+void RateGovernor::update(ma_tick_t now, ma_tick_t latency, uint64_t cpu_us) {
+    Guard guard(mutex_);
+    float latency_ms = Tick::toMicroseconds(latency) / 1000.0f;
+    if (frames_ == 0 && window_ == 0) {
+        latency_avg_ms_   = latency_ms;
+        cpu_per_frame_us_ = cpu_us;
+        window_           = now;
+    } else {
+        latency_avg_ms_ += (latency_ms - latency_avg_ms_) * GOVERNOR_SMOOTH;
+        cpu_per_frame_us_ += (cpu_us - cpu_per_frame_us_) * GOVERNOR_SMOOTH;
+    }
+    frames_++;
+    cpu_us_ += cpu_us;
+    if (now - window_ >= Tick::fromMilliseconds(GOVERNOR_WINDOW_MS)) {
+        adjust(now);
+    }
+}
+
+// caller holds the lock
+void RateGovernor::adjust(ma_tick_t now) {
+    uint64_t window_us = std::max<uint64_t>(Tick::toMicroseconds(now - window_), 1);
+    fps_               = frames_ * 1000000.0f / window_us;
+    load_              = static_cast<float>(cpu_us_) / window_us;
+    frames_            = 0;
+    cpu_us_            = 0;
+    window_            = now;
+
+    if (latency_ms_ <= 0 && cpu_ <= 0) {
+        return;
+    }
+
+    float rate = rate_;
+    std::string by;
+    bool headroom = true;
+
+    // the CPU cost per frame tells the sustainable rate directly
+    if (cpu_ > 0 && cpu_per_frame_us_ > 0) {
+        float cap = cpu_ * 1000000.0f / cpu_per_frame_us_;
+        if (cap < rate) {
+            rate = cap;
+            by   = "cpu";
+        }
+        headroom = load_ < cpu_ * GOVERNOR_HEADROOM;
+    }
+    // latency reacts late, back off in steps
+    if (latency_ms_ > 0) {
+        if (latency_avg_ms_ > latency_ms_) {
+            rate = std::min(rate, rate_ * GOVERNOR_DECREASE);
+            by   = "latency";
+        }
+        headroom = headroom && latency_avg_ms_ < latency_ms_ * GOVERNOR_HEADROOM;
+    }
+    if (by.empty()) {
+        // within budget: grow with headroom, otherwise hold; the last limit still applies below the source rate
+        rate = headroom ? rate_ + 1 : rate_;
+        by   = reason_;
+    }
+
+    if (rate >= max_) {
+        rate = max_;
+        by   = "source";
+    } else if (rate <= min_) {
+        rate = min_;
+        by   = "min";
+    }
+
+    if (std::fabs(rate - rate_) >= 0.5f) {
+        changed_ = true;
+        MA_LOGD(TAG, "rate %.1f -> %.1ffps (%s) latency %.1fms load %.2f", rate_, rate, by.c_str(), latency_avg_ms_, load_);
+    }
+    rate_   = rate;
+    reason_ = by;
+}
+
+bool RateGovernor::changed() {
+    Guard guard(mutex_);
+    bool changed = changed_;
+    changed_     = false;
+    return changed;
+}
+
+json RateGovernor::stats() {
+    Guard guard(mutex_);
+    json budget = json::object();
+    if (latency_ms_ > 0) {
+        budget["latency"] = latency_ms_;
+    }
+    if (cpu_ > 0) {
+        budget["cpu"] = std::round(cpu_ * 1000.0) / 10;
+    }
+    return json::object({{"enabled", latency_ms_ > 0 || cpu_ > 0},
+                         {"budget", budget},
+                         {"rate", std::round(rate_ * 10.0) / 10},
+                         {"fps", std::round(fps_ * 10.0) / 10},
+                         {"limit", reason_},
+                         {"latency", std::round(latency_avg_ms_ * 10.0) / 10},
+                         {"cpu", std::round(load_ * 1000.0) / 10},
+                         {"dropped", dropped_}});
+}
+
+uint64_t RateGovernor::threadCpuMicroseconds() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+}  // namespace ma::node
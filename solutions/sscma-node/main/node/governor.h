@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+
+#include "core/ma_core.h"
+#include "porting/ma_porting.h"
+
+namespace ma::node {
+
+// Holds a model node's inference rate to a latency and/or CPU budget. Frames above the governed
+// rate are skipped before they reach the TPU. Over budget the rate drops by a fifth per window,
+// with headroom it climbs back by one frame per second per window, up to the source rate.
+class RateGovernor {
+public:
+    RateGovernor();
+
+    // {"latency": ms, "cpu": percent of one core, "min": fps}, an empty budget turns it off
+    void configure(const json& config);
+    // the source rate caps the governed rate
+    void setLimit(float fps);
+    bool enabled();
+
+    // whether a frame arriving now should be inferred
+    bool admit(ma_tick_t now);
+    // after a frame: capture to hand-off latency and the worker's CPU time spent on it
+    void update(ma_tick_t now, ma_tick_t latency, uint64_t cpu_us);
+    // true once after the governed rate moved
+    bool changed();
+
+    json stats();
+
+    // CPU time of the calling thread
+    static uint64_t threadCpuMicroseconds();
+
+private:
+    void adjust(ma_tick_t now);
+
+    Mutex mutex_;
+    float latency_ms_;  // budgets, 0 when not set
+    float cpu_;
+    float min_;
+    float max_;
+    float rate_;
+    ma_tick_t due_;
+    ma_tick_t window_;
+    uint32_t frames_;
+    uint64_t cpu_us_;
+    float latency_avg_ms_;
+    float cpu_per_frame_us_;
+    float fps_;
+    float load_;
+    std::string reason_;  // what holds the rate down: "latency", "cpu", "min" or "source"
+    uint64_t dropped_;
+    bool changed_;
+};
+
+}  // namespace ma::node
@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <numeric>
+
+#include "mask.h"
+
+namespace ma::node {
+
+static constexpr int32_t MASK_CHUNK = 56;  // bits read per word, leaves room for an unaligned start
+
+// eight pixels of 0 or 255 for each bitmap byte, LSB first
+static const std::array<uint64_t, 256>& unpackTable() {
+    static const std::array<uint64_t, 256> table = [] {
+        std::array<uint64_t, 256> t;
+        for (int b = 0; b < 256; b++) {
+            uint64_t v = 0;
+            for (int i = 0; i < 8; i++) {
+                if (b & (1 << i)) {
+                    v |= 0xffull << (i * 8);
+                }
+            }
+            t[b] = v;
+        }
+        return t;
+    }();
+    return table;
+}
+
+static inline bool maskTest(const uint8_t* bits, int32_t width, int32_t height, int32_t x, int32_t y) {
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+        return false;
+    }
+    size_t n = static_cast<size_t>(y) * width + x;
+    return (bits[n >> 3] >> (n & 7)) & 1;
+}
+
+// up to MASK_CHUNK bits from bit position pos, never reads past the bitmap
+static inline uint64_t maskWord(const uint8_t* bits, size_t size, size_t pos, int32_t count) {
+    size_t byte = pos >> 3;
+    uint64_t w  = 0;
+    if (byte + 8 <= size) {
+        memcpy(&w, bits + byte, 8);
+    } else {
+        for (size_t i = 0; byte + i < size; i++) {
+            w |= static_cast<uint64_t>(bits[byte + i]) << (i * 8);
+        }
+    }
+    return (w >> (pos & 7)) & ((1ull << count) - 1);
+}
+
+void maskUnpack(const uint8_t* bits, int32_t width, int32_t height, uint8_t* dst) {
+    const auto& table = unpackTable();
+    size_t pixels     = static_cast<size_t>(width) * height;
+    size_t bytes      = pixels / 8;
+    size_t i          = 0;
+
+    // empty stretches are common, skip them 64 pixels at a time
+    for (; i + 8 <= bytes; i += 8) {
+        uint64_t w;
+        memcpy(&w, bits + i, 8);
+        if (w == 0) {
+            memset(dst + i * 8, 0, 64);
+            continue;
+        }
+        for (size_t k = 0; k < 8; k++) {
+            memcpy(dst + (i + k) * 8, &table[bits[i + k]], 8);
+        }
+    }
+    for (; i < bytes; i++) {
+        memcpy(dst + i * 8, &table[bits[i]], 8);
+    }
+    for (size_t n = bytes * 8; n < pixels; n++) {
+        dst[n] = (bits[n >> 3] >> (n & 7)) & 1 ? 255 : 0;
+    }
+}
+
+void maskRuns(const uint8_t* bits, int32_t width, int32_t height, std::vector<mask_run_t>& runs) {
+    size_t size = (static_cast<size_t>(width) * height + 7) / 8;
+    runs.clear();
+    for (int32_t y = 0; y < height; y++) {
+        size_t row   = static_cast<size_t>(y) * width;
+        bool in      = false;
+        int32_t from = 0;
+        for (int32_t x0 = 0; x0 < width; x0 += MASK_CHUNK) {
+            int32_t n  = std::min(MASK_CHUNK, width - x0);
+            uint64_t w = maskWord(bits, size, row + x0, n);
+            int32_t x  = 0;
+            while (x < n) {
+                if (!in) {
+                    uint64_t rest = w >> x;
+                    if (rest == 0) {
+                        break;
+                    }
+                    x += __builtin_ctzll(rest);
+                    from = x0 + x;
+                    in   = true;
+                } else {
+                    uint64_t rest = (~w >> x) & ((1ull << (n - x)) - 1);
+                    if (rest == 0) {
+                        break;
+                    }
+                    x += __builtin_ctzll(rest);
+                    runs.push_back({static_cast<int16_t>(y), static_cast<int16_t>(from), static_cast<int16_t>(x0 + x)});
+                    in = false;
+                }
+            }
+        }
+        if (in) {
+            runs.push_back({static_cast<int16_t>(y), static_cast<int16_t>(from), static_cast<int16_t>(width)});
+        }
+    }
+}
+
+static size_t maskFind(std::vector<size_t>& parent, size_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i         = parent[i];
+    }
+    return i;
+}
+
+void maskContour(const uint8_t* bits, int32_t width, int32_t height, std::vector<mask_point_t>& contour) {
+    static const int8_t dx[8] = {1, 1, 0, -1, -1, -1, 0, 1};  // E, NE, N, NW, W, SW, S, SE
+    static const int8_t dy[8] = {0, -1, -1, -1, 0, 1, 1, 1};
+
+    contour.clear();
+
+    std::vector<mask_run_t> runs;
+    maskRuns(bits, width, height, runs);
+    if (runs.empty()) {
+        return;
+    }
+
+    // blobs: runs touching a run of the row above, diagonals included
+    std::vector<size_t> parent(runs.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    size_t above = 0;  // first run of the previous row
+    size_t row   = 0;  // first run of the current row
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (i > 0 && runs[i].row != runs[i - 1].row) {
+            above = runs[i - 1].row == runs[i].row - 1 ? row : i;
+            row   = i;
+        }
+        for (size_t j = above; j < row; j++) {
+            if (runs[j].start > runs[i].end) {
+                break;
+            }
+            if (runs[i].start <= runs[j].end) {
+                size_t a = maskFind(parent, i);
+                size_t b = maskFind(parent, j);
+                if (a != b) {
+                    parent[std::max(a, b)] = std::min(a, b);
+                }
+            }
+        }
+    }
+    std::vector<uint32_t> area(runs.size(), 0);
+    size_t largest = 0;
+    for (size_t i = 0; i < runs.size(); i++) {
+        size_t root = maskFind(parent, i);
+        area[root] += runs[i].end - runs[i].start;
+        if (area[root] > area[largest]) {
+            largest = root;
+        }
+    }
+
+    // a root is the blob's first run in raster order, so its first pixel is on the outer border;
+    // Moore neighbour tracing from there
+    int32_t x0 = runs[largest].start;
+    int32_t y0 = runs[largest].row;
+    std::vector<mask_point_t> border;
+    border.push_back({static_cast<int16_t>(x0), static_cast<int16_t>(y0)});
+
+    int32_t x = x0, y = y0, dir = 7;
+    int32_t x1 = -1, y1 = -1;
+    size_t limit = static_cast<size_t>(width) * height * 4;
+    while (border.size() < limit) {
+        int32_t from = (dir % 2) ? (dir + 6) % 8 : (dir + 7) % 8;
+        int32_t next = -1;
+        for (int32_t k = 0; k < 8; k++) {
+            int32_t d = (from + k) % 8;
+            if (maskTest(bits, width, height, x + dx[d], y + dy[d])) {
+                next = d;
+                break;
+            }
+        }
+        if (next < 0) {
+            break;  // a single pixel
+        }
+        int32_t nx = x + dx[next], ny = y + dy[next];
+        if (x == x0 && y == y0 && nx == x1 && ny == y1) {
+            border.pop_back();  // back at the start, leaving the same way
+            break;
+        }
+        if (x1 < 0) {
+            x1 = nx;
+            y1 = ny;
+        }
+        x   = nx;
+        y   = ny;
+        dir = next;
+        border.push_back({static_cast<int16_t>(x), static_cast<int16_t>(y)});
+    }
+
+    // keep the corners
+    size_t count = border.size();
+    if (count < 3) {
+        contour = border;
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const mask_point_t& prev = border[(i + count - 1) % count];
+        const mask_point_t& cur  = border[i];
+        const mask_point_t& next = border[(i + 1) % count];
+        if (cur.x - prev.x != next.x - cur.x || cur.y - prev.y != next.y - cur.y) {
+            contour.push_back(cur);
+        }
+    }
+}
+
+void maskRLE(const uint8_t* bits, int32_t width, int32_t height, std::vector<uint32_t>& counts) {
+    // transpose through the runs, touching foreground pixels only, then read the runs of the columns
+    std::vector<mask_run_t> runs;
+    maskRuns(bits, width, height, runs);
+    std::vector<uint8_t> columns((static_cast<size_t>(width) * height + 7) / 8, 0);
+    for (auto& run : runs) {
+        for (int32_t x = run.start; x < run.end; x++) {
+            size_t n = static_cast<size_t>(x) * height + run.row;
+            columns[n >> 3] |= 1 << (n & 7);
+        }
+    }
+    maskRuns(columns.data(), height, width, runs);
+
+    counts.clear();
+    size_t last = 0;  // end of the previous foreground run in the column-major stream
+    for (auto& run : runs) {
+        size_t start = static_cast<size_t>(run.row) * height + run.start;
+        size_t end   = static_cast<size_t>(run.row) * height + run.end;
+        if (!counts.empty() && start == last) {
+            counts.back() += end - start;  // continues from the bottom of the previous column
+        } else {
+            counts.push_back(start - last);
+            counts.push_back(end - start);
+        }
+        last = end;
+    }
+    if (last < static_cast<size_t>(width) * height) {
+        counts.push_back(static_cast<size_t>(width) * height - last);
+    }
+}
+
+}  // namespace ma::node
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ma::node {
+
+// Segmentation masks arrive as a packed bitmap, bit n of the stream (LSB first) is pixel
+// (n % width, n / width). Everything here works on that bitmap without unpacking it.
+
+typedef struct {
+    int16_t x;
+    int16_t y;
+} mask_point_t;
+
+// foreground runs of one row, end exclusive
+typedef struct {
+    int16_t row;
+    int16_t start;
+    int16_t end;
+} mask_run_t;
+
+// expands the bitmap to one byte per pixel, 0 or 255
+void maskUnpack(const uint8_t* bits, int32_t width, int32_t height, uint8_t* dst);
+
+// foreground runs in row-major order, a 64-bit word at a time
+void maskRuns(const uint8_t* bits, int32_t width, int32_t height, std::vector<mask_run_t>& runs);
+
+// outer border of the largest 8-connected blob, corners only like CHAIN_APPROX_SIMPLE; empty without foreground
+void maskContour(const uint8_t* bits, int32_t width, int32_t height, std::vector<mask_point_t>& contour);
+
+// COCO uncompressed RLE: alternating background and foreground counts in column-major order,
+// starting with background
+void maskRLE(const uint8_t* bits, int32_t width, int32_t height, std::vector<uint32_t>& counts);
+
+}  // namespace ma::node
@@ -0,0 +1,223 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+
+#include "metadata.h"
+
+namespace ma::node {
+
+static constexpr char TAG[] = "ma::node::metadata";
+
+static std::string directoryOf(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? std::string("./") : path.substr(0, slash + 1);
+}
+
+static std::string sidecarOf(const std::string& path) {
+    size_t dot = path.rfind('.');
+    return (dot == std::string::npos || dot < path.rfind('/') + 1 ? path : path.substr(0, dot)) + METADATA_EXT;
+}
+
+MetadataWriter::MetadataWriter() : file_(nullptr), header_{}, base_(0), size_(0), current_{-1, {}, {}}, files_(0), records_(0), bytes_(0) {}
+
+MetadataWriter::~MetadataWriter() {
+    close();
+}
+
+bool MetadataWriter::open(const std::string& path, ma_tick_t base) {
+    Guard guard(mutex_);
+    close();
+    path_      = sidecarOf(path);
+    recording_ = path;
+    file_      = fopen(path_.c_str(), "wb");
+    if (file_ == nullptr) {
+        MA_LOGW(TAG, "could not open %s: %s", path_.c_str(), strerror(errno));
+        path_.clear();
+        return false;
+    }
+
+    base_ = Tick::toMicroseconds(base) / 1000000;
+    memcpy(header_.magic, METADATA_MAGIC, sizeof(header_.magic));
+    header_.version  = METADATA_VERSION;
+    header_.start    = static_cast<int64_t>(time(nullptr)) - (Tick::toMicroseconds(Tick::current()) / 1000000 - base_);
+    header_.duration = 0;
+    header_.records  = 0;
+    header_.mask[0]  = 0;
+    header_.mask[1]  = 0;
+    size_            = fwrite(&header_, 1, sizeof(header_), file_);
+
+    // seconds seen before the file opened, the pre-roll of a clip
+    for (auto& record : pending_) {
+        if (record.second >= base_) {
+            write(record);
+        }
+    }
+    pending_.clear();
+    files_++;
+    return true;
+}
+
+size_t MetadataWriter::close() {
+    Guard guard(mutex_);
+    if (file_ == nullptr) {
+        return 0;
+    }
+    // the second in progress goes to this file, the next one may get it too
+    if (!current_.counts.empty() && current_.second >= base_) {
+        write(current_);
+    }
+    header_.duration = static_cast<uint32_t>(std::max<int64_t>(0, Tick::toMicroseconds(Tick::current()) / 1000000 - base_));
+    if (fseek(file_, 0, SEEK_SET) == 0) {
+        fwrite(&header_, 1, sizeof(header_), file_);
+    }
+    fclose(file_);
+    file_ = nullptr;
+
+    std::string summary = directoryOf(path_) + METADATA_SUMMARY;
+    FILE* file          = fopen(summary.c_str(), "a");
+    if (file != nullptr) {
+        fprintf(file,
+                "%s %lld %lld %016llx%016llx\n",
+                std::filesystem::path(recording_).filename().c_str(),
+                static_cast<long long>(header_.start),
+                static_cast<long long>(header_.start + header_.duration),
+                static_cast<unsigned long long>(header_.mask[1]),
+                static_cast<unsigned long long>(header_.mask[0]));
+        fclose(file);
+    } else {
+        MA_LOGW(TAG, "could not append to %s: %s", summary.c_str(), strerror(errno));
+    }
+    path_.clear();
+    recording_.clear();
+    return size_;
+}
+
+bool MetadataWriter::opened() const {
+    Guard guard(mutex_);
+    return file_ != nullptr;
+}
+
+std::string MetadataWriter::path() const {
+    Guard guard(mutex_);
+    return path_;
+}
+
+// caller holds the lock
+void MetadataWriter::write(const record_t& record) {
+    uint8_t head[4];
+    uint16_t offset = static_cast<uint16_t>(std::clamp<int64_t>(record.second - base_, 0, UINT16_MAX));
+    memcpy(head, &offset, sizeof(offset));
+    head[2] = static_cast<uint8_t>(record.counts.size());
+    head[3] = static_cast<uint8_t>(std::min<size_t>(record.tracks.size(), UINT8_MAX));
+    size_t size = fwrite(head, 1, sizeof(head), file_);
+    for (auto& count : record.counts) {
+        uint8_t pair[2] = {count.first, count.second};
+        size += fwrite(pair, 1, sizeof(pair), file_);
+        int bit = std::min<int>(count.first, METADATA_CLASSES - 1);
+        header_.mask[bit / 64] |= 1ull << (bit % 64);
+    }
+    size += fwrite(record.tracks.data(), sizeof(uint32_t), head[3], file_) * sizeof(uint32_t);
+    header_.records++;
+    size_ += size;
+    bytes_ += size;
+    records_++;
+}
+
+// caller holds the lock and moves on to another second
+void MetadataWriter::finish() {
+    if (current_.counts.empty()) {
+        return;
+    }
+    if (file_ != nullptr && current_.second >= base_) {
+        write(current_);
+    } else if (file_ == nullptr) {
+        pending_.push_back(std::move(current_));
+        while (pending_.front().second < pending_.back().second - METADATA_PENDING) {
+            pending_.pop_front();
+        }
+    }
+    current_.counts.clear();
+    current_.tracks.clear();
+}
+
+void MetadataWriter::add(ma_tick_t timestamp, const std::vector<ma_bbox_t>& boxes, const std::vector<int>& tracks) {
+    Guard guard(mutex_);
+    int64_t second = Tick::toMicroseconds(timestamp) / 1000000;
+    if (second != current_.second) {
+        finish();
+        current_.second = second;
+    }
+
+    // most boxes of each class in a single frame of the second
+    std::vector<std::pair<uint8_t, uint8_t>> counts;
+    for (auto& box : boxes) {
+        uint8_t target = static_cast<uint8_t>(std::clamp(box.target, 0, UINT8_MAX));
+        auto it        = std::find_if(counts.begin(), counts.end(), [&](const auto& count) { return count.first == target; });
+        if (it == counts.end()) {
+            counts.push_back({target, 1});
+        } else if (it->second < UINT8_MAX) {
+            it->second++;
+        }
+    }
+    for (auto& count : counts) {
+        auto it = std::find_if(current_.counts.begin(), current_.counts.end(), [&](const auto& item) { return item.first == count.first; });
+        if (it == current_.counts.end()) {
+            current_.counts.push_back(count);
+        } else {
+            it->second = std::max(it->second, count.second);
+        }
+    }
+    for (int track : tracks) {
+        uint32_t id = static_cast<uint32_t>(track);
+        if (track >= 0 && current_.tracks.size() < UINT8_MAX && std::find(current_.tracks.begin(), current_.tracks.end(), id) == current_.tracks.end()) {
+            current_.tracks.push_back(id);
+        }
+    }
+}
+
+void MetadataWriter::prune(const std::string& dir) {
+    std::string summary = (dir.empty() || dir.back() == '/' ? dir : dir + "/") + METADATA_SUMMARY;
+    FILE* file          = fopen(summary.c_str(), "r");
+    if (file == nullptr) {
+        return;
+    }
+    std::string kept;
+    size_t lines = 0;
+    char* line   = nullptr;
+    size_t len   = 0;
+    char name[256];
+    while (getline(&line, &len, file) > 0) {
+        lines++;
+        if (sscanf(line, "%255s", name) == 1 && access(sidecarOf(directoryOf(summary) + name).c_str(), F_OK) == 0) {
+            kept += line;
+        }
+    }
+    free(line);
+    fclose(file);
+    if (std::count(kept.begin(), kept.end(), '\n') == static_cast<std::ptrdiff_t>(lines)) {
+        return;
+    }
+
+    std::string temp = summary + ".tmp";
+    file             = fopen(temp.c_str(), "w");
+    if (file == nullptr) {
+        return;
+    }
+    bool ok = fwrite(kept.data(), 1, kept.size(), file) == kept.size() && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    fclose(file);
+    if (!ok || rename(temp.c_str(), summary.c_str()) != 0) {
+        MA_LOGW(TAG, "could not replace %s: %s", summary.c_str(), strerror(errno));
+        unlink(temp.c_str());
+    }
+}
+
+json MetadataWriter::stats() {
+    Guard guard(mutex_);
+    return json::object({{"enabled", true}, {"open", file_ != nullptr}, {"files", files_}, {"records", records_}, {"bytes", bytes_}, {"pending", pending_.size()}});
+}
+
+}  // namespace ma::node
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/ma_core.h"
+#include "porting/ma_porting.h"
+
+namespace ma::node {
+
+#define METADATA_EXT     ".meta"
+#define METADATA_SUMMARY ".metadata"
+#define METADATA_MAGIC   "SSMD"
+#define METADATA_VERSION 1
+#define METADATA_CLASSES 128  // classes in the summary mask, the last one stands for it and above
+#define METADATA_PENDING 60   // seconds kept for a file yet to open, covers the event pre-roll
+
+// Per-second detections of a recording, in a sidecar next to it with the METADATA_EXT extension.
+// Little endian: a metadata_header_t, then one record per second with detections, in time order:
+//   u16 offset   seconds from the start of the recording
+//   u8  classes  u8 tracks
+//   classes x { u8 class, u8 count }  most boxes of the class in one frame of that second
+//   tracks  x u32 id                  tracker ids seen in that second
+// Classes above 255 count as 255 and counts stop at 255. Each closed sidecar adds a line
+//   "name start end mask"
+// to METADATA_SUMMARY in the directory, name being the recording, start and end in seconds since
+// the epoch and mask the classes seen, as 32 hex digits with class 0 in the lowest bit, so a
+// search opens only the sidecars that can match.
+struct __attribute__((packed)) metadata_header_t {
+    char magic[4];
+    uint8_t version;
+    uint8_t reserved[3];
+    int64_t start;      // seconds since the epoch
+    uint32_t duration;  // seconds, written on close
+    uint32_t records;   // written on close
+    uint64_t mask[2];   // classes seen, written on close
+};
+
+class MetadataWriter {
+public:
+    MetadataWriter();
+    ~MetadataWriter();
+
+    MetadataWriter(const MetadataWriter&)            = delete;
+    MetadataWriter& operator=(const MetadataWriter&) = delete;
+
+    // the sidecar of the recording at path, whose first frame was captured at base
+    bool open(const std::string& path, ma_tick_t base);
+    // returns the sidecar's size, 0 when none was open
+    size_t close();
+    bool opened() const;
+    std::string path() const;
+
+    // boxes of a frame captured at timestamp, tracks their tracker ids when tracking
+    void add(ma_tick_t timestamp, const std::vector<ma_bbox_t>& boxes, const std::vector<int>& tracks);
+
+    // drops the summary lines of sidecars that are gone, run before writing to a directory
+    static void prune(const std::string& dir);
+
+    json stats();
+
+private:
+    struct record_t {
+        int64_t second;  // of the tick clock
+        std::vector<std::pair<uint8_t, uint8_t>> counts;
+        std::vector<uint32_t> tracks;
+    };
+
+    void finish();
+    void write(const record_t& record);
+
+    mutable Mutex mutex_;
+    FILE* file_;
+    std::string path_;
+    std::string recording_;
+    metadata_header_t header_;
+    int64_t base_;  // second of the tick clock at the start of the recording
+    size_t size_;
+    record_t current_;
+    std::deque<record_t> pending_;
+    uint64_t files_;
+    uint64_t records_;
+    uint64_t bytes_;
+};
+
+}  // namespace ma::node
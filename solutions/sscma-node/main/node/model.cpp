@@ -1,8 +1,10 @@
 #include <unistd.h>
 
-#include <opencv2/opencv.hpp>
-namespace cv2 = cv;
+#include <optional>
+#include <set>
 
+#include "encoding.h"
+#include "mask.h"
 #include "model.h"
 
 namespace ma::node {
@@ -14,6 +16,14 @@ static constexpr char TAG[] = "ma::node::model";
 
 #define DEFAULT_MODEL "/userdata/Models/model.cvimodel"
 
+// the motion gate only needs a thumbnail
+#define MOTION_WIDTH  160
+#define MOTION_HEIGHT 96
+
+// websocket ports held by model nodes, each takes the first free one from the configured port up
+static Mutex ws_ports_mutex;
+static std::set<int> ws_ports;
+
 ModelNode::ModelNode(std::string id)
     : Node("model", id),
       uri_(""),
@@ -21,19 +31,33 @@ ModelNode::ModelNode(std::string id)
       output_(false),
       trace_(false),
       counting_(false),
+      mask_mode_("contour"),
+      encoding_(MSG_ENCODING_JSON),
       count_(0),
       algorithm_(0),
       engine_(nullptr),
       model_(nullptr),
       thread_(nullptr),
+      publisher_(nullptr),
+      results_(nullptr),
+      pipeline_(0),
       raw_frame_(1),
       jpeg_frame_(1),
+      motion_frame_(1),
       websocket_(true),
+      ws_port_(-1),
+      ws_config_(),
       transport_(nullptr),
       camera_(nullptr),
+      raw_chn_(-1),
+      motion_chn_(-1),
       preview_width_(640),
       preview_height_(640),
-      preview_fps_(30) {}
+      preview_fps_(30),
+      priority_(0),
+      weight_(1),
+      fps_(0),
+      skipped_(0) {}
 
 ModelNode::~ModelNode() {
     onDestroy();
@@ -47,7 +71,11 @@ void ModelNode::threadEntry() {
     int32_t height        = 0;
     int32_t target_width  = 0;
     int32_t target_height = 0;
+    ma_tick_t due         = 0;
     std::vector<std::string> labels;
+    std::vector<ma_bbox_t> detected;
+    std::vector<mask_point_t> points;
+    std::vector<uint32_t> counts;
 
     server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "enabled"}, {"code", MA_OK}, {"data", enabled_.load()}}));
 
@@ -56,29 +84,78 @@ void ModelNode::threadEntry() {
         if (!raw_frame_.fetch(reinterpret_cast<void**>(&raw), Tick::fromSeconds(2))) {
             continue;
         }
-        if (debug_ && !jpeg_frame_.fetch(reinterpret_cast<void**>(&jpeg), Tick::fromSeconds(2))) {
+        // the config control may switch it, a frame sticks to the value it started with
+        const bool debug = debug_.load();
+        if (debug && !jpeg_frame_.fetch(reinterpret_cast<void**>(&jpeg), Tick::fromSeconds(2))) {
             raw->release();
             continue;
         }
 
         if (!enabled_) {
             raw->release();
-            if (debug_) {
+            if (debug) {
+                jpeg->release();
+            }
+            continue;
+        }
+
+        int32_t fps = fps_.load();
+        if (fps > 0) {
+            // leave the TPU to the other models instead of running above the target rate
+            ma_tick_t now    = Tick::current();
+            ma_tick_t period = Tick::fromMilliseconds(1000 / fps);
+            if (now < due) {
+                skipped_++;
+                raw->release();
+                if (debug) {
+                    jpeg->release();
+                }
+                continue;
+            }
+            due = due + period > now ? due + period : now + period;
+        }
+        if (!governor_.admit(Tick::current())) {
+            raw->release();
+            if (debug) {
                 jpeg->release();
             }
             continue;
         }
 
-        Thread::enterCritical();
+        bool gated = motion_.enabled();
+        if (gated && !moved(raw) && !last_reply_.is_null()) {
+            // nothing moved since the last run, its result still holds
+            json reply              = last_reply_;
+            reply["data"]["count"]  = ++count_;
+            reply["data"]["stale"]  = true;
+            reply["data"]["motion"] = motion_.level();
+            reply["data"]["perf"]   = json::array();
+            if (model_->getOutputType() == MA_OUTPUT_TYPE_BBOX) {
+                notify(reply, raw->timestamp, last_boxes_);
+            }
+            raw->release();
+            emit(reply, debug ? jpeg : nullptr);
+            if (debug && !governor_.enabled()) {
+                Thread::sleep(Tick::fromMilliseconds(100));
+            }
+            continue;
+        }
+
+        // raw points into VPSS memory, keep the pipeline up until it is released; config_mutex_
+        // keeps thresholds, tracker and counter steady against the config control until the
+        // results are built, publishing and pacing run without it
+        std::shared_lock<std::shared_mutex> pipeline(CameraNode::pipeline());
+        std::optional<Guard> config_guard(std::in_place, config_mutex_);
 
         ma_tick_t start = Tick::current();
+        uint64_t cpu_us = RateGovernor::threadCpuMicroseconds();
 
         json reply       = json::object({{"type", MA_MSG_TYPE_EVT}, {"name", "invoke"}, {"code", MA_OK}, {"data", {{"count", ++count_}}}});
         float scale_h    = 1.0;
         float scale_w    = 1.0;
         int32_t offset_x = 0;
         int32_t offset_y = 0;
-        if (debug_) {
+        if (debug) {
             width  = jpeg->img.width;
             height = jpeg->img.height;
         } else {
@@ -107,6 +184,11 @@ void ModelNode::threadEntry() {
 
 
         tensor.data.data = reinterpret_cast<void*>(raw->img.data);
+
+        ma_tick_t stamp = raw->timestamp;
+
+        // held from input binding until run() returns, post-processing runs off the TPU
+        TpuScheduler::Grant tpu(id_);
         engine_->setInput(0, tensor);
         model_->setPreprocessDone([this, raw](void* ctx) { raw->release(); });
 
@@ -115,6 +197,7 @@ void ModelNode::threadEntry() {
         if (model_->getOutputType() == MA_OUTPUT_TYPE_BBOX) {
             Detector* detector     = static_cast<Detector*>(model_);
             err                    = detector->run(nullptr);
+            tpu.release();
             auto _results          = detector->getResults();
             reply["data"]["boxes"] = json::array();
             std::vector<ma_bbox_t> _bboxes;
@@ -161,9 +244,11 @@ void ModelNode::threadEntry() {
                 reply["data"]["lines"]  = json::array();
                 reply["data"]["lines"].push_back(counter_.getSplitter());
             }
+            detected = std::move(_bboxes);
         } else if (model_->getOutputType() == MA_OUTPUT_TYPE_CLASS) {
             Classifier* classifier   = static_cast<Classifier*>(model_);
             err                      = classifier->run(nullptr);
+            tpu.release();
             auto _results            = classifier->getResults();
             reply["data"]["classes"] = json::array();
             for (auto& result : _results) {
@@ -177,6 +262,7 @@ void ModelNode::threadEntry() {
         } else if (model_->getOutputType() == MA_OUTPUT_TYPE_KEYPOINT) {
             PoseDetector* pose_detector = static_cast<PoseDetector*>(model_);
             err                         = pose_detector->run(nullptr);
+            tpu.release();
             auto _results               = pose_detector->getResults();
             reply["data"]["keypoints"]  = json::array();
             for (auto& result : _results) {
@@ -200,6 +286,7 @@ void ModelNode::threadEntry() {
         } else if (model_->getOutputType() == MA_OUTPUT_TYPE_SEGMENT) {
             Segmentor* segmentor      = static_cast<Segmentor*>(model_);
             err                       = segmentor->run(nullptr);
+            tpu.release();
             auto _results             = segmentor->getResults();
             reply["data"]["segments"] = json::array();
             for (auto& result : _results) {
@@ -215,33 +302,25 @@ void ModelNode::threadEntry() {
                     reply["data"]["labels"].push_back(std::string("N/A-" + std::to_string(result.box.target)));
                 }
 
-                cv2::Mat maskImage(result.mask.height, result.mask.width, CV_8UC1, cv2::Scalar(0));
-
-                for (int i = 0; i < result.mask.height; ++i) {
-                    for (int j = 0; j < result.mask.width; ++j) {
-                        if (result.mask.data[i * result.mask.width / 8 + j / 8] & (1 << (j % 8))) {
-                            maskImage.at<uchar>(i, j) = 255;
-                        }
-                    }
-                }
-
-                std::vector<std::vector<cv2::Point>> contours;
-                std::vector<cv2::Vec4i> hierarchy;
-                cv2::findContours(maskImage, contours, hierarchy, cv2::RETR_EXTERNAL, cv2::CHAIN_APPROX_SIMPLE);
-
-                auto maxContour = std::max_element(contours.begin(), contours.end(), [](std::vector<cv2::Point>& a, std::vector<cv2::Point>& b) { return a.size() < b.size(); });
-
+                // straight from the packed mask, mask pixels map onto the letterboxed square
+                float w_scale = target_width / static_cast<float>(result.mask.width);
+                float h_scale = target_height / static_cast<float>(result.mask.height);
                 std::vector<uint16_t> contour;
-                if (maxContour != contours.end()) {
-                    contour.reserve(maxContour->size() * 2);
-                    float w_scale = width * scale_w / result.mask.width;
-                    float h_scale = target_height / result.mask.height;
-                    for (auto& c : *maxContour) {
-                        contour.push_back(static_cast<uint16_t>(c.x * w_scale + offset_x));
-                        contour.push_back(static_cast<uint16_t>(c.y * h_scale + offset_y));
+                if (mask_mode_ != "rle") {
+                    maskContour(result.mask.data, result.mask.width, result.mask.height, points);
+                    contour.reserve(points.size() * 2);
+                    for (auto& p : points) {
+                        contour.push_back(static_cast<uint16_t>(p.x * w_scale + offset_x));
+                        contour.push_back(static_cast<uint16_t>(p.y * h_scale + offset_y));
                     }
                 }
-                reply["data"]["segments"].push_back({box, contour});
+                if (mask_mode_ == "contour") {
+                    reply["data"]["segments"].push_back({box, contour});
+                } else {
+                    maskRLE(result.mask.data, result.mask.width, result.mask.height, counts);
+                    json rle = {{"size", {result.mask.height, result.mask.width}}, {"counts", counts}, {"rect", {offset_x, offset_y, target_width, target_height}}};
+                    reply["data"]["segments"].push_back({box, contour, rle});
+                }
             }
         }
 
@@ -250,31 +329,204 @@ void ModelNode::threadEntry() {
 
         reply["data"]["perf"].push_back({_perf.preprocess, _perf.inference, _perf.postprocess});
 
-        if (debug_) {
-            char* base64   = new char[4 * ((jpeg->img.size + 2) / 3 + 2)];
-            int base64_len = 4 * ((jpeg->img.size + 2) / 3 + 2);
-            ma::utils::base64_encode(jpeg->img.data, jpeg->img.size, base64, &base64_len);
-            reply["data"]["image"] = std::string(base64, base64_len);
-            delete[] base64;
-            jpeg->release();
-        } else {
-            reply["data"]["image"] = "";
+        if (model_->getOutputType() == MA_OUTPUT_TYPE_BBOX) {
+            notify(reply, stamp, detected);
+            if (gated) {
+                last_boxes_.swap(detected);
+            }
+            detected.clear();
         }
 
-        if (websocket_) {
-            transport_->send(reinterpret_cast<const char*>(reply.dump().c_str()), reply.dump().size());
-        }
-        if (!output_) {
-            reply["data"]["image"] = "";
+        pipeline.unlock();
+        config_guard.reset();
+
+        if (gated) {
+            reply["data"]["stale"]  = false;
+            reply["data"]["motion"] = motion_.level();
+            last_reply_             = reply;
+        } else if (!last_reply_.is_null()) {
+            last_reply_ = nullptr;
+            last_boxes_.clear();
         }
-        server_->response(id_, reply);
+
+        emit(reply, debug ? jpeg : nullptr);
 
         ma_tick_t end = Tick::current();
-        if (debug_ && (end - start < Tick::fromMilliseconds(100))) {
+        governor_.update(end, end - stamp, RateGovernor::threadCpuMicroseconds() - cpu_us);
+        if (governor_.changed()) {
+            server_->response(id_, json::object({{"type", MA_MSG_TYPE_EVT}, {"name", "governor"}, {"code", MA_OK}, {"data", governor_.stats()}}));
+        }
+        // without a budget the preview keeps its fixed pace
+        if (debug && !governor_.enabled() && (end - start < Tick::fromMilliseconds(100))) {
             Thread::sleep(Tick::fromMilliseconds(100) - (end - start));
         }
+    }
+}
+
+void ModelNode::emit(json& reply, videoFrame* jpeg) {
+    if (pipeline_ > 0) {
+        // serialisation and publishing overlap the next inference, one thread keeps results in order
+        result_t* result = new result_t{std::move(reply), jpeg, Tick::current()};
+        while (!results_->post(result, Tick::fromMilliseconds(100))) {
+            if (!started_) {
+                discard(result);
+                break;
+            }
+        }
+    } else {
+        publish(reply, jpeg);
+    }
+}
+
+bool ModelNode::moved(videoFrame* raw) {
+    videoFrame* thumb = nullptr;
+    // the thumbnail comes out of the same VPSS pass, give its callback a moment
+    if (motion_chn_ >= 0 && !motion_frame_.fetch(reinterpret_cast<void**>(&thumb), Tick::fromMilliseconds(10))) {
+        thumb = nullptr;
+    }
+
+    std::shared_lock<std::shared_mutex> pipeline(CameraNode::pipeline());
+    videoFrame* frame = thumb != nullptr ? thumb : raw;
+    bool rgb          = thumb == nullptr;
+    // NV21 keeps the Y plane first, its rows padded like the chroma rows below
+    int32_t stride = rgb ? frame->img.size / frame->img.height : frame->img.size * 2 / (frame->img.height * 3);
+    uint8_t* data  = frame->img.data;
+    if (frame->img.physical) {
+        data = static_cast<uint8_t*>(CVI_SYS_Mmap(reinterpret_cast<CVI_U64>(frame->img.data), frame->img.size));
+    }
+
+    bool run = true;
+    if (data != nullptr) {
+        run = motion_.update(data, frame->img.width, frame->img.height, stride, rgb, Tick::current());
+        if (frame->img.physical) {
+            CVI_SYS_Munmap(data, frame->img.size);
+        }
+    } else {
+        motion_.reset();
+    }
+
+    if (thumb != nullptr) {
+        thumb->release();
+    }
+    return run;
+}
+
+void ModelNode::preview(const json& reply, videoFrame* jpeg) {
+    static thread_local std::string results;
+    encode(reply, encoding_, results);
+
+    preview_header_t header = {};
+    header.magic            = PREVIEW_MAGIC;
+    header.version          = PREVIEW_VERSION;
+    header.flags            = encoding_;
+    header.size             = sizeof(preview_header_t);
+    header.id               = reply["data"].value("count", 0u);
+    header.image            = jpeg != nullptr ? jpeg->img.size : 0;
+    header.results          = results.size();
+    if (reply["data"].value("stale", false)) {
+        header.flags |= PREVIEW_FLAG_STALE;
+    }
+
+    const char* parts[] = {reinterpret_cast<const char*>(&header), jpeg != nullptr ? reinterpret_cast<const char*>(jpeg->img.data) : nullptr, results.data()};
+    size_t lengths[]    = {sizeof(preview_header_t), header.image, header.results};
+    transport_->send(parts, lengths, 3);
+}
+
+void ModelNode::publish(json& reply, videoFrame* jpeg) {
+    bool binary = encoding_ != MSG_ENCODING_JSON;
+    bool framed = websocket_ && transport_->clients(true) > 0;
+    bool legacy = websocket_ && transport_->clients(false) > 0;
+
+    // base64 is only needed for JSON consumers of the image
+    std::string image;
+    if (jpeg != nullptr && (legacy || (output_ && !binary))) {
+        char* base64   = new char[4 * ((jpeg->img.size + 2) / 3 + 2)];
+        int base64_len = 4 * ((jpeg->img.size + 2) / 3 + 2);
+        ma::utils::base64_encode(jpeg->img.data, jpeg->img.size, base64, &base64_len);
+        image.assign(base64, base64_len);
+        delete[] base64;
+    }
+
+    // the legacy preview keeps the nested JSON layout, labels included, whatever the encoding
+    if (legacy) {
+        static thread_local std::string payload;
+        reply["data"]["image"] = image;
+        encode(reply, MSG_ENCODING_JSON, payload);
+        transport_->send(payload.c_str(), payload.size());
+        reply["data"].erase("image");
+    }
+    if (binary) {
+        compact(reply);
+    }
+
+    // framed clients take the JPEG as it is, before any image lands in the reply
+    if (framed) {
+        preview(reply, jpeg);
+    }
+
+    if (!output_ || jpeg == nullptr) {
+        reply["data"]["image"] = "";
+    } else if (binary) {
+        reply["data"]["image"] = json::binary(std::vector<uint8_t>(jpeg->img.data, jpeg->img.data + jpeg->img.size));
+    } else {
+        reply["data"]["image"] = std::move(image);
+    }
+    if (jpeg != nullptr) {
+        jpeg->release();
+    }
+    server_->response(id_, reply, encoding_);
+}
+
+msg_encoding_t ModelNode::encoding() const {
+    return encoding_;
+}
+
+void ModelNode::attachDetections(MessageBox* box) {
+    Guard guard(listeners_mutex_);
+    listeners_.push_back(box);
+}
+
+void ModelNode::detachDetections(MessageBox* box) {
+    Guard guard(listeners_mutex_);
+    listeners_.erase(std::remove(listeners_.begin(), listeners_.end(), box), listeners_.end());
+}
+
+void ModelNode::notify(const json& reply, ma_tick_t timestamp, const std::vector<ma_bbox_t>& boxes) {
+    Guard guard(listeners_mutex_);
+    for (auto box : listeners_) {
+        detection_t* detection = new detection_t{timestamp, boxes, reply};
+        // a busy consumer skips the frame instead of stalling inference
+        if (!box->post(detection, Tick::fromMilliseconds(0))) {
+            delete detection;
+        }
+    }
+}
+
+void ModelNode::discard(result_t* result) {
+    if (result->jpeg != nullptr) {
+        result->jpeg->release();
+    }
+    delete result;
+}
+
+void ModelNode::threadPublishEntry() {
+    result_t* result = nullptr;
+    int64_t last     = 0;  // publish time of the previous result, ms
 
-        Thread::exitCritical();
+    // drain what inference queued before it stopped
+    while (started_ || results_->fetch(reinterpret_cast<void**>(&result), Tick::fromMilliseconds(0))) {
+        if (result == nullptr && !results_->fetch(reinterpret_cast<void**>(&result), Tick::fromMilliseconds(100))) {
+            continue;
+        }
+        ma_tick_t begin = Tick::current();
+        auto& perf      = result->reply["data"]["perf"][0];
+        perf.push_back(Tick::toMicroseconds(begin - result->queued) / 1000);
+        perf.push_back(last);
+        publish(result->reply, result->jpeg);
+        result->jpeg = nullptr;
+        discard(result);
+        result = nullptr;
+        last   = Tick::toMicroseconds(Tick::current() - begin) / 1000;
     }
 }
 
@@ -282,6 +534,10 @@ void ModelNode::threadEntryStub(void* obj) {
     reinterpret_cast<ModelNode*>(obj)->threadEntry();
 }
 
+void ModelNode::threadPublishEntryStub(void* obj) {
+    reinterpret_cast<ModelNode*>(obj)->threadPublishEntry();
+}
+
 ma_err_t ModelNode::onCreate(const json& config) {
     ma_err_t err = MA_OK;
     Guard guard(mutex_);
@@ -358,8 +614,15 @@ ma_err_t ModelNode::onCreate(const json& config) {
             if (config.contains("debug")) {
                 output_ = config["debug"].get<bool>();
             }
-            if (config.contains("websocket") && config["websocket"].is_boolean()) {
-                websocket_ = config["websocket"].get<bool>();
+            // depth of the inference/publish pipeline, 0 runs both in one thread
+            if (config.contains("pipeline") && config["pipeline"].is_number_integer()) {
+                pipeline_ = std::clamp(config["pipeline"].get<int>(), 0, 3);
+                if (pipeline_ == 1) {
+                    pipeline_ = 0;
+                }
+            }
+            if (config.contains("websocket")) {
+                websocketConfig(config["websocket"], websocket_, ws_config_);
             }
             if (websocket_ || output_) {
                 debug_ = true;
@@ -390,11 +653,43 @@ ma_err_t ModelNode::onCreate(const json& config) {
             if (config.contains("previewFps") && config["previewFps"].is_number_integer()) {
                 preview_fps_ = config["previewFps"].get<int32_t>();
             }
+            if (config.contains("priority") && config["priority"].is_number_integer()) {
+                priority_ = config["priority"].get<int>();
+            }
+            if (config.contains("weight") && config["weight"].is_number_integer()) {
+                weight_ = config["weight"].get<int>();
+            }
+            if (config.contains("fps") && config["fps"].is_number_integer()) {
+                fps_ = std::max(config["fps"].get<int32_t>(), 0);
+            }
+            if (config.contains("governor")) {
+                governor_.configure(config["governor"]);
+            }
+            if (config.contains("motion")) {
+                motion_.configure(config["motion"]);
+            }
+            if (config.contains("encoding") && config["encoding"].is_string() && !encodingFromName(config["encoding"].get<std::string>(), encoding_)) {
+                MA_THROW(Exception(MA_EINVAL, "Unknown encoding " + config["encoding"].get<std::string>()));
+            }
+            if (config.contains("mask") && config["mask"].is_string()) {
+                std::string mode = config["mask"].get<std::string>();
+                if (mode == "contour" || mode == "rle" || mode == "both") {
+                    mask_mode_ = mode;
+                }
+            }
         }
 
         if (websocket_) {
-            TransportWebSocket::Config ws_config = {.port = 8090};
+            TransportWebSocket::Config ws_config = ws_config_;
             MA_STORAGE_GET_POD(server_->getStorage(), MA_STORAGE_KEY_WS_PORT, ws_config.port, 8090);
+            {
+                Guard ports_guard(ws_ports_mutex);
+                while (ws_ports.count(ws_config.port)) {
+                    ws_config.port++;
+                }
+                ws_ports.insert(ws_config.port);
+                ws_port_ = ws_config.port;
+            }
             transport_ = new TransportWebSocket();
             if (transport_ != nullptr) {
                 transport_->init(&ws_config);
@@ -408,6 +703,14 @@ ma_err_t ModelNode::onCreate(const json& config) {
         if (thread_ == nullptr) {
             MA_THROW(Exception(MA_ENOMEM, "Not enough memory"));
         }
+
+        if (pipeline_ > 0) {
+            results_   = new MessageBox(pipeline_ - 1);
+            publisher_ = new Thread((type_ + "#" + id_ + "#pub").c_str(), &ModelNode::threadPublishEntryStub, this);
+            if (results_ == nullptr || publisher_ == nullptr) {
+                MA_THROW(Exception(MA_ENOMEM, "Not enough memory"));
+            }
+        }
     }
     MA_CATCH(ma::Exception & e) {
         if (engine_ != nullptr) {
@@ -422,6 +725,19 @@ ma_err_t ModelNode::onCreate(const json& config) {
             delete thread_;
             thread_ = nullptr;
         }
+        if (publisher_ != nullptr) {
+            delete publisher_;
+            publisher_ = nullptr;
+        }
+        if (results_ != nullptr) {
+            delete results_;
+            results_ = nullptr;
+        }
+        if (ws_port_ >= 0) {
+            Guard ports_guard(ws_ports_mutex);
+            ws_ports.erase(ws_port_);
+            ws_port_ = -1;
+        }
         MA_THROW(e);
     }
     MA_CATCH(std::exception & e) {
@@ -437,9 +753,24 @@ ma_err_t ModelNode::onCreate(const json& config) {
             delete thread_;
             thread_ = nullptr;
         }
+        if (publisher_ != nullptr) {
+            delete publisher_;
+            publisher_ = nullptr;
+        }
+        if (results_ != nullptr) {
+            delete results_;
+            results_ = nullptr;
+        }
+        if (ws_port_ >= 0) {
+            Guard ports_guard(ws_ports_mutex);
+            ws_ports.erase(ws_port_);
+            ws_port_ = -1;
+        }
         MA_THROW(Exception(MA_EINVAL, e.what()));
     }
 
+    TpuScheduler::instance().join(id_, priority_, weight_);
+
     created_ = true;
 
     server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "create"}, {"code", MA_OK}, {"data", info_}}));
@@ -447,33 +778,76 @@ ma_err_t ModelNode::onCreate(const json& config) {
     return MA_OK;
 }
 
+void ModelNode::applyConfig(const json& data) {
+    Guard guard(config_mutex_);
+    if (data.contains("tscore") && data["tscore"].is_number()) {
+        model_->setConfig(MA_MODEL_CFG_OPT_THRESHOLD, data["tscore"].get<float>());
+    }
+    if (data.contains("tiou") && data["tiou"].is_number()) {
+        model_->setConfig(MA_MODEL_CFG_OPT_NMS, data["tiou"].get<float>());
+    }
+    if (data.contains("topk") && data["topk"].is_number_integer()) {
+        model_->setConfig(MA_MODEL_CFG_OPT_TOPK, data["topk"].get<int32_t>());
+    }
+    if (data.contains("debug") && data["debug"].is_boolean()) {
+        debug_ = data["debug"].get<bool>();
+    }
+    if (data.contains("trace") && data["trace"].is_boolean()) {
+        trace_ = data["trace"].get<bool>();
+        tracker_.clear();
+    }
+    if (data.contains("counting") && data["counting"].is_boolean()) {
+        counting_ = data["counting"].get<bool>();
+        counter_.clear();
+    }
+    if (data.contains("splitter") && data["splitter"].is_array()) {
+        counter_.setSplitter(data["splitter"].get<std::vector<int16_t>>());
+    }
+    if (data.contains("fps") && data["fps"].is_number_integer()) {
+        fps_ = std::max(data["fps"].get<int32_t>(), 0);
+        governor_.setLimit(fps_ > 0 ? std::min(fps_.load(), preview_fps_) : preview_fps_);
+    }
+    if (data.contains("governor")) {
+        governor_.configure(data["governor"]);
+    }
+    if (data.contains("motion")) {
+        motion_.configure(data["motion"]);
+    }
+    if (data.contains("mask") && data["mask"].is_string()) {
+        std::string mode = data["mask"].get<std::string>();
+        if (mode == "contour" || mode == "rle" || mode == "both") {
+            mask_mode_ = mode;
+        }
+    }
+    if ((data.contains("priority") && data["priority"].is_number_integer()) || (data.contains("weight") && data["weight"].is_number_integer())) {
+        priority_ = data.value("priority", priority_);
+        weight_   = data.value("weight", weight_);
+        TpuScheduler::instance().join(id_, priority_, weight_);
+    }
+}
+
+ma_err_t ModelNode::onReconfigure(const json& delta) {
+    // thresholds and post-processing switch at runtime, anything else needs a new model;
+    // so does debug, which decides the camera channels onStart() attaches
+    static const char* tunables[] = {"tscore", "tiou", "topk", "trace", "counting", "splitter", "fps", "priority", "weight", "governor", "motion", "mask"};
+    for (auto& item : delta.items()) {
+        if (item.value().is_null() || std::none_of(std::begin(tunables), std::end(tunables), [&](const char* key) { return item.key() == key; })) {
+            return MA_ENOTSUP;
+        }
+    }
+    Guard guard(mutex_);
+    if (model_ == nullptr) {
+        return MA_ENOTSUP;
+    }
+    applyConfig(delta);
+    return MA_OK;
+}
+
 ma_err_t ModelNode::onControl(const std::string& control, const json& data) {
     Guard guard(mutex_);
     ma_err_t err = MA_OK;
     if (control == "config") {
-        if (data.contains("tscore") && data["tscore"].is_number_float()) {
-            model_->setConfig(MA_MODEL_CFG_OPT_THRESHOLD, data["tscore"].get<float>());
-        }
-        if (data.contains("tiou") && data["tiou"].is_number_float()) {
-            model_->setConfig(MA_MODEL_CFG_OPT_NMS, data["tiou"].get<float>());
-        }
-        if (data.contains("topk") && data["topk"].is_number_integer()) {
-            model_->setConfig(MA_MODEL_CFG_OPT_TOPK, data["topk"].get<int32_t>());
-        }
-        if (data.contains("debug") && data["debug"].is_boolean()) {
-            debug_ = data["debug"].get<bool>();
-        }
-        if (data.contains("trace") && data["trace"].is_boolean()) {
-            trace_ = data["trace"].get<bool>();
-            tracker_.clear();
-        }
-        if (data.contains("counting") && data["counting"].is_boolean()) {
-            counting_ = data["counting"].get<bool>();
-            counter_.clear();
-        }
-        if (data.contains("splitter") && data["splitter"].is_array()) {
-            counter_.setSplitter(data["splitter"].get<std::vector<int16_t>>());
-        }
+        applyConfig(data);
         server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", control}, {"code", MA_OK}, {"data", data}}));
     } else if (control == "enabled" && data.is_boolean()) {
         bool enabled = data.get<bool>();
@@ -481,6 +855,16 @@ ma_err_t ModelNode::onControl(const std::string& control, const json& data) {
             enabled_.store(enabled);
         }
         server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", control}, {"code", MA_OK}, {"data", enabled_.load()}}));
+    } else if (control == "stats") {
+        json stats = {{"chn", raw_chn_},
+                      {"fps", fps_.load()},
+                      {"skipped", skipped_.load()},
+                      {"governor", governor_.stats()},
+                      {"motion", motion_.stats()},
+                      {"queue", raw_frame_.stats()},
+                      {"websocket", websocketStats(transport_)},
+                      {"tpu", TpuScheduler::instance().stats()}};
+        server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", control}, {"code", MA_OK}, {"data", stats}}));
     } else {
         server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", control}, {"code", MA_ENOTSUP}, {"data", "Not supported"}}));
     }
@@ -496,10 +880,20 @@ ma_err_t ModelNode::onDestroy() {
 
     onStop();
 
+    TpuScheduler::instance().leave(id_);
+
     if (thread_ != nullptr) {
         delete thread_;
         thread_ = nullptr;
     }
+    if (publisher_ != nullptr) {
+        delete publisher_;
+        publisher_ = nullptr;
+    }
+    if (results_ != nullptr) {
+        delete results_;
+        results_ = nullptr;
+    }
     if (engine_ != nullptr) {
         delete engine_;
         engine_ = nullptr;
@@ -509,7 +903,7 @@ ma_err_t ModelNode::onDestroy() {
         model_ = nullptr;
     }
     if (camera_ != nullptr) {
-        camera_->detach(CHN_RAW, &raw_frame_);
+        camera_->detach(raw_chn_, &raw_frame_);
         if (debug_) {
             camera_->detach(CHN_JPEG, &jpeg_frame_);
         }
@@ -519,6 +913,11 @@ ma_err_t ModelNode::onDestroy() {
         delete transport_;
         transport_ = nullptr;
     }
+    if (ws_port_ >= 0) {
+        Guard ports_guard(ws_ports_mutex);
+        ws_ports.erase(ws_port_);
+        ws_port_ = -1;
+    }
 
 
     created_ = false;
@@ -548,8 +947,23 @@ ma_err_t ModelNode::onStart() {
         return MA_ENOTSUP;
     }
 
-    camera_->config(CHN_RAW, img->width, img->height, preview_fps_, img->format);
-    camera_->attach(CHN_RAW, &raw_frame_);
+    // models with the same input size share a channel, another size gets the camera's extra one
+    raw_chn_ = camera_->acquire(img->width, img->height, preview_fps_, img->format, &raw_frame_);
+    if (raw_chn_ < 0) {
+        camera_ = nullptr;
+        MA_THROW(Exception(MA_EBUSY, "No raw channel left for " + std::to_string(img->width) + "x" + std::to_string(img->height)));
+        return MA_EBUSY;
+    }
+    governor_.setLimit(fps_ > 0 ? std::min(fps_.load(), preview_fps_) : preview_fps_);
+
+    if (motion_.enabled()) {
+        // a thumbnail is cheaper to compare, the raw frame is sampled when no channel is left
+        motion_chn_ = camera_->acquire(MOTION_WIDTH, MOTION_HEIGHT, preview_fps_, MA_PIXEL_FORMAT_YUV422, &motion_frame_);
+        if (motion_chn_ < 0) {
+            MA_LOGW(TAG, "no channel for the motion thumbnail, sampling the model input");
+        }
+    }
+
     if (debug_) {
         if (preview_width_ == -1 || preview_height_ == -1) {
             preview_width_  = img->width;
@@ -563,6 +977,9 @@ ma_err_t ModelNode::onStart() {
     started_ = true;
 
     thread_->start(this);
+    if (publisher_ != nullptr) {
+        publisher_->start(this);
+    }
 
     return MA_OK;
 }
@@ -577,17 +994,33 @@ ma_err_t ModelNode::onStop() {
     if (thread_ != nullptr) {
         thread_->join();
     }
+    if (publisher_ != nullptr) {
+        publisher_->join();
+    }
+    if (results_ != nullptr) {
+        result_t* result = nullptr;
+        while (results_->fetch(reinterpret_cast<void**>(&result), Tick::fromMilliseconds(0))) {
+            discard(result);
+        }
+    }
 
     if (camera_ != nullptr) {
-        camera_->detach(CHN_RAW, &raw_frame_);
+        camera_->detach(raw_chn_, &raw_frame_);
+        if (motion_chn_ >= 0) {
+            camera_->detach(motion_chn_, &motion_frame_);
+            motion_frame_.clear();
+            motion_chn_ = -1;
+        }
+        motion_.reset();
         if (debug_) {
             camera_->detach(CHN_JPEG, &jpeg_frame_);
         }
-        camera_ = nullptr;
+        camera_  = nullptr;
+        raw_chn_ = -1;
     }
     return MA_OK;
 }
 
-REGISTER_NODE_SINGLETON("model", ModelNode);
+REGISTER_NODE("model", ModelNode);
 
 }  // namespace ma::node
\ No newline at end of file
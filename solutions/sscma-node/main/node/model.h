@@ -8,9 +8,21 @@
 #include "server.h"
 
 #include "camera.h"
+#include "encoding.h"
+#include "governor.h"
+#include "motion.h"
+#include "tpu_scheduler.h"
+#include "websocket.h"
 
 namespace ma::node {
 
+// detections handed to downstream nodes, boxes as the detector returned them
+struct detection_t {
+    ma_tick_t timestamp;  // capture time of the inferred frame
+    std::vector<ma_bbox_t> boxes;
+    json reply;
+};
+
 class ModelNode : public Node {
 
 public:
@@ -22,19 +34,43 @@ public:
     ma_err_t onControl(const std::string& control, const json& data) override;
     ma_err_t onStop() override;
     ma_err_t onDestroy() override;
+    ma_err_t onReconfigure(const json& delta) override;
 
+    // a detector posts a detection_t per frame to each box, dropped when the box is full
+    void attachDetections(MessageBox* box);
+    void detachDetections(MessageBox* box);
+
+    // events of a binary encoding use the compact schema, see compact()
+    msg_encoding_t encoding() const;
 
 protected:
+    struct result_t {
+        json reply;
+        videoFrame* jpeg;  // preview attached by the publisher, may be null
+        ma_tick_t queued;
+    };
+
     void threadEntry();
+    void threadPublishEntry();
     static void threadEntryStub(void* obj);
+    static void threadPublishEntryStub(void* obj);
+    void applyConfig(const json& data);
+    void publish(json& reply, videoFrame* jpeg);
+    void preview(const json& reply, videoFrame* jpeg);
+    void discard(result_t* result);
+    void notify(const json& reply, ma_tick_t timestamp, const std::vector<ma_bbox_t>& boxes);
+    void emit(json& reply, videoFrame* jpeg);
+    bool moved(videoFrame* raw);
 
 protected:
     std::string uri_;
     int32_t times_;
     int32_t count_;
-    bool debug_;
+    std::atomic<bool> debug_;
     bool trace_;
     bool counting_;
+    std::string mask_mode_;    // segments as "contour", "rle" or "both"
+    msg_encoding_t encoding_;  // events only, responses stay JSON
     json info_;
     int algorithm_;
     Model* model_;
@@ -43,15 +79,34 @@ protected:
     Counter counter_;
     std::vector<std::string> labels_;
     Thread* thread_;
+    Thread* publisher_;
+    MessageBox* results_;  // inference -> publisher, bounded by the pipeline depth
+    int pipeline_;
     CameraNode* camera_;
-    MessageBox raw_frame_;
-    MessageBox jpeg_frame_;
+    int raw_chn_;  // raw channel granted by the camera
+    int motion_chn_;  // -1 samples the raw frame instead
+    Mutex config_mutex_;
+    FrameQueue raw_frame_;
+    FrameQueue jpeg_frame_;
+    FrameQueue motion_frame_;  // tiny NV21 frames for the motion gate
     bool websocket_;
+    int ws_port_;
     bool output_;
+    TransportWebSocket::Config ws_config_;
     TransportWebSocket* transport_;
     int32_t preview_width_;   // Preview resolution width
     int32_t preview_height_;  // Preview resolution height
     int32_t preview_fps_;     // Preview FPS
+    int priority_;            // TPU scheduling, see TpuScheduler
+    int weight_;
+    std::atomic<int32_t> fps_;  // inference rate cap, 0 runs on every frame
+    std::atomic<uint64_t> skipped_;
+    RateGovernor governor_;              // rate under a latency or CPU budget, off unless configured
+    MotionGate motion_;                  // skips inference on a static scene, off unless configured
+    json last_reply_;                    // repeated as stale while the gate is closed
+    std::vector<ma_bbox_t> last_boxes_;  // detections of last_reply_, passed on with it to the cascade nodes
+    Mutex listeners_mutex_;
+    std::vector<MessageBox*> listeners_;
 };
 
 
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cmath>
+
+#include "motion.h"
+
+namespace ma::node {
+
+static constexpr char TAG[] = "ma::node::motion";
+
+static constexpr int32_t MOTION_GRID_MAX = 32;  // columns fit a mask word
+static constexpr int32_t MOTION_SAMPLES  = 8;   // samples per block side at most
+
+MotionGate::MotionGate()
+    : enabled_(false),
+      threshold_(1.0f),
+      sensitivity_(12),
+      keepalive_(Tick::fromSeconds(5)),
+      cols_(20),
+      rows_(12),
+      last_run_(0),
+      level_(0),
+      runs_(0),
+      skipped_(0),
+      keepalives_(0) {}
+
+void MotionGate::configure(const json& config) {
+    Guard guard(mutex_);
+    enabled_ = config.is_object();
+    if (!enabled_) {
+        reference_.clear();
+        return;
+    }
+    if (config.contains("threshold") && config["threshold"].is_number()) {
+        threshold_ = std::clamp(config["threshold"].get<float>(), 0.0f, 100.0f);
+    }
+    if (config.contains("sensitivity") && config["sensitivity"].is_number_integer()) {
+        sensitivity_ = std::clamp(config["sensitivity"].get<int32_t>(), 1, 255);
+    }
+    if (config.contains("keepalive") && config["keepalive"].is_number_integer()) {
+        keepalive_ = Tick::fromMilliseconds(std::max(config["keepalive"].get<int32_t>(), 0));
+    }
+    if (config.contains("grid") && config["grid"].is_array() && config["grid"].size() == 2) {
+        cols_ = std::clamp(config["grid"][0].get<int32_t>(), 1, MOTION_GRID_MAX);
+        rows_ = std::clamp(config["grid"][1].get<int32_t>(), 1, MOTION_GRID_MAX);
+    }
+    grid_.assign(cols_ * rows_, 0);
+    mask_.assign(rows_, 0);
+    reference_.clear();
+    MA_LOGI(TAG, "threshold %.1f%% sensitivity %d grid %dx%d", threshold_, sensitivity_, cols_, rows_);
+}
+
+bool MotionGate::enabled() {
+    Guard guard(mutex_);
+    return enabled_;
+}
+
+// caller holds the lock
+void MotionGate::sample(const uint8_t* data, int32_t width, int32_t height, int32_t stride, bool rgb) {
+    for (int32_t r = 0; r < rows_; r++) {
+        int32_t y0     = r * height / rows_;
+        int32_t y1     = (r + 1) * height / rows_;
+        int32_t step_y = std::max((y1 - y0) / MOTION_SAMPLES, 1);
+        for (int32_t c = 0; c < cols_; c++) {
+            int32_t x0     = c * width / cols_;
+            int32_t x1     = (c + 1) * width / cols_;
+            int32_t step_x = std::max((x1 - x0) / MOTION_SAMPLES, 1);
+            uint32_t sum   = 0;
+            uint32_t count = 0;
+            for (int32_t y = y0; y < y1; y += step_y) {
+                const uint8_t* row = data + static_cast<size_t>(y) * stride;
+                if (rgb) {
+                    for (int32_t x = x0; x < x1; x += step_x) {
+                        const uint8_t* px = row + x * 3;
+                        sum += (77 * px[0] + 150 * px[1] + 29 * px[2]) >> 8;
+                    }
+                } else {
+                    for (int32_t x = x0; x < x1; x += step_x) {
+                        sum += row[x];
+                    }
+                }
+                count += (x1 - x0 + step_x - 1) / step_x;
+            }
+            grid_[r * cols_ + c] = count ? sum / count : 0;
+        }
+    }
+}
+
+bool MotionGate::update(const uint8_t* data, int32_t width, int32_t height, int32_t stride, bool rgb, ma_tick_t now) {
+    Guard guard(mutex_);
+    if (!enabled_) {
+        return true;
+    }
+    if (width < cols_ || height < rows_) {
+        reference_.clear();
+        return true;
+    }
+
+    sample(data, width, height, stride, rgb);
+
+    bool run = reference_.size() != grid_.size();
+    if (!run) {
+        int32_t changed = 0;
+        for (int32_t r = 0; r < rows_; r++) {
+            uint32_t bits = 0;
+            for (int32_t c = 0; c < cols_; c++) {
+                int32_t i = r * cols_ + c;
+                if (std::abs(grid_[i] - reference_[i]) > sensitivity_) {
+                    bits |= 1u << c;
+                    changed++;
+                }
+            }
+            mask_[r] = bits;
+        }
+        level_ = changed * 100.0f / (cols_ * rows_);
+        run    = level_ >= threshold_ && changed > 0;
+        if (!run && keepalive_ > 0 && now - last_run_ >= keepalive_) {
+            keepalives_++;
+            run = true;
+        }
+    }
+
+    if (run) {
+        reference_ = grid_;
+        last_run_  = now;
+        runs_++;
+    } else {
+        skipped_++;
+    }
+    return run;
+}
+
+void MotionGate::reset() {
+    Guard guard(mutex_);
+    reference_.clear();
+}
+
+float MotionGate::level() {
+    Guard guard(mutex_);
+    return std::round(level_ * 10.0f) / 10.0f;
+}
+
+json MotionGate::stats() {
+    Guard guard(mutex_);
+    uint64_t total = std::max<uint64_t>(runs_ + skipped_, 1);
+    return json::object({{"enabled", enabled_},
+                         {"grid", {cols_, rows_}},
+                         {"level", std::round(level_ * 10.0) / 10},
+                         {"mask", mask_},
+                         {"runs", runs_},
+                         {"skipped", skipped_},
+                         {"keepalives", keepalives_},
+                         {"ratio", std::round(skipped_ * 1000.0 / total) / 1000}});
+}
+
+}  // namespace ma::node
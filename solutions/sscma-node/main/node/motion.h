@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include "core/ma_core.h"
+#include "porting/ma_porting.h"
+
+namespace ma::node {
+
+// Decides whether a model has to run again: the frame is reduced to a grid of block means and
+// compared with the grid the model last ran on. The model runs when enough blocks changed or the
+// keep-alive interval ran out, otherwise its last result still holds.
+class MotionGate {
+public:
+    MotionGate();
+
+    // {"threshold": percent of blocks, "sensitivity": luma delta, "keepalive": ms, "grid": [cols, rows]},
+    // anything but an object turns the gate off
+    void configure(const json& config);
+    bool enabled();
+
+    // true when the model should run on this frame; data is a Y plane, or packed RGB888 when rgb is set
+    bool update(const uint8_t* data, int32_t width, int32_t height, int32_t stride, bool rgb, ma_tick_t now);
+    // a run the gate did not ask for, e.g. without a frame to compare
+    void reset();
+
+    // share of changed blocks in the last frame, percent
+    float level();
+    json stats();
+
+private:
+    void sample(const uint8_t* data, int32_t width, int32_t height, int32_t stride, bool rgb);
+
+    Mutex mutex_;
+    bool enabled_;
+    float threshold_;
+    int32_t sensitivity_;
+    ma_tick_t keepalive_;
+    int32_t cols_;
+    int32_t rows_;
+    std::vector<uint8_t> grid_;
+    std::vector<uint8_t> reference_;  // grid at the last run
+    std::vector<uint32_t> mask_;      // changed blocks of the last frame, a bit per column
+    ma_tick_t last_run_;
+    float level_;
+    uint64_t runs_;
+    uint64_t skipped_;
+    uint64_t keepalives_;
+};
+
+}  // namespace ma::node
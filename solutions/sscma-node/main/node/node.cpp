@@ -9,6 +9,10 @@ Node::Node(std::string type, std::string id) : mutex_(), id_(std::move(id)), typ
 
 Node::~Node() = default;
 
+ma_err_t Node::onReconfigure(const json& delta) {
+    return MA_ENOTSUP;
+}
+
 const std::string& Node::id() const {
     return id_;
 }
@@ -22,8 +26,121 @@ const std::string Node::dump() const {
 }
 
 Mutex NodeFactory::m_mutex;
+Mutex NodeFactory::m_nodes_mutex;
 std::unordered_map<std::string, Node*> NodeFactory::m_nodes;
+std::unordered_map<std::string, std::vector<std::string>> NodeFactory::m_referrers;
+std::unordered_map<std::string, size_t> NodeFactory::m_pending;
+std::unordered_map<std::string, json> NodeFactory::m_specs;
+
+// Readiness is tracked per node as a count of unmet conditions: every dependency must exist and every
+// dependent must be started. Each condition is settled once by an event (node created, node started),
+// routed through m_referrers, so resolving a whole flow costs O(V+E) regardless of creation order.
+
+size_t NodeFactory::unmet(Node* n) {
+    size_t count = 0;
+    for (auto& dep : n->dependencies_) {
+        if (dep.second == nullptr) {
+            count++;
+        }
+    }
+    for (auto& dep : n->dependents_) {
+        if (dep.second == nullptr || !dep.second->started_) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool NodeFactory::cyclic(Node* n) {
+    // start order follows dependents, a path back to n would never become ready
+    std::unordered_map<std::string, bool> visited;
+    std::vector<Node*> stack{n};
+    while (!stack.empty()) {
+        Node* cur = stack.back();
+        stack.pop_back();
+        for (auto& dep : cur->dependents_) {
+            if (dep.first == n->id_) {
+                return true;
+            }
+            Node* next = dep.second;
+            if (next == nullptr || visited[dep.first]) {
+                continue;
+            }
+            visited[dep.first] = true;
+            stack.push_back(next);
+        }
+    }
+    return false;
+}
+
+void NodeFactory::notifyStarted(Node* n, std::vector<Node*>& ready) {
+    auto it = m_referrers.find(n->id_);
+    if (it == m_referrers.end()) {
+        return;
+    }
+    for (auto& id : it->second) {
+        auto ref = m_nodes.find(id);
+        if (ref == m_nodes.end() || ref->second->started_ || !ref->second->dependents_.count(n->id_)) {
+            continue;
+        }
+        if (m_pending[id] > 0 && --m_pending[id] == 0) {
+            ready.push_back(ref->second);
+        }
+    }
+}
 
+void NodeFactory::startReady(std::vector<Node*> ready, NodeServer* server) {
+    while (!ready.empty()) {
+        // nodes in one wave do not wait on each other, start them side by side
+        std::vector<ma_err_t> errors(ready.size(), MA_OK);
+        std::vector<std::string> reasons(ready.size());
+        std::vector<std::thread> workers;
+        auto start = [&](size_t i) {
+            MA_LOGI(TAG, "start node: %s(%s)", ready[i]->type_.c_str(), ready[i]->id_.c_str());
+            // runs on its own thread, so nothing may escape; a node that did not start holds back its dependents
+            MA_TRY {
+                errors[i] = ready[i]->onStart();
+                if (errors[i] != MA_OK) {
+                    reasons[i] = "start returned " + std::to_string(errors[i]);
+                }
+            }
+            MA_CATCH(Exception & e) {
+                errors[i]  = e.err();
+                reasons[i] = e.what();
+            }
+            MA_CATCH(std::exception & e) {
+                errors[i]  = MA_EINVAL;
+                reasons[i] = e.what();
+            }
+            MA_CATCH(...) {
+                errors[i]  = MA_EINVAL;
+                reasons[i] = "unknown exception";
+            }
+        };
+        for (size_t i = 1; i < ready.size(); i++) {
+            workers.emplace_back(start, i);
+        }
+        start(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        std::vector<Node*> next;
+        for (size_t i = 0; i < ready.size(); i++) {
+            Node* n = ready[i];
+            if (errors[i] != MA_OK) {
+                MA_LOGE(TAG, "failed to start node: %s(%s) %s", n->type_.c_str(), n->id_.c_str(), reasons[i].c_str());
+                if (server) {
+                    server->response(n->id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "start"}, {"code", errors[i]}, {"data", reasons[i]}}));
+                }
+                continue;
+            }
+            m_pending.erase(n->id_);
+            notifyStarted(n, next);
+        }
+        ready.swap(next);
+    }
+}
 
 Node* NodeFactory::create(const std::string id, const std::string type, const json& data, NodeServer* server) {
 
@@ -61,9 +178,6 @@ Node* NodeFactory::create(const std::string id, const std::string type, const js
         return nullptr;
     }
     n->server_ = server;
-    if (MA_OK != n->onCreate(data["config"])) {
-        return nullptr;
-    }
 
     // set dependencies
     if (data.contains("dependencies")) {
@@ -79,87 +193,60 @@ Node* NodeFactory::create(const std::string id, const std::string type, const js
         }
     }
 
-    m_nodes[id] = n;
+    if (m_referrers.count(id) && cyclic(n)) {
+        delete n;
+        MA_THROW(Exception(MA_EINVAL, "Dependency cycle: " + id));
+        return nullptr;
+    }
 
-    // check dependencies
-    for (auto node : m_nodes) {
-        if (node.second->started_) {  // not started yet
-            MA_LOGV(TAG, "skip check node: %s(%s) %s", node.second->type_.c_str(), node.second->id_.c_str(), id.c_str());
-            continue;
-        }
-        bool ready = true;
-        MA_LOGV(TAG, "check node: %s(%s) %s", node.second->type_.c_str(), node.second->id_.c_str(), id.c_str());
-        for (auto& dep : node.second->dependencies_) {
-            MA_LOGV(TAG, "dependencies: %s %p", dep.first.c_str(), dep.second);
-            if (dep.second == nullptr && dep.first == id) {
-                MA_LOGV(TAG, "dependencies %s ready: %s(%s)", dep.first.c_str(), node.second->type_.c_str(), node.second->id_.c_str());
-                dep.second = n;
-            }
-            if (dep.second == nullptr) {
-                MA_LOGV(TAG, "dependencies %s not ready: %s(%s)", dep.first.c_str(), node.second->type_.c_str(), node.second->id_.c_str());
-                ready = false;
-            }
-        }
-        for (auto& dep : node.second->dependents_) {
-            MA_LOGV(TAG, "dependents: %s %p", dep.first.c_str(), dep.second);
-            if (dep.second == nullptr && dep.first == id) {
-                MA_LOGV(TAG, "dependents %s ready: %s(%s)", dep.first.c_str(), node.second->type_.c_str(), node.second->id_.c_str());
-                dep.second = n;
-            }
-            if (dep.second == nullptr || !dep.second->started_) {
-                MA_LOGV(TAG, "dependents %s not ready: %s(%s) ", dep.first.c_str(), node.second->type_.c_str(), node.second->id_.c_str());
-                ready = false;
-            }
+    if (MA_OK != n->onCreate(data["config"])) {
+        return nullptr;
+    }
+
+    {
+        Guard nodes_guard(m_nodes_mutex);
+        m_nodes[id] = n;
+    }
+    m_specs[id] = normalize(_type, data);
+    for (auto& dep : n->dependencies_) {
+        m_referrers[dep.first].push_back(id);
+    }
+    for (auto& dep : n->dependents_) {
+        if (!n->dependencies_.count(dep.first)) {
+            m_referrers[dep.first].push_back(id);
         }
-        if (ready) {
-            MA_LOGI(TAG, "start node: %s(%s)", node.second->type_.c_str(), node.second->id_.c_str());
-            MA_TRY {
-                node.second->onStart();
-            }
-            MA_CATCH(Exception & e) {
-                MA_LOGE(TAG, "failed to start node: %s(%s) %s", node.second->type_.c_str(), node.second->id_.c_str(), e.what());
-                Thread::sleep(Tick::fromMilliseconds(20));
-                server->response(node.first, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "start"}, {"code", e.err()}, {"data", e.what()}}));
+    }
+
+    std::vector<Node*> ready;
+    m_pending[id] = unmet(n);
+    if (m_pending[id] == 0) {
+        ready.push_back(n);
+    }
+
+    // settle the nodes that were waiting for this one to exist
+    auto refs = m_referrers.find(id);
+    if (refs != m_referrers.end()) {
+        for (auto& ref_id : refs->second) {
+            auto ref = m_nodes.find(ref_id);
+            if (ref == m_nodes.end()) {
                 continue;
             }
-            // if dependency is not ready, check it
-            for (auto& dep : node.second->dependencies_) {
-                if (!dep.second->started_) {
-                    ready = true;
-                    MA_LOGV(TAG, "check node: %s(%s) %s", dep.second->type_.c_str(), dep.second->id_.c_str(), node.first.c_str());
-                    for (auto& d : dep.second->dependents_) {
-                        if (d.second == nullptr && d.first == node.second->id_) {
-                            MA_LOGV(TAG, "dependencies %s ready: %s(%s)", d.first.c_str(), dep.second->type_.c_str(), dep.second->id_.c_str());
-                            d.second = node.second;
-                        }
-                        if (d.second == nullptr || !d.second->started_) {
-                            MA_LOGV(TAG, "dependencies %s not ready: %s(%s)", d.first.c_str(), dep.second->type_.c_str(), dep.second->id_.c_str());
-                            ready = false;
-                        }
-                    }
-                    for (auto& d : dep.second->dependencies_) {
-                        if (d.second == nullptr) {
-                            MA_LOGV(TAG, "dependencies %s not ready: %s(%s)", d.first.c_str(), dep.second->type_.c_str(), dep.second->id_.c_str());
-                            ready = false;
-                        }
-                    }
-                    if (ready) {
-                        MA_LOGI(TAG, "start node: %s(%s)", dep.second->type_.c_str(), dep.second->id_.c_str());
-                        MA_TRY {
-                            dep.second->onStart();
-                        }
-                        MA_CATCH(Exception & e) {
-                            MA_LOGE(TAG, "start node: %s(%s) failed: %s", dep.second->type_.c_str(), dep.second->id_.c_str(), e.what());
-                            Thread::sleep(Tick::fromMilliseconds(20));
-                            server->response(dep.first, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "start"}, {"code", e.err()}, {"data", e.what()}}));
-                            continue;
-                        }
-                    }
+            auto dep = ref->second->dependencies_.find(id);
+            if (dep != ref->second->dependencies_.end() && dep->second == nullptr) {
+                dep->second = n;
+                if (!ref->second->started_ && m_pending[ref_id] > 0 && --m_pending[ref_id] == 0) {
+                    ready.push_back(ref->second);
                 }
             }
+            auto dept = ref->second->dependents_.find(id);
+            if (dept != ref->second->dependents_.end() && dept->second == nullptr) {
+                dept->second = n;  // still has to start before ref is ready
+            }
         }
     }
 
+    startReady(std::move(ready), server);
+
     return n;
 }
 
@@ -190,8 +277,47 @@ void NodeFactory::destroy(const std::string id) {
     // call onDestroy
     node->second->onDestroy();
 
-    delete node->second;
-    m_nodes.erase(id);
+    // unlink the node, its referrers wait for a new one with the same id
+    Node* n = node->second;
+    for (auto& dep : n->dependencies_) {
+        auto refs = m_referrers.find(dep.first);
+        if (refs != m_referrers.end()) {
+            refs->second.erase(std::remove(refs->second.begin(), refs->second.end(), id), refs->second.end());
+        }
+    }
+    for (auto& dep : n->dependents_) {
+        auto refs = m_referrers.find(dep.first);
+        if (refs != m_referrers.end()) {
+            refs->second.erase(std::remove(refs->second.begin(), refs->second.end(), id), refs->second.end());
+        }
+    }
+    {
+        Guard nodes_guard(m_nodes_mutex);
+        m_nodes.erase(id);
+    }
+    m_pending.erase(id);
+    m_specs.erase(id);
+
+    auto refs = m_referrers.find(id);
+    if (refs != m_referrers.end()) {
+        for (auto& ref_id : refs->second) {
+            auto ref = m_nodes.find(ref_id);
+            if (ref == m_nodes.end()) {
+                continue;
+            }
+            if (ref->second->dependencies_.count(id)) {
+                ref->second->dependencies_[id] = nullptr;
+            }
+            if (ref->second->dependents_.count(id)) {
+                ref->second->dependents_[id] = nullptr;
+            }
+            if (!ref->second->started_) {
+                m_pending[ref_id] = unmet(ref->second);
+            }
+        }
+    }
+
+    delete n;
 
     MA_LOGD(TAG, "destroy node: %s done", id.c_str());
 
@@ -199,6 +325,8 @@ void NodeFactory::destroy(const std::string id) {
 }
 
 Node* NodeFactory::find(const std::string id) {
+    // only the map lock, so lookups do not wait for a node being created or started
+    Guard guard(m_nodes_mutex);
     auto node = m_nodes.find(id);
     if (node == m_nodes.end()) {
         return nullptr;
@@ -209,10 +337,259 @@ Node* NodeFactory::find(const std::string id) {
 void NodeFactory::clear() {
     MA_LOGI(TAG, "clear nodes");
     Guard guard(m_mutex);
-    for (auto node : m_nodes) {
-        destroy(node.first);
+    std::vector<std::string> ids;
+    ids.reserve(m_nodes.size());
+    for (auto& node : m_nodes) {
+        ids.push_back(node.first);
     }
-    m_nodes.clear();
+    for (auto& id : ids) {
+        destroy(id);
+    }
+    {
+        Guard nodes_guard(m_nodes_mutex);
+        m_nodes.clear();
+    }
+    m_referrers.clear();
+    m_pending.clear();
+    m_specs.clear();
+}
+
+json NodeFactory::normalize(const std::string& type, const json& data) {
+    std::vector<std::string> dependencies;
+    std::vector<std::string> dependents;
+    if (data.contains("dependencies")) {
+        dependencies = data["dependencies"].get<std::vector<std::string>>();
+    }
+    if (data.contains("dependents")) {
+        dependents = data["dependents"].get<std::vector<std::string>>();
+    }
+    // edge order carries no meaning
+    std::sort(dependencies.begin(), dependencies.end());
+    std::sort(dependents.begin(), dependents.end());
+
+    std::string _type = type;
+    std::transform(_type.begin(), _type.end(), _type.begin(), ::tolower);
+
+    return json::object({{"type", _type},
+                         {"config", data.contains("config") ? data["config"] : json::object()},
+                         {"dependencies", dependencies},
+                         {"dependents", dependents}});
+}
+
+void NodeFactory::relink(Node* n, const json& spec, std::vector<Node*>& ready) {
+    auto unref = [&](const std::string& name) {
+        auto refs = m_referrers.find(name);
+        if (refs != m_referrers.end()) {
+            refs->second.erase(std::remove(refs->second.begin(), refs->second.end(), n->id_), refs->second.end());
+        }
+    };
+    for (auto& dep : n->dependencies_) {
+        unref(dep.first);
+    }
+    for (auto& dep : n->dependents_) {
+        unref(dep.first);
+    }
+
+    n->dependencies_.clear();
+    n->dependents_.clear();
+    for (auto& dep : spec["dependencies"].get<std::vector<std::string>>()) {
+        n->dependencies_[dep] = find(dep);
+        m_referrers[dep].push_back(n->id_);
+    }
+    for (auto& dep : spec["dependents"].get<std::vector<std::string>>()) {
+        n->dependents_[dep] = find(dep);
+        if (!n->dependencies_.count(dep)) {
+            m_referrers[dep].push_back(n->id_);
+        }
+    }
+
+    m_specs[n->id_]["dependencies"] = spec["dependencies"];
+    m_specs[n->id_]["dependents"]   = spec["dependents"];
+
+    if (!n->started_) {
+        m_pending[n->id_] = unmet(n);
+        if (m_pending[n->id_] == 0) {
+            ready.push_back(n);
+        }
+    }
+}
+
+json NodeFactory::deploy(const json& data, NodeServer* server) {
+    Guard guard(m_mutex);
+
+    if (!data.contains("nodes") || !data["nodes"].is_array()) {
+        MA_THROW(Exception(MA_EINVAL, "Invalid flow: nodes"));
+    }
+
+    // validate the whole flow before touching the running graph
+    std::unordered_map<std::string, json> specs;
+    std::vector<std::string> order;
+    for (auto& node : data["nodes"]) {
+        if (!node.is_object() || !node.contains("id") || !node["id"].is_string() || !node.contains("type") || !node["type"].is_string()) {
+            MA_THROW(Exception(MA_EINVAL, "Invalid flow: node requires id and type"));
+        }
+        std::string id = node["id"].get<std::string>();
+        if (id.empty() || specs.count(id)) {
+            MA_THROW(Exception(MA_EINVAL, "Invalid flow: duplicate node " + id));
+        }
+        for (auto key : {"dependencies", "dependents"}) {
+            if (node.contains(key) && (!node[key].is_array() || !std::all_of(node[key].begin(), node[key].end(), [](const json& v) { return v.is_string(); }))) {
+                MA_THROW(Exception(MA_EINVAL, "Invalid flow: " + std::string(key) + " of " + id));
+            }
+        }
+        if (node.contains("config") && !node["config"].is_object()) {
+            MA_THROW(Exception(MA_EINVAL, "Invalid flow: config of " + id));
+        }
+        json spec = normalize(node["type"].get<std::string>(), node);
+        auto it   = registry().find(spec["type"].get<std::string>());
+        if (it == registry().end()) {
+            MA_THROW(Exception(MA_EINVAL, "Unknown node type: " + spec["type"].get<std::string>()));
+        }
+        specs[id] = std::move(spec);
+        order.push_back(id);
+    }
+
+    std::unordered_map<std::string, size_t> indegree;
+    std::unordered_map<std::string, size_t> singletons;
+    for (auto& id : order) {
+        const json& spec = specs[id];
+        if (registry()[spec["type"].get<std::string>()].singleton && ++singletons[spec["type"].get<std::string>()] > 1) {
+            MA_THROW(Exception(MA_EEXIST, "Singleton node already exists: " + id));
+        }
+        for (auto key : {"dependencies", "dependents"}) {
+            for (auto& dep : spec[key]) {
+                if (!specs.count(dep.get<std::string>())) {
+                    MA_THROW(Exception(MA_EINVAL, "Invalid flow: " + id + " refers to unknown node " + dep.get<std::string>()));
+                }
+            }
+        }
+        for (auto& dep : spec["dependents"]) {
+            indegree[dep.get<std::string>()]++;
+        }
+    }
+
+    // Kahn over the dependents edges, anything left over sits on a cycle
+    std::vector<std::string> queue;
+    for (auto& id : order) {
+        if (indegree[id] == 0) {
+            queue.push_back(id);
+        }
+    }
+    for (size_t i = 0; i < queue.size(); i++) {
+        for (auto& dep : specs[queue[i]]["dependents"]) {
+            if (--indegree[dep.get<std::string>()] == 0) {
+                queue.push_back(dep.get<std::string>());
+            }
+        }
+    }
+    if (queue.size() != order.size()) {
+        MA_THROW(Exception(MA_EINVAL, "Invalid flow: dependency cycle"));
+    }
+
+    json results = json::object();
+    auto result  = [&](const std::string& id, const char* action, ma_err_t code, const std::string& message) {
+        results[id] = json::object({{"action", action}, {"code", code}, {"data", message}});
+    };
+
+    // diff against the running graph
+    std::vector<std::string> removed, recreate, relinked, created;
+    std::unordered_map<std::string, json> deltas;
+    for (auto& node : m_nodes) {
+        if (!specs.count(node.first)) {
+            removed.push_back(node.first);
+        }
+    }
+    for (auto& id : order) {
+        auto running = m_specs.find(id);
+        if (running == m_specs.end() || !m_nodes.count(id)) {
+            created.push_back(id);
+            continue;
+        }
+        const json& want = specs[id];
+        const json& have = running->second;
+        if (want["type"] != have["type"]) {
+            recreate.push_back(id);
+            continue;
+        }
+        if (want["config"] != have["config"]) {
+            json delta = json::object();
+            for (auto& item : want["config"].items()) {
+                if (!have["config"].contains(item.key()) || have["config"][item.key()] != item.value()) {
+                    delta[item.key()] = item.value();
+                }
+            }
+            for (auto& item : have["config"].items()) {
+                if (!want["config"].contains(item.key())) {
+                    delta[item.key()] = nullptr;
+                }
+            }
+            deltas[id] = std::move(delta);
+        }
+        if (want["dependencies"] != have["dependencies"] || want["dependents"] != have["dependents"]) {
+            relinked.push_back(id);
+        }
+    }
+
+    // config changes the node cannot take in place turn into a re-create
+    for (auto& delta : deltas) {
+        ma_err_t err = MA_ENOTSUP;
+        MA_TRY {
+            err = m_nodes[delta.first]->onReconfigure(delta.second);
+        }
+        MA_CATCH(Exception & e) {
+            err = e.err();
+        }
+        if (err == MA_OK) {
+            m_specs[delta.first]["config"] = specs[delta.first]["config"];
+            result(delta.first, "update", MA_OK, "");
+        } else {
+            recreate.push_back(delta.first);
+            relinked.erase(std::remove(relinked.begin(), relinked.end(), delta.first), relinked.end());
+        }
+    }
+
+    for (auto& id : removed) {
+        destroy(id);
+        result(id, "destroy", MA_OK, "");
+    }
+    for (auto& id : recreate) {
+        destroy(id);
+        created.push_back(id);
+    }
+
+    std::vector<Node*> ready;
+    for (auto& id : relinked) {
+        relink(m_nodes[id], specs[id], ready);
+        if (!results.contains(id)) {
+            result(id, "update", MA_OK, "");
+        }
+    }
+    startReady(std::move(ready), server);
+
+    for (auto& id : order) {
+        if (std::find(created.begin(), created.end(), id) == created.end()) {
+            if (!results.contains(id)) {
+                result(id, "keep", MA_OK, "");
+            }
+            continue;
+        }
+        const char* action = std::find(recreate.begin(), recreate.end(), id) != recreate.end() ? "recreate" : "create";
+        const json& spec   = specs[id];
+        MA_TRY {
+            if (create(id, spec["type"].get<std::string>(), spec, server) == nullptr) {
+                MA_THROW(Exception(MA_EINVAL, "Failed to create node: " + id));
+            }
+            result(id, action, MA_OK, "");
+        }
+        MA_CATCH(Exception & e) {
+            result(id, action, e.err(), e.what());
+        }
+        MA_CATCH(std::exception & e) {
+            result(id, action, MA_EINVAL, e.what());
+        }
+    }
+
+    return json::object({{"nodes", results}});
 }
 
 void NodeFactory::registerNode(const std::string type, CreateNode create, bool singleton) {
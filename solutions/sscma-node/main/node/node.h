@@ -3,7 +3,9 @@
 #include <algorithm>
 #include <functional>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "core/ma_core.h"
 #include "porting/ma_porting.h"
@@ -24,6 +26,9 @@ public:
     virtual ma_err_t onStop()                                                = 0;
     virtual ma_err_t onDestroy()                                             = 0;
 
+    // apply the changed keys of a running node's config in place, MA_ENOTSUP asks for a re-create
+    virtual ma_err_t onReconfigure(const json& delta);
+
     const std::string& id() const;
     const std::string& type() const;
     const std::string dump() const;
@@ -58,13 +63,25 @@ public:
     static void destroy(const std::string id);
     static Node* find(const std::string id);
     static void clear();
+    static json deploy(const json& data, NodeServer* server = nullptr);
 
     static void registerNode(const std::string type, CreateNode create, bool singleton = false);
 
 private:
     static std::unordered_map<std::string, NodeCreator>& registry();
+    static size_t unmet(Node* n);
+    static bool cyclic(Node* n);
+    static void notifyStarted(Node* n, std::vector<Node*>& ready);
+    static void startReady(std::vector<Node*> ready, NodeServer* server);
+    static void relink(Node* n, const json& spec, std::vector<Node*>& ready);
+    static json normalize(const std::string& type, const json& data);
+
     static std::unordered_map<std::string, Node*> m_nodes;
-    static Mutex m_mutex;
+    static std::unordered_map<std::string, std::vector<std::string>> m_referrers;  // id -> nodes naming it as dependency or dependent
+    static std::unordered_map<std::string, size_t> m_pending;                      // unmet start conditions of created nodes
+    static std::unordered_map<std::string, json> m_specs;                          // type, config and edges each node was created with
+    static Mutex m_mutex;        // serializes create/destroy/clear
+    static Mutex m_nodes_mutex;  // guards m_nodes for find()
 };
 
 #if MA_USE_NODE_REGISTRAR
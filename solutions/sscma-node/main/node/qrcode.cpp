@@ -39,7 +39,8 @@ void QRCodeNode::threadEntry() {
             continue;
         }
 
-        Thread::enterCritical();
+        // the frame points into VPSS memory, keep the pipeline up while it is read
+        std::shared_lock<std::shared_mutex> pipeline(CameraNode::pipeline());
         struct quirc* q = nullptr;
         try {
             const int width     = frame->img.width;
@@ -59,7 +60,6 @@ void QRCodeNode::threadEntry() {
                     CVI_SYS_Munmap(frame->img.data, frame->img.size);
                 }
                 frame->release();
-                Thread::exitCritical();
                 continue;
             }
 
@@ -70,7 +70,6 @@ void QRCodeNode::threadEntry() {
                 }
                 frame->release();
                 quirc_destroy(q);
-                Thread::exitCritical();
                 continue;
             }
 
@@ -128,8 +127,8 @@ void QRCodeNode::threadEntry() {
             quirc_destroy(q);
         }
         frame->release();
+        pipeline.unlock();
         Thread::sleep(Tick::fromMilliseconds(500));  // limit fps
-        Thread::exitCritical();
     }
 }
 
@@ -89,7 +89,7 @@ protected:
     int32_t count_;           ///< Running counter of processed frames
     Thread* thread_;          ///< Worker thread
     CameraNode* camera_;      ///< Connected camera node
-    MessageBox raw_frame_;    ///< Message box to receive raw RGB888 frames
+    FrameQueue raw_frame_;    ///< Frame queue to receive raw RGB888 frames
 };
 
 }  // namespace ma::node
\ No newline at end of file
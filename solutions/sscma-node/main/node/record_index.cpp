@@ -0,0 +1,300 @@
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdarg>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "record_index.h"
+
+namespace ma::node {
+
+static constexpr char TAG[] = "ma::node::index";
+
+RecordIndex::RecordIndex()
+    : log_(nullptr), bytes_(0), available_(0), synced_(0), rebuilt_(0), lines_(0), evictions_(0), missing_(0), rebuilds_(0), syncs_(0), load_us_(0) {}
+
+RecordIndex::~RecordIndex() {
+    close();
+}
+
+bool RecordIndex::open(const std::string& dir) {
+    Guard guard(mutex_);
+    close();
+    dir_ = dir.empty() || dir.back() == '/' ? dir : dir + "/";
+
+    ma_tick_t start = Tick::current();
+    if (!replay()) {
+        rebuild();
+    } else {
+        log_ = fopen((dir_ + RECORD_INDEX_FILE).c_str(), "a");
+    }
+    if (log_ == nullptr) {
+        MA_LOGW(TAG, "could not open %s%s: %s", dir_.c_str(), RECORD_INDEX_FILE, strerror(errno));
+    }
+    sync();
+    load_us_ = Tick::toMicroseconds(Tick::current() - start);
+    MA_LOGI(TAG, "%s: %zu files, %lu bytes, loaded in %ld us", dir_.c_str(), entries_.size(), static_cast<unsigned long>(bytes_), static_cast<long>(load_us_));
+    return log_ != nullptr;
+}
+
+void RecordIndex::close() {
+    Guard guard(mutex_);
+    if (log_ != nullptr) {
+        fclose(log_);
+        log_ = nullptr;
+    }
+    entries_.clear();
+    bytes_ = 0;
+    lines_ = 0;
+}
+
+std::string RecordIndex::name(const std::string& path) const {
+    if (path.compare(0, dir_.size(), dir_) == 0) {
+        return path.substr(dir_.size());
+    }
+    return std::filesystem::path(path).filename().string();
+}
+
+bool RecordIndex::replay() {
+    FILE* file = fopen((dir_ + RECORD_INDEX_FILE).c_str(), "r");
+    if (file == nullptr) {
+        return false;
+    }
+
+    std::unordered_map<std::string, entry_t> entries;
+    char* line = nullptr;
+    size_t len = 0;
+    char name[256];
+    unsigned long long size;
+    long long start, end;
+    while (getline(&line, &len, file) > 0) {
+        lines_++;
+        if (line[0] == '=' && sscanf(line, "= %255s %llu %lld %lld", name, &size, &start, &end) == 4) {
+            entries[name] = {name, size, start, end, false};
+        } else if (line[0] == '+' && sscanf(line, "+ %255s %lld", name, &start) == 2) {
+            entries[name] = {name, 0, start, start, true};
+        } else if (line[0] == '-' && sscanf(line, "- %255s", name) == 1) {
+            entries.erase(name);
+        }
+    }
+    free(line);
+    fclose(file);
+
+    std::vector<entry_t> sorted;
+    sorted.reserve(entries.size());
+    for (auto& item : entries) {
+        entry_t& entry = item.second;
+        // opened and never completed, the service stopped while writing it
+        if (entry.open) {
+            std::error_code ec;
+            entry.size = std::filesystem::file_size(dir_ + entry.name, ec);
+            entry.open = false;
+            if (ec) {
+                continue;
+            }
+        }
+        sorted.push_back(std::move(entry));
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const entry_t& a, const entry_t& b) { return a.start < b.start || (a.start == b.start && a.name < b.name); });
+    for (auto& entry : sorted) {
+        bytes_ += entry.size;
+        entries_.push_back(std::move(entry));
+    }
+    return true;
+}
+
+void RecordIndex::rebuild() {
+    std::unordered_set<std::string> writing;
+    for (auto& entry : entries_) {
+        if (entry.open) {
+            writing.insert(entry.name);
+        }
+    }
+
+    std::vector<entry_t> sorted;
+    std::error_code ec;
+    for (const auto& p : std::filesystem::directory_iterator(dir_, ec)) {
+        std::string name = p.path().filename().string();
+        // the index itself, and names the log cannot hold
+        if (name.empty() || name[0] == '.' || std::any_of(name.begin(), name.end(), [](unsigned char c) { return std::isspace(c); })) {
+            continue;
+        }
+        struct stat info;
+        if (stat(p.path().c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+            continue;
+        }
+        int64_t time = static_cast<int64_t>(info.st_mtime);
+        sorted.push_back({name, static_cast<uint64_t>(info.st_size), time, time, writing.count(name) > 0});
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const entry_t& a, const entry_t& b) { return a.end < b.end || (a.end == b.end && a.name < b.name); });
+
+    entries_.clear();
+    bytes_ = 0;
+    for (auto& entry : sorted) {
+        bytes_ += entry.size;
+        entries_.push_back(std::move(entry));
+    }
+    rebuilds_++;
+    rebuilt_ = Tick::current();
+    MA_LOGI(TAG, "%s: rebuilt from %zu files", dir_.c_str(), entries_.size());
+    compact();
+}
+
+void RecordIndex::compact() {
+    std::string path = dir_ + RECORD_INDEX_FILE;
+    std::string temp = path + ".tmp";
+    if (log_ != nullptr) {
+        fclose(log_);
+        log_ = nullptr;
+    }
+    FILE* file = fopen(temp.c_str(), "w");
+    if (file == nullptr) {
+        MA_LOGW(TAG, "could not write %s: %s", temp.c_str(), strerror(errno));
+        return;
+    }
+    for (auto& entry : entries_) {
+        if (entry.open) {
+            fprintf(file, "+ %s %lld\n", entry.name.c_str(), static_cast<long long>(entry.start));
+        } else {
+            fprintf(file, "= %s %llu %lld %lld\n", entry.name.c_str(), static_cast<unsigned long long>(entry.size), static_cast<long long>(entry.start), static_cast<long long>(entry.end));
+        }
+    }
+    // the old log stays in place until the new one is complete on disk
+    bool ok = fflush(file) == 0 && fsync(fileno(file)) == 0;
+    fclose(file);
+    if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+        MA_LOGW(TAG, "could not replace %s: %s", path.c_str(), strerror(errno));
+        unlink(temp.c_str());
+    }
+    lines_ = entries_.size();
+    log_   = fopen(path.c_str(), "a");
+}
+
+// caller holds the lock
+void RecordIndex::append(const char* format, ...) {
+    if (log_ == nullptr) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(log_, format, args);
+    va_end(args);
+    fflush(log_);
+    if (++lines_ > 2 * entries_.size() + 1024) {
+        compact();
+    }
+}
+
+void RecordIndex::sync() {
+    struct statvfs info;
+    if (statvfs(dir_.c_str(), &info) == 0) {
+        available_ = static_cast<int64_t>(info.f_bavail) * info.f_frsize;
+    }
+    synced_ = Tick::current();
+    syncs_++;
+}
+
+// caller holds the lock
+bool RecordIndex::evict() {
+    if (entries_.empty() || entries_.front().open) {
+        return false;
+    }
+    entry_t& entry   = entries_.front();
+    std::string path = dir_ + entry.name;
+    if (unlink(path.c_str()) == 0) {
+        MA_LOGI(TAG, "recycle %s", path.c_str());
+        available_ += entry.size;
+    } else if (errno == ENOENT) {
+        missing_++;  // removed by someone else, the space is already back
+    } else {
+        // left on the card, a rebuild finds it again
+        MA_LOGW(TAG, "recycle %s failed: %s", path.c_str(), strerror(errno));
+    }
+    bytes_ -= entry.size;
+    evictions_++;
+    std::string name = std::move(entry.name);
+    entries_.pop_front();
+    append("- %s\n", name.c_str());
+    return true;
+}
+
+void RecordIndex::begin(const std::string& path) {
+    Guard guard(mutex_);
+    int64_t now = static_cast<int64_t>(time(nullptr));
+    entries_.push_back({name(path), 0, now, now, true});
+    append("+ %s %lld\n", entries_.back().name.c_str(), static_cast<long long>(now));
+}
+
+void RecordIndex::end(const std::string& path, uint64_t size) {
+    Guard guard(mutex_);
+    std::string file = name(path);
+    // the file being written is the newest, or close to it
+    auto it = std::find_if(entries_.rbegin(), entries_.rend(), [&](const entry_t& entry) { return entry.open && entry.name == file; });
+    if (it == entries_.rend()) {
+        int64_t now = static_cast<int64_t>(time(nullptr));
+        entries_.push_back({file, 0, now, now, true});
+        it = entries_.rbegin();
+    }
+    it->size = size;
+    it->end  = static_cast<int64_t>(time(nullptr));
+    it->open = false;
+    bytes_ += size;
+    append("= %s %llu %lld %lld\n", file.c_str(), static_cast<unsigned long long>(size), static_cast<long long>(it->start), static_cast<long long>(it->end));
+}
+
+void RecordIndex::insert(const std::string& path, uint64_t size) {
+    Guard guard(mutex_);
+    int64_t now = static_cast<int64_t>(time(nullptr));
+    entries_.push_back({name(path), size, now, now, false});
+    bytes_ += size;
+    append("= %s %llu %lld %lld\n", entries_.back().name.c_str(), static_cast<unsigned long long>(size), static_cast<long long>(now), static_cast<long long>(now));
+}
+
+bool RecordIndex::reserve(uint64_t size, uint64_t keep) {
+    Guard guard(mutex_);
+    ma_tick_t now = Tick::current();
+    if (now - synced_ > Tick::fromSeconds(RECORD_INDEX_SYNC)) {
+        sync();
+    }
+    int64_t required = static_cast<int64_t>(size + keep);
+    if (available_ < required) {
+        while (available_ < required && evict()) {}
+        sync();
+        // files the index does not know, e.g. from before it or lost with the log's last lines
+        if (available_ < required && (rebuilds_ == 0 || now - rebuilt_ > Tick::fromSeconds(RECORD_INDEX_REBUILD))) {
+            rebuild();
+            while (available_ < required && evict()) {}
+            sync();
+        }
+    }
+    if (available_ < required) {
+        return false;
+    }
+    available_ -= size;
+    return true;
+}
+
+json RecordIndex::stats() {
+    Guard guard(mutex_);
+    return json::object({{"files", entries_.size()},
+                         {"bytes", bytes_},
+                         {"available", available_},
+                         {"oldest", entries_.empty() ? 0 : entries_.front().start},
+                         {"lines", lines_},
+                         {"evictions", evictions_},
+                         {"missing", missing_},
+                         {"rebuilds", rebuilds_},
+                         {"syncs", syncs_},
+                         {"load_us", load_us_}});
+}
+
+}  // namespace ma::node
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdio>
+#include <deque>
+#include <string>
+
+#include "core/ma_core.h"
+#include "porting/ma_porting.h"
+
+namespace ma::node {
+
+#define RECORD_INDEX_FILE    ".recordings"
+#define RECORD_INDEX_SYNC    10  // seconds between reads of the free space
+#define RECORD_INDEX_REBUILD 60  // seconds between rescans when space runs out
+
+// The recordings of a storage directory, oldest first, so space is reclaimed from the front without
+// walking the directory. The index is an append-only log in the directory, replayed once at open:
+//   "+ name start"            a file was opened
+//   "= name size start end"   a file is complete, times in seconds since the epoch
+//   "- name"                  a file was removed
+// and rewritten as "=" lines only once removals make up most of it. Without a log, or when the
+// indexed files cannot free enough space, the directory is scanned once to rebuild it.
+// Free space is read once and then kept by charging writes and crediting removals, and read again
+// every RECORD_INDEX_SYNC seconds to take in what others wrote.
+class RecordIndex {
+public:
+    RecordIndex();
+    ~RecordIndex();
+
+    RecordIndex(const RecordIndex&)            = delete;
+    RecordIndex& operator=(const RecordIndex&) = delete;
+
+    bool open(const std::string& dir);
+    void close();
+
+    // a file being written, never reclaimed until end()
+    void begin(const std::string& path);
+    void end(const std::string& path, uint64_t size);
+    // a file written at once
+    void insert(const std::string& path, uint64_t size);
+
+    // removes the oldest files until size bytes fit with keep bytes left, then charges size
+    bool reserve(uint64_t size, uint64_t keep);
+
+    json stats();
+
+private:
+    struct entry_t {
+        std::string name;
+        uint64_t size;
+        int64_t start;
+        int64_t end;
+        bool open;
+    };
+
+    bool replay();
+    void rebuild();
+    void compact();
+    void append(const char* format, ...);
+    void sync();
+    bool evict();
+    std::string name(const std::string& path) const;
+
+    Mutex mutex_;
+    std::string dir_;
+    std::deque<entry_t> entries_;
+    FILE* log_;
+    uint64_t bytes_;
+    int64_t available_;
+    ma_tick_t synced_;
+    ma_tick_t rebuilt_;
+    uint64_t lines_;
+    uint64_t evictions_;
+    uint64_t missing_;
+    uint64_t rebuilds_;
+    uint64_t syncs_;
+    int64_t load_us_;
+};
+
+}  // namespace ma::node
@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "roi.h"
+
+namespace ma::node {
+
+roi_t roiFromBox(float cx, float cy, float w, float h, int32_t width, int32_t height, float expand, bool square) {
+    // same mapping as the model node uses for its published boxes
+    float side = static_cast<float>(std::max(width, height));
+    float x    = cx * side + (width - side) / 2;
+    float y    = cy * side + (height - side) / 2;
+    w *= side * (1 + 2 * expand);
+    h *= side * (1 + 2 * expand);
+    if (square) {
+        w = h = std::max(w, h);
+    }
+
+    int32_t x0 = std::clamp(static_cast<int32_t>(std::lround(x - w / 2)), 0, width);
+    int32_t y0 = std::clamp(static_cast<int32_t>(std::lround(y - h / 2)), 0, height);
+    int32_t x1 = std::clamp(static_cast<int32_t>(std::lround(x + w / 2)), 0, width);
+    int32_t y1 = std::clamp(static_cast<int32_t>(std::lround(y + h / 2)), 0, height);
+
+    return roi_t{x0, y0, x1 - x0, y1 - y0};
+}
+
+void roiResize(const uint8_t* src, int32_t stride, const roi_t& roi, uint8_t* dst, int32_t dst_width, int32_t dst_height, bool planar) {
+    if (roi.width <= 0 || roi.height <= 0 || dst_width <= 0 || dst_height <= 0) {
+        return;
+    }
+
+    // source column and 8-bit weight per destination column, pixel centres aligned
+    std::vector<int32_t> xs(dst_width);
+    std::vector<uint16_t> wx(dst_width);
+    float sx      = static_cast<float>(roi.width) / dst_width;
+    int32_t lastx = std::max(roi.width - 2, 0);
+    for (int32_t i = 0; i < dst_width; i++) {
+        float fx  = std::clamp((i + 0.5f) * sx - 0.5f, 0.0f, static_cast<float>(roi.width - 1));
+        int32_t x = std::min(static_cast<int32_t>(fx), lastx);
+        xs[i]     = (roi.x + x) * 3;
+        wx[i]     = roi.width > 1 ? static_cast<uint16_t>((fx - x) * 256) : 0;
+    }
+
+    size_t plane  = static_cast<size_t>(dst_width) * dst_height;
+    float sy      = static_cast<float>(roi.height) / dst_height;
+    int32_t lasty = std::max(roi.height - 2, 0);
+    int32_t next  = roi.width > 1 ? 3 : 0;
+    for (int32_t j = 0; j < dst_height; j++) {
+        float fy            = std::clamp((j + 0.5f) * sy - 0.5f, 0.0f, static_cast<float>(roi.height - 1));
+        int32_t y           = std::min(static_cast<int32_t>(fy), lasty);
+        uint16_t wy         = roi.height > 1 ? static_cast<uint16_t>((fy - y) * 256) : 0;
+        const uint8_t* row0 = src + static_cast<size_t>(roi.y + y) * stride;
+        const uint8_t* row1 = roi.height > 1 ? row0 + stride : row0;
+        for (int32_t i = 0; i < dst_width; i++) {
+            const uint8_t* p0 = row0 + xs[i];
+            const uint8_t* p1 = row1 + xs[i];
+            uint32_t ax       = 256 - wx[i];
+            uint32_t ay       = 256 - wy;
+            for (int32_t c = 0; c < 3; c++) {
+                uint32_t top    = p0[c] * ax + p0[c + next] * wx[i];
+                uint32_t bottom = p1[c] * ax + p1[c + next] * wx[i];
+                uint8_t value   = static_cast<uint8_t>((top * ay + bottom * wy + (1 << 15)) >> 16);
+                if (planar) {
+                    dst[c * plane + static_cast<size_t>(j) * dst_width + i] = value;
+                } else {
+                    dst[(static_cast<size_t>(j) * dst_width + i) * 3 + c] = value;
+                }
+            }
+        }
+    }
+}
+
+}  // namespace ma::node
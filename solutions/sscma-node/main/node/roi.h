@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+namespace ma::node {
+
+typedef struct {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+} roi_t;
+
+// Maps a detector box (centre and size normalised to the letterboxed square the model saw) to
+// pixels of a width x height frame, grown by expand of its size on each side, optionally made
+// square, and clipped to the frame. An empty roi means the box lies outside the frame.
+roi_t roiFromBox(float cx, float cy, float w, float h, int32_t width, int32_t height, float expand, bool square);
+
+// Bilinear crop and scale of packed RGB888. planar writes three channel planes instead of
+// interleaved pixels, for models that take CHW input. Plain C++, the fallback for the VPSS scaler.
+void roiResize(const uint8_t* src, int32_t stride, const roi_t& roi, uint8_t* dst, int32_t dst_width, int32_t dst_height, bool planar);
+
+}  // namespace ma::node
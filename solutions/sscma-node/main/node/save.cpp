@@ -1,9 +1,11 @@
 // save.cpp
 #include <filesystem>
 #include <fstream>
+#include <memory>
 #include <sys/statvfs.h>
 
 #include "camera.h"  // Explicitly include camera.h to ensure audioFrame and videoFrame are available
+#include "model.h"
 #include "save.h"
 
 // Default folders for saving
@@ -33,6 +35,12 @@
 
 #define NODE_MIN_AVILABLE_CAPACITY 128 * 1024 * 1024
 
+// fmp4 files reserve slice seconds at about the main stream's H.264 and AAC rate, up to the cap
+#define NODE_PREALLOC_RATE 160 * 1024
+#define NODE_PREALLOC_MAX  256 * 1024 * 1024
+
+#define NODE_AVIO_BUFFER_SIZE 64 * 1024
+
 namespace ma::node {
 
 static constexpr char TAG[] = "ma::node::save";
@@ -41,6 +49,8 @@ SaveNode::SaveNode(std::string id)
     : Node("save", id),
       storage_(NODE_SAVE_PATH_LOCAL),
       saveMode_("video"),
+      container_("mp4"),
+      prealloc_(0),
       slice_(300),
       duration_(-1),
       begin_(0),
@@ -50,15 +60,24 @@ SaveNode::SaveNode(std::string id)
       vcount_(0),
       acount_(0),
       imageCount_(0),
+      stampCount_(0),
       camera_(nullptr),
       frame_(60),
       thread_(nullptr),
       avFmtCtx_(nullptr),
       avStream_(nullptr),
       audioStream_(nullptr),
-      audioCodec_(nullptr),
-      audioCodecCtx_(nullptr),
-      audio_buffer_() {}
+      metadata_(true),
+      pre_(Tick::fromSeconds(5)),
+      post_(Tick::fromSeconds(10)),
+      last_trigger_(0),
+      score_(50),
+      count_(1),
+      clip_begin_(0),
+      clips_(0),
+      triggers_(0),
+      detector_(nullptr),
+      detections_(nullptr) {}
 
 SaveNode::~SaveNode() {
     onDestroy();
@@ -67,7 +86,16 @@ SaveNode::~SaveNode() {
 std::string SaveNode::generateFileName() {
     auto now = std::time(nullptr);
     std::ostringstream oss;
-    oss << storage_ << std::put_time(std::localtime(&now), "%Y%m%d_%H%M%S") << ".mp4";
+    oss << storage_ << std::put_time(std::localtime(&now), "%Y%m%d_%H%M%S");
+    // files opened within the same second, e.g. a clip retriggered right after it ended
+    std::string stamp = oss.str();
+    if (stamp == stamp_) {
+        oss << "_" << ++stampCount_;
+    } else {
+        stamp_      = stamp;
+        stampCount_ = 0;
+    }
+    oss << ".mp4";
     return oss.str();
 }
 
@@ -105,43 +133,14 @@ bool SaveNode::saveImage(videoFrame* frame) {
         return false;
     }
 
+    index_.insert(filename_, frame->img.size);
     imageCount_++;
     MA_LOGI(TAG, "image saved successfully: %s (size: %d bytes)", filename_.c_str(), frame->img.size);
     return true;
 }
 
 bool SaveNode::recycle(uint32_t req_size) {
-    uint64_t avail = std::filesystem::space(storage_).available;
-    req_size += NODE_MIN_AVILABLE_CAPACITY;
-    if (avail < req_size) {
-        std::vector<std::filesystem::directory_entry> files;
-        for (const auto& p : std::filesystem::directory_iterator(storage_)) {
-            if (p.is_regular_file()) {
-                files.push_back(p);
-            }
-        }
-        std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) { return std::filesystem::last_write_time(a) < std::filesystem::last_write_time(b); });
-        for (const auto& file : files) {
-            if (file.path() == filename_) {
-                continue;
-            }
-            uint64_t size = std::filesystem::file_size(file);
-            MA_TRY {
-                if (std::filesystem::remove(file)) {
-                    MA_LOGI(TAG, "recycle %s", file.path().c_str());
-                    avail += size;
-                    if (avail >= req_size) {
-                        break;
-                    }
-                }
-            }
-            MA_CATCH(Exception & e) {
-                MA_LOGW(TAG, "recycle %s failed: %s", file.path().c_str(), e.what());
-                continue;
-            }
-        }
-    }
-    return avail >= req_size;
+    return index_.reserve(req_size, NODE_MIN_AVILABLE_CAPACITY);
 }
 
 bool SaveNode::openFile(videoFrame* frame) {
@@ -185,249 +184,280 @@ bool SaveNode::openFile(videoFrame* frame) {
         goto err;
     }
 
-    audioCodec_ = avcodec_find_encoder(AV_CODEC_ID_AAC);
-    if (!audioCodec_) {
-        MA_LOGE(TAG, "could not find AAC encoder");
-        goto err;
-    }
-
-    audioCodecCtx_ = avcodec_alloc_context3(audioCodec_);
-    if (!audioCodecCtx_) {
-        MA_LOGE(TAG, "could not allocate AAC codec context");
-        goto err;
-    }
-
-    audioCodecCtx_->bit_rate       = 128000;
-    audioCodecCtx_->sample_rate    = SAMPLE_RATE;
-    audioCodecCtx_->channels       = CHANNELS;
-    audioCodecCtx_->channel_layout = av_get_default_channel_layout(CHANNELS);
-    audioCodecCtx_->sample_fmt     = AV_SAMPLE_FMT_FLTP;
-    audioCodecCtx_->time_base      = {1, SAMPLE_RATE};
-
-    ret = avcodec_open2(audioCodecCtx_, audioCodec_, nullptr);
-    if (ret < 0) {
-        MA_LOGE(TAG, "could not open AAC codec: %d", ret);
-        goto err;
-    }
-
-    audioStream_->id                       = avFmtCtx_->nb_streams - 1;
-    audioStream_->time_base                = {1, SAMPLE_RATE};
-    audioStream_->codecpar->codec_id       = AV_CODEC_ID_AAC;
-    audioStream_->codecpar->codec_type     = AVMEDIA_TYPE_AUDIO;
-    audioStream_->codecpar->sample_rate    = SAMPLE_RATE;
-    audioStream_->codecpar->channels       = CHANNELS;
-    audioStream_->codecpar->channel_layout = av_get_default_channel_layout(CHANNELS);
-    audioStream_->codecpar->format         = AV_SAMPLE_FMT_FLTP;
-
-    ret = avcodec_parameters_from_context(audioStream_->codecpar, audioCodecCtx_);
-    if (ret < 0) {
-        MA_LOGE(TAG, "could not copy codec parameters: %d", ret);
-        goto err;
+    // the packets come encoded from the camera, shared with the other consumers
+    {
+        std::vector<uint8_t> asc = AacEncoder::config(SAMPLE_RATE, CHANNELS);
+
+        audioStream_->id                       = avFmtCtx_->nb_streams - 1;
+        audioStream_->time_base                = {1, SAMPLE_RATE};
+        audioStream_->codecpar->codec_id       = AV_CODEC_ID_AAC;
+        audioStream_->codecpar->codec_type     = AVMEDIA_TYPE_AUDIO;
+        audioStream_->codecpar->profile        = FF_PROFILE_AAC_LOW;
+        audioStream_->codecpar->sample_rate    = SAMPLE_RATE;
+        audioStream_->codecpar->channels       = CHANNELS;
+        audioStream_->codecpar->channel_layout = av_get_default_channel_layout(CHANNELS);
+        audioStream_->codecpar->frame_size     = AAC_FRAME_SAMPLES;
+        audioStream_->codecpar->extradata      = static_cast<uint8_t*>(av_mallocz(asc.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+        audioStream_->codecpar->extradata_size = asc.size();
+        if (audioStream_->codecpar->extradata == nullptr) {
+            MA_LOGE(TAG, "could not allocate AAC config");
+            goto err;
+        }
+        memcpy(audioStream_->codecpar->extradata, asc.data(), asc.size());
     }
 
     time(&curtime);
     lt = localtime(&curtime);
     strftime(value, sizeof(value), "%Y-%m-%d %H:%M:%S", lt);
 
-    av_dict_set(&dict, "truncate", "false", 0);
-    av_dict_set(&dict, "fsync", "false", 0);
     av_dict_set(&avFmtCtx_->metadata, "creation_time", value, 0);
-    if (avio_open2(&avFmtCtx_->pb, filename_.c_str(), AVIO_FLAG_WRITE, nullptr, &dict) < 0) {
-        MA_LOGE(TAG, "could not open %s", filename_.c_str());
-        goto err;
+    if (container_ == "fmp4") {
+        // a moov without samples up front and a moof per GOP, each flushed to the writer at the
+        // next IDR: the file plays up to the last whole GOP however the recording ends
+        uint8_t* buffer = static_cast<uint8_t*>(av_malloc(NODE_AVIO_BUFFER_SIZE));
+        if (buffer == nullptr || !writer_.open(filename_, recycle(prealloc_) ? prealloc_ : 0)) {
+            MA_LOGE(TAG, "could not open %s", filename_.c_str());
+            av_free(buffer);
+            goto err;
+        }
+        avFmtCtx_->pb = avio_alloc_context(buffer, NODE_AVIO_BUFFER_SIZE, 1, &writer_, nullptr, AsyncWriter::writePacket, nullptr);
+        if (avFmtCtx_->pb == nullptr) {
+            MA_LOGE(TAG, "could not create io context");
+            av_free(buffer);
+            writer_.close();
+            goto err;
+        }
+        av_dict_set(&opt, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+    } else {
+        // the moov goes at the end, written by seeking back, so the file plays only once closed
+        av_dict_set(&dict, "truncate", "false", 0);
+        av_dict_set(&dict, "fsync", "false", 0);
+        if (avio_open2(&avFmtCtx_->pb, filename_.c_str(), AVIO_FLAG_WRITE, nullptr, &dict) < 0) {
+            MA_LOGE(TAG, "could not open %s", filename_.c_str());
+            goto err;
+        }
+        av_dict_free(&dict);
     }
-    av_dict_free(&dict);
 
     if (avformat_write_header(avFmtCtx_, &opt) < 0) {
         MA_LOGE(TAG, "write header failed");
         goto err;
     }
+    av_dict_free(&opt);
+    index_.begin(filename_);
+    if (metadata_ && detector_ != nullptr) {
+        meta_.open(filename_, frame->timestamp);
+    }
     return true;
 
 err:
+    av_dict_free(&dict);
+    av_dict_free(&opt);
     if (avFmtCtx_) {
-        if (avFmtCtx_->pb) {
-            avio_closep(&avFmtCtx_->pb);
-        }
+        closeIo();
         avformat_free_context(avFmtCtx_);
         avFmtCtx_    = nullptr;
         avStream_    = nullptr;
         audioStream_ = nullptr;
-        if (audioCodecCtx_) {
-            avcodec_free_context(&audioCodecCtx_);
-            audioCodecCtx_ = nullptr;
-        }
-        audioCodec_ = nullptr;
-        filename_   = "";
-        av_dict_free(&opt);
+        filename_    = "";
     }
     return false;
 }
 
+void SaveNode::closeIo() {
+    if (avFmtCtx_->pb == nullptr) {
+        return;
+    }
+    if (container_ == "fmp4") {
+        avio_flush(avFmtCtx_->pb);
+        writer_.close();
+        av_freep(&avFmtCtx_->pb->buffer);
+        avio_context_free(&avFmtCtx_->pb);
+    } else {
+        avio_closep(&avFmtCtx_->pb);
+    }
+}
+
 void SaveNode::closeFile() {
     if (avFmtCtx_ == nullptr || avStream_ == nullptr || avFmtCtx_->pb == nullptr) {
         return;
     }
 
-    if (avFmtCtx_ && audioCodecCtx_) {
-        // Flush remaining audio data by processing buffered PCM
-        size_t sample_bytes = CHANNELS * 2;  // Bytes per sample (S16LE)
-        size_t needed_bytes = audioCodecCtx_->frame_size * sample_bytes;
-        while (audio_buffer_.size() >= needed_bytes) {
-            AVFrame* audioFrame        = av_frame_alloc();
-            audioFrame->nb_samples     = audioCodecCtx_->frame_size;
-            audioFrame->format         = AV_SAMPLE_FMT_FLTP;
-            audioFrame->channel_layout = audioCodecCtx_->channel_layout;
-            audioFrame->sample_rate    = audioCodecCtx_->sample_rate;
-
-            int ret = av_frame_get_buffer(audioFrame, 0);
-            if (ret < 0) {
-                MA_LOGW(TAG, "could not allocate audio frame buffer: %d", ret);
-                av_frame_free(&audioFrame);
-                break;
-            }
+    av_write_trailer(avFmtCtx_);
+    closeIo();
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(filename_, ec);
+    index_.end(filename_, ec ? 0 : size);
+    if (meta_.opened()) {
+        std::string path = meta_.path();
+        index_.insert(path, meta_.close());
+    }
+    avformat_free_context(avFmtCtx_);
+    avFmtCtx_    = nullptr;
+    avStream_    = nullptr;
+    audioStream_ = nullptr;
+    filename_    = "";
+}
 
-            const int16_t* pcm_data = (const int16_t*)audio_buffer_.data();
-            int samples             = audioCodecCtx_->frame_size;
-            for (int i = 0; i < samples; i++) {
-                for (int ch = 0; ch < CHANNELS; ch++) {
-                    float val                         = pcm_data[i * CHANNELS + ch] / 32768.0f;
-                    ((float*)audioFrame->data[ch])[i] = val;
-                }
-            }
+bool SaveNode::writeVideo(videoFrame* video) {
+    AVPacket packet = {0};
+    if (vcount_ == 0) {
+        first_video_ts_ = video->timestamp;
+        packet.pts      = 0;
+    } else {
+        packet.pts = ma::Tick::toMicroseconds(video->timestamp - first_video_ts_);
+    }
 
-            audio_buffer_.erase(audio_buffer_.begin(), audio_buffer_.begin() + needed_bytes);
+    packet.dts          = packet.pts;
+    packet.data         = video->img.data;
+    packet.size         = video->img.size;
+    packet.flags        = video->img.key ? AV_PKT_FLAG_KEY : 0;
+    packet.stream_index = avStream_->index;
+    vcount_++;
 
-            audioFrame->pts = acount_ * audioCodecCtx_->frame_size;
-            acount_++;
+    int ret = av_write_frame(avFmtCtx_, &packet);
+    if (ret != 0 || writer_.failed()) {
+        MA_LOGW(TAG, "write video (%d: size %d) failed %d", ret, vcount_, video->img.size);
+        return false;
+    }
+    // an IDR closes the previous fragment, hand it to the writer as a whole
+    if (video->img.key && container_ == "fmp4") {
+        avio_flush(avFmtCtx_->pb);
+        writer_.flush();
+    }
+    return true;
+}
 
-            ret = avcodec_send_frame(audioCodecCtx_, audioFrame);
-            av_frame_free(&audioFrame);
-            if (ret < 0) {
-                MA_LOGW(TAG, "error sending audio frame to encoder: %d", ret);
-                break;
-            }
+bool SaveNode::writeAudio(audioFrame* audio) {
+    // one access unit of AAC_FRAME_SAMPLES samples per frame
+    AVPacket packet     = {0};
+    packet.stream_index = audioStream_->index;
+    packet.data         = audio->data;
+    packet.size         = audio->size;
+    packet.pts          = acount_ * AAC_FRAME_SAMPLES;
+    packet.dts          = packet.pts;
+    packet.duration     = AAC_FRAME_SAMPLES;
+    packet.flags        = AV_PKT_FLAG_KEY;
+    av_packet_rescale_ts(&packet, {1, SAMPLE_RATE}, audioStream_->time_base);
+    acount_++;
+
+    int ret = av_write_frame(avFmtCtx_, &packet);
+    if (ret != 0 || writer_.failed()) {
+        MA_LOGW(TAG, "write audio (%d: size %d) failed %d", ret, acount_, audio->size);
+        return false;
+    }
+    return true;
+}
 
-            while (true) {
-                AVPacket pkt = {0};
-                ret          = avcodec_receive_packet(audioCodecCtx_, &pkt);
-                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
-                    break;
-                if (ret < 0) {
-                    MA_LOGW(TAG, "error receiving audio packet: %d", ret);
-                    break;
-                }
+void SaveNode::trigger(ma_tick_t now) {
+    last_trigger_ = now;
+    triggers_++;
+}
 
-                pkt.stream_index = audioStream_->index;
-                av_packet_rescale_ts(&pkt, audioCodecCtx_->time_base, audioStream_->time_base);
-                ret = av_write_frame(avFmtCtx_, &pkt);
-                av_packet_unref(&pkt);
-                if (ret != 0) {
-                    MA_LOGW(TAG, "write audio failed %d", ret);
-                    break;
-                }
+void SaveNode::pollDetections(ma_tick_t now) {
+    detection_t* item = nullptr;
+    while (detections_ != nullptr && detections_->fetch(reinterpret_cast<void**>(&item), Tick::fromMilliseconds(0))) {
+        std::unique_ptr<detection_t> detection(item);
+        int count = 0;
+        for (auto& box : detection->boxes) {
+            if (box.score * 100 >= score_ && (targets_.empty() || std::find(targets_.begin(), targets_.end(), box.target) != targets_.end())) {
+                count++;
             }
         }
+        if (metadata_) {
+            std::vector<int> tracks;
+            if (detection->reply.contains("data") && detection->reply["data"].contains("tracks")) {
+                tracks = detection->reply["data"]["tracks"].get<std::vector<int>>();
+            }
+            meta_.add(detection->timestamp, detection->boxes, tracks);
+        }
+        if (saveMode_ == "event" && count >= count_) {
+            trigger(now);
+        }
+    }
+}
 
-        if (!audio_buffer_.empty()) {
-            // Pad the remaining buffer to full frame size with silence
-            audio_buffer_.resize(needed_bytes, 0);
-
-            AVFrame* audioFrame        = av_frame_alloc();
-            audioFrame->nb_samples     = audioCodecCtx_->frame_size;
-            audioFrame->format         = AV_SAMPLE_FMT_FLTP;
-            audioFrame->channel_layout = audioCodecCtx_->channel_layout;
-            audioFrame->sample_rate    = audioCodecCtx_->sample_rate;
+void SaveNode::closeClip(const char* reason) {
+    if (avFmtCtx_ == nullptr) {
+        return;
+    }
+    std::string file = filename_;
+    int64_t length   = Tick::toMicroseconds(Tick::current() - clip_begin_) / 1000;
+    closeFile();
+    MA_LOGI(TAG, "clip %s closed (%s, %ld ms)", file.c_str(), reason, static_cast<long>(length));
+    server_->response(id_, json::object({{"type", MA_MSG_TYPE_EVT}, {"name", "clip"}, {"code", MA_OK}, {"data", {{"file", file}, {"state", "end"}, {"reason", reason}, {"length", length}}}}));
+}
 
-            int ret = av_frame_get_buffer(audioFrame, 0);
-            if (ret < 0) {
-                MA_LOGW(TAG, "could not allocate audio frame buffer: %d", ret);
-                av_frame_free(&audioFrame);
-            } else {
-                const int16_t* pcm_data = (const int16_t*)audio_buffer_.data();
-                int samples             = audioCodecCtx_->frame_size;
-                for (int i = 0; i < samples; i++) {
-                    for (int ch = 0; ch < CHANNELS; ch++) {
-                        float val                         = pcm_data[i * CHANNELS + ch] / 32768.0f;
-                        ((float*)audioFrame->data[ch])[i] = val;
-                    }
-                }
+void SaveNode::event(Frame* frame) {
+    ma_tick_t now = Tick::current();
+    pollDetections(now);
 
-                audio_buffer_.clear();
+    if (begin_ == 0) {
+        closeClip("disabled");
+        ring_.clear();
+        enabled_ = false;
+        server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "enabled"}, {"code", MA_OK}, {"data", enabled_.load()}}));
+        frame->release();
+        return;
+    }
 
-                audioFrame->pts = acount_ * audioCodecCtx_->frame_size;
-                acount_++;
+    ma_tick_t last = last_trigger_;
+    bool active    = last != 0 && now - last < post_;
+    bool key       = frame->chn == CHN_H264 && static_cast<videoFrame*>(frame)->img.key;
 
-                ret = avcodec_send_frame(audioCodecCtx_, audioFrame);
-                av_frame_free(&audioFrame);
-                if (ret < 0) {
-                    MA_LOGW(TAG, "error sending padded audio frame to encoder: %d", ret);
-                } else {
-                    while (true) {
-                        AVPacket pkt = {0};
-                        ret          = avcodec_receive_packet(audioCodecCtx_, &pkt);
-                        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
-                            break;
-                        if (ret < 0) {
-                            MA_LOGW(TAG, "error receiving padded audio packet: %d", ret);
-                            break;
-                        }
+    // clips end and split at an IDR, which then starts the ring or the next clip
+    if (avFmtCtx_ != nullptr && key && (!active || (slice_ > 0 && now - start_ > Tick::fromSeconds(slice_)))) {
+        closeClip(active ? "slice" : "idle");
+    }
 
-                        pkt.stream_index = audioStream_->index;
-                        av_packet_rescale_ts(&pkt, audioCodecCtx_->time_base, audioStream_->time_base);
-                        ret = av_write_frame(avFmtCtx_, &pkt);
-                        av_packet_unref(&pkt);
-                        if (ret != 0) {
-                            MA_LOGW(TAG, "write padded audio failed %d", ret);
-                            break;
-                        }
-                    }
-                }
-            }
+    if (avFmtCtx_ == nullptr) {
+        ring_.push(frame);
+        if (!active || ring_.empty()) {
+            return;
         }
-
-        // Flush the AAC encoder
-        int ret = avcodec_send_frame(audioCodecCtx_, nullptr);
-        if (ret < 0 && ret != AVERROR_EOF) {
-            MA_LOGW(TAG, "error flushing audio encoder: %d", ret);
-        } else {
-            while (true) {
-                AVPacket pkt = {0};
-                ret          = avcodec_receive_packet(audioCodecCtx_, &pkt);
-                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
-                    break;
-                if (ret < 0) {
-                    MA_LOGW(TAG, "error receiving flushed audio packet: %d", ret);
-                    break;
-                }
-
-                pkt.stream_index = audioStream_->index;
-                av_packet_rescale_ts(&pkt, audioCodecCtx_->time_base, audioStream_->time_base);
-                ret = av_write_frame(avFmtCtx_, &pkt);
-                av_packet_unref(&pkt);
-                if (ret != 0) {
-                    break;
-                }
+        std::vector<Frame*> frames;
+        ring_.drain(frames);
+        videoFrame* first = static_cast<videoFrame*>(frames.front());
+        start_            = now;
+        clip_begin_       = first->timestamp;
+        vcount_           = 0;
+        acount_           = 0;
+        bool opened       = recycle(first->img.size) && openFile(first);
+        if (opened) {
+            clips_++;
+            MA_LOGI(TAG, "clip %s with %ld ms pre-roll", filename_.c_str(), static_cast<long>(Tick::toMicroseconds(now - clip_begin_) / 1000));
+            server_->response(id_,
+                              json::object({{"type", MA_MSG_TYPE_EVT},
+                                            {"name", "clip"},
+                                            {"code", MA_OK},
+                                            {"data", {{"file", filename_}, {"state", "start"}, {"pre", Tick::toMicroseconds(now - clip_begin_) / 1000}}}}));
+        }
+        for (auto item : frames) {
+            if (opened) {
+                opened = item->chn == CHN_H264 ? writeVideo(static_cast<videoFrame*>(item)) : writeAudio(static_cast<audioFrame*>(item));
             }
+            item->release();
+        }
+        if (!opened) {
+            closeFile();
+            enabled_ = false;
+            server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "save"}, {"code", MA_ENOMEM}, {"data", "No space left on device"}}));
         }
+        return;
     }
 
-    av_write_trailer(avFmtCtx_);
-
-    if (avFmtCtx_->pb) {
-        avio_closep(&avFmtCtx_->pb);
+    bool written = true;
+    if (frame->chn == CHN_H264) {
+        written = recycle(static_cast<videoFrame*>(frame)->img.size) && writeVideo(static_cast<videoFrame*>(frame));
+    } else {
+        written = writeAudio(static_cast<audioFrame*>(frame));
     }
-    avformat_free_context(avFmtCtx_);
-    if (audioCodecCtx_) {
-        avcodec_free_context(&audioCodecCtx_);
-        audioCodecCtx_ = nullptr;
+    frame->release();
+    if (!written) {
+        closeFile();
+        enabled_ = false;
+        server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "save"}, {"code", MA_ENOMEM}, {"data", "No space left on device"}}));
     }
-    avFmtCtx_    = nullptr;
-    avStream_    = nullptr;
-    audioStream_ = nullptr;
-    audioCodec_  = nullptr;
-    filename_    = "";
-    audio_buffer_.clear();
 }
 
 void SaveNode::threadEntry() {
@@ -435,16 +465,12 @@ void SaveNode::threadEntry() {
     Frame* frame                = nullptr;
     videoFrame* video           = nullptr;
     ma::node::audioFrame* audio = nullptr;  // Explicitly qualify audioFrame with namespace
-    AVPacket packet             = {0};
     begin_                      = Tick::current();
 
     server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "enabled"}, {"code", MA_OK}, {"data", enabled_.load()}}));
 
     while (started_) {
-        Thread::exitCritical();
-
         if (frame_.fetch(reinterpret_cast<void**>(&frame), Tick::fromSeconds(2))) {
-            Thread::enterCritical();
             if (!enabled_) {
                 frame->release();
                 continue;
@@ -456,9 +482,8 @@ void SaveNode::threadEntry() {
                 bool shouldSave = false;
 
                 if (duration_ == 0) {
-                    if (manual_capture_requested_) {
-                        shouldSave                = true;
-                        manual_capture_requested_ = false;
+                    if (manual_capture_requested_.exchange(false)) {
+                        shouldSave = true;
                     }
                 } else {
                     if (slice_ > 0 && Tick::current() - start_ > Tick::fromSeconds(slice_)) {
@@ -491,6 +516,7 @@ void SaveNode::threadEntry() {
                 continue;
             } else if (saveMode_ == "video" && frame->chn == CHN_H264) {
                 video = static_cast<videoFrame*>(frame);
+                pollDetections(Tick::current());
                 if (recycle(video->img.size) == false) {
                     video->release();
                     closeFile();
@@ -519,23 +545,7 @@ void SaveNode::threadEntry() {
                     }
                 }
                 if (avFmtCtx_ != nullptr) {
-                    if (vcount_ == 0) {
-                        first_video_ts_ = video->timestamp;
-                        packet.pts      = 0;
-                    } else {
-                        packet.pts = ma::Tick::toMicroseconds(video->timestamp - first_video_ts_);
-                    }
-                    
-                    packet.dts          = packet.pts;
-                    packet.data         = video->img.data;
-                    packet.size         = video->img.size;
-                    packet.flags        = video->img.key ? AV_PKT_FLAG_KEY : 0;
-                    packet.stream_index = avStream_->index;
-                    vcount_++;
-
-                    int ret = av_write_frame(avFmtCtx_, &packet);
-                    if (ret != 0) {
-                        MA_LOGW(TAG, "write video (%d: size %d) failed %d", ret, vcount_, video->img.size);
+                    if (!writeVideo(video)) {
                         closeFile();
                         enabled_ = false;
                         server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "save"}, {"code", MA_ENOMEM}, {"data", "No space left on device"}}));
@@ -551,74 +561,16 @@ void SaveNode::threadEntry() {
                         continue;
                     }
                 }
-            } else if (saveMode_ == "video" && frame->chn == CHN_AUDIO) {
+            } else if (saveMode_ == "video" && frame->chn == CHN_AAC) {
                 audio = static_cast<ma::node::audioFrame*>(frame);  // Explicitly qualify audioFrame
-                if (avFmtCtx_ != nullptr && audioCodecCtx_ != nullptr) {
-
-                    audio_buffer_.insert(audio_buffer_.end(), audio->data, audio->data + audio->size);
-
-                    size_t sample_bytes = CHANNELS * 2;  // Bytes per sample (S16LE)
-                    size_t needed_bytes = audioCodecCtx_->frame_size * sample_bytes;
-                    while (audio_buffer_.size() >= needed_bytes) {
-                        AVFrame* audioFrame        = av_frame_alloc();
-                        audioFrame->nb_samples     = audioCodecCtx_->frame_size;
-                        audioFrame->format         = AV_SAMPLE_FMT_FLTP;
-                        audioFrame->channel_layout = audioCodecCtx_->channel_layout;
-                        audioFrame->sample_rate    = audioCodecCtx_->sample_rate;
-                        int ret                    = av_frame_get_buffer(audioFrame, 0);
-                        if (ret < 0) {
-                            MA_LOGW(TAG, "could not allocate audio frame buffer: %d", ret);
-                            av_frame_free(&audioFrame);
-                            frame->release();
-                            continue;
-                        }
-
-                        const int16_t* pcm_data = (const int16_t*)audio_buffer_.data();
-                        int samples             = audioCodecCtx_->frame_size;
-                        for (int i = 0; i < samples; i++) {
-                            for (int ch = 0; ch < CHANNELS; ch++) {
-                                float val                         = pcm_data[i * CHANNELS + ch] / 32768.0f;
-                                ((float*)audioFrame->data[ch])[i] = val;
-                            }
-                        }
-
-                        audio_buffer_.erase(audio_buffer_.begin(), audio_buffer_.begin() + needed_bytes);
-
-                        audioFrame->pts = acount_ * audioCodecCtx_->frame_size;
-                        acount_++;
-
-                        ret = avcodec_send_frame(audioCodecCtx_, audioFrame);
-                        av_frame_free(&audioFrame);
-                        if (ret < 0) {
-                            MA_LOGW(TAG, "error sending audio frame to encoder: %d", ret);
-                            frame->release();
-                            continue;
-                        }
-
-                        while (true) {
-                            AVPacket pkt = {0};
-                            ret          = avcodec_receive_packet(audioCodecCtx_, &pkt);
-                            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
-                                break;
-                            if (ret < 0) {
-                                MA_LOGW(TAG, "error receiving audio packet: %d", ret);
-                                break;
-                            }
-
-                            pkt.stream_index = audioStream_->index;
-                            av_packet_rescale_ts(&pkt, audioCodecCtx_->time_base, audioStream_->time_base);
-                            ret = av_write_frame(avFmtCtx_, &pkt);
-                            av_packet_unref(&pkt);
-                            if (ret != 0) {
-                                MA_LOGW(TAG, "write audio (%d: size %d) failed %d", ret, acount_, audio->size);
-                                closeFile();
-                                enabled_ = false;
-                                server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "save"}, {"code", MA_ENOMEM}, {"data", "No space left on device"}}));
-                                break;
-                            }
-                        }
-                    }
+                if (avFmtCtx_ != nullptr && audioStream_ != nullptr && !writeAudio(audio)) {
+                    closeFile();
+                    enabled_ = false;
+                    server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "save"}, {"code", MA_ENOMEM}, {"data", "No space left on device"}}));
                 }
+            } else if (saveMode_ == "event" && (frame->chn == CHN_H264 || frame->chn == CHN_AAC)) {
+                event(frame);
+                continue;
             }
             frame->release();
         }
@@ -645,11 +597,18 @@ ma_err_t SaveNode::onCreate(const json& config) {
 
     if (config.contains("saveMode") && config["saveMode"].is_string()) {
         saveMode_ = config["saveMode"].get<std::string>();
-        if (saveMode_ != "video" && saveMode_ != "image") {
+        if (saveMode_ != "video" && saveMode_ != "event" && saveMode_ != "image") {
             saveMode_ = "video";
         }
     }
 
+    if (config.contains("container") && config["container"].is_string()) {
+        container_ = config["container"].get<std::string>();
+        if (container_ != "mp4" && container_ != "fmp4") {
+            container_ = "mp4";
+        }
+    }
+
     if (config.contains("duration") && config["duration"].is_number()) {
         duration_ = config["duration"].get<int>();
     }
@@ -658,6 +617,27 @@ ma_err_t SaveNode::onCreate(const json& config) {
         enabled_ = config["enabled"].get<bool>();
     }
 
+    if (config.contains("metadata") && config["metadata"].is_boolean()) {
+        metadata_ = config["metadata"].get<bool>();
+    }
+    metadata_ = metadata_ && saveMode_ != "image";
+
+    // event mode: "pre" and "post" in seconds, ring "bytes" in KiB, detections of "targets" scoring
+    // at least "score" percent trigger when there are "count" of them
+    size_t ring_bytes = 4096;
+    if (config.contains("event") && config["event"].is_object()) {
+        const json& options = config["event"];
+        pre_                = Tick::fromSeconds(std::clamp(options.value("pre", 5), 0, 60));
+        post_               = Tick::fromSeconds(std::clamp(options.value("post", 10), 1, 600));
+        ring_bytes          = std::clamp(options.value("bytes", 4096), 256, 32 * 1024);
+        score_              = std::clamp(options.value("score", 50), 0, 100);
+        count_              = std::max(options.value("count", 1), 1);
+        if (options.contains("targets") && options["targets"].is_array()) {
+            targets_ = options["targets"].get<std::vector<int>>();
+        }
+    }
+    ring_.configure(pre_, saveMode_ == "event" ? ring_bytes * 1024 : 0);
+
     std::string storageType = config["storage"].get<std::string>();
     if (saveMode_ == "image") {
         storage_ = (storageType == "local") ? NODE_IMAGE_PATH_LOCAL : (storageType == "external") ? NODE_IMAGE_PATH_EXTERNAL : "";
@@ -674,11 +654,26 @@ ma_err_t SaveNode::onCreate(const json& config) {
             MA_THROW(Exception(MA_EINVAL, "Failed to create storage directory"));
         }
     }
+    index_.open(storage_);
+    if (metadata_) {
+        MetadataWriter::prune(storage_);
+    }
 
     slice_ = config["slice"].get<int>();
 
+    // "prealloc" in MiB, 0 turns it off
+    if (container_ == "fmp4") {
+        prealloc_ = slice_ > 0 ? std::min<size_t>(static_cast<size_t>(slice_) * NODE_PREALLOC_RATE, NODE_PREALLOC_MAX) : 0;
+        if (config.contains("prealloc") && config["prealloc"].is_number()) {
+            prealloc_ = static_cast<size_t>(std::clamp(config["prealloc"].get<int>(), 0, 1024)) * 1024 * 1024;
+        }
+    }
+
     thread_ = new Thread((type_ + "#" + id_).c_str(), threadEntryStub);
-    if (thread_ == nullptr) {
+    if (saveMode_ == "event" || metadata_) {
+        detections_ = new MessageBox(4);
+    }
+    if (thread_ == nullptr || ((saveMode_ == "event" || metadata_) && detections_ == nullptr)) {
         MA_THROW(Exception(MA_ENOMEM, "Not enough memory"));
     }
 
@@ -688,7 +683,14 @@ ma_err_t SaveNode::onCreate(const json& config) {
         available = 0;
     }
 
-    MA_LOGI(TAG, "storage: %s, saveMode: %s, slice: %d duration: %d available: %ldKB", storage_.c_str(), saveMode_.c_str(), slice_, duration_, available);
+    MA_LOGI(TAG,
+            "storage: %s, saveMode: %s, container: %s, slice: %d duration: %d available: %ldKB",
+            storage_.c_str(),
+            saveMode_.c_str(),
+            container_.c_str(),
+            slice_,
+            duration_,
+            available);
 
     server_->response(
         id_,
@@ -707,6 +709,7 @@ ma_err_t SaveNode::onControl(const std::string& control, const json& data) {
             if (!enabled) {
                 begin_ = 0;
             } else {
+                begin_ = Tick::current();
                 enabled_.store(enabled);
             }
         }
@@ -721,6 +724,22 @@ ma_err_t SaveNode::onControl(const std::string& control, const json& data) {
             MA_LOGW(TAG, "Capture command rejected - save node not enabled");
             server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", control}, {"code", MA_EBUSY}, {"data", "Save node not enabled"}}));
         }
+    } else if (control == "trigger" && saveMode_ == "event") {
+        if (enabled_.load()) {
+            trigger(Tick::current());
+        }
+        server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", control}, {"code", enabled_.load() ? MA_OK : MA_EBUSY}, {"data", {{"triggers", triggers_.load()}}}}));
+    } else if (control == "stats") {
+        json stats = {{"mode", saveMode_},
+                      {"container", container_},
+                      {"recording", avFmtCtx_ != nullptr},
+                      {"clips", clips_.load()},
+                      {"triggers", triggers_.load()},
+                      {"ring", ring_.stats()},
+                      {"index", index_.stats()},
+                      {"metadata", metadata_ && detector_ != nullptr ? meta_.stats() : json::object({{"enabled", false}})},
+                      {"writer", writer_.stats()}};
+        server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", control}, {"code", MA_OK}, {"data", stats}}));
     } else {
         server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", control}, {"code", MA_ENOTSUP}, {"data", "Not supported"}}));
     }
@@ -738,6 +757,11 @@ ma_err_t SaveNode::onDestroy() {
         delete thread_;
         thread_ = nullptr;
     }
+    if (detections_ != nullptr) {
+        delete detections_;
+        detections_ = nullptr;
+    }
+    index_.close();
 
     created_ = false;
     return MA_OK;
@@ -767,11 +791,27 @@ ma_err_t SaveNode::onStart() {
         MA_LOGI(TAG, "attached to JPEG channel for image saving (using model's configuration)");
     } else {
         camera_->config(CHN_H264);
-        camera_->attach(CHN_H264, &frame_);
-        camera_->attach(CHN_AUDIO, &frame_);
+        camera_->attach(CHN_H264, &frame_, FRAME_POLICY_KEYFRAME);
+        camera_->attach(CHN_AAC, &frame_, FRAME_POLICY_KEYFRAME);
         MA_LOGI(TAG, "configured H264 and audio channels for video saving");
     }
 
+    // detections trigger clips and fill the sidecars when a model is wired in, the trigger control
+    // works without one
+    if (detections_ != nullptr) {
+        for (auto& dep : dependencies_) {
+            if (dep.second->type() == "model") {
+                detector_ = static_cast<ModelNode*>(dep.second);
+                detector_->attachDetections(detections_);
+                break;
+            }
+        }
+    }
+
+    if (container_ == "fmp4" && saveMode_ != "image") {
+        writer_.start(type_ + "#" + id_ + "#io");
+    }
+
     recycle();
     started_ = true;
     thread_->start(this);
@@ -794,11 +834,23 @@ ma_err_t SaveNode::onStop() {
             camera_->detach(CHN_JPEG, &frame_);
         } else {
             camera_->detach(CHN_H264, &frame_);
-            camera_->detach(CHN_AUDIO, &frame_);
+            camera_->detach(CHN_AAC, &frame_);
         }
     }
 
+    if (detector_ != nullptr) {
+        detector_->detachDetections(detections_);
+        detector_ = nullptr;
+    }
+    detection_t* detection = nullptr;
+    while (detections_ != nullptr && detections_->fetch(reinterpret_cast<void**>(&detection), Tick::fromMilliseconds(0))) {
+        delete detection;
+    }
+
     closeFile();
+    writer_.stop();
+    ring_.clear();
+    last_trigger_ = 0;
     return MA_OK;
 }
 
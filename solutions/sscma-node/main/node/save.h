@@ -9,13 +9,19 @@ extern "C" {
 #include <libavutil/opt.h>
 }
 
+#include "async_writer.h"
 #include "camera.h"
+#include "event_ring.h"
+#include "metadata.h"
 #include "node.h"
+#include "record_index.h"
 
 #include "executor.hpp"
 
 namespace ma::node {
 
+class ModelNode;
+
 class SaveNode : public Node {
 
 
@@ -41,29 +47,54 @@ private:
     bool openFile(videoFrame* frame);
     bool saveImage(videoFrame* frame);
     void closeFile();
+    void closeIo();
+    bool writeVideo(videoFrame* video);
+    bool writeAudio(audioFrame* audio);
+    // event mode: rings the frame or writes it to the open clip, takes the frame
+    void event(Frame* frame);
+    void trigger(ma_tick_t now);
+    void pollDetections(ma_tick_t now);
+    void closeClip(const char* reason);
 
 protected:
     std::string storage_;
-    std::string saveMode_;  // "video" or "image"
+    std::string saveMode_;   // "video", "event" or "image"
+    std::string container_;  // "mp4", or "fmp4" to write fragments through writer_
+    size_t prealloc_;        // bytes reserved for each fmp4 file
     int slice_;
     int duration_;
-    ma_tick_t begin_;
+    std::atomic<ma_tick_t> begin_;  // reset by the enabled control to stop recording
     ma_tick_t start_;  // For tracking interval timing
-    bool manual_capture_requested_;  // For manual capture mode
+    std::atomic<bool> manual_capture_requested_;  // For manual capture mode
     ma_tick_t first_video_ts_;
     uint64_t vcount_;
     uint64_t acount_;
     uint64_t imageCount_;  // Counter for saved images
+    std::string stamp_;    // second of the last recording's name
+    int stampCount_;       // recordings named in that second after the first
     CameraNode* camera_;
-    MessageBox frame_;
+    FrameQueue frame_;
     Thread* thread_;
     std::string filename_;
     AVFormatContext* avFmtCtx_;
     AVStream* avStream_;
     AVStream* audioStream_;
-    const AVCodec* audioCodec_;
-    AVCodecContext* audioCodecCtx_;
-    std::vector<uint8_t> audio_buffer_;
+    AsyncWriter writer_;
+    RecordIndex index_;
+    MetadataWriter meta_;
+    bool metadata_;  // detections of a model dependency go to a sidecar of each recording
+    EventRing ring_;                       // pre-roll of the event mode
+    ma_tick_t pre_;                        // pre-roll a clip starts with, as far as the ring holds it
+    ma_tick_t post_;                       // a clip ends at the first IDR this long after the last trigger
+    std::atomic<ma_tick_t> last_trigger_;  // 0 before the first
+    std::vector<int> targets_;             // classes that trigger, all when empty
+    int score_;                            // minimum score of a triggering box, percent
+    int count_;                            // boxes a detection needs to trigger
+    ma_tick_t clip_begin_;                 // capture time of the first frame of the open clip
+    std::atomic<uint64_t> clips_;
+    std::atomic<uint64_t> triggers_;
+    ModelNode* detector_;
+    MessageBox* detections_;
 };
 
 }  // namespace ma::node
\ No newline at end of file
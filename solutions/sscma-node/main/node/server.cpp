@@ -2,6 +2,7 @@
 #include "server.h"
 
 #include "camera.h"
+#include "cascade.h"
 #include "model.h"
 #include "save.h"
 #include "stream.h"
@@ -30,14 +31,22 @@ void NodeServer::onMessage(struct mosquitto* mosq, const struct mosquitto_messag
     Exception e(MA_OK, "");
     json payload;
     MA_TRY {
-        id      = topic.substr(m_topic_in_prefix.length() + 1);
+        // the bare in topic carries requests for no node in particular, such as deploy
+        if (topic.size() > m_topic_in_prefix.length()) {
+            id = topic.substr(m_topic_in_prefix.length() + 1);
+        }
         payload = json::parse(static_cast<const char*>(msg->payload), nullptr, false);
         if (payload.is_discarded() || !payload.contains("name") || !payload.contains("data")) {
             e = Exception(MA_EINVAL, "Invalid payload");
             MA_THROW(e);
         }
         MA_LOGV(TAG, "request: %s <== %s", id.c_str(), payload.dump().c_str());
-        m_executor.submit([this, id = std::move(id), payload = std::move(payload)]() -> bool {
+        // requests for one node run in order, different nodes run in parallel; clear and deploy wait for everything
+        std::string key  = id;
+        std::string name = payload["name"].is_string() ? payload["name"].get<std::string>() : "";
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        bool exclusive   = name == "clear" || name == "deploy";
+        auto task        = [this, id = std::move(id), payload = std::move(payload)]() -> bool {
             Exception e(MA_OK, "");
             std::string name = payload["name"].get<std::string>();
             std::transform(name.begin(), name.end(), name.begin(), ::tolower);
@@ -60,8 +69,11 @@ void NodeServer::onMessage(struct mosquitto* mosq, const struct mosquitto_messag
                     MA_LOGD(TAG, "clear all nodes");
                     NodeFactory::clear();
                     this->response(id, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", name}, {"code", MA_OK}, {"data", ""}}));
+                } else if (name == "deploy") {
+                    json result = NodeFactory::deploy(data, this);
+                    this->response(id, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", name}, {"code", MA_OK}, {"data", result}}));
                 } else if (name == "health") {
-                    this->response(id, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", name}, {"code", MA_OK}, {"data", ""}}));
+                    this->response(id, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", name}, {"code", MA_OK}, {"data", {{"executor", m_executor.stats()}}}}));
                 } else {
                     Node* node = NodeFactory::find(id);
                     if (node) {
@@ -81,7 +93,12 @@ void NodeServer::onMessage(struct mosquitto* mosq, const struct mosquitto_messag
                 return false;
             }
             return false;
-        });
+        };
+        if (exclusive) {
+            m_executor.submitExclusive(std::move(task));
+        } else {
+            m_executor.submit(key, std::move(task));
+        }
     }
     MA_CATCH(const Exception& e) {
         response(id, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "request"}, {"code", e.err()}, {"data", e.what()}}));
@@ -116,15 +133,21 @@ void NodeServer::onMessageStub(struct mosquitto* mosq, void* obj, const struct m
     }
 }
 
-void NodeServer::response(const std::string& id, const json& msg) {
+void NodeServer::response(const std::string& id, const json& msg, msg_encoding_t encoding) {
 
     if (!m_connected) {
         return;
     }
     // Guard guard(m_mutex);
+    static thread_local std::string payload;
     std::string topic = m_topic_out_prefix + '/' + id;
-    MA_LOGV(TAG, "response: %s ==> %s", id.c_str(), msg.dump().c_str());
-    int mid = mosquitto_publish(m_client, nullptr, topic.c_str(), msg.dump().size(), msg.dump().data(), 0, false);
+    encode(msg, encoding, payload);
+    if (encoding == MSG_ENCODING_JSON) {
+        MA_LOGV(TAG, "response: %s ==> %s", id.c_str(), payload.c_str());
+    } else {
+        MA_LOGV(TAG, "response: %s ==> %s %zu bytes", id.c_str(), encodingName(encoding), payload.size());
+    }
+    int mid = mosquitto_publish(m_client, nullptr, topic.c_str(), payload.size(), payload.data(), 0, false);
     return;
 }
 
@@ -136,7 +159,7 @@ StorageFile* NodeServer::getStorage() const {
     return m_storage;
 }
 
-NodeServer::NodeServer(std::string client_id) : m_client(nullptr), m_connected(false), m_client_id(std::move(client_id)), m_storage(nullptr), m_mutex() {
+NodeServer::NodeServer(std::string client_id) : m_client(nullptr), m_connected(false), m_client_id(std::move(client_id)), m_storage(nullptr), m_executor(MA_NODE_SERVER_WORKERS), m_mutex() {
     mosquitto_lib_init();
 
     m_client = mosquitto_new(m_client_id.c_str(), true, this);
@@ -155,6 +178,7 @@ NodeServer::NodeServer(std::string client_id) : m_client(nullptr), m_connected(f
     NodeFactory::registerNode("save", [](const std::string& id) { return new SaveNode(id); });
     NodeFactory::registerNode("stream", [](const std::string& id) { return new StreamNode(id); });
     NodeFactory::registerNode("qrcode", [](const std::string& id) { return new QRCodeNode(id); });
+    NodeFactory::registerNode("cascade", [](const std::string& id) { return new CascadeNode(id); });
 #endif
 }
 NodeServer::~NodeServer() {
@@ -7,6 +7,7 @@
 #include "core/ma_core.h"
 #include "porting/ma_porting.h"
 
+#include "encoding.h"
 #include "executor.hpp"
 #include "node.h"
 namespace ma::node {
@@ -20,7 +21,8 @@ public:
     ma_err_t stop();
 
     // void dispatch(const std::string& id, const json& msg);
-    void response(const std::string& id, const json& msg);
+    // serialised once per call into a per-thread buffer
+    void response(const std::string& id, const json& msg, msg_encoding_t encoding = MSG_ENCODING_JSON);
 
     StorageFile* getStorage() const;
     void setStorage(StorageFile* storage);
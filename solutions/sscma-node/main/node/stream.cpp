@@ -9,7 +9,7 @@ namespace ma::node {
 
 static constexpr char TAG[] = "ma::node::stream";
 
-StreamNode::StreamNode(std::string id) : Node("stream", id), port_(0), host_(""), url_(""), username_(""), password_(""), thread_(nullptr), camera_(nullptr), frame_(60), transport_(nullptr) {
+StreamNode::StreamNode(std::string id) : Node("stream", id), port_(0), host_(""), url_(""), username_(""), password_(""), audio_(CHN_AAC), idr_(true), connections_(0), idr_at_(0), idle_(0), seen_(0), paused_(false), sub_(false), sub_width_(640), sub_height_(360), sub_fps_(15), sub_seen_(0), sub_paused_(false), sub_transport_(nullptr), thread_(nullptr), camera_(nullptr), frame_(60), transport_(nullptr) {
     char hostname[1024];
     hostname[1023] = '\0';
     gethostname(hostname, 1023);
@@ -27,26 +27,74 @@ void StreamNode::threadEntry() {
 
     server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "enabled"}, {"code", MA_OK}, {"data", enabled_.load()}}));
 
+    connections_   = transport_->connections();
+    idr_at_        = 0;
+    seen_          = Tick::current();
+    sub_seen_      = seen_;
+    paused_        = false;
+    sub_paused_    = false;
+    ma_tick_t last = 0;
+
     while (started_) {
-        if (frame_.fetch(reinterpret_cast<void**>(&frame), Tick::fromSeconds(2))) {
-            Thread::enterCritical();
+        ma_tick_t now = Tick::current();
+        if (idle_ > 0 && now - last >= Tick::fromMilliseconds(500)) {
+            last = now;
+            watch(CHN_H264, transport_, seen_, paused_, now);
+            if (sub_transport_ != nullptr) {
+                watch(CHN_SUB, sub_transport_, sub_seen_, sub_paused_, now);
+            }
+        }
+        // The RTSP source is shared by every viewer, so a newcomer cannot be replayed a GOP of its own;
+        // it would wait up to a GOP for the next IDR. Asking for one once PLAY had time to follow the
+        // connect gets it a picture at once.
+        if (idr_) {
+            uint32_t connections = transport_->connections();
+            if (connections != connections_) {
+                connections_ = connections;
+                idr_at_      = Tick::current() + Tick::fromMilliseconds(300);
+            }
+            if (idr_at_ != 0 && Tick::current() >= idr_at_) {
+                idr_at_ = 0;
+                requestVideoIDR(CHN_H264);
+                if (sub_transport_ != nullptr) {
+                    requestVideoIDR(static_cast<video_ch_index_t>(CHN_SUB));
+                }
+            }
+        }
+        if (frame_.fetch(reinterpret_cast<void**>(&frame), Tick::fromMilliseconds(100))) {
             if (enabled_) {
-                if (frame->chn == CHN_H264) {
-                    video = static_cast<videoFrame*>(frame);
+                if (frame->chn == CHN_H264 || frame->chn == CHN_SUB) {
+                    TransportRTSP* transport = frame->chn == CHN_H264 ? transport_ : sub_transport_;
+                    video                    = static_cast<videoFrame*>(frame);
                     for (auto& block : video->blocks) {
-                        transport_->send(reinterpret_cast<const char*>(block.first), block.second);
+                        transport->send(reinterpret_cast<const char*>(block.first), block.second);
                     }
-                } else if (frame->chn == CHN_AUDIO) {
+                } else if (frame->chn == audio_) {
                     audio = static_cast<audioFrame*>(frame);
                     transport_->sendAudio(reinterpret_cast<const char*>(audio->data), audio->size);
+                    if (sub_transport_ != nullptr) {
+                        sub_transport_->sendAudio(reinterpret_cast<const char*>(audio->data), audio->size);
+                    }
                 }
             }
             frame->release();
-            Thread::exitCritical();
         }
     }
 }
 
+void StreamNode::watch(int chn, TransportRTSP* transport, ma_tick_t& seen, bool& idle, ma_tick_t now) {
+    if (transport->viewers() > 0) {
+        seen = now;
+        if (idle) {
+            idle = false;
+            camera_->idle(chn, &frame_, false);
+        }
+    } else if (!idle && now - seen >= idle_) {
+        idle = true;
+        camera_->idle(chn, &frame_, true);
+    }
+}
+
 void StreamNode::threadEntryStub(void* obj) {
     reinterpret_cast<StreamNode*>(obj)->threadEntry();
 }
@@ -76,8 +124,44 @@ ma_err_t StreamNode::onCreate(const json& config) {
         password_ = config["password"].get<std::string>();
     }
 
-    if (session_.empty()) {
-        MA_THROW(Exception(MA_EINVAL, "Session is empty"));
+    // "aac" shares the camera's single AAC encode, "pcm" sends L16 as captured
+    audio_ = CHN_AAC;
+    if (config.contains("audio") && config["audio"].is_string()) {
+        std::string audio = config["audio"].get<std::string>();
+        if (audio != "aac" && audio != "pcm") {
+            MA_THROW(Exception(MA_EINVAL, "Unknown audio format " + audio));
+        }
+        audio_ = audio == "pcm" ? CHN_AUDIO : CHN_AAC;
+    }
+
+    idr_ = true;
+    if (config.contains("idr") && config["idr"].is_boolean()) {
+        idr_ = config["idr"].get<bool>();
+    }
+
+    // a viewer reconnecting within the grace time finds the encoder running
+    idle_ = Tick::fromMilliseconds(5000);
+    if (config.contains("idle") && config["idle"].is_number_integer()) {
+        idle_ = Tick::fromMilliseconds(std::max(config["idle"].get<int>(), 0));
+    }
+
+    // "sub": true or {"session", "width", "height", "fps"}
+    sub_         = false;
+    sub_session_ = "sub";
+    if (config.contains("sub") && config["sub"].is_boolean()) {
+        sub_ = config["sub"].get<bool>();
+    }
+    if (config.contains("sub") && config["sub"].is_object()) {
+        const json& sub = config["sub"];
+        sub_            = sub.value("enabled", true);
+        sub_session_    = sub.value("session", sub_session_);
+        sub_width_      = sub.value("width", sub_width_);
+        sub_height_     = sub.value("height", sub_height_);
+        sub_fps_        = sub.value("fps", sub_fps_);
+    }
+
+    if (session_.empty() || (sub_ && (sub_session_.empty() || sub_session_ == session_))) {
+        MA_THROW(Exception(MA_EINVAL, "Session is empty or taken"));
     }
 
     url_ = "rtsp://" + username_ + ":" + password_ + "@" + host_ + ":" + std::to_string(port_) + "/" + session_;
@@ -97,12 +181,26 @@ ma_err_t StreamNode::onCreate(const json& config) {
         MA_THROW(Exception(MA_ENOMEM, "Not enough memory"));
     }
 
-    TransportRTSP::Config rtspConfig = {port_, MA_PIXEL_FORMAT_H264, MA_AUDIO_FORMAT_PCM, 16000, 1, 16, session_, username_, password_};
+    TransportRTSP::Config rtspConfig = {port_, MA_PIXEL_FORMAT_H264, audio_ == CHN_AAC ? MA_AUDIO_FORMAT_AAC : MA_AUDIO_FORMAT_PCM, SAMPLE_RATE, CHANNELS, 16, session_, username_, password_};
 
     err = transport_->init(&rtspConfig);
     if (err != MA_OK) {
         MA_THROW(Exception(err, "RTSP transport init failed"));
     }
+
+    // the sub session shares the server and its credentials, only the source differs
+    if (sub_) {
+        sub_transport_ = new TransportRTSP();
+        if (sub_transport_ == nullptr) {
+            MA_THROW(Exception(MA_ENOMEM, "Not enough memory"));
+        }
+        rtspConfig.session = sub_session_;
+        err                = sub_transport_->init(&rtspConfig);
+        if (err != MA_OK) {
+            MA_THROW(Exception(err, "RTSP sub transport init failed"));
+        }
+        MA_LOGI(TAG, "rtsp://%s:%s@%s:%d/%s (%dx%d)", username_.c_str(), password_.c_str(), host_.c_str(), port_, sub_session_.c_str(), sub_width_, sub_height_);
+    }
     server_->response(id_, json::object({{"type", MA_MSG_TYPE_RESP}, {"name", "create"}, {"code", err}, {"data", {"url", url_}}}));
     created_ = true;
     return err;
@@ -137,6 +235,12 @@ ma_err_t StreamNode::onDestroy() {
         thread_ = nullptr;
     }
 
+    if (sub_transport_ != nullptr) {
+        sub_transport_->deInit();
+        delete sub_transport_;
+        sub_transport_ = nullptr;
+    }
+
     if (transport_ != nullptr) {
         transport_->deInit();
         delete transport_;
@@ -168,8 +272,12 @@ ma_err_t StreamNode::onStart() {
     }
 
     camera_->config(CHN_H264);
-    camera_->attach(CHN_H264, &frame_);
-    camera_->attach(CHN_AUDIO, &frame_);
+    camera_->attach(CHN_H264, &frame_, FRAME_POLICY_KEYFRAME);
+    camera_->attach(audio_, &frame_, FRAME_POLICY_KEYFRAME);
+    if (sub_) {
+        camera_->config(CHN_SUB, sub_width_, sub_height_, sub_fps_, MA_PIXEL_FORMAT_H264);
+        camera_->attach(CHN_SUB, &frame_, FRAME_POLICY_KEYFRAME);
+    }
 
     started_ = true;
 
@@ -192,9 +300,13 @@ ma_err_t StreamNode::onStop() {
 
     if (camera_ != nullptr) {
         camera_->detach(CHN_H264, &frame_);
-        camera_->detach(CHN_AUDIO, &frame_);
+        camera_->detach(audio_, &frame_);
+        camera_->detach(CHN_SUB, &frame_);
     }
 
+    if (sub_transport_ != nullptr) {
+        sub_transport_->deInit();
+    }
     if (transport_ != nullptr) {
         transport_->deInit();
     }
@@ -22,6 +22,8 @@ public:
 protected:
     void threadEntry();
     static void threadEntryStub(void* obj);
+    // marks the camera channel of a session idle once it had no viewers for idle_, busy again on the first one
+    void watch(int chn, TransportRTSP* transport, ma_tick_t& seen, bool& idle, ma_tick_t now);
 
 protected:
     int port_;
@@ -30,9 +32,24 @@ protected:
     std::string url_;
     std::string username_;
     std::string password_;
+    int audio_;               // CHN_AAC or CHN_AUDIO
+    bool idr_;                // ask the encoder for an IDR when a viewer connects
+    uint32_t connections_;    // as last seen on the transport
+    ma_tick_t idr_at_;        // 0 when no request is pending
+    ma_tick_t idle_;          // without viewers this long a session's encoder is paused, 0 never
+    ma_tick_t seen_;          // last time the main session had viewers
+    bool paused_;
+    bool sub_;                // second session on CHN_SUB
+    std::string sub_session_;
+    int32_t sub_width_;
+    int32_t sub_height_;
+    int32_t sub_fps_;
+    ma_tick_t sub_seen_;
+    bool sub_paused_;
     TransportRTSP* transport_;
+    TransportRTSP* sub_transport_;
     CameraNode* camera_;
-    MessageBox frame_;
+    FrameQueue frame_;
     Thread* thread_;
 };
 
@@ -0,0 +1,197 @@
+#include <algorithm>
+
+#include "tpu_scheduler.h"
+
+namespace ma::node {
+
+static constexpr char TAG[] = "ma::node::tpu";
+
+static constexpr int TPU_WEIGHT_MAX = 100;
+static constexpr int TPU_GRACE_MS   = 5;  // post-processing and fetching the next frame fit in here
+
+TpuScheduler& TpuScheduler::instance() {
+    static TpuScheduler* scheduler = new TpuScheduler();
+    return *scheduler;
+}
+
+TpuScheduler::TpuScheduler() : busy_(false), since_(Tick::current()), busy_us_(0), contended_(0) {}
+
+void TpuScheduler::join(const std::string& id, int priority, int weight) {
+    Guard guard(mutex_);
+    weight = std::clamp(weight, 1, TPU_WEIGHT_MAX);
+
+    auto it = clients_.find(id);
+    if (it != clients_.end()) {
+        it->second.priority = priority;
+        it->second.weight   = weight;
+        return;
+    }
+
+    Client& client     = clients_[id];
+    client.priority    = priority;
+    client.weight      = weight;
+    client.pass        = 0;
+    client.waiting     = false;
+    client.sem         = std::make_unique<Semaphore>(0);
+    client.joined      = Tick::current();
+    client.requested   = 0;
+    client.granted     = 0;
+    client.released    = 0;
+    client.think       = Tick::waitForever;
+    client.runs        = 0;
+    client.busy_us     = 0;
+    client.wait_avg_us = 0;
+    client.wait_max_us = 0;
+
+    MA_LOGI(TAG, "join %s priority %d weight %d", id.c_str(), priority, weight);
+}
+
+void TpuScheduler::leave(const std::string& id) {
+    release(id);
+    Guard guard(mutex_);
+    clients_.erase(id);
+    dispatch(Tick::current());
+    MA_LOGI(TAG, "leave %s", id.c_str());
+}
+
+// caller holds the lock for the helpers below
+
+bool TpuScheduler::contending(const Client& client, ma_tick_t now) const {
+    ma_tick_t grace = Tick::fromMilliseconds(TPU_GRACE_MS);
+    return client.waiting || (client.released != 0 && client.think < grace && now - client.released < grace);
+}
+
+bool TpuScheduler::eligible(const std::string& id, const Client& client, ma_tick_t now) const {
+    for (auto& item : clients_) {
+        const Client& other = item.second;
+        if (item.first == id || !contending(other, now)) {
+            continue;
+        }
+        if (other.priority > client.priority || (other.priority == client.priority && other.pass < client.pass)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TpuScheduler::dispatch(ma_tick_t now) {
+    if (busy_) {
+        return;
+    }
+    Client* next               = nullptr;
+    const std::string* next_id = nullptr;
+    for (auto& item : clients_) {
+        Client& client = item.second;
+        if (!client.waiting) {
+            continue;
+        }
+        if (next == nullptr || client.priority > next->priority || (client.priority == next->priority && client.pass < next->pass)) {
+            next    = &client;
+            next_id = &item.first;
+        }
+    }
+    // the TPU stays idle while a model that goes first is about to come back
+    if (next == nullptr || !eligible(*next_id, *next, now)) {
+        return;
+    }
+    next->waiting = false;
+    busy_         = true;
+    grant(*next_id, *next, now);
+    next->sem->signal();
+}
+
+void TpuScheduler::grant(const std::string& id, Client& client, ma_tick_t now) {
+    owner_             = id;
+    client.granted     = now;
+    uint64_t us        = Tick::toMicroseconds(now - client.requested);
+    client.wait_avg_us = client.runs == 0 ? us : (client.wait_avg_us * 7 + us) / 8;
+    client.wait_max_us = std::max(client.wait_max_us, us);
+}
+
+bool TpuScheduler::acquire(const std::string& id) {
+    Semaphore* sem = nullptr;
+    {
+        Guard guard(mutex_);
+        auto it = clients_.find(id);
+        if (it == clients_.end()) {
+            return false;
+        }
+        Client& client   = it->second;
+        ma_tick_t now    = Tick::current();
+        client.requested = now;
+
+        bool idle = !contending(client, now);
+        if (client.released != 0) {
+            client.think = now - client.released;
+        }
+        if (idle) {
+            // back from idle: catch up with the others instead of claiming everything missed
+            for (auto& item : clients_) {
+                if (item.first != id && contending(item.second, now)) {
+                    client.pass = std::max(client.pass, item.second.pass);
+                }
+            }
+        }
+
+        if (!busy_ && eligible(id, client, now)) {
+            busy_ = true;
+            grant(id, client, now);
+            return true;
+        }
+        contended_++;
+        client.waiting = true;
+        sem            = client.sem.get();
+        dispatch(now);
+    }
+    // woken by a hand-over; on timeout a reservation may have run out, look again
+    while (!sem->wait(Tick::fromMilliseconds(TPU_GRACE_MS))) {
+        Guard guard(mutex_);
+        dispatch(Tick::current());
+    }
+    return true;
+}
+
+void TpuScheduler::release(const std::string& id) {
+    Guard guard(mutex_);
+    if (!busy_ || owner_ != id) {
+        return;
+    }
+
+    ma_tick_t now = Tick::current();
+    auto it       = clients_.find(id);
+    if (it != clients_.end()) {
+        Client& client = it->second;
+        uint64_t us    = Tick::toMicroseconds(now - client.granted);
+        client.runs++;
+        client.busy_us += us;
+        client.pass += us * TPU_WEIGHT_MAX / client.weight;
+        client.released = now;
+        busy_us_ += us;
+    }
+
+    busy_ = false;
+    owner_.clear();
+    dispatch(now);
+}
+
+json TpuScheduler::stats() {
+    Guard guard(mutex_);
+    ma_tick_t now   = Tick::current();
+    uint64_t uptime = std::max<uint64_t>(Tick::toMicroseconds(now - since_), 1);
+    json models     = json::object();
+    for (auto& item : clients_) {
+        const Client& client = item.second;
+        uint64_t joined      = std::max<uint64_t>(Tick::toMicroseconds(now - client.joined), 1);
+        models[item.first]   = {{"priority", client.priority},
+                                {"weight", client.weight},
+                                {"runs", client.runs},
+                                {"waiting", client.waiting},
+                                {"busy_us", client.busy_us},
+                                {"occupancy", static_cast<double>(client.busy_us) / joined},
+                                {"wait_avg_us", client.wait_avg_us},
+                                {"wait_max_us", client.wait_max_us}};
+    }
+    return json::object({{"owner", owner_}, {"occupancy", static_cast<double>(busy_us_) / uptime}, {"contended", contended_}, {"models", models}});
+}
+
+}  // namespace ma::node
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "core/ma_core.h"
+#include "porting/ma_porting.h"
+
+namespace ma::node {
+
+// Arbitrates the TPU between model nodes, one run() at a time. The highest priority goes first;
+// equal priorities share the TPU in proportion to their weight (stride scheduling on measured busy
+// time). A model that just ran, is due again and usually comes straight back keeps its turn for a
+// short grace period, otherwise two busy models would simply alternate whatever their weights.
+class TpuScheduler {
+public:
+    static TpuScheduler& instance();
+
+    // join() again updates priority and weight
+    void join(const std::string& id, int priority, int weight);
+    void leave(const std::string& id);
+
+    // blocks until the TPU is granted to id, false if id has not joined
+    bool acquire(const std::string& id);
+    void release(const std::string& id);
+
+    json stats();
+
+    // holds the TPU for a scope, release() may end it early
+    class Grant {
+    public:
+        explicit Grant(const std::string& id) : id_(id), held_(TpuScheduler::instance().acquire(id)) {}
+        ~Grant() {
+            release();
+        }
+        void release() {
+            if (held_) {
+                held_ = false;
+                TpuScheduler::instance().release(id_);
+            }
+        }
+
+    private:
+        const std::string& id_;
+        bool held_;
+    };
+
+private:
+    TpuScheduler();
+    ~TpuScheduler() = default;
+    TpuScheduler(const TpuScheduler&)            = delete;
+    TpuScheduler& operator=(const TpuScheduler&) = delete;
+
+    struct Client {
+        int priority;
+        int weight;
+        uint64_t pass;  // busy time scaled by 1/weight, the lowest pass runs next
+        bool waiting;
+        std::unique_ptr<Semaphore> sem;
+        ma_tick_t joined;
+        ma_tick_t requested;
+        ma_tick_t granted;
+        ma_tick_t released;
+        ma_tick_t think;  // from the last release to the next request
+        uint64_t runs;
+        uint64_t busy_us;
+        uint64_t wait_avg_us;
+        uint64_t wait_max_us;
+    };
+
+    bool contending(const Client& client, ma_tick_t now) const;
+    bool eligible(const std::string& id, const Client& client, ma_tick_t now) const;
+    void dispatch(ma_tick_t now);
+    void grant(const std::string& id, Client& client, ma_tick_t now);
+
+    Mutex mutex_;
+    std::map<std::string, Client> clients_;
+    std::string owner_;
+    bool busy_;
+    ma_tick_t since_;
+    uint64_t busy_us_;
+    uint64_t contended_;
+};
+
+}  // namespace ma::node
@@ -0,0 +1,43 @@
+#include <algorithm>
+
+#include "websocket.h"
+
+namespace ma::node {
+
+void websocketConfig(const json& config, bool& enabled, TransportWebSocket::Config& ws_config) {
+    if (config.is_boolean()) {
+        enabled = config.get<bool>();
+        return;
+    }
+    if (!config.is_object()) {
+        return;
+    }
+    enabled = config.value("enabled", true);
+    if (config.contains("queue") && config["queue"].is_number_integer()) {
+        ws_config.queue = static_cast<size_t>(std::clamp(config["queue"].get<int>(), 64, 64 * 1024)) * 1024;
+    }
+    if (config.contains("lag") && config["lag"].is_number_integer()) {
+        ws_config.lag = std::max(config["lag"].get<int>(), 0);
+    }
+}
+
+json websocketStats(TransportWebSocket* transport) {
+    json clients = json::array();
+    if (transport == nullptr) {
+        return clients;
+    }
+    for (const auto& client : transport->stats()) {
+        clients.push_back({{"address", client.address},
+                           {"framed", client.framed},
+                           {"queued", client.queued},
+                           {"lag", client.lag},
+                           {"sent", client.sent},
+                           {"bytes", client.bytes},
+                           {"dropped", client.dropped},
+                           {"primed", client.primed},
+                           {"rate", client.rate}});
+    }
+    return clients;
+}
+
+}  // namespace ma::node
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "core/ma_core.h"
+#include "porting/ma_porting.h"
+
+namespace ma::node {
+
+// "websocket": true, false or {"enabled", "queue" (KiB per client), "lag" (ms)}, other values leave both untouched
+void websocketConfig(const json& config, bool& enabled, TransportWebSocket::Config& ws_config);
+
+// per client queue and throughput, empty without a transport
+json websocketStats(TransportWebSocket* transport);
+
+}  // namespace ma::node
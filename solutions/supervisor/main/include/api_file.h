@@ -2,6 +2,7 @@
 #define API_FILE_H
 
 #include "api_base.h"
+#include "metadata_query.h"
 #include <algorithm>
 #include <filesystem>
 #include <fstream>
@@ -679,6 +680,73 @@ private:
         return API_STATUS_OK;
     }
 
+    // Find recordings by their metadata without opening any video
+    static api_status_t query(request_t req, response_t res) {
+        try {
+            std::string path    = getParam(req, "path");
+            std::string storage = getParam(req, "storage");
+            path                = decodePath(path.empty() ? "Videos" : path);
+
+            std::string effectiveStorage = storage.empty() ? "local" : storage;
+
+            if (!isValidStorage(effectiveStorage)) {
+                response(res, -1, "Invalid storage parameter. Use 'local' or 'sd'.");
+                return API_STATUS_OK;
+            }
+            if (effectiveStorage == "sd" && !isSDAvailable()) {
+                response(res, -1, "SD card not available.");
+                return API_STATUS_OK;
+            }
+            if (!isValidPath(path)) {
+                response(res, -1, "Invalid path.");
+                return API_STATUS_OK;
+            }
+
+            std::string fullPath = getFullPath(path, effectiveStorage);
+            if (!std::filesystem::is_directory(fullPath)) {
+                response(res, -1, "Path is not a directory.");
+                return API_STATUS_OK;
+            }
+
+            metaQuery query;
+            std::string from    = getParam(req, "from");
+            std::string to      = getParam(req, "to");
+            std::string classes = getParam(req, "class");
+            std::string track   = getParam(req, "track");
+            std::string min     = getParam(req, "min");
+            std::string limit   = getParam(req, "limit");
+            query.from          = from.empty() ? 0 : std::stoll(from);
+            query.to            = to.empty() ? INT64_MAX : std::stoll(to);
+            query.track         = track.empty() ? -1 : std::stoll(track);
+            query.min           = min.empty() ? 1 : std::max(std::stoi(min), 1);
+            query.limit         = limit.empty() ? 100 : std::max(std::stoi(limit), 1);
+            query.setClasses(decodePath(classes));
+
+            auto begin  = std::chrono::steady_clock::now();
+            size_t rows = 0, opened = 0;
+            json files  = query.run(fullPath, rows, opened);
+
+            json data       = json::object();
+            data["path"]    = path;
+            data["storage"] = effectiveStorage;
+            data["files"]   = files;
+            data["summary"] = rows;
+            data["opened"]  = opened;
+            data["elapsed"] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+            response(res, 0, "Success", data);
+        } catch (const std::invalid_argument& e) {
+            response(res, -1, "Invalid query parameter.");
+        } catch (const std::out_of_range& e) {
+            response(res, -1, "Invalid query parameter.");
+        } catch (const std::exception& e) {
+            response(res, -1, "Internal server error: " + std::string(e.what()));
+        } catch (...) {
+            response(res, -1, "Unknown error occurred.");
+        }
+
+        return API_STATUS_OK;
+    }
+
 public:
     api_file() : api_base("fileMgr") {
         try {
@@ -695,6 +763,7 @@ public:
             REG_API(download);  // GET  /api/file/download
             REG_API(rename);    // POST /api/file/rename
             REG_API(info);      // GET  /api/file/info
+            REG_API(query);     // GET  /api/file/query
         } catch (const std::exception& e) {
             // Handle constructor errors
         }
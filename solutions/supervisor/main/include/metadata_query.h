@@ -0,0 +1,160 @@
+#ifndef METADATA_QUERY_H
+#define METADATA_QUERY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// Recording metadata written by sscma-node's save node: a ".meta" sidecar per recording with its
+// detections per second, and a ".metadata" summary per directory, one line per sidecar with
+// "name start end mask", times in seconds since the epoch and mask the classes seen as 32 hex
+// digits. The sidecar stores classes up to 255, the mask up to 127, each the last one standing for
+// it and above. See docs/sscma-node-protocol.md.
+struct metaQuery {
+    int64_t from             = 0;
+    int64_t to               = INT64_MAX;
+    std::vector<int> classes = {};  // any of them, any detection when empty
+    int64_t track            = -1;  // -1 for any
+    int min                  = 1;   // boxes of a class in one frame
+    size_t limit             = 100;
+
+    // a comma separated list, clamped the way the sidecar stores them; throws on anything but numbers
+    void setClasses(const std::string& list) {
+        std::istringstream items(list);
+        for (std::string item; std::getline(items, item, ',');) {
+            if (!item.empty()) {
+                classes.push_back(std::clamp(std::stoi(item), 0, 255));
+            }
+        }
+    }
+
+    bool maskMatches(const uint64_t mask[2]) const {
+        if (classes.empty()) {
+            return mask[0] != 0 || mask[1] != 0;
+        }
+        for (int target : classes) {
+            int bit = std::min(target, 127);
+            if (mask[bit / 64] & (1ull << (bit % 64))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // seconds of one sidecar that match, merged into [from, to] ranges of offsets into the recording
+    json scanSidecar(const std::string& path, int64_t& start, int64_t& duration) const {
+        json ranges = json::array();
+        std::ifstream file(path, std::ios::binary);
+        char header[40];
+        if (!file.read(header, sizeof(header)) || memcmp(header, "SSMD", 4) != 0 || header[4] != 1) {
+            return nullptr;
+        }
+        uint32_t length;
+        memcpy(&start, header + 8, sizeof(start));
+        memcpy(&length, header + 16, sizeof(length));
+        duration = length;
+
+        std::vector<char> body((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        const uint8_t* p   = reinterpret_cast<const uint8_t*>(body.data());
+        const uint8_t* end = p + body.size();
+
+        int64_t first = -1, last = -1;
+        while (end - p >= 4) {
+            uint16_t offset;
+            memcpy(&offset, p, sizeof(offset));
+            size_t count = p[2], tracks = p[3];
+            if (static_cast<size_t>(end - p) < 4 + count * 2 + tracks * 4) {
+                break;  // cut short while being written
+            }
+            const uint8_t* counts = p + 4;
+            const uint8_t* ids    = counts + count * 2;
+            p                     = ids + tracks * 4;
+
+            int64_t second = start + offset;
+            if (second < from || second > to) {
+                continue;
+            }
+            bool hit = false;
+            for (size_t i = 0; i < count && !hit; i++) {
+                hit = counts[i * 2 + 1] >= min && (classes.empty() || std::find(classes.begin(), classes.end(), counts[i * 2]) != classes.end());
+            }
+            if (hit && track >= 0) {
+                hit = false;
+                for (size_t i = 0; i < tracks && !hit; i++) {
+                    uint32_t id;
+                    memcpy(&id, ids + i * 4, sizeof(id));
+                    hit = id == track;
+                }
+            }
+            if (!hit) {
+                continue;
+            }
+            // a gap of a second or two is the same event
+            if (first >= 0 && offset - last > 2) {
+                ranges.push_back({first, last});
+                first = -1;
+            }
+            if (first < 0) {
+                first = offset;
+            }
+            last = offset;
+        }
+        if (first >= 0) {
+            ranges.push_back({first, last});
+        }
+        return ranges;
+    }
+
+    // recordings of a directory with matching seconds, opening only the sidecars its summary allows;
+    // rows and opened count the summary lines and sidecars read
+    json run(const std::string& dir, size_t& rows, size_t& opened) const {
+        json files = json::array();
+        rows = opened = 0;
+        std::ifstream summary(dir + "/.metadata");
+        for (std::string line; files.size() < limit && std::getline(summary, line);) {
+            char name[256], hex[33];
+            long long start, end;
+            rows++;
+            if (sscanf(line.c_str(), "%255s %lld %lld %32s", name, &start, &end, hex) != 4 || strlen(hex) != 32) {
+                continue;
+            }
+            if (end < from || start > to) {
+                continue;
+            }
+            uint64_t mask[2] = {std::strtoull(hex + 16, nullptr, 16), 0};
+            hex[16]          = '\0';
+            mask[1]          = std::strtoull(hex, nullptr, 16);
+            if (!maskMatches(mask)) {
+                continue;
+            }
+
+            std::string recording = name;
+            std::string sidecar   = dir + "/" + recording.substr(0, recording.rfind('.')) + ".meta";
+            int64_t first = 0, duration = 0;
+            opened++;
+            json ranges = scanSidecar(sidecar, first, duration);
+            if (ranges.is_null() || ranges.empty()) {
+                continue;  // removed since, or only near misses
+            }
+            json item        = json::object();
+            item["name"]     = recording;
+            item["start"]    = first;
+            item["duration"] = duration;
+            item["ranges"]   = ranges;
+            files.push_back(item);
+        }
+        return files;
+    }
+};
+
+#endif  // METADATA_QUERY_H
@@ -0,0 +1,58 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+
+#include "async_writer.h"
+#include "check.h"
+
+using namespace ma;
+using namespace ma::node;
+
+// Time the recording thread spends per packet of a 30 fps, 4 Mbit/s stream, writing and syncing
+// each one second fragment itself as the muxer did, against handing them to the writer thread.
+// Set BENCH_DIR to the storage to measure, the default is /tmp.
+int main() {
+    std::string dir  = getenv("BENCH_DIR") != nullptr ? getenv("BENCH_DIR") : "/tmp";
+    std::string path = dir + "/bench_async_writer.mp4";
+    const int count  = 900;
+    std::vector<uint8_t> data(128 * 1024, 0x42);
+    auto sizeOf = [](int i) { return static_cast<size_t>(i % 30 == 0 ? 100 * 1024 : 14 * 1024); };
+
+    double worst = 0;
+    int fd       = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    double sync  = timeIt(count, [&](int i) {
+        double us = timeIt(1, [&](int) {
+            if (::write(fd, data.data(), sizeOf(i)) < 0) {
+                perror("write");
+            }
+            if (i % 30 == 29) {
+                fdatasync(fd);
+            }
+        });
+        worst = std::max(worst, us);
+    });
+    ::close(fd);
+    printf("direct  %8.1f us/packet, worst %8.1f us\n", sync, worst);
+
+    AsyncWriter writer;
+    writer.start("writer");
+    writer.open(path, 64 * 1024 * 1024);
+    worst        = 0;
+    double async = timeIt(count, [&](int i) {
+        double us = timeIt(1, [&](int) {
+            writer.write(data.data(), sizeOf(i));
+            if (i % 30 == 29) {
+                writer.flush();
+            }
+        });
+        worst = std::max(worst, us);
+    });
+    writer.close();
+    printf("writer  %8.1f us/packet, worst %8.1f us\n", async, worst);
+    printf("%s\n", writer.stats().dump().c_str());
+    writer.stop();
+    std::filesystem::remove(path);
+    return 0;
+}
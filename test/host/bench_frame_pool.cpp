@@ -0,0 +1,56 @@
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "check.h"
+#include "frame_pool.h"
+
+using namespace ma;
+using namespace ma::node;
+
+// The capture path per encoded pack, before and after the pool: a heap block of the pack's size,
+// or a pooled one, filled with the pack and freed by the last subscriber.
+int main() {
+    const int count = 200000;
+    // an IDR every 30 frames, P slices in between, at 1080p and a few Mbit/s
+    std::vector<size_t> sizes;
+    for (int i = 0; i < count; i++) {
+        sizes.push_back(i % 30 == 0 ? 120 * 1024 + (i % 7) * 4096 : 8 * 1024 + (i % 13) * 512);
+    }
+    std::vector<uint8_t> pack(256 * 1024, 0x5a);
+
+    // subscribers hold a few frames before the last one lets go
+    const size_t window = 8;
+    std::vector<uint8_t*> held(window, nullptr);
+    volatile uint8_t sink = 0;
+
+    double heap = timeIt(count, [&](int i) {
+        uint8_t*& slot = held[i % window];
+        if (slot != nullptr) {
+            sink = sink + slot[0];
+            free(slot);
+        }
+        slot = static_cast<uint8_t*>(malloc(sizes[i]));
+        memcpy(slot, pack.data(), sizes[i]);
+    });
+    for (auto& slot : held) {
+        free(slot);
+        slot = nullptr;
+    }
+    double pooled = timeIt(count, [&](int i) {
+        uint8_t*& slot = held[i % window];
+        if (slot != nullptr) {
+            sink = sink + slot[0];
+            FramePool::instance().release(slot);
+        }
+        slot = static_cast<uint8_t*>(FramePool::instance().allocate(sizes[i]));
+        memcpy(slot, pack.data(), sizes[i]);
+    });
+    for (auto& slot : held) {
+        FramePool::instance().release(slot);
+    }
+    printf("heap   %.3f us/pack\n", heap);
+    printf("pooled %.3f us/pack\n", pooled);
+    printf("%s\n", FramePool::instance().stats().dump().c_str());
+    return 0;
+}
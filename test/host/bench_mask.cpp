@@ -0,0 +1,68 @@
+#include "check.h"
+#include "mask.h"
+
+using namespace ma::node;
+
+// Mask post-processing for one 160x160 segmentation mask holding a disc, against reading the
+// bitmap a pixel at a time as the node did before.
+int main() {
+    const int32_t width = 160, height = 160, count = 2000;
+    std::vector<uint8_t> bits((width * height + 7) / 8, 0);
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            if ((x - 70) * (x - 70) + (y - 90) * (y - 90) < 50 * 50) {
+                size_t n = y * width + x;
+                bits[n >> 3] |= 1 << (n & 7);
+            }
+        }
+    }
+    std::vector<uint8_t> dst(width * height);
+    std::vector<uint32_t> counts;
+    std::vector<mask_run_t> runs;
+    std::vector<mask_point_t> contour;
+    volatile uint32_t sink = 0;
+
+    double pixels = timeIt(count, [&](int) {
+        for (size_t n = 0; n < dst.size(); n++) {
+            dst[n] = ((bits[n >> 3] >> (n & 7)) & 1) ? 255 : 0;
+        }
+        sink = sink + dst[count % dst.size()];
+    });
+    double unpack = timeIt(count, [&](int) {
+        maskUnpack(bits.data(), width, height, dst.data());
+        sink = sink + dst[count % dst.size()];
+    });
+    double rlePixels = timeIt(count, [&](int) {
+        counts.assign(1, 0);
+        bool fg = false;
+        for (int32_t x = 0; x < width; x++) {
+            for (int32_t y = 0; y < height; y++) {
+                size_t n = y * width + x;
+                if (((bits[n >> 3] >> (n & 7)) & 1) != fg) {
+                    fg = !fg;
+                    counts.push_back(0);
+                }
+                counts.back()++;
+            }
+        }
+        sink = sink + counts.size();
+    });
+    double rle = timeIt(count, [&](int) {
+        maskRLE(bits.data(), width, height, counts);
+        sink = sink + counts.size();
+    });
+    double run = timeIt(count, [&](int) {
+        maskRuns(bits.data(), width, height, runs);
+        sink = sink + runs.size();
+    });
+    double trace = timeIt(count, [&](int) {
+        maskContour(bits.data(), width, height, contour);
+        sink = sink + contour.size();
+    });
+
+    printf("unpack   per pixel %7.2f us, packed %7.2f us\n", pixels, unpack);
+    printf("rle      per pixel %7.2f us, packed %7.2f us\n", rlePixels, rle);
+    printf("runs     %7.2f us (%zu runs)\n", run, runs.size());
+    printf("contour  %7.2f us (%zu corners)\n", trace, contour.size());
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include "check.h"
+#include "metadata_month.h"
+#include "metadata_query.h"
+
+// the whole query, every sidecar of the directory opened, as before the summary
+static size_t scanAll(const std::string& dir, const metaQuery& query) {
+    size_t found = 0;
+    for (auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() != ".meta") {
+            continue;
+        }
+        int64_t start = 0, duration = 0;
+        json ranges   = query.scanSidecar(entry.path().string(), start, duration);
+        found += !ranges.is_null() && !ranges.empty();
+    }
+    return found;
+}
+
+static void report(const char* what, const std::string& dir, const metaQuery& query, int runs) {
+    size_t rows = 0, opened = 0, files = 0;
+    double us = timeIt(runs, [&](int) { files = query.run(dir, rows, opened).size(); });
+    printf("%-44s %9.1f ms  %5zu files  %5zu sidecars opened\n", what, us / 1000, files, opened);
+}
+
+// GET /api/file/query over a month of 300 s recordings, a person in a fifth of the seconds.
+//   bench_metadata_query [days] [dir]
+int main(int argc, char** argv) {
+    int days        = argc > 1 ? atoi(argv[1]) : 30;
+    std::string dir = argc > 2 ? argv[2] : "/tmp/bench_metadata_query";
+
+    size_t bytes = month::write(dir, days);
+    printf("%d sidecars, %.1f MiB of metadata\n", days * month::PER_DAY, bytes / 1048576.0);
+
+    metaQuery hour;
+    hour.from = month::BASE + 14 * 3600;
+    hour.to   = month::BASE + 15 * 3600 - 1;
+    hour.setClasses("0");
+    report("person, 14:00 to 15:00 of one day", dir, hour, 50);
+
+    metaQuery rare;
+    rare.setClasses(std::to_string(month::DOG));
+    report("class seen on one day, whole month", dir, rare, 20);
+    double us = timeIt(3, [&](int) { scanAll(dir, rare); });
+    printf("%-44s %9.1f ms\n", "  the same opening every sidecar", us / 1000);
+
+    metaQuery never;
+    never.setClasses(std::to_string(month::NEVER));
+    report("class never seen, whole month", dir, never, 20);
+
+    metaQuery person;
+    person.setClasses("0");
+    person.limit = SIZE_MAX;
+    report("person, whole month", dir, person, 3);
+
+    std::filesystem::remove_all(dir);
+    return 0;
+}
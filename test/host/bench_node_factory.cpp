@@ -0,0 +1,51 @@
+#include "check.h"
+#include "node.h"
+
+using namespace ma;
+using namespace ma::node;
+
+class NullNode : public Node {
+public:
+    explicit NullNode(const std::string& id) : Node("null", id) {}
+    ma_err_t onCreate(const json&) override {
+        return MA_OK;
+    }
+    ma_err_t onStart() override {
+        started_ = true;
+        return MA_OK;
+    }
+    ma_err_t onControl(const std::string&, const json&) override {
+        return MA_OK;
+    }
+    ma_err_t onStop() override {
+        started_ = false;
+        return MA_OK;
+    }
+    ma_err_t onDestroy() override {
+        return MA_OK;
+    }
+};
+
+// Time to create a chain of n nodes, each the dependent of the one before it, sources first, so
+// no node can start until the sink at the end of the chain arrives. The per-node cost stays flat
+// when resolving is linear in the graph.
+int main() {
+    NodeFactory::registerNode("null", [](const std::string& id) { return new NullNode(id); });
+    for (int n : {100, 200, 400, 800, 1600}) {
+        double us = timeIt(1, [n](int) {
+            for (int i = 0; i < n; i++) {
+                json data = json::object({{"config", json::object()}, {"dependencies", json::array()}, {"dependents", json::array()}});
+                if (i > 0) {
+                    data["dependencies"].push_back("n" + std::to_string(i - 1));
+                }
+                if (i + 1 < n) {
+                    data["dependents"].push_back("n" + std::to_string(i + 1));
+                }
+                NodeFactory::create("n" + std::to_string(i), "null", data);
+            }
+        });
+        printf("%5d nodes %8.0f us, %.2f us/node\n", n, us, us / n);
+        NodeFactory::clear();
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <fcntl.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+
+#include "check.h"
+#include "record_index.h"
+
+using namespace ma;
+using namespace ma::node;
+
+namespace fs = std::filesystem;
+
+static uint64_t available(const std::string& dir) {
+    struct statvfs info;
+    statvfs(dir.c_str(), &info);
+    return static_cast<uint64_t>(info.f_bavail) * info.f_frsize;
+}
+
+// SaveNode::recycle before the index: the free space on every call, and when short a walk of the
+// directory sorted by age
+static bool recycle(const std::string& dir, uint64_t required) {
+    uint64_t space = fs::space(dir).available;
+    if (space < required) {
+        std::vector<fs::directory_entry> files;
+        for (auto& entry : fs::directory_iterator(dir)) {
+            if (entry.is_regular_file()) {
+                files.push_back(entry);
+            }
+        }
+        std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) { return fs::last_write_time(a) < fs::last_write_time(b); });
+        for (auto& file : files) {
+            uint64_t size = fs::file_size(file);
+            if (fs::remove(file)) {
+                space += size;
+                if (space >= required) {
+                    break;
+                }
+            }
+        }
+    }
+    return space >= required;
+}
+
+static void populate(const std::string& dir, int count) {
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    char data[4096] = {1};
+    for (int i = 0; i < count; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "20260101_%06d_%04d.jpg", i / 10, i % 10);
+        int fd = open((dir + name).c_str(), O_CREAT | O_WRONLY, 0644);
+        if (fd < 0 || write(fd, data, sizeof(data)) < 0) {
+            perror(name);
+        }
+        close(fd);
+    }
+}
+
+// Cost of making room for a recording in a directory of `files` images, with space to spare and
+// with every call having to reclaim a file, before and after the index.
+//   bench_record_index [files] [reclaims] [dir]
+int main(int argc, char** argv) {
+    int files       = argc > 1 ? atoi(argv[1]) : 20000;
+    int reclaims    = argc > 2 ? atoi(argv[2]) : 20;
+    std::string dir = argc > 3 ? std::string(argv[3]) + "/" : "/tmp/bench_record_index/";
+
+    populate(dir, files);
+    double spare   = timeIt(1000, [&](int) { recycle(dir, 1024); });
+    double reclaim = timeIt(reclaims, [&](int) { recycle(dir, available(dir) + 2048); });
+    printf("scan   %8.1f us/call with space, %8.1f us/call reclaiming\n", spare, reclaim);
+
+    populate(dir, files);
+    RecordIndex index;
+    double rebuild = timeIt(1, [&](int) { index.open(dir); });
+    index.close();
+    double replay = timeIt(1, [&](int) { index.open(dir); });
+    spare         = timeIt(1000, [&](int) { index.reserve(1024, 0); });
+    reclaim       = timeIt(reclaims, [&](int) { index.reserve(0, available(dir) + 2048); });
+    printf("index  %8.1f us/call with space, %8.1f us/call reclaiming\n", spare, reclaim);
+    printf("       open %.0f us rebuilding, %.0f us replaying\n", rebuild, replay);
+    printf("%s\n", index.stats().dump().c_str());
+    index.close();
+    fs::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include <algorithm>
+#include <thread>
+
+#include "check.h"
+#include "ma_transport_websocket.h"
+
+using namespace ma;
+
+// Cost of send() to the producer, the camera's encoder callback, with three clients keeping up and
+// one whose socket stopped draining: 30 fps, 20 KiB P frames and a 120 KiB IDR every 30 frames.
+int main() {
+    TransportWebSocket ws;
+    TransportWebSocket::Config config = {};
+    config.port                       = 8090;
+    config.keyframes                  = true;
+    config.lag                        = 0;
+    ws.init(&config);
+    std::vector<WebSocketChannelPtr> channels;
+    for (int i = 0; i < 4; i++) {
+        auto channel = std::make_shared<hv::WebSocketChannel>("client" + std::to_string(i));
+        hv::WebSocketServer::registered()->onopen(channel, std::make_shared<hv::HttpRequest>());
+        channels.push_back(channel);
+    }
+    channels.back()->stalled = true;
+
+    const int frames = 300;
+    std::vector<char> data(120 * 1024, 0);
+    double worst = 0;
+    double total = 0;
+    for (int i = 0; i < frames; i++) {
+        bool key  = i % 30 == 0;
+        double us = timeIt(1, [&](int) { ws.send(data.data(), key ? 120 * 1024 : 20 * 1024, key); });
+        worst = std::max(worst, us);
+        total += us;
+        std::this_thread::sleep_for(std::chrono::microseconds(33333));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for (auto& item : ws.stats()) {
+        printf("%s: sent %lu dropped %lu queued %zu\n", item.address.c_str(), static_cast<unsigned long>(item.sent), static_cast<unsigned long>(item.dropped), item.queued);
+    }
+    printf("send() avg %.1f us, worst %.1f us\n", total / frames, worst);
+    ws.deInit();
+    return 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// Minimal checks for the host tests: a failed CHECK reports and the test exits non-zero.
+
+#include <chrono>
+#include <cstdio>
+
+[[maybe_unused]] static int check_failures = 0;
+
+#define CHECK(cond)                                                           \
+    do {                                                                      \
+        if (!(cond)) {                                                        \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            check_failures++;                                                 \
+        }                                                                     \
+    } while (0)
+
+#define CHECK_DONE() (check_failures == 0 ? (printf("ok\n"), 0) : (fprintf(stderr, "%d checks failed\n", check_failures), 1))
+
+// microseconds spent in fn, averaged over n calls
+template <typename F>
+static double timeIt(int n, F fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        fn(i);
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / n;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+// A synthetic month of recording metadata for the supervisor's query: 300 s slices, each with a
+// ".meta" sidecar and a line in ".metadata", laid out as sscma-node's MetadataWriter writes them.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace month {
+
+static const int64_t BASE  = 1767225600;  // 2026-01-01 00:00:00 UTC
+static const int SLICE     = 300;
+static const int PER_DAY   = 86400 / SLICE;
+static const int PERSON    = 0;
+static const int DOG       = 16;  // one hour of one day
+static const int DOG_DAY   = 1;
+static const int DOG_SLICE = 14 * 3600 / SLICE;
+static const int OVERSIZED = 300;  // a single second of the first slice, stored as 255
+static const int NEVER     = 5;
+
+// a person in about a fifth of the seconds, two of them in every seventh of those
+static int persons(int slice, int second) {
+    uint32_t h = static_cast<uint32_t>(slice * SLICE + second) * 2654435761u;
+    return (h >> 16) % 5 != 0 ? 0 : (h >> 8) % 7 == 0 ? 2 : 1;
+}
+
+static bool dog(int slice, int second) {
+    return slice / PER_DAY == DOG_DAY && slice % PER_DAY >= DOG_SLICE && slice % PER_DAY < DOG_SLICE + 12 && second % 10 < 3;
+}
+
+static int64_t start(int slice) {
+    return BASE + static_cast<int64_t>(slice) * SLICE;
+}
+
+static uint32_t track(int slice) {
+    return 1000 + slice;
+}
+
+static std::string name(int slice) {
+    char name[32];
+    snprintf(name, sizeof(name), "%05d.mp4", slice);
+    return name;
+}
+
+static void put(std::vector<uint8_t>& data, const void* value, size_t size) {
+    data.insert(data.end(), static_cast<const uint8_t*>(value), static_cast<const uint8_t*>(value) + size);
+}
+
+// writes the month into dir, returns the bytes of metadata
+static size_t write(const std::string& dir, int days) {
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    FILE* summary = fopen((dir + "/.metadata").c_str(), "w");
+    size_t total  = 0;
+    for (int slice = 0; slice < days * PER_DAY; slice++) {
+        std::vector<uint8_t> data(40, 0);
+        uint64_t mask[2] = {0, 0};
+        uint32_t records = 0;
+        for (int second = 0; second < SLICE; second++) {
+            std::vector<std::pair<int, int>> counts;
+            if (persons(slice, second) > 0) {
+                counts.push_back({PERSON, persons(slice, second)});
+            }
+            if (dog(slice, second)) {
+                counts.push_back({DOG, 1});
+            }
+            if (slice == 0 && second == 100) {
+                counts.push_back({OVERSIZED, 1});
+            }
+            if (counts.empty()) {
+                continue;
+            }
+            uint16_t offset = second;
+            put(data, &offset, sizeof(offset));
+            data.push_back(counts.size());
+            data.push_back(counts[0].first == PERSON ? 1 : 0);
+            for (auto& count : counts) {
+                int target = std::min(count.first, 255);
+                data.push_back(target);
+                data.push_back(count.second);
+                mask[std::min(target, 127) / 64] |= 1ull << (std::min(target, 127) % 64);
+            }
+            if (counts[0].first == PERSON) {
+                uint32_t id = track(slice);
+                put(data, &id, sizeof(id));
+            }
+            records++;
+        }
+        int64_t begin     = start(slice);
+        uint32_t duration = SLICE;
+        memcpy(data.data(), "SSMD", 4);
+        data[4] = 1;
+        memcpy(data.data() + 8, &begin, sizeof(begin));
+        memcpy(data.data() + 16, &duration, sizeof(duration));
+        memcpy(data.data() + 20, &records, sizeof(records));
+        memcpy(data.data() + 24, mask, sizeof(mask));
+
+        std::string recording = name(slice);
+        FILE* file            = fopen((dir + "/" + recording.substr(0, recording.rfind('.')) + ".meta").c_str(), "wb");
+        fwrite(data.data(), 1, data.size(), file);
+        fclose(file);
+        int line = fprintf(summary, "%s %lld %lld %016llx%016llx\n", recording.c_str(), static_cast<long long>(begin), static_cast<long long>(begin + duration),
+                           static_cast<unsigned long long>(mask[1]), static_cast<unsigned long long>(mask[0]));
+        total += data.size() + line;
+    }
+    fclose(summary);
+    return total;
+}
+
+}  // namespace month
@@ -0,0 +1,439 @@
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "camera.h"
+#include "check.h"
+#include "governor.h"
+#include "motion.h"
+#include "node.h"
+
+using namespace ma;
+using namespace ma::node;
+
+std::atomic<int> ma::node::held_streams{0};
+
+// Built with -fsanitize=thread: the threads below share state the way the capture callbacks, the
+// node workers and the control requests do on the device, ThreadSanitizer fails the run on a data
+// race. CameraNode and ModelNode need the SDK, the locking of theirs mirrored here follows
+// camera.cpp and model.cpp and has to be kept in step with them.
+
+static const auto RUN = std::chrono::milliseconds(300);
+
+static uint8_t stream[2048];
+
+static bool running(std::chrono::steady_clock::time_point since) {
+    return std::chrono::steady_clock::now() - since < RUN;
+}
+
+static videoFrame* raw(int seq) {
+    videoFrame* frame = new videoFrame();
+    frame->chn        = CHN_RAW;
+    frame->timestamp  = seq;
+    frame->img.size   = 64;
+    frame->img.data   = static_cast<uint8_t*>(FramePool::instance().allocate(frame->img.size));
+    memset(frame->img.data, seq, frame->img.size);
+    return frame;
+}
+
+// a zero-copy H.264 frame over the encoder's buffer
+static videoFrame* h264(int seq) {
+    videoFrame* frame = new videoFrame();
+    frame->chn        = CHN_H264;
+    frame->timestamp  = seq;
+    frame->img.key    = seq % 10 == 0;
+    frame->img.size   = sizeof(stream);
+    frame->img.data   = stream;
+    frame->handle     = stream;
+    frame->blocks.push_back({stream, sizeof(stream)});
+    held_streams++;
+    return frame;
+}
+
+static audioFrame* aac(int seq) {
+    audioFrame* frame = new audioFrame();
+    frame->chn        = CHN_AAC;
+    frame->timestamp  = seq;
+    frame->size       = 32;
+    frame->data       = static_cast<uint8_t*>(FramePool::instance().allocate(frame->size));
+    return frame;
+}
+
+static uint64_t consume(FrameQueue& queue) {
+    uint64_t bytes = 0;
+    Frame* frame   = nullptr;
+    if (queue.fetch(reinterpret_cast<void**>(&frame), Tick::fromMilliseconds(5))) {
+        if (frame->chn == CHN_AAC) {
+            bytes = static_cast<audioFrame*>(frame)->data[0] + static_cast<audioFrame*>(frame)->size;
+        } else {
+            bytes = static_cast<videoFrame*>(frame)->img.data[0] + static_cast<videoFrame*>(frame)->img.size;
+        }
+        frame->release();
+    }
+    return bytes;
+}
+
+// producers of every policy, two consumers and a control thread clearing and reading stats
+static void queues() {
+    FrameQueue queue(8);
+    auto since = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+        for (int seq = 0; running(since); seq++) {
+            queue.post(raw(seq), FRAME_POLICY_DROP_OLDEST);
+        }
+    });
+    threads.emplace_back([&] {
+        for (int seq = 0; running(since); seq++) {
+            queue.post(h264(seq), FRAME_POLICY_KEYFRAME);
+        }
+    });
+    threads.emplace_back([&] {
+        for (int seq = 0; running(since); seq++) {
+            queue.post(aac(seq), FRAME_POLICY_KEYFRAME);
+        }
+    });
+    for (int i = 0; i < 2; i++) {
+        threads.emplace_back([&] {
+            while (running(since)) {
+                consume(queue);
+            }
+        });
+    }
+    threads.emplace_back([&] {
+        while (running(since)) {
+            CHECK(queue.stats()["capacity"] == 8 && queue.size() <= 8);
+            queue.clear();
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    });
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    queue.clear();
+    CHECK(queue.size() == 0 && held_streams == 0);
+}
+
+// camera.cpp's subscriber lists: attach() and detach() lock mutex_ then subscribers_mutex_, the
+// capture callbacks dispatch under subscribers_mutex_ alone and feed the GOP cache after it,
+// onStop() turns dispatch away before it drops what is queued
+class Subscribers {
+public:
+    Subscribers() : started_(true) {
+        gop_.configure(30, 1 << 20);
+    }
+    void attach(int chn, FrameQueue* queue, frame_policy_t policy) {
+        Guard guard(mutex_);
+        Guard subscribers(subscribers_mutex_);
+        channels_[chn].push_back({queue, policy});
+    }
+    void detach(int chn, FrameQueue* queue) {
+        Guard guard(mutex_);
+        Guard subscribers(subscribers_mutex_);
+        auto& list = channels_[chn];
+        for (auto it = list.begin(); it != list.end(); it++) {
+            if (it->first == queue) {
+                list.erase(it);
+                break;
+            }
+        }
+    }
+    void dispatch(int chn, Frame* frame) {
+        bool cached = chn == CHN_H264 && gop_.enabled();
+        {
+            Guard subscribers(subscribers_mutex_);
+            if (!started_ || (channels_[chn].empty() && !cached)) {
+                frame->release();
+                return;
+            }
+            frame->ref(channels_[chn].size() + (cached ? 1 : 0));
+            for (auto& sub : channels_[chn]) {
+                sub.first->post(frame, sub.second);
+            }
+            if (!cached) {
+                return;
+            }
+        }
+        gop_.push(static_cast<videoFrame*>(frame));
+    }
+    // a consumer joining midway, as prime() does
+    size_t replay() {
+        std::vector<videoFrame*> frames;
+        gop_.snapshot(frames, Tick::current());
+        for (auto* frame : frames) {
+            frame->release();
+        }
+        return frames.size();
+    }
+    void stop(std::vector<FrameQueue*> queues) {
+        Guard guard(mutex_);
+        {
+            Guard subscribers(subscribers_mutex_);
+            started_ = false;
+            for (auto* queue : queues) {
+                queue->clear();
+            }
+        }
+        gop_.clear();
+    }
+
+private:
+    Mutex mutex_;
+    Mutex subscribers_mutex_;
+    bool started_;
+    std::vector<std::pair<FrameQueue*, frame_policy_t>> channels_[CHN_MAX];
+    GopCache gop_;
+};
+
+static void camera() {
+    Subscribers camera;
+    FrameQueue model(4), stream(16), viewer(16);
+    camera.attach(CHN_RAW, &model, FRAME_POLICY_DROP_OLDEST);
+    camera.attach(CHN_H264, &stream, FRAME_POLICY_KEYFRAME);
+
+    auto since = std::chrono::steady_clock::now();
+    std::atomic<bool> capturing{true};
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+        for (int seq = 0; capturing; seq++) {
+            camera.dispatch(CHN_RAW, raw(seq));
+        }
+    });
+    threads.emplace_back([&] {
+        for (int seq = 0; capturing; seq++) {
+            camera.dispatch(CHN_H264, h264(seq));
+        }
+    });
+    std::atomic<bool> consuming{true};
+    for (auto* queue : {&model, &stream, &viewer}) {
+        threads.emplace_back([&, queue] {
+            while (consuming) {
+                consume(*queue);
+            }
+        });
+    }
+    size_t replayed = 0;
+    while (running(since)) {
+        camera.attach(CHN_H264, &viewer, FRAME_POLICY_KEYFRAME);
+        replayed += camera.replay();
+        camera.attach(CHN_RAW, &viewer, FRAME_POLICY_DROP_NEWEST);
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        camera.detach(CHN_RAW, &viewer);
+        camera.detach(CHN_H264, &viewer);
+    }
+    CHECK(replayed > 0);
+
+    // the callbacks keep coming while the camera stops
+    camera.stop({&model, &stream, &viewer});
+    capturing = false;
+    threads[0].join();
+    threads[1].join();
+    consuming = false;
+    for (size_t i = 2; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    CHECK(model.size() == 0 && stream.size() == 0 && viewer.size() == 0);
+    CHECK(held_streams == 0);
+}
+
+// model.cpp's config_mutex_: the worker holds it from the start of a frame's results until they
+// are built and publishes without it, the config control applies under it; the governor and the
+// motion gate lock on their own
+class Model {
+public:
+    Model() : debug_(false), trace_(false), counting_(false), mask_mode_("contour"), fps_(0), tracked_(0), published_(0) {}
+    void applyConfig(const json& data) {
+        Guard guard(config_mutex_);
+        if (data.contains("debug")) {
+            debug_ = data["debug"].get<bool>();
+        }
+        if (data.contains("trace")) {
+            trace_ = data["trace"].get<bool>();
+            tracker_.clear();
+        }
+        if (data.contains("counting")) {
+            counting_ = data["counting"].get<bool>();
+        }
+        if (data.contains("mask")) {
+            mask_mode_ = data["mask"].get<std::string>();
+        }
+        if (data.contains("fps")) {
+            fps_ = data["fps"].get<int32_t>();
+            governor_.setLimit(fps_ > 0 ? fps_.load() : 30);
+        }
+        if (data.contains("governor")) {
+            governor_.configure(data["governor"]);
+        }
+        if (data.contains("motion")) {
+            motion_.configure(data["motion"]);
+        }
+    }
+    json stats() {
+        return json::object({{"governor", governor_.stats()}, {"motion", motion_.stats()}, {"published", published_.load()}});
+    }
+    void threadEntry(std::atomic<bool>& started) {
+        uint8_t luma[64 * 36];
+        for (int seq = 0; started; seq++) {
+            const bool debug = debug_.load();
+            if (!governor_.admit(Tick::current())) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+            memset(luma, seq % 7 == 0 ? seq : 0, sizeof(luma));
+            bool gated = motion_.enabled();
+            if (gated && !motion_.update(luma, 64, 36, 64, false, Tick::current()) && !last_reply_.is_null()) {
+                json reply            = last_reply_;
+                reply["data"]["stale"] = true;
+                publish(reply);
+                continue;
+            }
+
+            std::optional<Guard> config_guard(std::in_place, config_mutex_);
+            ma_tick_t start = Tick::current();
+            json reply      = json::object({{"data", {{"count", seq}, {"debug", debug}}}});
+            if (trace_) {
+                tracker_.push_back(seq);
+                reply["data"]["tracks"] = tracker_.size();
+            }
+            if (counting_) {
+                reply["data"]["counts"] = json::array({seq, seq});
+            }
+            reply["data"]["mask"] = mask_mode_;
+            config_guard.reset();
+
+            if (gated) {
+                last_reply_ = reply;
+            } else {
+                last_reply_ = nullptr;
+            }
+            publish(reply);
+            ma_tick_t end = Tick::current();
+            governor_.update(end, end - start, 100);
+            if (governor_.changed()) {
+                governor_.stats();
+            }
+        }
+    }
+
+private:
+    void publish(const json& reply) {
+        tracked_ = reply["data"].value("tracks", 0);
+        published_++;
+    }
+
+    Mutex config_mutex_;
+    std::atomic<bool> debug_;
+    bool trace_;
+    bool counting_;
+    std::string mask_mode_;
+    std::vector<int> tracker_;
+    std::atomic<int32_t> fps_;
+    RateGovernor governor_;
+    MotionGate motion_;
+    json last_reply_;
+    size_t tracked_;
+    std::atomic<uint64_t> published_;
+};
+
+static void model() {
+    Model model;
+    std::atomic<bool> started{true};
+    std::thread worker([&] { model.threadEntry(started); });
+
+    auto since = std::chrono::steady_clock::now();
+    for (int i = 0; running(since); i++) {
+        switch (i % 4) {
+            case 0:
+                model.applyConfig({{"debug", i % 8 == 0}, {"trace", true}, {"mask", "rle"}});
+                break;
+            case 1:
+                model.applyConfig({{"counting", i % 3 == 0}, {"fps", i % 5 * 10}, {"motion", {{"threshold", 5}, {"keepalive", 50}, {"grid", {8, 6}}}}});
+                break;
+            case 2:
+                model.applyConfig({{"governor", {{"latency", 20}, {"cpu", 50}, {"min", 1}}}, {"mask", "contour"}});
+                break;
+            default:
+                model.applyConfig({{"governor", nullptr}, {"motion", nullptr}, {"trace", false}});
+                break;
+        }
+        CHECK(model.stats()["governor"].is_object());
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    started = false;
+    worker.join();
+    CHECK(model.stats()["published"].get<uint64_t>() > 0);
+}
+
+class MockNode : public Node {
+public:
+    MockNode(const std::string& type, const std::string& id) : Node(type, id) {}
+    ma_err_t onCreate(const json&) override {
+        return MA_OK;
+    }
+    ma_err_t onStart() override {
+        started_ = true;
+        return MA_OK;
+    }
+    ma_err_t onControl(const std::string&, const json&) override {
+        return MA_OK;
+    }
+    ma_err_t onStop() override {
+        started_ = false;
+        return MA_OK;
+    }
+    ma_err_t onDestroy() override {
+        return MA_OK;
+    }
+};
+
+static json spec(const std::vector<std::string>& dependencies, const std::vector<std::string>& dependents) {
+    return json::object({{"config", json::object()}, {"dependencies", dependencies}, {"dependents", dependents}});
+}
+
+// two flows created and torn down side by side, each start wave on its own threads, while a
+// control request looks nodes up
+static void factory() {
+    NodeFactory::registerNode("mock", [](const std::string& id) { return new MockNode("mock", id); });
+    std::atomic<bool> building{true};
+    std::vector<std::thread> threads;
+    for (int flow = 0; flow < 2; flow++) {
+        threads.emplace_back([flow] {
+            std::string prefix = "flow" + std::to_string(flow) + "_";
+            std::vector<std::string> sinks;
+            for (int i = 0; i < 4; i++) {
+                sinks.push_back(prefix + "sink" + std::to_string(i));
+            }
+            for (int round = 0; round < 20; round++) {
+                for (auto& id : sinks) {
+                    NodeFactory::create(id, "mock", spec({prefix + "camera"}, {}));
+                }
+                NodeFactory::create(prefix + "camera", "mock", spec({}, sinks));
+                CHECK(NodeFactory::find(prefix + "camera") != nullptr);
+                NodeFactory::destroy(prefix + "camera");
+                for (auto& id : sinks) {
+                    NodeFactory::destroy(id);
+                }
+            }
+        });
+    }
+    std::thread control([&] {
+        while (building) {
+            NodeFactory::find("flow0_sink0");
+            NodeFactory::find("flow1_camera");
+        }
+    });
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    building = false;
+    control.join();
+    NodeFactory::clear();
+}
+
+int main() {
+    queues();
+    camera();
+    model();
+    factory();
+    return CHECK_DONE();
+}
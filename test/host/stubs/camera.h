@@ -0,0 +1,90 @@
+#pragma once
+
+// Host stand-in for camera.h: the frame types and channels the queue, cache and ring work on,
+// without the video, audio and websocket stacks behind the camera node.
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "core/ma_core.h"
+#include "porting/ma_porting.h"
+
+#include "frame_pool.h"
+#include "frame_queue.h"
+#include "gop_cache.h"
+
+namespace ma::node {
+
+enum { CHN_RAW = 0, CHN_JPEG = 1, CHN_H264 = 2, CHN_EXT = 3, CHN_SUB = 4, CHN_AUDIO = 5, CHN_AAC = 6, CHN_MAX };
+
+static inline bool isAudioChannel(int chn) {
+    return chn == CHN_AUDIO || chn == CHN_AAC;
+}
+
+// encoder streams held by zero-copy frames, counted instead of returned to a VENC
+extern std::atomic<int> held_streams;
+
+static inline void dropVideoStream(void* handle) {
+    (void)handle;
+    held_streams--;
+}
+
+class Frame {
+public:
+    Frame() : ref_cnt(0), chn(CHN_MAX) {}
+    virtual ~Frame() = default;
+    inline void ref(int n = 1) {
+        ref_cnt.fetch_add(n, std::memory_order_relaxed);
+    }
+    virtual inline void release() = 0;
+    static void* operator new(size_t size) {
+        void* ptr = FramePool::instance().allocate(size);
+        if (ptr == nullptr) {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+    static void operator delete(void* ptr) {
+        FramePool::instance().release(ptr);
+    }
+    std::atomic<int> ref_cnt;
+    int chn;
+    ma_tick_t timestamp;
+};
+
+class videoFrame : public Frame {
+public:
+    videoFrame() : Frame(), fps(0), handle(nullptr) {
+        memset(&img, 0, sizeof(img));
+    }
+    inline void release() override {
+        if (ref_cnt.load(std::memory_order_relaxed) == 0 || ref_cnt.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            if (handle != nullptr) {
+                dropVideoStream(handle);
+            } else if (!img.physical) {
+                FramePool::instance().release(img.data);
+            }
+            delete this;
+        }
+    }
+    std::vector<std::pair<void*, size_t>> blocks;
+    ma_img_t img;
+    int fps;
+    void* handle;
+};
+
+class audioFrame : public Frame {
+public:
+    audioFrame() : Frame(), data(nullptr), size(0) {}
+    inline void release() override {
+        if (ref_cnt.load(std::memory_order_relaxed) == 0 || ref_cnt.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            FramePool::instance().release(data);
+            delete this;
+        }
+    }
+    uint8_t* data;
+    size_t size;
+};
+
+}  // namespace ma::node
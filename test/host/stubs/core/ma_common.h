@@ -0,0 +1,16 @@
+#pragma once
+
+#include "core/ma_core.h"
+
+enum {
+    MA_TRANSPORT_UNKNOWN = 0,
+    MA_TRANSPORT_CONSOLE,
+    MA_TRANSPORT_SERIAL,
+    MA_TRANSPORT_SPI,
+    MA_TRANSPORT_I2C,
+    MA_TRANSPORT_MQTT,
+    MA_TRANSPORT_TCP,
+    MA_TRANSPORT_UDP,
+    MA_TRANSPORT_RTSP,
+    MA_TRANSPORT_WS,
+};
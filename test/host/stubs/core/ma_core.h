@@ -0,0 +1,88 @@
+#pragma once
+
+// Host stand-in for the sscma-micro core: the types, errors and macros the node sources use.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+typedef int ma_err_t;
+typedef int64_t ma_tick_t;
+
+enum {
+    MA_OK       = 0,
+    MA_AGAIN    = -1,
+    MA_ELOG     = -2,
+    MA_ETIMEOUT = -3,
+    MA_EIO      = -4,
+    MA_EINVAL   = -5,
+    MA_ENOMEM   = -6,
+    MA_EBUSY    = -7,
+    MA_ENOTSUP  = -8,
+    MA_EPERM    = -9,
+    MA_ENOENT   = -10,
+    MA_EEXIST   = -11,
+};
+
+enum {
+    MA_MSG_TYPE_RESP = 0,
+    MA_MSG_TYPE_EVT  = 1,
+    MA_MSG_TYPE_LOG  = 2,
+};
+
+typedef struct {
+    float x;
+    float y;
+    float w;
+    float h;
+    float score;
+    int target;
+} ma_bbox_t;
+
+typedef enum {
+    MA_PIXEL_FORMAT_UNKNOWN = 0,
+    MA_PIXEL_FORMAT_RGB888,
+    MA_PIXEL_FORMAT_H264,
+    MA_PIXEL_FORMAT_JPEG,
+} ma_pixel_format_t;
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    int32_t width;
+    int32_t height;
+    ma_pixel_format_t format;
+    int rotate;
+    bool key;
+    bool physical;
+} ma_img_t;
+
+namespace ma {
+
+class Exception : public std::runtime_error {
+public:
+    Exception(ma_err_t err, const std::string& msg) : std::runtime_error(msg), err_(err) {}
+    ma_err_t err() const {
+        return err_;
+    }
+
+private:
+    ma_err_t err_;
+};
+
+}  // namespace ma
+
+#define MA_TRY      try
+#define MA_CATCH(e) catch (e)
+#define MA_THROW(e) throw e
+
+#define MA_LOGE(tag, ...) (fprintf(stderr, "E %s: ", tag), fprintf(stderr, __VA_ARGS__), fprintf(stderr, "\n"))
+#define MA_LOGW(tag, ...) (fprintf(stderr, "W %s: ", tag), fprintf(stderr, __VA_ARGS__), fprintf(stderr, "\n"))
+#define MA_LOGI(tag, ...) ((void)(tag))
+#define MA_LOGD(tag, ...) ((void)(tag))
@@ -0,0 +1,51 @@
+#pragma once
+
+// Host stand-in for the sscma-micro ring buffer, unbounded and single threaded, enough for the
+// transports' receive paths.
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+
+namespace ma {
+
+template <typename T>
+class SPSCRingBuffer {
+public:
+    explicit SPSCRingBuffer(size_t size) {
+        (void)size;
+    }
+    size_t push(const T* data, size_t length) {
+        items_.insert(items_.end(), data, data + length);
+        return length;
+    }
+    size_t pop(T* data, size_t length) {
+        size_t n = 0;
+        while (n < length && !items_.empty()) {
+            data[n++] = items_.front();
+            items_.pop_front();
+        }
+        return n;
+    }
+    size_t popIf(T* data, size_t length, T delimiter) {
+        size_t n = 0;
+        while (n < items_.size() && items_[n] != delimiter) {
+            n++;
+        }
+        return n < items_.size() ? pop(data, std::min(length, n + 1)) : 0;
+    }
+    size_t size() const {
+        return items_.size();
+    }
+    bool empty() const {
+        return items_.empty();
+    }
+    void clear() {
+        items_.clear();
+    }
+
+private:
+    std::deque<T> items_;
+};
+
+}  // namespace ma
@@ -0,0 +1,112 @@
+#pragma once
+
+// Host stand-in for the libhv websocket server. A channel records what is sent to it; a test stalls
+// it to stand for a client whose socket stopped draining, and plays the server's callbacks through
+// the last service registered.
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace hv {
+
+using Json = nlohmann::json;
+
+enum ws_opcode {
+    WS_OPCODE_CONTINUE = 0x0,
+    WS_OPCODE_TEXT     = 0x1,
+    WS_OPCODE_BINARY   = 0x2,
+};
+
+class HttpRequest {
+public:
+    std::string GetParam(const std::string& key) {
+        auto it = params.find(key);
+        return it == params.end() ? std::string() : it->second;
+    }
+    std::map<std::string, std::string> params;
+};
+using HttpRequestPtr = std::shared_ptr<HttpRequest>;
+
+class WebSocketChannel {
+public:
+    explicit WebSocketChannel(std::string address) : stalled(false), address_(std::move(address)), connected_(true) {}
+
+    int send(const char* data, int length, ws_opcode opcode = WS_OPCODE_BINARY, bool fin = true) {
+        (void)opcode;
+        (void)fin;
+        std::lock_guard<std::mutex> lock(mutex_);
+        messages_.emplace_back(data, length);
+        return length;
+    }
+    // a stalled socket holds everything written to it, as far as the sender can tell
+    size_t writeBufsize() {
+        return stalled ? SIZE_MAX / 2 : 0;
+    }
+    bool isConnected() {
+        return connected_;
+    }
+    int close(bool async = false) {
+        (void)async;
+        if (connected_.exchange(false) && onclose) {
+            onclose();
+        }
+        return 0;
+    }
+    std::string peeraddr() {
+        return address_;
+    }
+
+    std::vector<std::string> messages() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return messages_;
+    }
+
+    std::atomic<bool> stalled;
+    std::function<void()> onclose;
+
+private:
+    std::string address_;
+    std::atomic<bool> connected_;
+    std::mutex mutex_;
+    std::vector<std::string> messages_;
+};
+
+}  // namespace hv
+
+using WebSocketChannelPtr = std::shared_ptr<hv::WebSocketChannel>;
+
+namespace hv {
+
+struct WebSocketService {
+    std::function<void(const WebSocketChannelPtr&, const HttpRequestPtr&)> onopen;
+    std::function<void(const WebSocketChannelPtr&, const std::string&)> onmessage;
+    std::function<void(const WebSocketChannelPtr&)> onclose;
+};
+
+class WebSocketServer {
+public:
+    void registerWebSocketService(WebSocketService* service) {
+        registered() = service;
+    }
+    int start() {
+        return 0;
+    }
+    int stop() {
+        return 0;
+    }
+    static WebSocketService*& registered() {
+        static WebSocketService* service = nullptr;
+        return service;
+    }
+
+    int port = 0;
+};
+
+}  // namespace hv
@@ -0,0 +1,5 @@
+#pragma once
+
+// Host stand-in for the one FFmpeg macro AsyncWriter returns.
+
+#define AVERROR(e) (-(e))
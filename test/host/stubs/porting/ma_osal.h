@@ -0,0 +1,3 @@
+#pragma once
+
+#include "porting/ma_porting.h"
@@ -0,0 +1,157 @@
+#pragma once
+
+// Host stand-in for the sscma-micro OSAL on std primitives. Ticks are microseconds.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "core/ma_core.h"
+
+namespace ma {
+
+class Tick {
+public:
+    static constexpr ma_tick_t waitForever = INT64_MAX;
+
+    static ma_tick_t current() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static ma_tick_t fromMilliseconds(int64_t ms) {
+        return ms * 1000;
+    }
+    static ma_tick_t fromSeconds(int64_t s) {
+        return s * 1000000;
+    }
+    static ma_tick_t fromMicroseconds(int64_t us) {
+        return us;
+    }
+    static int64_t toMicroseconds(ma_tick_t tick) {
+        return tick;
+    }
+};
+
+// lockable through const references, as const members take their object's lock
+class Mutex {
+public:
+    void lock() const {
+        mutex_.lock();
+    }
+    void unlock() const {
+        mutex_.unlock();
+    }
+
+private:
+    mutable std::recursive_mutex mutex_;
+};
+
+class Guard {
+public:
+    explicit Guard(const Mutex& mutex) : mutex_(mutex) {
+        mutex_.lock();
+    }
+    ~Guard() {
+        mutex_.unlock();
+    }
+
+private:
+    const Mutex& mutex_;
+};
+
+class Semaphore {
+public:
+    explicit Semaphore(size_t count = 0) : count_(count) {}
+    bool wait(ma_tick_t timeout = Tick::waitForever) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto ready = [this] { return count_ > 0; };
+        if (timeout == Tick::waitForever) {
+            cv_.wait(lock, ready);
+        } else if (!cv_.wait_for(lock, std::chrono::microseconds(timeout), ready)) {
+            return false;
+        }
+        count_--;
+        taken++;
+        return true;
+    }
+    void signal() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        count_++;
+        cv_.notify_one();
+    }
+
+    // signals taken by every semaphore, for the tests that check a wait was not spurious
+    static inline std::atomic<uint64_t> taken{0};
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t count_;
+};
+
+class MessageBox {
+public:
+    explicit MessageBox(size_t size = 1) : size_(size) {}
+    bool post(void* msg, ma_tick_t timeout = Tick::waitForever) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!wait(lock, timeout, [this] { return queue_.size() < size_; })) {
+            return false;
+        }
+        queue_.push_back(msg);
+        cv_.notify_all();
+        return true;
+    }
+    bool fetch(void** msg, ma_tick_t timeout = Tick::waitForever) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!wait(lock, timeout, [this] { return !queue_.empty(); })) {
+            return false;
+        }
+        *msg = queue_.front();
+        queue_.pop_front();
+        cv_.notify_all();
+        return true;
+    }
+
+private:
+    template <typename P>
+    bool wait(std::unique_lock<std::mutex>& lock, ma_tick_t timeout, P ready) {
+        if (timeout == Tick::waitForever) {
+            cv_.wait(lock, ready);
+            return true;
+        }
+        return cv_.wait_for(lock, std::chrono::microseconds(timeout), ready);
+    }
+
+    size_t size_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<void*> queue_;
+};
+
+class Thread {
+public:
+    Thread(const char* name, void (*entry)(void*), void* arg = nullptr) : entry_(entry), arg_(arg) {
+        (void)name;
+    }
+    ~Thread() {
+        join();
+    }
+    bool start(void* arg = nullptr) {
+        thread_ = std::thread(entry_, arg != nullptr ? arg : arg_);
+        return true;
+    }
+    void join() {
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+private:
+    void (*entry_)(void*);
+    void* arg_;
+    std::thread thread_;
+};
+
+}  // namespace ma
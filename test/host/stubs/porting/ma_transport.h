@@ -0,0 +1,25 @@
+#pragma once
+
+#include "core/ma_common.h"
+
+namespace ma {
+
+class Transport {
+public:
+    explicit Transport(int type) : m_type(type), m_initialized(false) {}
+    virtual ~Transport() = default;
+
+    virtual ma_err_t init(const void* config) noexcept                           = 0;
+    virtual void deInit() noexcept                                               = 0;
+    virtual size_t available() const noexcept                                    = 0;
+    virtual size_t send(const char* data, size_t length) noexcept                = 0;
+    virtual size_t receive(char* data, size_t length) noexcept                   = 0;
+    virtual size_t receiveIf(char* data, size_t length, char delimiter) noexcept = 0;
+    virtual size_t flush() noexcept                                              = 0;
+
+protected:
+    int m_type;
+    bool m_initialized;
+};
+
+}  // namespace ma
@@ -0,0 +1,92 @@
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+#include "async_writer.h"
+#include "check.h"
+
+extern "C" {
+#include <libavutil/error.h>
+}
+
+using namespace ma;
+using namespace ma::node;
+
+static std::string directory() {
+    char path[] = "/tmp/async_writer_XXXXXX";
+    return std::string(mkdtemp(path)) + "/";
+}
+
+static std::vector<uint8_t> readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// what goes in in pieces of any size comes out whole, and the file ends with the data even when
+// more was reserved
+static void roundTrip(const std::string& dir) {
+    AsyncWriter writer;
+    CHECK(!writer.open(dir + "early.mp4", 0));  // not started
+    writer.start("writer");
+
+    std::mt19937 rng(5);
+    std::vector<uint8_t> data(3 * WRITER_BUFFER_COUNT * WRITER_BUFFER_SIZE + 12345);
+    for (auto& byte : data) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    for (size_t prealloc : {static_cast<size_t>(0), static_cast<size_t>(64 * 1024 * 1024)}) {
+        std::string path = dir + "clip" + std::to_string(prealloc) + ".mp4";
+        CHECK(writer.open(path, prealloc));
+        size_t done = 0;
+        while (done < data.size()) {
+            size_t size = std::min<size_t>(data.size() - done, 1 + rng() % 40000);
+            CHECK(AsyncWriter::writePacket(&writer, data.data() + done, static_cast<int>(size)) == static_cast<int>(size));
+            done += size;
+            if (rng() % 16 == 0) {
+                writer.flush();  // the end of a fragment
+            }
+        }
+        writer.close();
+        CHECK(!writer.failed());
+        CHECK(readFile(path) == data);
+        struct stat info;
+        CHECK(stat(path.c_str(), &info) == 0 && static_cast<size_t>(info.st_blocks) * 512 < data.size() + 1024 * 1024);
+    }
+    json stats = writer.stats();
+    CHECK(stats["files"].get<uint64_t>() == 2);
+    CHECK(stats["bytes"].get<uint64_t>() == 2 * data.size());
+    CHECK(stats["queued"].get<uint32_t>() == 0);
+    CHECK(stats["peak"].get<uint32_t>() <= WRITER_BUFFER_COUNT);
+    writer.stop();
+}
+
+// a failed write shows at the next packet, which the muxer then sees as an I/O error
+static void failure() {
+    AsyncWriter writer;
+    writer.start("writer");
+    CHECK(!writer.open("/nonexistent/clip.mp4", 0));
+    CHECK(writer.open("/dev/full", 1024 * 1024));
+    std::vector<uint8_t> data(WRITER_BUFFER_SIZE, 1);
+    writer.write(data.data(), data.size());
+    for (int i = 0; i < 2000 && !writer.failed(); i++) {
+        usleep(1000);
+    }
+    CHECK(writer.failed());
+    CHECK(AsyncWriter::writePacket(&writer, data.data(), 16) == AVERROR(EIO));
+    writer.close();
+    json stats = writer.stats();
+    CHECK(stats["failed"].get<bool>());
+    CHECK(stats["prealloc_failed"].get<uint64_t>() == 1);
+}
+
+int main() {
+    std::string dir = directory();
+    roundTrip(dir);
+    failure();
+    std::filesystem::remove_all(dir);
+    return CHECK_DONE();
+}
@@ -0,0 +1,112 @@
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+
+#include "app_ipcam_ll.h"
+#include "check.h"
+
+// the stream list of a VENC channel: items are copied in on push, handled and freed by the consumer
+
+static std::atomic<int> handled{0};
+static std::atomic<int> freed{0};
+static std::atomic<int> last{-1};
+static std::atomic<bool> ordered{true};
+static std::atomic<bool> blocked{false};
+
+static int save(void** dst, void* src) {
+    int* item = static_cast<int*>(malloc(sizeof(int)));
+    *item     = *static_cast<int*>(src);
+    *dst      = item;
+    return 0;
+}
+
+static int release(void** src) {
+    free(*src);
+    *src = nullptr;
+    freed++;
+    return 0;
+}
+
+static void handle(void* data, void*) {
+    while (blocked) {
+        usleep(1000);
+    }
+    int seq = *static_cast<int*>(data);
+    if (seq <= last) {
+        ordered = false;
+    }
+    last = seq;
+    handled++;
+}
+
+static void* start() {
+    APP_DATA_PARAM_S param = {nullptr, save, release, handle};
+    void* ctx              = nullptr;
+    CHECK(app_ipcam_LList_Data_Init(&ctx, &param) == 0);
+    handled = freed = 0;
+    last            = -1;
+    return ctx;
+}
+
+static void waitHandled(int count) {
+    for (int i = 0; i < 2000 && handled < count; i++) {
+        usleep(1000);
+    }
+}
+
+// every item pushed is handled once, in order, and freed
+static void order() {
+    void* ctx       = start();
+    const int count = 100000;
+    for (int i = 0; i < count; i++) {
+        while (app_ipcam_LList_Data_Push(&i, ctx) != 0) {
+            std::this_thread::yield();
+        }
+    }
+    waitHandled(count);
+    CHECK(handled == count);
+    CHECK(ordered);
+
+    APP_DATA_STAT_S stat;
+    CHECK(app_ipcam_LList_Data_Stat_Get(ctx, &stat) == 0);
+    CHECK(stat.u32Depth == 0);
+    CHECK(stat.u64Handled == static_cast<uint64_t>(count));
+    CHECK(stat.u32PeakDepth <= APP_DATA_RING_DEPTH);
+    CHECK(app_ipcam_LList_Data_DeInit(&ctx) == 0);
+    CHECK(ctx == nullptr);
+    CHECK(freed == count);
+}
+
+// a stalled consumer makes the producer drop the newest items, never block
+static void full() {
+    void* ctx = start();
+    blocked   = true;
+    int first = 0;
+    CHECK(app_ipcam_LList_Data_Push(&first, ctx) == 0);
+    usleep(10000);  // the consumer is now inside the handler of the first item
+    int pushed = 1;
+    for (int i = 1; i < APP_DATA_RING_DEPTH + 10; i++) {
+        if (app_ipcam_LList_Data_Push(&i, ctx) == 0) {
+            pushed++;
+        }
+    }
+    CHECK(pushed == APP_DATA_RING_DEPTH + 1);
+    APP_DATA_STAT_S stat;
+    app_ipcam_LList_Data_Stat_Get(ctx, &stat);
+    CHECK(stat.u64Dropped == 9);
+    CHECK(stat.u32Depth == APP_DATA_RING_DEPTH);
+
+    blocked = false;
+    waitHandled(pushed);
+    CHECK(handled == pushed);
+    CHECK(app_ipcam_LList_Data_DeInit(&ctx) == 0);
+    CHECK(freed == pushed);
+}
+
+int main() {
+    order();
+    full();
+    return CHECK_DONE();
+}
@@ -0,0 +1,118 @@
+#include "camera.h"
+#include "check.h"
+#include "event_ring.h"
+
+using namespace ma;
+using namespace ma::node;
+
+std::atomic<int> ma::node::held_streams{0};
+
+static const ma_tick_t FRAME = Tick::fromMicroseconds(33333);
+
+static uint8_t stream[1024];
+
+static videoFrame* video(int seq, bool key, size_t size = 1000, bool zerocopy = false) {
+    videoFrame* frame = new videoFrame();
+    frame->chn        = CHN_H264;
+    frame->timestamp  = seq * FRAME;
+    frame->img.key    = key;
+    frame->img.size   = size;
+    if (zerocopy) {
+        frame->img.data = stream;
+        frame->handle   = stream;
+        held_streams++;
+    } else {
+        frame->img.data = static_cast<uint8_t*>(FramePool::instance().allocate(size));
+    }
+    frame->ref();
+    return frame;
+}
+
+static audioFrame* audio(int seq) {
+    audioFrame* frame = new audioFrame();
+    frame->chn        = CHN_AAC;
+    frame->timestamp  = seq * FRAME;
+    frame->size       = 100;
+    frame->data       = static_cast<uint8_t*>(FramePool::instance().allocate(frame->size));
+    frame->ref();
+    return frame;
+}
+
+static void release(std::vector<Frame*>& frames) {
+    for (auto frame : frames) {
+        frame->release();
+    }
+    frames.clear();
+}
+
+// the ring starts at an IDR and holds the pre-roll, at most a GOP more
+static void span() {
+    EventRing ring;
+    ring.configure(Tick::fromSeconds(1), 1024 * 1024);
+    for (int i = 0; i < 5; i++) {
+        ring.push(video(i, false));  // before the first IDR, nothing to start a clip with
+    }
+    CHECK(ring.empty());
+    for (int i = 5; i < 200; i++) {
+        ring.push(video(i, i % 10 == 0));
+        ring.push(audio(i));
+    }
+    std::vector<Frame*> frames;
+    ring.drain(frames);
+    CHECK(ring.empty());
+    CHECK(!frames.empty() && frames.front()->chn == CHN_H264 && static_cast<videoFrame*>(frames.front())->img.key);
+    ma_tick_t covered = frames.back()->timestamp - frames.front()->timestamp;
+    CHECK(covered >= Tick::fromSeconds(1) && covered < Tick::fromSeconds(1) + 10 * FRAME);
+    bool ordered = true;
+    for (size_t i = 1; i < frames.size(); i++) {
+        ordered &= frames[i]->timestamp >= frames[i - 1]->timestamp;
+    }
+    CHECK(ordered);
+    release(frames);
+    CHECK(FramePool::instance().stats()["bytes"].get<uint64_t>() == 0);
+}
+
+// over its byte limit the ring drops whole GOPs, all of them when one alone is too large
+static void bytes() {
+    EventRing ring;
+    ring.configure(Tick::fromSeconds(60), 25000);
+    for (int i = 0; i < 40; i++) {
+        ring.push(video(i, i % 10 == 0));
+    }
+    json stats = ring.stats();
+    CHECK(stats["bytes"].get<size_t>() <= 25000);
+    CHECK(stats["overflows"].get<uint64_t>() > 0);
+    std::vector<Frame*> frames;
+    ring.drain(frames);
+    CHECK(frames.size() == 20 && frames.front()->timestamp == 20 * FRAME);
+    release(frames);
+
+    for (int i = 0; i < 30; i++) {
+        ring.push(video(i, i == 0, 1000));
+    }
+    CHECK(ring.empty());
+    ring.configure(Tick::fromSeconds(1), 0);
+    ring.push(video(0, true));
+    CHECK(ring.empty());
+}
+
+// zero-copy frames are held as copies, the encoder streams go back at once
+static void zeroCopy() {
+    EventRing ring;
+    ring.configure(Tick::fromSeconds(1), 1024 * 1024);
+    for (int i = 0; i < 20; i++) {
+        ring.push(video(i, i % 10 == 0, sizeof(stream), true));
+    }
+    CHECK(held_streams == 0);
+    CHECK(ring.stats()["copies"].get<uint64_t>() == 20);
+    ring.clear();
+    CHECK(ring.empty());
+    CHECK(FramePool::instance().stats()["bytes"].get<uint64_t>() == 0);
+}
+
+int main() {
+    span();
+    bytes();
+    zeroCopy();
+    return CHECK_DONE();
+}
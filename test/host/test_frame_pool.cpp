@@ -0,0 +1,96 @@
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "frame_pool.h"
+
+using namespace ma;
+using namespace ma::node;
+
+// a released block is handed out again to the next request of its class
+static void recycle() {
+    FramePool& pool = FramePool::instance();
+    void* first     = pool.allocate(1000);
+    CHECK(first != nullptr);
+    memset(first, 0xa5, 1000);
+    pool.release(first);
+    void* second = pool.allocate(2000);
+    CHECK(second == first);
+    pool.release(second);
+
+    json stats = pool.stats();
+    CHECK(stats["classes"][1]["hits"].get<uint64_t>() >= 1);
+    CHECK(stats["classes"][1]["used"].get<uint32_t>() == 0);
+}
+
+// blocks above the largest class come from the heap and go back to it
+static void oversize() {
+    FramePool& pool   = FramePool::instance();
+    uint64_t before   = pool.stats()["oversize"].get<uint64_t>();
+    uint64_t bytes    = pool.stats()["bytes"].get<uint64_t>();
+    const size_t size = 4 * 1024 * 1024;
+    uint8_t* data     = static_cast<uint8_t*>(pool.allocate(size));
+    CHECK(data != nullptr);
+    data[0] = data[size - 1] = 1;
+    CHECK(pool.stats()["oversize"].get<uint64_t>() == before + 1);
+    CHECK(pool.stats()["bytes"].get<uint64_t>() == bytes + size);
+    pool.release(data);
+    CHECK(pool.stats()["bytes"].get<uint64_t>() == bytes);
+    pool.release(nullptr);
+}
+
+// no more blocks are cached than a class holds, the rest are freed
+static void capacity() {
+    FramePool& pool = FramePool::instance();
+    pool.trim();
+    std::vector<void*> blocks;
+    for (int i = 0; i < 100; i++) {
+        blocks.push_back(pool.allocate(512 * 1024));
+    }
+    for (auto block : blocks) {
+        pool.release(block);
+    }
+    json cls = pool.stats()["classes"][5];
+    CHECK(cls["free"].get<size_t>() == 4);
+    CHECK(cls["used"].get<uint32_t>() == 0);
+    pool.trim();
+    CHECK(pool.stats()["cached"].get<uint64_t>() == 0);
+}
+
+// blocks move between threads, as frames do from the capture callbacks to the nodes
+static void threads() {
+    FramePool& pool = FramePool::instance();
+    uint64_t bytes  = pool.stats()["bytes"].get<uint64_t>();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; t++) {
+        workers.emplace_back([&pool, t] {
+            std::vector<uint8_t*> held;
+            for (int i = 0; i < 20000; i++) {
+                size_t size   = 64 + (i * 7919 + t) % (96 * 1024);
+                uint8_t* data = static_cast<uint8_t*>(pool.allocate(size));
+                data[0] = data[size - 1] = static_cast<uint8_t>(t);
+                held.push_back(data);
+                if (held.size() > 16) {
+                    pool.release(held.front());
+                    held.erase(held.begin());
+                }
+            }
+            for (auto data : held) {
+                pool.release(data);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    CHECK(pool.stats()["bytes"].get<uint64_t>() == bytes);
+}
+
+int main() {
+    recycle();
+    oversize();
+    capacity();
+    threads();
+    return CHECK_DONE();
+}
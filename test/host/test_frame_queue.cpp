@@ -0,0 +1,190 @@
+#include <thread>
+
+#include "camera.h"
+#include "check.h"
+
+using namespace ma;
+using namespace ma::node;
+
+std::atomic<int> ma::node::held_streams{0};
+
+static videoFrame* video(int chn, bool key, int seq) {
+    videoFrame* frame = new videoFrame();
+    frame->chn        = chn;
+    frame->img.key    = key;
+    frame->img.size   = 1;
+    frame->img.data   = static_cast<uint8_t*>(FramePool::instance().allocate(1));
+    frame->timestamp  = seq;
+    return frame;
+}
+
+static int fetchSeq(FrameQueue& queue) {
+    void* item = nullptr;
+    if (!queue.fetch(&item, Tick::fromMilliseconds(0))) {
+        return -1;
+    }
+    Frame* frame = static_cast<Frame*>(item);
+    int seq      = static_cast<int>(frame->timestamp);
+    frame->release();
+    return seq;
+}
+
+// a single slot holds one frame, never reads as empty when full or full when empty
+static void singleSlot() {
+    FrameQueue queue(1);
+    CHECK(queue.capacity() == 1);
+    CHECK(queue.post(video(CHN_RAW, true, 1), FRAME_POLICY_DROP_OLDEST));
+    CHECK(queue.post(video(CHN_RAW, true, 2), FRAME_POLICY_DROP_OLDEST));
+    CHECK(queue.size() == 1);
+    CHECK(fetchSeq(queue) == 2);
+    CHECK(fetchSeq(queue) == -1);
+
+    CHECK(queue.post(video(CHN_RAW, true, 3), FRAME_POLICY_DROP_NEWEST));
+    CHECK(!queue.post(video(CHN_RAW, true, 4), FRAME_POLICY_DROP_NEWEST));
+    CHECK(fetchSeq(queue) == 3);
+    CHECK(fetchSeq(queue) == -1);
+}
+
+static void dropOldest() {
+    FrameQueue queue(4);
+    for (int i = 0; i < 10; i++) {
+        CHECK(queue.post(video(CHN_RAW, true, i), FRAME_POLICY_DROP_OLDEST));
+    }
+    for (int i = 6; i < 10; i++) {
+        CHECK(fetchSeq(queue) == i);
+    }
+    CHECK(fetchSeq(queue) == -1);
+}
+
+// no delta frame is ever delivered without the frames it refers to
+static void keyframe() {
+    FrameQueue queue(4);
+    queue.post(video(CHN_H264, true, 0), FRAME_POLICY_KEYFRAME);
+    for (int i = 1; i < 6; i++) {
+        queue.post(video(CHN_H264, false, i), FRAME_POLICY_KEYFRAME);
+    }
+    // the delta frame 4 found the queue full and was dropped, 5 waits for a key frame
+    CHECK(fetchSeq(queue) == 0);
+    CHECK(fetchSeq(queue) == 1);
+    queue.post(video(CHN_H264, true, 6), FRAME_POLICY_KEYFRAME);
+    queue.post(video(CHN_H264, false, 7), FRAME_POLICY_KEYFRAME);
+    CHECK(fetchSeq(queue) == 2);
+    CHECK(fetchSeq(queue) == 3);
+    CHECK(fetchSeq(queue) == 6);
+    CHECK(fetchSeq(queue) == 7);
+    CHECK(fetchSeq(queue) == -1);
+}
+
+// a key frame arriving at a full queue replaces the GOP a slow consumer is behind on
+static void keyframeFlush() {
+    FrameQueue queue(4);
+    queue.post(video(CHN_H264, true, 0), FRAME_POLICY_KEYFRAME);
+    for (int i = 1; i < 6; i++) {
+        queue.post(video(CHN_H264, false, i), FRAME_POLICY_KEYFRAME);
+    }
+    CHECK(queue.post(video(CHN_H264, true, 6), FRAME_POLICY_KEYFRAME));
+    CHECK(queue.post(video(CHN_H264, false, 7), FRAME_POLICY_KEYFRAME));
+    CHECK(fetchSeq(queue) == 6);
+    CHECK(fetchSeq(queue) == 7);
+    CHECK(fetchSeq(queue) == -1);
+
+    // audio never evicts video, it would leave delta frames without their reference
+    videoFrame* key = video(CHN_H264, true, 8);
+    queue.post(key, FRAME_POLICY_KEYFRAME);
+    for (int i = 9; i < 12; i++) {
+        queue.post(video(CHN_H264, false, i), FRAME_POLICY_KEYFRAME);
+    }
+    audioFrame* audio = new audioFrame();
+    audio->chn        = CHN_AAC;
+    CHECK(!queue.post(audio, FRAME_POLICY_KEYFRAME));
+    for (int i = 8; i < 12; i++) {
+        CHECK(fetchSeq(queue) == i);
+    }
+}
+
+// two H.264 channels in one queue each wait for their own key frame after a drop
+static void sharedChannels() {
+    FrameQueue queue(2);
+    queue.post(video(CHN_H264, true, 0), FRAME_POLICY_KEYFRAME);
+    queue.post(video(CHN_SUB, true, 1), FRAME_POLICY_KEYFRAME);
+    CHECK(!queue.post(video(CHN_H264, false, 2), FRAME_POLICY_KEYFRAME));
+    CHECK(!queue.post(video(CHN_SUB, false, 3), FRAME_POLICY_KEYFRAME));
+    CHECK(fetchSeq(queue) == 0);
+    CHECK(fetchSeq(queue) == 1);
+    CHECK(queue.post(video(CHN_H264, true, 4), FRAME_POLICY_KEYFRAME));
+    CHECK(!queue.post(video(CHN_SUB, false, 5), FRAME_POLICY_KEYFRAME));
+    CHECK(queue.post(video(CHN_H264, false, 6), FRAME_POLICY_KEYFRAME));
+    CHECK(fetchSeq(queue) == 4);
+    CHECK(queue.post(video(CHN_SUB, true, 7), FRAME_POLICY_KEYFRAME));
+    CHECK(fetchSeq(queue) == 6);
+    CHECK(fetchSeq(queue) == 7);
+    CHECK(fetchSeq(queue) == -1);
+}
+
+// evicted and flushed frames take their signals along, so an empty queue never wakes its consumer
+static void signals() {
+    FrameQueue queue(4);
+    for (int i = 0; i < 1000; i++) {
+        queue.post(video(CHN_RAW, true, i), FRAME_POLICY_DROP_OLDEST);
+    }
+    for (int i = 0; i < 10; i++) {
+        queue.post(video(CHN_H264, i % 5 == 0, 1000 + i), FRAME_POLICY_KEYFRAME);
+    }
+    CHECK(fetchSeq(queue) == 1005);
+    while (fetchSeq(queue) >= 0) {
+    }
+    uint64_t taken = Semaphore::taken;
+    void* item     = nullptr;
+    CHECK(!queue.fetch(&item, Tick::fromMilliseconds(20)));
+    CHECK(Semaphore::taken == taken);
+
+    // a consumer waiting on the empty queue still wakes for the next frame
+    std::thread producer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        queue.post(video(CHN_RAW, true, 2000), FRAME_POLICY_DROP_OLDEST);
+    });
+    CHECK(queue.fetch(&item, Tick::fromSeconds(1)));
+    producer.join();
+    CHECK(static_cast<Frame*>(item)->timestamp == 2000);
+    static_cast<Frame*>(item)->release();
+    CHECK(!queue.fetch(&item, Tick::fromMilliseconds(0)) && Semaphore::taken == taken + 1);
+}
+
+// frames posted from one thread come out once each, in order, on another
+static void threads() {
+    FrameQueue queue(8);
+    const int count = 200000;
+    std::thread consumer([&] {
+        int last = -1;
+        int seen = 0;
+        while (seen < count) {
+            void* item = nullptr;
+            if (!queue.fetch(&item, Tick::fromMilliseconds(100))) {
+                continue;
+            }
+            Frame* frame = static_cast<Frame*>(item);
+            CHECK(frame->timestamp > last);
+            last = static_cast<int>(frame->timestamp);
+            frame->release();
+            seen++;
+        }
+    });
+    for (int i = 0; i < count; i++) {
+        while (!queue.post(video(CHN_RAW, true, i), FRAME_POLICY_DROP_NEWEST)) {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+    CHECK(queue.size() == 0);
+}
+
+int main() {
+    singleSlot();
+    dropOldest();
+    keyframe();
+    keyframeFlush();
+    sharedChannels();
+    signals();
+    threads();
+    return CHECK_DONE();
+}
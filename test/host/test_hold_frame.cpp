@@ -0,0 +1,75 @@
+#include "camera.h"
+#include "check.h"
+
+using namespace ma;
+using namespace ma::node;
+
+std::atomic<int> ma::node::held_streams{0};
+
+static uint8_t stream[4096];
+
+// a zero-copy frame over the encoder's buffer, its two NALs as blocks
+static videoFrame* zeroCopy(bool key, int seq) {
+    videoFrame* frame = new videoFrame();
+    frame->chn        = CHN_H264;
+    frame->timestamp  = seq;
+    frame->img.key    = key;
+    frame->img.size   = sizeof(stream);
+    frame->img.data   = stream;
+    frame->handle     = stream;
+    frame->blocks.push_back({stream, 100});
+    frame->blocks.push_back({stream + 100, sizeof(stream) - 100});
+    frame->ref();
+    held_streams++;
+    return frame;
+}
+
+// a held zero-copy frame is a pool copy, the encoder stream goes back at once
+static void copy() {
+    for (size_t i = 0; i < sizeof(stream); i++) {
+        stream[i] = static_cast<uint8_t>(i * 31);
+    }
+    videoFrame* frame = holdFrame(zeroCopy(true, 1));
+    CHECK(held_streams == 0);
+    CHECK(frame != nullptr && frame->handle == nullptr);
+    CHECK(frame->img.data != stream && memcmp(frame->img.data, stream, sizeof(stream)) == 0);
+    CHECK(frame->blocks.size() == 2);
+    CHECK(frame->blocks[0].first == frame->img.data && frame->blocks[0].second == 100);
+    CHECK(frame->blocks[1].first == frame->img.data + 100);
+    CHECK(frame->timestamp == 1 && frame->img.key);
+    frame->release();
+
+    // a pool frame is held as it is
+    videoFrame* pooled = new videoFrame();
+    pooled->img.size   = 16;
+    pooled->img.data   = static_cast<uint8_t*>(FramePool::instance().allocate(16));
+    CHECK(holdFrame(pooled) == pooled);
+    pooled->release();
+}
+
+// the GOP cache holds copies, so viewers joining late never pin encoder streams
+static void gopCache() {
+    GopCache cache;
+    cache.configure(8, 1024 * 1024);
+    for (int i = 0; i < 5; i++) {
+        cache.push(zeroCopy(i == 0, i));
+    }
+    CHECK(held_streams == 0);
+    CHECK(cache.stats()["copies"].get<uint64_t>() == 5);
+
+    std::vector<videoFrame*> frames;
+    CHECK(cache.snapshot(frames, 3) == 3);
+    cache.clear();
+    for (size_t i = 0; i < frames.size(); i++) {
+        CHECK(static_cast<size_t>(frames[i]->timestamp) == i);
+        CHECK(memcmp(frames[i]->img.data, stream, sizeof(stream)) == 0);
+        frames[i]->release();
+    }
+    CHECK(FramePool::instance().stats()["bytes"].get<uint64_t>() == 0);
+}
+
+int main() {
+    copy();
+    gopCache();
+    return CHECK_DONE();
+}
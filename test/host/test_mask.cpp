@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <random>
+#include <set>
+#include <utility>
+
+#include "check.h"
+#include "mask.h"
+
+using namespace ma::node;
+
+// reference versions reading the bitmap a pixel at a time
+
+static bool pixel(const std::vector<uint8_t>& bits, int32_t width, int32_t x, int32_t y) {
+    size_t n = static_cast<size_t>(y) * width + x;
+    return (bits[n >> 3] >> (n & 7)) & 1;
+}
+
+static std::vector<uint8_t> random(int32_t width, int32_t height, std::mt19937& rng, int density) {
+    std::vector<uint8_t> bits((static_cast<size_t>(width) * height + 7) / 8, 0);
+    for (size_t n = 0; n < static_cast<size_t>(width) * height; n++) {
+        if (static_cast<int>(rng() % 100) < density) {
+            bits[n >> 3] |= 1 << (n & 7);
+        }
+    }
+    return bits;
+}
+
+static void set(std::vector<uint8_t>& bits, int32_t width, int32_t x, int32_t y) {
+    size_t n = static_cast<size_t>(y) * width + x;
+    bits[n >> 3] |= 1 << (n & 7);
+}
+
+// blob label of each pixel, 8-connected, -1 for background; returns the label of the largest blob
+static int label(const std::vector<uint8_t>& bits, int32_t width, int32_t height, std::vector<int>& labels) {
+    labels.assign(static_cast<size_t>(width) * height, -1);
+    std::vector<int> area;
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            if (!pixel(bits, width, x, y) || labels[y * width + x] >= 0) {
+                continue;
+            }
+            int id = area.size();
+            area.push_back(0);
+            std::vector<std::pair<int32_t, int32_t>> stack{{x, y}};
+            labels[y * width + x] = id;
+            while (!stack.empty()) {
+                auto [cx, cy] = stack.back();
+                stack.pop_back();
+                area[id]++;
+                for (int32_t ny = cy - 1; ny <= cy + 1; ny++) {
+                    for (int32_t nx = cx - 1; nx <= cx + 1; nx++) {
+                        if (nx >= 0 && ny >= 0 && nx < width && ny < height && labels[ny * width + nx] < 0 && pixel(bits, width, nx, ny)) {
+                            labels[ny * width + nx] = id;
+                            stack.push_back({nx, ny});
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return area.empty() ? -1 : std::max_element(area.begin(), area.end()) - area.begin();
+}
+
+static void unpack() {
+    std::mt19937 rng(1);
+    for (auto [width, height] : std::vector<std::pair<int32_t, int32_t>>{{1, 1}, {7, 3}, {64, 2}, {65, 9}, {160, 160}, {37, 101}}) {
+        auto bits = random(width, height, rng, 40);
+        std::vector<uint8_t> dst(static_cast<size_t>(width) * height);
+        maskUnpack(bits.data(), width, height, dst.data());
+        bool same = true;
+        for (int32_t y = 0; y < height; y++) {
+            for (int32_t x = 0; x < width; x++) {
+                same &= dst[y * width + x] == (pixel(bits, width, x, y) ? 255 : 0);
+            }
+        }
+        CHECK(same);
+    }
+}
+
+static void runs() {
+    std::mt19937 rng(2);
+    for (auto [width, height] : std::vector<std::pair<int32_t, int32_t>>{{1, 1}, {63, 5}, {64, 4}, {130, 17}, {160, 160}}) {
+        for (int density : {0, 5, 50, 95, 100}) {
+            auto bits = random(width, height, rng, density);
+            std::vector<mask_run_t> expected;
+            for (int32_t y = 0; y < height; y++) {
+                for (int32_t x = 0; x < width; x++) {
+                    if (pixel(bits, width, x, y) && (x == 0 || !pixel(bits, width, x - 1, y))) {
+                        int32_t end = x;
+                        while (end < width && pixel(bits, width, end, y)) {
+                            end++;
+                        }
+                        expected.push_back({static_cast<int16_t>(y), static_cast<int16_t>(x), static_cast<int16_t>(end)});
+                    }
+                }
+            }
+            std::vector<mask_run_t> actual;
+            maskRuns(bits.data(), width, height, actual);
+            CHECK(actual.size() == expected.size());
+            bool same = actual.size() == expected.size();
+            for (size_t i = 0; same && i < actual.size(); i++) {
+                same = actual[i].row == expected[i].row && actual[i].start == expected[i].start && actual[i].end == expected[i].end;
+            }
+            CHECK(same);
+        }
+    }
+}
+
+static void rle() {
+    std::mt19937 rng(3);
+    for (auto [width, height] : std::vector<std::pair<int32_t, int32_t>>{{1, 1}, {5, 7}, {64, 64}, {100, 30}}) {
+        for (int density : {0, 10, 50, 100}) {
+            auto bits = random(width, height, rng, density);
+            std::vector<uint32_t> expected{0};
+            bool fg = false;
+            for (int32_t x = 0; x < width; x++) {
+                for (int32_t y = 0; y < height; y++) {
+                    if (pixel(bits, width, x, y) != fg) {
+                        fg = !fg;
+                        expected.push_back(0);
+                    }
+                    expected.back()++;
+                }
+            }
+            std::vector<uint32_t> actual;
+            maskRLE(bits.data(), width, height, actual);
+            CHECK(actual == expected);
+        }
+    }
+}
+
+static void contour() {
+    std::vector<mask_point_t> points;
+    std::vector<uint8_t> empty(16, 0);
+    maskContour(empty.data(), 8, 16, points);
+    CHECK(points.empty());
+
+    // a rectangle is its four corners, a single pixel itself
+    std::vector<uint8_t> box((32 * 16 + 7) / 8, 0);
+    for (int32_t y = 2; y <= 7; y++) {
+        for (int32_t x = 3; x <= 10; x++) {
+            set(box, 32, x, y);
+        }
+    }
+    set(box, 32, 20, 12);
+    maskContour(box.data(), 32, 16, points);
+    std::set<std::pair<int, int>> corners;
+    for (auto& point : points) {
+        corners.insert({point.x, point.y});
+    }
+    CHECK(points.size() == 4);
+    CHECK(corners == (std::set<std::pair<int, int>>{{3, 2}, {10, 2}, {10, 7}, {3, 7}}));
+
+    std::vector<uint8_t> dot((8 * 8 + 7) / 8, 0);
+    set(dot, 8, 5, 6);
+    maskContour(dot.data(), 8, 8, points);
+    CHECK(points.size() == 1 && points[0].x == 5 && points[0].y == 6);
+
+    // on noise every corner lies on the outer border of the largest blob
+    std::mt19937 rng(4);
+    for (int density : {30, 60, 90}) {
+        const int32_t width = 96, height = 64;
+        auto bits           = random(width, height, rng, density);
+        std::vector<int> labels;
+        int largest = label(bits, width, height, labels);
+        maskContour(bits.data(), width, height, points);
+        CHECK(!points.empty());
+        bool onBorder = true;
+        for (auto& point : points) {
+            int32_t x = point.x, y = point.y;
+            onBorder &= x >= 0 && y >= 0 && x < width && y < height && labels[y * width + x] == largest;
+            bool edge = x == 0 || y == 0 || x == width - 1 || y == height - 1;
+            for (int32_t ny = y - 1; !edge && ny <= y + 1; ny++) {
+                for (int32_t nx = x - 1; nx <= x + 1; nx++) {
+                    edge |= !pixel(bits, width, nx, ny);
+                }
+            }
+            onBorder &= edge;
+        }
+        CHECK(onBorder);
+    }
+}
+
+int main() {
+    unpack();
+    runs();
+    rle();
+    contour();
+    return CHECK_DONE();
+}
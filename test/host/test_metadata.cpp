@@ -0,0 +1,156 @@
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+#include "check.h"
+#include "metadata.h"
+
+using namespace ma;
+using namespace ma::node;
+
+namespace fs = std::filesystem;
+
+static std::string directory() {
+    char path[] = "/tmp/metadata_XXXXXX";
+    return std::string(mkdtemp(path)) + "/";
+}
+
+static std::string read(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static ma_bbox_t box(int target) {
+    return {0.5f, 0.5f, 0.1f, 0.1f, 0.9f, target};
+}
+
+// seconds before the open are held and written once it starts the file, older ones dropped
+static void sidecar(const std::string& dir) {
+    int64_t now = Tick::toMicroseconds(Tick::current()) / 1000000;
+    MetadataWriter writer;
+    writer.add(Tick::fromSeconds(now - 10), {box(1)}, {});  // before the clip
+    writer.add(Tick::fromSeconds(now - 3), {box(0)}, {7});
+    writer.add(Tick::fromSeconds(now - 2), {box(0), box(0)}, {7, -1});
+    writer.add(Tick::fromSeconds(now - 2), {box(0), box(3)}, {7, 8});
+    CHECK(writer.stats()["pending"].get<size_t>() == 2);
+
+    CHECK(writer.open(dir + "clip.mp4", Tick::fromSeconds(now - 3)));
+    CHECK(writer.opened());
+    CHECK(writer.path() == dir + "clip.meta");
+    CHECK(writer.stats()["pending"].get<size_t>() == 0);
+    writer.add(Tick::fromSeconds(now - 1), {box(300)}, {});
+    writer.add(Tick::fromSeconds(now - 1), {}, {});  // no boxes, no record
+    size_t size = writer.close();
+    CHECK(!writer.opened());
+    CHECK(writer.close() == 0);
+
+    std::string data = read(dir + "clip.meta");
+    CHECK(size == data.size());
+    CHECK(data.size() >= sizeof(metadata_header_t));
+    metadata_header_t header;
+    memcpy(&header, data.data(), sizeof(header));
+    CHECK(memcmp(header.magic, METADATA_MAGIC, 4) == 0);
+    CHECK(header.version == METADATA_VERSION);
+    CHECK(header.records == 3);
+    CHECK(header.duration >= 3);
+    CHECK(header.mask[0] == ((1ull << 0) | (1ull << 3)));
+    CHECK(header.mask[1] == (1ull << 63));  // class 255 counts as the last one
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data()) + sizeof(header);
+    uint16_t offset;
+    uint32_t track;
+    // second 0: one person, track 7
+    memcpy(&offset, p, 2);
+    CHECK(offset == 0 && p[2] == 1 && p[3] == 1);
+    CHECK(p[4] == 0 && p[5] == 1);
+    memcpy(&track, p + 6, 4);
+    CHECK(track == 7);
+    p += 10;
+    // second 1: most boxes of a class in one frame, tracks once each
+    memcpy(&offset, p, 2);
+    CHECK(offset == 1 && p[2] == 2 && p[3] == 2);
+    CHECK(p[4] == 0 && p[5] == 2 && p[6] == 3 && p[7] == 1);
+    memcpy(&track, p + 8, 4);
+    CHECK(track == 7);
+    memcpy(&track, p + 12, 4);
+    CHECK(track == 8);
+    p += 16;
+    // second 2: written by close
+    memcpy(&offset, p, 2);
+    CHECK(offset == 2 && p[2] == 1 && p[3] == 0);
+    CHECK(p[4] == 255 && p[5] == 1);
+    p += 6;
+    CHECK(p == reinterpret_cast<const uint8_t*>(data.data()) + data.size());
+
+    std::istringstream line(read(dir + METADATA_SUMMARY));
+    std::string name, mask;
+    long long start, end;
+    line >> name >> start >> end >> mask;
+    CHECK(name == "clip.mp4");
+    CHECK(start == header.start && end == header.start + header.duration);
+    CHECK(mask == "80000000000000000000000000000009");
+}
+
+// summary lines go with their sidecars, the file left alone when all are there
+static void prune(const std::string& dir) {
+    MetadataWriter writer;
+    CHECK(writer.open(dir + "other.mp4", Tick::current()));
+    writer.close();
+    std::string summary = read(dir + METADATA_SUMMARY);
+    MetadataWriter::prune(dir);
+    CHECK(read(dir + METADATA_SUMMARY) == summary);
+
+    fs::remove(dir + "other.meta");
+    MetadataWriter::prune(dir.substr(0, dir.size() - 1));
+    summary = read(dir + METADATA_SUMMARY);
+    CHECK(summary.find("clip.mp4") == 0);
+    CHECK(summary.find("other.mp4") == std::string::npos);
+    CHECK(!fs::exists(dir + METADATA_SUMMARY ".tmp"));
+
+    MetadataWriter::prune(dir + "missing/");  // no summary, nothing to do
+}
+
+// stats and the accessors are read from the server thread while frames come in
+static void concurrent(const std::string& dir) {
+    MetadataWriter writer;
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+        while (!done) {
+            json stats = writer.stats();
+            if (writer.opened()) {
+                std::string path = writer.path();
+                CHECK(path.empty() || path.compare(0, dir.size(), dir) == 0);
+            }
+        }
+    });
+    ma_tick_t tick = Tick::current();
+    for (int i = 0; i < 20; i++) {
+        CHECK(writer.open(dir + "c" + std::to_string(i) + ".mp4", tick));
+        for (int j = 0; j < 50; j++) {
+            tick += Tick::fromMilliseconds(100);
+            writer.add(tick, {box(j % 4)}, {j});
+        }
+        writer.close();
+    }
+    done = true;
+    reader.join();
+    json stats = writer.stats();
+    CHECK(stats["files"].get<uint64_t>() == 20);
+    CHECK(stats["records"].get<uint64_t>() > 0);
+    CHECK(!stats["open"].get<bool>());
+}
+
+int main() {
+    std::string dir = directory();
+    sidecar(dir);
+    prune(dir);
+    concurrent(dir);
+    fs::remove_all(dir);
+    return CHECK_DONE();
+}
@@ -0,0 +1,154 @@
+#include <stdexcept>
+
+#include "check.h"
+#include "metadata_month.h"
+#include "metadata_query.h"
+
+// the supervisor's /api/file/query over two days of synthetic metadata
+
+static const std::string DIR = "/tmp/test_metadata_query";
+static const int DAYS        = 2;
+
+static json run(const metaQuery& query, size_t& opened) {
+    size_t rows = 0;
+    json files  = query.run(DIR, rows, opened);
+    CHECK(rows <= static_cast<size_t>(DAYS * month::PER_DAY));
+    return files;
+}
+
+static int slice(const json& file) {
+    return std::stoi(file["name"].get<std::string>());
+}
+
+// the ranges of one slice, worked out from the generator
+static json expected(int slice, int min) {
+    json ranges   = json::array();
+    int64_t first = -1, last = -1;
+    for (int second = 0; second < month::SLICE; second++) {
+        if (month::persons(slice, second) < min) {
+            continue;
+        }
+        if (first >= 0 && second - last > 2) {
+            ranges.push_back({first, last});
+            first = -1;
+        }
+        if (first < 0) {
+            first = second;
+        }
+        last = second;
+    }
+    if (first >= 0) {
+        ranges.push_back({first, last});
+    }
+    return ranges;
+}
+
+// an hour of one day opens the slices that overlap it, and their seconds in it are merged into ranges
+static void window() {
+    metaQuery query;
+    query.from = month::BASE + 14 * 3600;
+    query.to   = month::BASE + 15 * 3600 - 1;
+    query.setClasses("0");
+    size_t opened = 0;
+    json files    = run(query, opened);
+    CHECK(files.size() == 12);
+    CHECK(opened == 13);  // the slice before ends on the hour
+    for (auto& file : files) {
+        CHECK(file["start"] >= query.from && file["start"].get<int64_t>() + file["duration"].get<int64_t>() <= query.to + 1);
+        CHECK(file["ranges"] == expected(slice(file), 1));
+    }
+
+    // counts below min are near misses
+    query.min = 2;
+    files     = run(query, opened);
+    CHECK(!files.empty());
+    for (auto& file : files) {
+        CHECK(file["ranges"] == expected(slice(file), 2));
+    }
+}
+
+// the summary keeps sidecars of other classes closed
+static void classes() {
+    metaQuery query;
+    size_t opened = 0;
+    query.setClasses(std::to_string(month::DOG));
+    json files = run(query, opened);
+    CHECK(files.size() == 12 && opened == 12 && slice(files[0]) == month::DOG_DAY * month::PER_DAY + month::DOG_SLICE);
+
+    query = metaQuery();
+    query.setClasses(std::to_string(month::NEVER));
+    CHECK(run(query, opened).empty() && opened == 0);
+
+    // any of them
+    query = metaQuery();
+    query.setClasses(std::to_string(month::NEVER) + "," + std::to_string(month::DOG));
+    CHECK(run(query, opened).size() == 12);
+
+    // no classes is any detection, up to the limit
+    query       = metaQuery();
+    query.limit = 5;
+    files       = run(query, opened);
+    CHECK(files.size() == 5 && opened == 5);
+}
+
+// a class above 255 is stored as 255 and above 127 summarised as 127, a query for it finds it
+static void clamped() {
+    metaQuery query;
+    size_t opened = 0;
+    query.setClasses(std::to_string(month::OVERSIZED));
+    CHECK(query.classes == std::vector<int>{255});
+    json files = run(query, opened);
+    CHECK(files.size() == 1 && opened == 1 && slice(files[0]) == 0 && files[0]["ranges"] == json::array({json::array({100, 100})}));
+
+    query = metaQuery();
+    query.setClasses("255");
+    CHECK(run(query, opened).size() == 1);
+
+    // 127 shares the summary bit but not the sidecar class
+    query = metaQuery();
+    query.setClasses("127");
+    CHECK(run(query, opened).empty() && opened == 1);
+
+    query = metaQuery();
+    query.setClasses("-3");
+    CHECK(query.classes == std::vector<int>{0});
+
+    bool thrown = false;
+    try {
+        query.setClasses("person");
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+static void tracks() {
+    metaQuery query;
+    size_t opened = 0;
+    int target    = month::PER_DAY + 7;
+    query.track   = month::track(target);
+    json files    = run(query, opened);
+    CHECK(files.size() == 1 && slice(files[0]) == target && files[0]["ranges"] == expected(target, 1));
+}
+
+// a sidecar cut short or gone is skipped, not an error
+static void damaged() {
+    std::filesystem::resize_file(DIR + "/00001.meta", 45);
+    std::filesystem::remove(DIR + "/00002.meta");
+    metaQuery query;
+    query.to      = month::start(3) - 1;
+    size_t opened = 0;
+    json files    = run(query, opened);
+    CHECK(opened == 3 && files.size() == 1 && slice(files[0]) == 0);
+}
+
+int main() {
+    month::write(DIR, DAYS);
+    window();
+    classes();
+    clamped();
+    tracks();
+    damaged();
+    std::filesystem::remove_all(DIR);
+    return CHECK_DONE();
+}
@@ -0,0 +1,167 @@
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#include "check.h"
+#include "node.h"
+
+using namespace ma;
+using namespace ma::node;
+
+static std::mutex log_mutex;
+static std::vector<std::string> starts;
+static std::set<std::thread::id> starters;
+
+class MockNode : public Node {
+public:
+    MockNode(const std::string& type, const std::string& id) : Node(type, id) {}
+    ma_err_t onCreate(const json& config) override {
+        fail_ = config.value("fail", "");
+        return MA_OK;
+    }
+    ma_err_t onStart() override {
+        if (fail_ == "exception") {
+            MA_THROW(Exception(MA_EIO, "start failed: " + id_));
+        } else if (fail_ == "std") {
+            throw std::runtime_error("start failed: " + id_);
+        } else if (fail_ == "other") {
+            throw 1;
+        } else if (fail_ == "code") {
+            return MA_EIO;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        {
+            std::lock_guard<std::mutex> lock(log_mutex);
+            starts.push_back(id_);
+            starters.insert(std::this_thread::get_id());
+        }
+        started_ = true;
+        return MA_OK;
+    }
+    ma_err_t onControl(const std::string&, const json&) override {
+        return MA_OK;
+    }
+    ma_err_t onStop() override {
+        started_ = false;
+        return MA_OK;
+    }
+    ma_err_t onDestroy() override {
+        return MA_OK;
+    }
+
+private:
+    std::string fail_;
+};
+
+static json spec(const std::vector<std::string>& dependencies, const std::vector<std::string>& dependents, json config = json::object()) {
+    return json::object({{"config", config}, {"dependencies", dependencies}, {"dependents", dependents}});
+}
+
+static size_t position(const std::string& id) {
+    return std::find(starts.begin(), starts.end(), id) - starts.begin();
+}
+
+static void reset() {
+    NodeFactory::clear();
+    starts.clear();
+    starters.clear();
+}
+
+// a node starts once its dependencies exist and its dependents run, whatever order they come in
+static void order() {
+    const std::vector<std::vector<std::string>> orders = {{"camera", "model", "stream"}, {"stream", "model", "camera"}, {"model", "stream", "camera"}};
+    for (auto& ids : orders) {
+        reset();
+        for (auto& id : ids) {
+            if (id == "camera") {
+                NodeFactory::create(id, "mock", spec({}, {"model"}));
+            } else if (id == "model") {
+                NodeFactory::create(id, "mock", spec({"camera"}, {"stream"}));
+            } else {
+                NodeFactory::create(id, "mock", spec({"model"}, {}));
+            }
+        }
+        CHECK(starts.size() == 3);
+        CHECK(position("stream") < position("model"));
+        CHECK(position("model") < position("camera"));
+    }
+}
+
+// dependents of one node start side by side, the node after all of them
+static void wave() {
+    reset();
+    std::vector<std::string> sinks;
+    for (int i = 0; i < 8; i++) {
+        sinks.push_back("sink" + std::to_string(i));
+    }
+    NodeFactory::create("camera", "mock", spec({}, sinks));
+    for (auto& id : sinks) {
+        NodeFactory::create(id, "mock", spec({"camera"}, {}));
+    }
+    CHECK(starts.size() == 9);
+    CHECK(starts.back() == "camera");
+
+    // waiting on the camera to exist, they become ready together and form a single wave
+    reset();
+    for (auto& id : sinks) {
+        NodeFactory::create(id, "mock", spec({"camera"}, {}));
+    }
+    NodeFactory::create("camera", "mock", spec({}, sinks));
+    CHECK(starts.size() == 9 && starts.back() == "camera");
+    CHECK(starters.size() > 1);
+
+    // a deployed flow is created in one pass and starts the same way
+    reset();
+    json nodes = json::array();
+    for (auto& id : sinks) {
+        nodes.push_back({{"id", id}, {"type", "mock"}, {"dependencies", {"camera"}}});
+    }
+    nodes.push_back({{"id", "camera"}, {"type", "mock"}, {"dependents", sinks}});
+    json reply = NodeFactory::deploy({{"nodes", nodes}});
+    CHECK(reply["nodes"].size() == 9);
+    CHECK(starts.size() == 9 && starts.back() == "camera");
+    CHECK(starters.size() > 1);
+}
+
+// a node whose dependents lead back to it would never start
+static void cycle() {
+    reset();
+    NodeFactory::create("a", "mock", spec({}, {"b"}));
+    NodeFactory::create("b", "mock", spec({}, {"c"}));
+    bool thrown = false;
+    try {
+        NodeFactory::create("c", "mock", spec({}, {"a"}));
+    } catch (Exception& e) {
+        thrown = e.err() == MA_EINVAL;
+    }
+    CHECK(thrown);
+    CHECK(NodeFactory::find("c") == nullptr);
+    CHECK(starts.empty());
+}
+
+// a dependent that fails to start holds back the nodes waiting on it, and only those, however it fails
+static void failure() {
+    for (const char* fail : {"exception", "std", "other", "code"}) {
+        reset();
+        NodeFactory::create("camera", "mock", spec({}, {"model", "save"}));
+        NodeFactory::create("model", "mock", spec({"camera"}, {}, {{"fail", fail}}));
+        NodeFactory::create("save", "mock", spec({"camera"}, {}));
+        CHECK(starts.size() == 1 && starts[0] == "save");
+
+        // replacing it releases the camera
+        NodeFactory::destroy("model");
+        NodeFactory::create("model", "mock", spec({"camera"}, {}));
+        CHECK(starts.size() == 3 && starts.back() == "camera");
+    }
+}
+
+int main() {
+    NodeFactory::registerNode("mock", [](const std::string& id) { return new MockNode("mock", id); });
+    order();
+    wave();
+    cycle();
+    failure();
+    reset();
+    return CHECK_DONE();
+}
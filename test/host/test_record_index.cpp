@@ -0,0 +1,108 @@
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include "check.h"
+#include "record_index.h"
+
+using namespace ma;
+using namespace ma::node;
+
+namespace fs = std::filesystem;
+
+static std::string directory() {
+    char path[] = "/tmp/record_index_XXXXXX";
+    return std::string(mkdtemp(path)) + "/";
+}
+
+static void touch(const std::string& path, size_t size) {
+    std::ofstream(path, std::ios::binary) << std::string(size, 'x');
+}
+
+static uint64_t available(const std::string& dir) {
+    struct statvfs info;
+    statvfs(dir.c_str(), &info);
+    return static_cast<uint64_t>(info.f_bavail) * info.f_frsize;
+}
+
+// what was recorded comes back from the log, a file open at the stop with its size on disk
+static void replay(const std::string& dir) {
+    {
+        RecordIndex index;
+        CHECK(index.open(dir));
+        CHECK(index.stats()["files"].get<size_t>() == 0);
+        touch(dir + "a.jpg", 1000);
+        index.insert(dir + "a.jpg", 1000);
+        index.begin(dir + "b.mp4");
+        touch(dir + "b.mp4", 5000);
+        index.end(dir + "b.mp4", 5000);
+        index.begin(dir + "c.mp4");
+        touch(dir + "c.mp4", 3000);  // the service stops while writing it
+    }
+    RecordIndex index;
+    CHECK(index.open(dir));
+    json stats = index.stats();
+    CHECK(stats["files"].get<size_t>() == 3);
+    CHECK(stats["bytes"].get<uint64_t>() == 9000);
+    CHECK(stats["rebuilds"].get<uint64_t>() == 0);  // replayed, only the first open scanned
+}
+
+// space comes from the oldest files, never from the one being written
+static void reclaim(const std::string& dir) {
+    RecordIndex index;
+    index.open(dir);
+    touch(dir + "d.mp4", 0);
+    index.begin(dir + "d.mp4");
+    fs::remove(dir + "a.jpg");  // removed by someone else
+    CHECK(!index.reserve(0, available(dir) + (UINT64_C(1) << 50)));
+    CHECK(!fs::exists(dir + "b.mp4") && !fs::exists(dir + "c.mp4"));
+    json stats = index.stats();
+    CHECK(stats["files"].get<size_t>() == 1);
+    CHECK(stats["evictions"].get<uint64_t>() == 3);
+    CHECK(stats["missing"].get<uint64_t>() == 1);
+    CHECK(index.reserve(1024, 0));
+    index.end(dir + "d.mp4", 0);
+}
+
+// without a log the directory is scanned, dot files and names the log cannot hold left out
+static void rebuild(const std::string& dir) {
+    fs::remove(dir + RECORD_INDEX_FILE);
+    touch(dir + "e.jpg", 100);
+    touch(dir + "with space.jpg", 100);
+    RecordIndex index;
+    CHECK(index.open(dir));
+    json stats = index.stats();
+    CHECK(stats["files"].get<size_t>() == 2);  // d.mp4 and e.jpg
+    CHECK(stats["rebuilds"].get<uint64_t>() == 1);
+}
+
+// removals are folded into a fresh log once they make up most of it
+static void compact(const std::string& dir) {
+    RecordIndex index;
+    index.open(dir);
+    for (int i = 0; i < 2000; i++) {
+        std::string path = dir + "f" + std::to_string(i) + ".jpg";
+        touch(path, 10);
+        index.insert(path, 10);
+    }
+    CHECK(!index.reserve(0, available(dir) + (UINT64_C(1) << 50)));
+    CHECK(index.stats()["lines"].get<uint64_t>() < 2000);
+    index.close();
+
+    RecordIndex reopened;
+    CHECK(reopened.open(dir));
+    CHECK(reopened.stats()["files"].get<size_t>() == 0);
+    CHECK(reopened.stats()["rebuilds"].get<uint64_t>() == 0);
+}
+
+int main() {
+    std::string dir = directory();
+    replay(dir);
+    reclaim(dir);
+    rebuild(dir);
+    compact(dir);
+    fs::remove_all(dir);
+    return CHECK_DONE();
+}
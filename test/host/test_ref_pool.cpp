@@ -0,0 +1,133 @@
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "app_ipcam_ref.h"
+#include "check.h"
+
+// the zero-copy stream pool of a VENC channel: a fake producer numbers its streams and must get
+// them back in the order it handed them out, never while a consumer still holds one
+
+struct Stream {
+    int seq;
+};
+
+static std::vector<int> returned;
+static std::atomic<int> held{0};
+
+static void release(void* payload, void*) {
+    returned.push_back(static_cast<Stream*>(payload)->seq);
+    held--;
+}
+
+static void* start(int depth) {
+    void* ctx = nullptr;
+    CHECK(app_ipcam_Ref_Pool_Init(&ctx, depth, sizeof(Stream), release, nullptr) == 0);
+    returned.clear();
+    held = 0;
+    return ctx;
+}
+
+static APP_REF_HANDLE_S* produce(void* ctx, int seq, int timeout = 0) {
+    APP_REF_HANDLE_S* handle = app_ipcam_Ref_Alloc(ctx, timeout);
+    if (handle != nullptr) {
+        static_cast<Stream*>(handle->pPayload)->seq = seq;
+        held++;
+    }
+    return handle;
+}
+
+static long elapsedMs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+// streams dropped out of order go back in the order they were taken
+static void fifo() {
+    void* ctx                    = start(4);
+    APP_REF_HANDLE_S* handles[3] = {produce(ctx, 0), produce(ctx, 1), produce(ctx, 2)};
+    app_ipcam_Ref_Get(handles[0]);
+
+    app_ipcam_Ref_Put(handles[2]);
+    app_ipcam_Ref_Put(handles[1]);
+    CHECK(returned.empty());
+    app_ipcam_Ref_Put(handles[0]);
+    CHECK(returned.empty() && app_ipcam_Ref_InFlight(ctx) == 3);
+    app_ipcam_Ref_Put(handles[0]);
+    CHECK((returned == std::vector<int>{0, 1, 2}));
+
+    // handles are reused round-robin past the end of the pool
+    for (int i = 3; i < 11; i++) {
+        app_ipcam_Ref_Put(produce(ctx, i));
+    }
+    CHECK(returned.size() == 11 && returned.back() == 10 && held == 0);
+    CHECK(app_ipcam_Ref_Pool_DeInit(&ctx, 100) == 0 && ctx == nullptr);
+}
+
+// a full pool holds the producer back until the oldest stream returns, it is never copied around
+static void exhausted() {
+    void* ctx                = start(2);
+    APP_REF_HANDLE_S* oldest = produce(ctx, 0);
+    APP_REF_HANDLE_S* next   = produce(ctx, 1);
+    CHECK(produce(ctx, 2) == nullptr);
+
+    auto since = std::chrono::steady_clock::now();
+    CHECK(produce(ctx, 2, 50) == nullptr);
+    CHECK(elapsedMs(since) >= 45);
+
+    // the newer stream coming back frees nothing while the oldest is held
+    app_ipcam_Ref_Put(next);
+    CHECK(produce(ctx, 2, 20) == nullptr && returned.empty());
+
+    std::thread consumer([&] {
+        usleep(30 * 1000);
+        app_ipcam_Ref_Put(oldest);
+    });
+    since                    = std::chrono::steady_clock::now();
+    APP_REF_HANDLE_S* handle = produce(ctx, 2, 1000);
+    CHECK(handle != nullptr && elapsedMs(since) < 1000);
+    consumer.join();
+    CHECK((returned == std::vector<int>{0, 1}));
+    app_ipcam_Ref_Put(handle);
+    CHECK(held == 0 && static_cast<APP_REF_POOL_S*>(ctx)->u64Exhausted == 3);
+    app_ipcam_Ref_Pool_DeInit(&ctx, 100);
+}
+
+// deinit with streams in flight waits for the last consumer, and the pool refuses new ones meanwhile
+static void deinitInFlight() {
+    void* ctx                    = start(4);
+    APP_REF_HANDLE_S* handles[2] = {produce(ctx, 0), produce(ctx, 1)};
+    APP_REF_POOL_S* pool         = static_cast<APP_REF_POOL_S*>(ctx);
+    std::atomic<bool> refused{false};
+
+    std::thread consumer([&] {
+        bool closing = false;
+        while (!closing) {
+            usleep(1000);
+            pthread_mutex_lock(&pool->mutex);
+            closing = pool->bClosing;
+            pthread_mutex_unlock(&pool->mutex);
+        }
+        refused = app_ipcam_Ref_Alloc(pool, 10) == nullptr;
+        usleep(30 * 1000);
+        app_ipcam_Ref_Put(handles[1]);
+        // outlasts a deinit timeout, which only reports the handles still out, the newer behind the oldest
+        usleep(60 * 1000);
+        CHECK(held == 2);
+        app_ipcam_Ref_Put(handles[0]);
+    });
+    CHECK(app_ipcam_Ref_Pool_DeInit(&ctx, 20) == 0);
+    consumer.join();
+    CHECK(refused);
+    CHECK(ctx == nullptr && held == 0);
+    CHECK((returned == std::vector<int>{0, 1}));
+}
+
+int main() {
+    fifo();
+    exhausted();
+    deinitInFlight();
+    return CHECK_DONE();
+}
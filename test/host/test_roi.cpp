@@ -0,0 +1,109 @@
+#include <cstring>
+#include <vector>
+
+#include "check.h"
+#include "roi.h"
+
+using namespace ma::node;
+
+// a 32x24 RGB888 frame whose red and green encode the column and row
+static const int32_t WIDTH  = 32;
+static const int32_t HEIGHT = 24;
+
+static std::vector<uint8_t> frame() {
+    std::vector<uint8_t> rgb(WIDTH * HEIGHT * 3);
+    for (int32_t y = 0; y < HEIGHT; y++) {
+        for (int32_t x = 0; x < WIDTH; x++) {
+            uint8_t* p = &rgb[(y * WIDTH + x) * 3];
+            p[0]       = x * 4;
+            p[1]       = y * 4;
+            p[2]       = 200;
+        }
+    }
+    return rgb;
+}
+
+static bool same(const roi_t& roi, int32_t x, int32_t y, int32_t width, int32_t height) {
+    return roi.x == x && roi.y == y && roi.width == width && roi.height == height;
+}
+
+// boxes are normalised to the letterboxed square, a 640x480 frame sits 80 px into its 640 side
+static void mapping() {
+    CHECK(same(roiFromBox(0.5, 0.5, 0.1, 0.05, 640, 480, 0, false), 288, 224, 64, 32));
+    CHECK(same(roiFromBox(0.5, 0.5, 0.1, 0.05, 640, 480, 0.25, false), 272, 216, 96, 48));
+    CHECK(same(roiFromBox(0.5, 0.5, 0.1, 0.05, 640, 480, 0.25, true), 272, 192, 96, 96));
+    // portrait frames pad the sides instead
+    CHECK(same(roiFromBox(0.5, 0.5, 0.05, 0.1, 480, 640, 0, false), 224, 288, 32, 64));
+}
+
+static void clamping() {
+    CHECK(same(roiFromBox(0, 0.5, 0.1, 0.1, 640, 480, 0, false), 0, 208, 32, 64));
+    CHECK(same(roiFromBox(1, 0.875, 0.1, 0.1, 640, 480, 0, false), 608, 448, 32, 32));
+    CHECK(same(roiFromBox(0.5, 0.5, 2, 2, 640, 480, 0.5, true), 0, 0, 640, 480));
+    // within the letterbox padding, outside the frame
+    roi_t outside = roiFromBox(0.5, 0.05, 0.1, 0.05, 640, 480, 0, false);
+    CHECK(outside.height == 0 && outside.y == 0);
+}
+
+// the cascade skips anything under 2 px, which must come out that small and not wrap around
+static void tiny() {
+    roi_t roi = roiFromBox(0.5, 0.5, 0.001, 0.001, 640, 480, 0, false);
+    CHECK(roi.width < 2 && roi.height < 2 && roi.width >= 0 && roi.height >= 0);
+    roi = roiFromBox(0.5, 0.5, 0.001, 0.1, 640, 480, 0.1, true);
+    CHECK(roi.width == roi.height && roi.width >= 2);
+
+    // a single pixel or column scales up to its own colour and reads nothing beside it
+    std::vector<uint8_t> rgb = frame();
+    std::vector<uint8_t> dst(4 * 4 * 3);
+    roiResize(rgb.data(), WIDTH * 3, roi_t{WIDTH - 1, HEIGHT - 1, 1, 1}, dst.data(), 4, 4, false);
+    for (size_t i = 0; i < dst.size(); i += 3) {
+        CHECK(dst[i] == (WIDTH - 1) * 4 && dst[i + 1] == (HEIGHT - 1) * 4 && dst[i + 2] == 200);
+    }
+    roiResize(rgb.data(), WIDTH * 3, roi_t{WIDTH - 1, 0, 1, HEIGHT}, dst.data(), 4, 4, false);
+    CHECK(dst[0] == (WIDTH - 1) * 4 && dst[(3 * 4 + 3) * 3] == (WIDTH - 1) * 4);
+
+    // an empty roi leaves the input alone
+    std::fill(dst.begin(), dst.end(), 7);
+    roiResize(rgb.data(), WIDTH * 3, roi_t{0, 0, 0, 5}, dst.data(), 4, 4, false);
+    CHECK(dst[0] == 7 && dst.back() == 7);
+}
+
+// the input tensor is filled exactly, HWC or CHW
+static void layout() {
+    std::vector<uint8_t> rgb = frame();
+    const int32_t w = 8, h = 6;
+    size_t size     = w * h * 3;
+    std::vector<uint8_t> hwc(size + 16, 0xAA), chw(size + 16, 0xAA);
+
+    // same size: a straight copy
+    roi_t roi{2, 1, w, h};
+    roiResize(rgb.data(), WIDTH * 3, roi, hwc.data(), w, h, false);
+    roiResize(rgb.data(), WIDTH * 3, roi, chw.data(), w, h, true);
+    for (int32_t j = 0; j < h; j++) {
+        for (int32_t i = 0; i < w; i++) {
+            const uint8_t* p = &hwc[(j * w + i) * 3];
+            CHECK(p[0] == (roi.x + i) * 4 && p[1] == (roi.y + j) * 4 && p[2] == 200);
+            CHECK(chw[j * w + i] == p[0] && chw[w * h + j * w + i] == p[1] && chw[2 * w * h + j * w + i] == p[2]);
+        }
+    }
+    CHECK(hwc[size] == 0xAA && hwc.back() == 0xAA && chw[size] == 0xAA && chw.back() == 0xAA);
+
+    // half size: every output pixel between the two source pixels it covers
+    roi = roi_t{4, 2, 2 * w, 2 * h};
+    roiResize(rgb.data(), WIDTH * 3, roi, hwc.data(), w, h, false);
+    for (int32_t j = 0; j < h; j++) {
+        for (int32_t i = 0; i < w; i++) {
+            const uint8_t* p = &hwc[(j * w + i) * 3];
+            CHECK(p[0] == (roi.x + 2 * i) * 4 + 2 && p[1] == (roi.y + 2 * j) * 4 + 2 && p[2] == 200);
+        }
+    }
+    CHECK(hwc[size] == 0xAA);
+}
+
+int main() {
+    mapping();
+    clamping();
+    tiny();
+    layout();
+    return CHECK_DONE();
+}
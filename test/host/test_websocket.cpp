@@ -0,0 +1,201 @@
+#include <thread>
+
+#include "check.h"
+#include "ma_transport_websocket.h"
+
+using namespace ma;
+
+// frames carry their sequence number and whether they are a key frame in the first bytes
+static std::string frame(uint32_t seq, bool key, size_t size) {
+    std::string data(size, '\0');
+    memcpy(&data[0], &seq, sizeof(seq));
+    data[4] = key;
+    return data;
+}
+
+static uint32_t seqOf(const std::string& data) {
+    uint32_t seq;
+    memcpy(&seq, data.data(), sizeof(seq));
+    return seq;
+}
+
+static WebSocketChannelPtr connect(const std::string& address, bool framed = false) {
+    auto channel     = std::make_shared<hv::WebSocketChannel>(address);
+    auto request     = std::make_shared<hv::HttpRequest>();
+    auto service     = hv::WebSocketServer::registered();
+    channel->onclose = [service, channel] { service->onclose(channel); };
+    if (framed) {
+        request->params["format"] = "framed";
+    }
+    service->onopen(channel, request);
+    return channel;
+}
+
+static bool waitFor(const std::function<bool()>& done, int ms = 2000) {
+    for (int i = 0; i < ms && !done(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return done();
+}
+
+static const TransportWebSocket::ClientStats* statsOf(const std::vector<TransportWebSocket::ClientStats>& stats, const std::string& address) {
+    for (auto& item : stats) {
+        if (item.address == address) {
+            return &item;
+        }
+    }
+    return nullptr;
+}
+
+// every client gets every message in order, plain and framed ones their own kind only
+static void fanout() {
+    TransportWebSocket ws;
+    TransportWebSocket::Config config = {};
+    config.port                       = 8080;
+    ws.init(&config);
+    auto a      = connect("a");
+    auto b      = connect("b");
+    auto framed = connect("framed", true);
+    CHECK(ws.clients(false) == 2 && ws.clients(true) == 1);
+
+    for (uint32_t i = 0; i < 100; i++) {
+        std::string data = frame(i, false, 64);
+        CHECK(ws.send(data.data(), data.size(), false) == data.size());
+    }
+    const char* parts[]    = {"head", "body"};
+    const size_t lengths[] = {4, 4};
+    CHECK(ws.send(parts, lengths, 2) == 8);
+
+    CHECK(waitFor([&] { return a->messages().size() == 100 && b->messages().size() == 100 && framed->messages().size() == 1; }));
+    bool ordered = true;
+    for (auto& channel : {a, b}) {
+        auto messages = channel->messages();
+        for (uint32_t i = 0; i < messages.size(); i++) {
+            ordered &= seqOf(messages[i]) == i;
+        }
+    }
+    CHECK(ordered);
+    CHECK(framed->messages()[0] == "headbody");
+    ws.deInit();
+}
+
+// a stalled client loses its own oldest messages, the others get everything
+static void dropOldest() {
+    TransportWebSocket ws;
+    TransportWebSocket::Config config = {};
+    config.port                       = 8081;
+    config.queue                      = 10 * 1024;
+    config.lag                        = 0;
+    ws.init(&config);
+    auto fast     = connect("fast");
+    auto slow     = connect("slow");
+    slow->stalled = true;
+
+    for (uint32_t i = 0; i < 40; i++) {
+        std::string data = frame(i, false, 1024);
+        ws.send(data.data(), data.size(), false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    CHECK(waitFor([&] { return fast->messages().size() == 40; }));
+    auto stats = ws.stats();
+    CHECK(statsOf(stats, "slow")->queued == 10 * 1024);
+    CHECK(statsOf(stats, "slow")->dropped == 30);
+    CHECK(statsOf(stats, "fast")->dropped == 0);
+
+    slow->stalled = false;
+    CHECK(waitFor([&] { return slow->messages().size() == 10; }));
+    CHECK(seqOf(slow->messages().front()) == 30);
+    ws.deInit();
+}
+
+// with key frames, a client that overflows resumes at a key frame, never in the middle of a GOP,
+// and one that stays behind longer than the lag is disconnected
+static void keyframes() {
+    TransportWebSocket ws;
+    TransportWebSocket::Config config = {};
+    config.port                       = 8082;
+    config.queue                      = 16 * 1024;
+    config.lag                        = 0;
+    config.keyframes                  = true;
+    ws.init(&config);
+    auto fast = connect("fast");
+    auto slow = connect("slow");
+
+    // joined midway, both wait for the first key frame
+    std::string delta = frame(0, false, 1024);
+    ws.send(delta.data(), delta.size(), false);
+    slow->stalled = true;
+    for (uint32_t i = 1; i <= 60; i++) {
+        bool key         = i % 10 == 1;
+        std::string data = frame(i, key, key ? 4096 : 1024);
+        ws.send(data.data(), data.size(), key);
+        if (i == 35) {
+            slow->stalled = false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    CHECK(waitFor([&] { return fast->messages().size() == 60; }));
+    CHECK(waitFor([&] { return !slow->messages().empty() && seqOf(slow->messages().back()) == 60; }));
+
+    auto messages  = slow->messages();
+    bool decodable = true;
+    for (size_t i = 0; i < messages.size(); i++) {
+        bool key = messages[i][4];
+        if (i == 0 || seqOf(messages[i]) != seqOf(messages[i - 1]) + 1) {
+            decodable &= key;
+        }
+    }
+    CHECK(decodable);
+    CHECK(statsOf(ws.stats(), "slow")->dropped > 0);
+    CHECK(statsOf(ws.stats(), "fast")->dropped == 1);  // the delta before the first key frame
+    ws.deInit();
+
+    config.port = 8083;
+    config.lag  = 100;
+    ws.init(&config);
+    auto stuck     = connect("stuck");
+    stuck->stalled = true;
+    for (uint32_t i = 0; i < 40; i++) {
+        std::string data = frame(i, i % 10 == 0, 1024);
+        ws.send(data.data(), data.size(), i % 10 == 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(waitFor([&] { return !stuck->isConnected(); }));
+    CHECK(waitFor([&] { return ws.stats().empty(); }));
+    ws.deInit();
+}
+
+// a joining client gets the cached GOP first, then the live stream
+static void prime() {
+    TransportWebSocket ws;
+    TransportWebSocket::Config config = {};
+    config.port                       = 8084;
+    config.keyframes                  = true;
+    ws.init(&config);
+    auto late = connect("late");
+    CHECK(ws.joining() == 1);
+
+    std::string gop[]      = {frame(10, true, 2048), frame(11, false, 512), frame(12, false, 512)};
+    const char* data[]     = {gop[0].data(), gop[1].data(), gop[2].data()};
+    const size_t lengths[] = {gop[0].size(), gop[1].size(), gop[2].size()};
+    CHECK(ws.prime(data, lengths, 3, true) == 1);
+    CHECK(ws.joining() == 0);
+    std::string next = frame(13, false, 512);
+    ws.send(next.data(), next.size(), false);
+
+    CHECK(waitFor([&] { return late->messages().size() == 4; }));
+    auto messages = late->messages();
+    for (uint32_t i = 0; i < messages.size(); i++) {
+        CHECK(seqOf(messages[i]) == 10 + i);
+    }
+    CHECK(statsOf(ws.stats(), "late")->primed == 1);
+    ws.deInit();
+}
+
+int main() {
+    fanout();
+    dropOldest();
+    keyframes();
+    prime();
+    return CHECK_DONE();
+}
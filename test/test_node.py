@@ -1,7 +1,160 @@
 import paho.mqtt.client as mqtt
+import base64
 import json
+import struct
+import sys
+import threading
+import time
 import uuid
 
+
+def cbor_decode(buf, pos=0):
+    # the subset the node emits: ints, floats, strings, bytes, arrays, maps, bool and null
+    head = buf[pos]
+    major, info = head >> 5, head & 0x1f
+    pos += 1
+    if major == 7:
+        if info == 20 or info == 21:
+            return info == 21, pos
+        if info == 22:
+            return None, pos
+        if info == 25:
+            half = struct.unpack_from(">e", buf, pos)[0]
+            return half, pos + 2
+        if info == 26:
+            return struct.unpack_from(">f", buf, pos)[0], pos + 4
+        if info == 27:
+            return struct.unpack_from(">d", buf, pos)[0], pos + 8
+        raise ValueError(f"cbor: simple value {info}")
+    if info < 24:
+        value = info
+    elif info <= 27:
+        size = 1 << (info - 24)
+        value = int.from_bytes(buf[pos:pos + size], "big")
+        pos += size
+    else:
+        raise ValueError(f"cbor: indefinite length at {pos - 1}")
+    if major == 0:
+        return value, pos
+    if major == 1:
+        return -1 - value, pos
+    if major == 2:
+        return bytes(buf[pos:pos + value]), pos + value
+    if major == 3:
+        return buf[pos:pos + value].decode(), pos + value
+    if major == 4:
+        items = []
+        for _ in range(value):
+            item, pos = cbor_decode(buf, pos)
+            items.append(item)
+        return items, pos
+    if major == 5:
+        items = {}
+        for _ in range(value):
+            key, pos = cbor_decode(buf, pos)
+            items[key], pos = cbor_decode(buf, pos)
+        return items, pos
+    raise ValueError(f"cbor: tag at {pos - 1}")
+
+
+def msgpack_decode(buf, pos=0):
+    head = buf[pos]
+    pos += 1
+    if head <= 0x7f:
+        return head, pos
+    if head >= 0xe0:
+        return head - 0x100, pos
+    if 0xa0 <= head <= 0xbf:
+        size = head & 0x1f
+        return buf[pos:pos + size].decode(), pos + size
+    if 0x90 <= head <= 0x9f or head in (0xdc, 0xdd):
+        if head <= 0x9f:
+            size = head & 0x0f
+        else:
+            width = 2 if head == 0xdc else 4
+            size = int.from_bytes(buf[pos:pos + width], "big")
+            pos += width
+        items = []
+        for _ in range(size):
+            item, pos = msgpack_decode(buf, pos)
+            items.append(item)
+        return items, pos
+    if 0x80 <= head <= 0x8f or head in (0xde, 0xdf):
+        if head <= 0x8f:
+            size = head & 0x0f
+        else:
+            width = 2 if head == 0xde else 4
+            size = int.from_bytes(buf[pos:pos + width], "big")
+            pos += width
+        items = {}
+        for _ in range(size):
+            key, pos = msgpack_decode(buf, pos)
+            items[key], pos = msgpack_decode(buf, pos)
+        return items, pos
+    if head == 0xc0:
+        return None, pos
+    if head in (0xc2, 0xc3):
+        return head == 0xc3, pos
+    if head in (0xc4, 0xc5, 0xc6, 0xd9, 0xda, 0xdb):
+        width = {0xc4: 1, 0xc5: 2, 0xc6: 4, 0xd9: 1, 0xda: 2, 0xdb: 4}[head]
+        size = int.from_bytes(buf[pos:pos + width], "big")
+        pos += width
+        data = bytes(buf[pos:pos + size])
+        return (data if head <= 0xc6 else data.decode()), pos + size
+    if head == 0xca:
+        return struct.unpack_from(">f", buf, pos)[0], pos + 4
+    if head == 0xcb:
+        return struct.unpack_from(">d", buf, pos)[0], pos + 8
+    if 0xcc <= head <= 0xd3:
+        width = 1 << ((head - 0xcc) & 3)
+        signed = head >= 0xd0
+        return int.from_bytes(buf[pos:pos + width], "big", signed=signed), pos + width
+    raise ValueError(f"msgpack: type 0x{head:02x} at {pos - 1}")
+
+
+def decode(payload, encoding="json"):
+    # responses stay JSON whatever the node's encoding
+    if encoding == "json" or payload[:1] == b"{":
+        return json.loads(payload.decode())
+    decoder = cbor_decode if encoding == "cbor" else msgpack_decode
+    return decoder(payload)[0]
+
+
+def expand(payload, labels=None):
+    # turns the compact "v": 1 layout of the binary encodings back into the JSON one
+    if payload.get("v") != 1 or not isinstance(payload.get("data"), dict):
+        return payload
+    data = payload["data"]
+    labels = labels or []
+
+    def label(target):
+        return labels[target] if target < len(labels) else f"N/A-{target}"
+
+    if "boxes" in data:
+        flat = data["boxes"]
+        data["boxes"] = [flat[i:i + 6] for i in range(0, len(flat), 6)]
+        data["labels"] = [label(box[5]) for box in data["boxes"]]
+    if "classes" in data:
+        flat = data["classes"]
+        data["classes"] = [flat[i:i + 2] for i in range(0, len(flat), 2)]
+        data["labels"] = [label(item[1]) for item in data["classes"]]
+    if "keypoints" in data:
+        data["keypoints"] = [[item[:6], [item[i:i + 3] for i in range(6, len(item), 3)]] for item in data["keypoints"]]
+        data["labels"] = [label(item[0][5]) for item in data["keypoints"]]
+    if "segments" in data:
+        masks = data.pop("masks", [])
+        segments = []
+        for i, item in enumerate(data["segments"]):
+            segment = [item[:6], item[6:]]
+            if i < len(masks):
+                segment.append(masks[i])
+            segments.append(segment)
+        data["segments"] = segments
+        data["labels"] = [label(item[0][5]) for item in data["segments"]]
+    if isinstance(data.get("image"), bytes):
+        data["image"] = base64.b64encode(data["image"]).decode()
+    return payload
+
 class SSCMANodeClient:
     def __init__(self, id="recamera", version="v0"):
         self.id = id
@@ -23,15 +176,16 @@ class SSCMANodeClient:
     
 
     def on_message(self, client, userdata, msg):
-        try:
-            payload = json.loads(msg.payload.decode())
-            id = msg.topic.split("/")[-1]
-            for node in self._nodes:
-                if node.id == id:
-                    node.receive(payload)
-                    break
-        except json.JSONDecodeError:
-            print(f"Invalid JSON payload received on topic {msg.topic}: {msg.payload.decode()}")
+        id = msg.topic.split("/")[-1]
+        for node in self._nodes:
+            if node.id == id:
+                try:
+                    payload = decode(msg.payload, getattr(node, "encoding", "json"))
+                except (ValueError, IndexError, UnicodeDecodeError):
+                    print(f"Invalid payload received on topic {msg.topic}: {msg.payload[:64]}")
+                    return
+                node.receive(payload)
+                break
         
     def request(self, node, action, data):
         
@@ -109,11 +263,12 @@ class Node:
 
 class CameraNode(Node):
     
-    def __init__(self, client, option='2', audio=True, preview=False):
+    def __init__(self, client, option='2', audio=True, preview=False, encoding="json"):
         super().__init__(client)
         self.option = option
         self.audio = audio
         self.preview = preview
+        self.encoding = encoding
         
     def create(self):
         data = {
@@ -121,7 +276,8 @@ class CameraNode(Node):
             "config": {
                 "option": self.option,
                 "audio": self.audio,
-                "preview": self.preview
+                "preview": self.preview,
+                "encoding": self.encoding
             },
             "dependencies": [n.id for n in self.dependencies],  
             "dependents": [n.id for n in self.dependents]       
@@ -131,7 +287,7 @@ class CameraNode(Node):
 class ModelNode(Node):
     
     def __init__(self, client, uri="", tscore=0.45, tiou=0.35, topk=0, labels=None, debug=False, audio=True, trace=False,
-                 counting=False, splitter=None):
+                 counting=False, splitter=None, encoding="json"):
         super().__init__(client)
         self.uri = uri
         self.tscore = tscore
@@ -143,6 +299,7 @@ class ModelNode(Node):
         self.trace = trace
         self.counting = counting
         self.splitter = splitter or []
+        self.encoding = encoding
         
     def create(self):
         data = {
@@ -157,7 +314,8 @@ class ModelNode(Node):
                 "audio": self.audio,
                 "trace": self.trace,
                 "counting": self.counting,
-                "splitter": self.splitter
+                "splitter": self.splitter,
+                "encoding": self.encoding
             },
             "dependencies": [n.id for n in self.dependencies],  
             "dependents": [n.id for n in self.dependents]       
@@ -194,11 +352,12 @@ class StreamingNode(Node):
 
 class SaveNode(Node):
     
-    def __init__(self, client, storage="local", duration=-1, slice_time=300):
+    def __init__(self, client, storage="local", duration=-1, slice_time=300, container="mp4"):
         super().__init__(client)
         self.storage = storage
         self.duration = duration
         self.slice_time = slice_time
+        self.container = container
         
     def create(self):
         data = {
@@ -207,6 +366,7 @@ class SaveNode(Node):
                 "storage": self.storage,
                 "duration": self.duration,
                 "slice":self.slice_time,
+                "container": self.container,
                 "enabled": True
             },
             "dependencies": [n.id for n in self.dependencies],  
@@ -227,8 +387,163 @@ def stream_message_handler(data):
 def save_message_handler(data):
     print(f"Received data: {data}")
 
+def stress_control(client, nodes=16, count=4000, timeout=60):
+    # interleave health requests over many node ids, each id must answer every request
+    targets = [Node(client, f"stress-{i}") for i in range(nodes)]
+    received = {t.id: 0 for t in targets}
+    done = threading.Event()
+    lock = threading.Lock()
+
+    def handler(target):
+        def on_receive(data):
+            if data.get("name") != "health":
+                return
+            with lock:
+                received[target.id] += 1
+                if sum(received.values()) >= count:
+                    done.set()
+        return on_receive
+
+    for t in targets:
+        t.onReceive = handler(t)
+
+    start = time.time()
+    for i in range(count):
+        targets[i % nodes].request("health", "")
+    done.wait(timeout)
+    elapsed = time.time() - start
+
+    total = sum(received.values())
+    print(f"stress: {total}/{count} responses in {elapsed:.2f}s")
+    for t in targets:
+        if received[t.id] != count // nodes + (1 if targets.index(t) < count % nodes else 0):
+            print(f"stress: {t.id} answered {received[t.id]} requests")
+    return total == count
+
+
+def parse_preview(message):
+    # framed WebSocket preview: "SSPV" header, JPEG, results in the model node's encoding
+    magic, version, flags, size, id, image, results = struct.unpack_from("<4sBBHIII", message)
+    if magic != b"SSPV":
+        raise ValueError("preview: bad magic")
+    jpeg = message[size:size + image]
+    payload = None
+    if results:
+        encoding = ("json", "cbor", "msgpack")[flags & 0x03]
+        payload = decode(message[size + image:size + image + results], encoding)
+        if payload["data"].get("count") != id:
+            raise ValueError(f"preview: frame {id} carries the results of {payload['data'].get('count')}")
+    return id, jpeg, payload, bool(flags & 0x04)
+
+
+def preview_client(host, port=8090, frames=100):
+    import websocket
+
+    ws = websocket.create_connection(f"ws://{host}:{port}/?format=framed")
+    total = 0
+    start = time.time()
+    for _ in range(frames):
+        id, jpeg, payload, stale = parse_preview(ws.recv())
+        total += len(jpeg)
+        if jpeg and not jpeg.startswith(b"\xff\xd8"):
+            print(f"preview: frame {id} is not a JPEG")
+            return False
+    ws.close()
+    print(f"preview: {frames} frames, {total / frames:.0f} JPEG bytes/frame, {frames / (time.time() - start):.1f} fps")
+    return True
+
+
+def bench_encoding(broker, port, frames=200, timeout=60):
+    # bytes per invoke event and client decode time for each encoding, one flow at a time
+    results = {}
+    for encoding in ("json", "cbor", "msgpack"):
+        client = SSCMANodeClient("recamera", "v0")
+        camera = CameraNode(client)
+        model = ModelNode(client, debug=True, encoding=encoding)
+        camera.sink(model)
+        sizes = []
+        decode_us = []
+        done = threading.Event()
+
+        def on_message(mqtt_client, userdata, msg, model=model):
+            if msg.topic.split("/")[-1] != model.id:
+                return
+            start = time.perf_counter()
+            payload = expand(decode(msg.payload, encoding), model.labels)
+            elapsed = (time.perf_counter() - start) * 1e6
+            if payload.get("name") != "invoke":
+                return
+            sizes.append(len(msg.payload))
+            decode_us.append(elapsed)
+            if len(sizes) >= frames:
+                done.set()
+
+        client.mqtt_client.on_message = on_message
+        client.start(broker, port)
+        done.wait(timeout)
+        client.stop()
+        if sizes:
+            results[encoding] = (sum(sizes) / len(sizes), sum(decode_us) / len(decode_us))
+            print(f"{encoding}: {len(sizes)} events, {results[encoding][0]:.0f} bytes/event, {results[encoding][1]:.1f} us/event to decode")
+    return results
+
+
+def crash_recording(host, port=1883, slice_time=60, record=20):
+    # kill the service mid-slice and check the fmp4 it was writing still plays up to the kill
+    import subprocess
+    client = SSCMANodeClient("recamera", "v0")
+    camera = CameraNode(client)
+    saving = SaveNode(client, storage="local", slice_time=slice_time, container="fmp4")
+    camera.sink(saving)
+    client.start(host, port)
+    time.sleep(record)
+    ssh = ["ssh", "-o", "StrictHostKeyChecking=no", f"root@{host}"]
+    subprocess.run(ssh + ["killall", "-9", "sscma-node"], check=False)
+    client.stop()
+    newest = subprocess.run(ssh + ["ls -t /userdata/Videos/*.mp4 | head -n 1"], capture_output=True, text=True).stdout.strip()
+    if not newest:
+        print("no recording found")
+        return False
+    local = "/tmp/" + newest.split("/")[-1]
+    subprocess.run(["scp", "-o", "StrictHostKeyChecking=no", f"root@{host}:{newest}", local], check=True)
+    probe = subprocess.run(["ffprobe", "-v", "error", "-count_packets", "-select_streams", "v:0",
+                            "-show_entries", "stream=nb_read_packets:format=duration", "-of", "json", local],
+                           capture_output=True, text=True)
+    if probe.returncode != 0:
+        print(f"{local} does not play: {probe.stderr}")
+        return False
+    info = json.loads(probe.stdout)
+    packets = int(info["streams"][0].get("nb_read_packets", 0)) if info.get("streams") else 0
+    print(f"{local}: {packets} video packets, {info.get('format', {}).get('duration')} s")
+    return packets > 0
+
+
 if __name__ == "__main__":
     client = SSCMANodeClient("recamera", "v0")
+
+    if len(sys.argv) > 1 and sys.argv[1] == "stress":
+        client.start("192.168.42.1", 1883)
+        ok = stress_control(client)
+        client.stop()
+        sys.exit(0 if ok else 1)
+
+    if len(sys.argv) > 1 and sys.argv[1] == "preview":
+        camera = CameraNode(client)
+        model = ModelNode(client, debug=True)
+        camera.sink(model)
+        client.start("192.168.42.1", 1883)
+        time.sleep(3)
+        ok = preview_client("192.168.42.1")
+        client.stop()
+        sys.exit(0 if ok else 1)
+
+    if len(sys.argv) > 1 and sys.argv[1] == "crash":
+        ok = crash_recording("192.168.42.1")
+        sys.exit(0 if ok else 1)
+
+    if len(sys.argv) > 1 and sys.argv[1] == "bench":
+        results = bench_encoding("192.168.42.1", 1883)
+        sys.exit(0 if len(results) == 3 else 1)
     
     camera = CameraNode(client)
     model = ModelNode(client, tiou=0.25, tscore=0.45) 